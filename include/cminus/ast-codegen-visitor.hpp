@@ -1,22 +1,93 @@
 #pragma once
 #include <cminus/ast-visitor.hpp>
+#include <cminus/range-analysis.hpp>
 
 namespace cminus
 {
+/// Optimizations performed by the code generator.
+struct CodegenOptions
+{
+    /// Keeps variables in registers (see `ASTCodegenVisitor`).
+    bool regalloc = false;
+
+    /// Evaluates expressions in registers (see `ASTCodegenVisitor`).
+    bool expr_regs = false;
+
+    /// Multiplies by constants with shifts and adds, and divides by
+    /// constants with a multiplication by their reciprocal.
+    bool strength_reduce = false;
+
+    /// Elides the bounds checks found by `analyze_bounds_checks`.
+    bool bounds_check_elim = false;
+
+    /// Omits saving the return address and parameters of functions
+    /// which make no calls.
+    bool leaf_frames = false;
+
+    /// Turns calls in tail position into jumps.
+    bool tail_calls = false;
+
+    /// Branches on the operands of comparisons in conditions instead of
+    /// computing their truth value.
+    bool fused_branches = false;
+
+    /// Tests the condition of loops at their bottom.
+    bool rotate_loops = false;
+
+    /// \returns the optimizations enabled by an optimization level.
+    static auto from_level(int level) -> CodegenOptions;
+};
+
 /// This is a code generator for MIPS.
 ///
 /// The generated code is fully compatible with the O32 ABI, thus functions
 /// generated by this may be used by foreign functions in the system.
 ///
-/// This generator does no perform register allocation, therefore the
-/// spit code makes very poor use of registers. Indeed, it makes poor
+/// By default this generator does no perform register allocation, therefore
+/// the spit code makes very poor use of registers. Indeed, it makes poor
 /// use of everything as there is no optimization whatsover.
 ///
+/// With `CodegenOptions::regalloc`, scalar variables and array parameters
+/// are assigned to registers by linear scan over their live intervals. Those
+/// live across calls use the callee-saved registers ($s0-$s7), which are
+/// saved in the prologue and restored in the epilogue.
+///
+/// With `CodegenOptions::expr_regs`, the operands of expressions are held in
+/// the caller-saved registers left free by the variables. Each expression is
+/// labelled with its Sethi-Ullman number, that is, the number of registers
+/// needed to evaluate it, and the heavier operand is evaluated first whenever
+/// that does not change the observable behaviour of the program. Operands are
+/// only spilled into the temporary block of the frame when the registers run
+/// out or a call would clobber them.
+///
+/// With `CodegenOptions::bounds_check_elim`, subscripts proven non-negative
+/// are not checked, and the checks of subscripts which do not change within
+/// a loop are performed once before entering it.
+///
+/// With `CodegenOptions::leaf_frames`, functions making no calls keep $ra and
+/// their first parameters in place, and have no stack frame at all unless
+/// they need one for their locals.
+///
+/// With `CodegenOptions::tail_calls`, a function returning the result of a
+/// call tears down its frame and jumps into the callee, which returns to the
+/// original caller. A function calling itself this way jumps back to its
+/// beginning instead, reusing its frame.
+///
+/// With `CodegenOptions::fused_branches`, conditions of selection and
+/// iteration statements which are comparisons jump on their operands, with
+/// `beq` and `bne`, with `slt` followed by either, or with `bltz` and friends
+/// when one of the operands is zero.
+///
+/// With `CodegenOptions::rotate_loops`, the condition of a loop is tested
+/// once before entering it, then at the bottom of its body, which branches
+/// back to its beginning while the condition holds.
+///
 class ASTCodegenVisitor : public ASTVisitor
 {
 public:
-    explicit ASTCodegenVisitor(std::string& dest) :
-        dest(dest)
+    explicit ASTCodegenVisitor(std::string& dest, CodegenOptions options = {}) :
+        dest(dest),
+        options(options)
     {
     }
 
@@ -59,10 +130,107 @@ public:
         int32_t input_offset(int32_t offset) const;
     };
 
+    struct ExprLabel
+    {
+        int32_t need = 0;              //< registers needed besides $v0 and $t0
+        bool has_call = false;         //< whether a call is performed
+        bool has_side_effects = false; //< whether a call or assignment is performed
+    };
+
+    /// Bounds checks elided from a function.
+    struct BoundsCheckStats
+    {
+        std::string function;
+        size_t num_checks = 0;  //< subscripts in the function
+        size_t num_removed = 0; //< checks proven redundant
+        size_t num_hoisted = 0; //< checks moved before a loop
+    };
+
+    /// \returns the bounds checks elided from each function, if
+    /// `CodegenOptions::bounds_check_elim` is enabled.
+    auto get_bounds_check_stats() const -> const std::vector<BoundsCheckStats>&
+    {
+        return bounds_check_stats;
+    }
+
+    /// Registers assigned to a function.
+    struct RegisterInfo
+    {
+        /// Registers of the variables kept in registers.
+        std::unordered_map<ASTVarDecl*, int> var_regs;
+        /// Callee-saved registers used by the variables.
+        std::vector<int> saved_regs;
+        /// Registers available for evaluating expressions.
+        std::vector<int> expr_regs;
+        /// Labels of the expressions.
+        std::unordered_map<ASTExpr*, ExprLabel> expr_labels;
+        /// Whether the function makes no calls, thus its parameters are
+        /// kept in $a0-$a3 and $ra is not saved.
+        bool is_leaf = false;
+    };
+
 private:
+    /// Assigns registers to the variables and expressions of a function.
+    void allocate_registers(ASTFunDecl& decl);
+
+    /// Assigns registers to the variables of a function by linear scan.
+    void allocate_var_registers(ASTFunDecl& decl);
+
+    /// \returns the register assigned to a variable or `-1` if the variable
+    /// lives in memory.
+    int reg_of(ASTVarDecl& decl) const;
+
     /// Loads the address of the variable into $v0.
     void load_address_of(ASTVarRef&);
 
+    /// Exits the program if the index in $v0 is negative.
+    void emit_bounds_check();
+
+    /// Evaluates the arguments of a call into $a0-$a3 and the output block.
+    void emit_call_args(ASTFunCall& call);
+
+    /// Checks whether a call in tail position may be turned into a jump.
+    bool can_tail_call(ASTFunCall& call);
+
+    /// Emits the restoration of the saved registers and the stack pointer.
+    void emit_frame_teardown();
+
+    /// Loads the address of the first element of an array into `reg`,
+    /// unless the array parameter is kept in a register.
+    ///
+    /// \returns the register holding the address.
+    int load_base_address(int reg, ASTVarDecl& decl);
+
+    /// Loads a number or a scalar variable into `reg`, unless the variable
+    /// is kept in a register.
+    ///
+    /// \returns the register holding the value.
+    int load_leaf(int reg, ASTExpr& leaf);
+
+    /// Stores $v0 into a scalar variable kept in memory.
+    void store_into(ASTVarDecl& decl);
+
+    /// Emits the computation of `lhs op rhs` into $v0.
+    void emit_binary_op(ASTBinaryExpr::Operation op, int lhs, int rhs);
+
+    /// Evaluates a binary expression into $v0 or, if `branch_label` is not
+    /// `-1`, jumps to `branch_label` if the truth of the comparison `expr`
+    /// is `branch_when`.
+    void emit_binary_expr(ASTBinaryExpr& expr, int32_t branch_label, bool branch_when);
+
+    /// Emits a jump to `label` if the truth of `cond` is `when`.
+    void emit_cond_branch(ASTExpr& cond, bool when, int32_t label);
+
+    /// Emits a jump to `label` unless `lhs op rhs` holds, where `op` is a
+    /// comparison. Either operand may be $0.
+    void emit_compare_branch(ASTBinaryExpr::Operation op, int lhs, int rhs, int32_t label);
+
+    /// Emits the multiplication of `src` by a constant into $v0.
+    void emit_multiply_by(int src, int32_t factor);
+
+    /// Emits the signed division of `src` by a constant into $v0.
+    void emit_divide_by(int src, int32_t divisor);
+
     /// Emits a store word into the current stack frame.
     void emit_frame_sw(int reg, int32_t frame_offset);
 
@@ -86,14 +254,23 @@ private:
 
 private:
     std::string& dest;
+    CodegenOptions options;
     std::unordered_map<ASTFunDecl*, FrameInfo> frames;
     std::unordered_map<ASTVarDecl*, int32_t> local_pos;
 
+    RegisterInfo regs;
+    size_t num_used_expr_regs = 0;
+
+    BoundsCheckInfo bounds;
+    std::vector<BoundsCheckStats> bounds_check_stats;
+
     FrameInfo current_frame;
     int32_t current_temp_pos = 0;
     int32_t current_label_id = 0;
     bool inside_function = false;
     int32_t function_label_goto_ob = -1;
     int32_t function_epilogue_label;
+    int32_t function_entry_label = -1;
+    ASTFunDecl* current_function = nullptr;
 };
 }
@@ -0,0 +1,33 @@
+#pragma once
+#include <cminus/ast-visitor.hpp>
+#include <unordered_set>
+
+namespace cminus
+{
+/// Removes the statements which cannot be reached and the assignments to
+/// locals which are never read, in place.
+///
+/// This must run on semantically analyzed trees, preferably after constant
+/// folding. Statements following a return, an `if` returning from both of
+/// its branches or a loop whose condition is a non-zero constant are
+/// removed, as well as branches and loops whose condition is a constant
+/// never taking them.
+///
+/// A backward liveness analysis over the scalar locals and parameters of
+/// each function finds the assignments whose value is overwritten or left
+/// unused on every path, which are replaced by their right-hand side. Thus
+/// calls in it are still performed, and expression statements are only
+/// removed when evaluating them has no observable effect. Arrays are never
+/// considered dead, since they may be passed to and read by other functions.
+class ASTDeadCodeVisitor : public ASTVisitor
+{
+public:
+    explicit ASTDeadCodeVisitor() = default;
+
+    void visit_program(ASTProgram& program) override;
+    void visit_fun_decl(ASTFunDecl& decl) override;
+
+private:
+    std::unordered_set<ASTVarDecl*> globals;
+};
+}
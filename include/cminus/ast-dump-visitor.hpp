@@ -1,12 +1,16 @@
 #pragma once
 #include <cminus/ast-visitor.hpp>
+#include <cminus/utility/output_sink.hpp>
 
 namespace cminus
 {
+/// Dumps the abstract syntax tree in a bracketed notation.
+///
+/// The dump is written into the sink as the tree is traversed.
 class ASTDumpVisitor : public ASTVisitor
 {
 public:
-    explicit ASTDumpVisitor(std::string& dest) :
+    explicit ASTDumpVisitor(OutputSink& dest) :
         dest(dest)
     {
     }
@@ -36,7 +40,7 @@ private:
     void newline(size_t depth);
 
 private:
-    std::string& dest;
+    OutputSink& dest;
     size_t depth = 0;
 };
 }
@@ -0,0 +1,41 @@
+#pragma once
+#include <cminus/ast-visitor.hpp>
+
+namespace cminus
+{
+/// Folds constant expressions and simplifies algebraic identities of the
+/// abstract syntax tree, in place.
+///
+/// This must run on semantically analyzed trees. Arithmetic wraps around as
+/// the 32-bit two's complement arithmetic of the target does. Divisions by
+/// zero are left to the runtime.
+///
+/// The identity (e.g. `x + 0`, `x * 1`) and annihilator (e.g. `x * 0`) rules
+/// are applied, and chains of constants like `x + 1 + 2` are merged. An
+/// operand is only dropped when evaluating it has no observable effect,
+/// which excludes calls, assignments and subscripts that may be out of bounds.
+class ASTFoldVisitor : public ASTVisitor
+{
+public:
+    explicit ASTFoldVisitor() = default;
+
+    void visit_program(ASTProgram& program) override;
+
+    void visit_compound_stmt(ASTCompoundStmt& stmt) override;
+    void visit_selection_stmt(ASTSelectionStmt& stmt) override;
+    void visit_iteration_stmt(ASTIterationStmt& stmt) override;
+    void visit_return_stmt(ASTReturnStmt& stmt) override;
+
+    void visit_var_expr(ASTVarRef& expr) override;
+    void visit_call_expr(ASTFunCall& expr) override;
+    void visit_binary_expr(ASTBinaryExpr& expr) override;
+
+    /// \returns the folded form of an expression, which may be the
+    /// expression itself.
+    auto fold(std::shared_ptr<ASTExpr> expr) -> std::shared_ptr<ASTExpr>;
+
+private:
+    /// The folded form of the most recently visited expression.
+    std::shared_ptr<ASTExpr> folded;
+};
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cminus/ast-visitor.hpp>
+#include <cstdint>
+#include <unordered_map>
+
+namespace cminus
+{
+/// Computes a structural hash of the abstract syntax tree.
+///
+/// The hash covers node kinds, operations, types and constants, but not
+/// identifiers nor source locations. References are hashed by the position
+/// of their declaration instead: top-level declarations by their order in
+/// the program, and local declarations by their de Bruijn index (i.e. how
+/// many local declarations are in scope between the reference and the
+/// declaration). Hence, programs that only differ by the naming of their
+/// symbols or by formatting hash equally.
+///
+/// Builtin functions are the exception. They are not declared in the
+/// program, thus they are hashed by name.
+///
+/// The hash of every statement and expression subtree is recorded as well.
+/// Notice local references are context dependent, so subtree hashes are only
+/// comparable between subtrees within the same scope.
+class ASTHashVisitor : public ASTVisitor
+{
+public:
+    explicit ASTHashVisitor() = default;
+
+    void visit_program(ASTProgram& program) override;
+
+    void visit_var_decl(ASTVarDecl& decl) override;
+    void visit_parm_decl(ASTParmVarDecl& decl) override;
+    void visit_fun_decl(ASTFunDecl& decl) override;
+
+    void visit_null_stmt(ASTNullStmt& stmt) override;
+    void visit_compound_stmt(ASTCompoundStmt& stmt) override;
+    void visit_selection_stmt(ASTSelectionStmt& stmt) override;
+    void visit_iteration_stmt(ASTIterationStmt& stmt) override;
+    void visit_return_stmt(ASTReturnStmt& stmt) override;
+
+    void visit_number_expr(ASTNumber& expr) override;
+    void visit_var_expr(ASTVarRef& expr) override;
+    void visit_call_expr(ASTFunCall& expr) override;
+    void visit_binary_expr(ASTBinaryExpr& expr) override;
+
+    /// \returns the hash of the most recently visited node (i.e. of the
+    /// program after `visit_program`).
+    uint64_t get_hash() const { return last_hash; }
+
+    /// \returns the hash of a visited statement or expression subtree.
+    uint64_t hash_of(const ASTStmt& stmt) const;
+
+private:
+    /// Hashes the visitation of an optional statement.
+    uint64_t hash_optional(ASTStmt* stmt);
+
+    /// Binds a declaration to a new de Bruijn level.
+    void bind_local(const ASTVarDecl& decl);
+
+    /// Records the hash of a statement subtree.
+    void record(const ASTStmt& stmt, uint64_t hash);
+
+private:
+    std::unordered_map<const ASTStmt*, uint64_t> subtree_hashes;
+
+    /// Position of top-level declarations in the program.
+    std::unordered_map<const ASTDecl*, uint64_t> global_levels;
+
+    /// Locals in scope, indexed by de Bruijn level.
+    std::vector<const ASTVarDecl*> local_stack;
+    std::unordered_map<const ASTVarDecl*, uint64_t> local_levels;
+
+    uint64_t last_hash = 0;
+};
+}
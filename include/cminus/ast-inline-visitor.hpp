@@ -0,0 +1,54 @@
+#pragma once
+#include <cminus/ast-visitor.hpp>
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace cminus
+{
+/// Inlines calls to small functions into their callers, in place.
+///
+/// This must run on semantically analyzed trees. A callee is inlined when its
+/// body is no larger than a cost budget, measured in nodes after inlining
+/// into the callee itself, and when it does not call itself. Functions are
+/// processed in program order, so chains of small functions collapse.
+///
+/// The parameters and locals of the callee become fresh locals of the caller,
+/// which receive frame slots (or registers) of their own. Array parameters
+/// are not copied; their references are rewritten into references to the
+/// array passed by the caller.
+///
+/// Since statements cannot be nested in expressions, the cloned body is placed
+/// before the statement performing the call, so only calls performed before
+/// anything observable in that statement are inlined (e.g. the call in
+/// `x = f(y) + g[i]` but not the one in `x = g[i] + f(y)`). Calls in loop
+/// conditions are never inlined. Returns become assignments to a result
+/// variable, which requires the callee to not return from within a loop.
+class ASTInlineVisitor : public ASTVisitor
+{
+public:
+    /// The default cost budget of a callee.
+    static constexpr size_t default_max_cost = 32;
+
+    explicit ASTInlineVisitor(size_t max_cost = default_max_cost) :
+        max_cost(max_cost)
+    {
+    }
+
+    void visit_program(ASTProgram& program) override;
+    void visit_fun_decl(ASTFunDecl& decl) override;
+
+    /// \returns the number of calls inlined so far.
+    auto get_num_inlined() const -> size_t { return this->num_inlined; }
+
+private:
+    /// Checks whether calls to a function may be inlined.
+    bool is_inlinable(ASTFunDecl& decl);
+
+private:
+    size_t max_cost;
+    size_t num_inlined = 0;
+    std::unordered_map<ASTFunDecl*, bool> inlinable;
+    std::unordered_set<ASTVarDecl*> globals;
+};
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cminus/ast-codegen-visitor.hpp>
+#include <cminus/ast-visitor.hpp>
+#include <cminus/ir.hpp>
+#include <cminus/range-analysis.hpp>
+#include <unordered_map>
+
+namespace cminus
+{
+/// Optimizations performed while lowering.
+struct LowerOptions
+{
+    /// Elides the bounds checks found by `analyze_bounds_checks`, as
+    /// `CodegenOptions::bounds_check_elim` does.
+    bool bounds_check_elim = false;
+};
+
+/// Lowers the abstract syntax tree into the intermediate representation.
+///
+/// This must run on semantically analyzed trees. Variables live in stack slots
+/// (or globals) and are accessed through loads and stores, with the slots of
+/// variables in sibling scopes sharing the same place in the frame.
+///
+/// Instructions are produced in the order `ASTCodegenVisitor` evaluates
+/// expressions when no optimizations are enabled, and labels are numbered in
+/// the same order, so `IRCodegen` reproduces its code. Every value is defined
+/// and used within the same block. Code following a return is kept in a block
+/// of its own, which nothing branches into.
+///
+/// With `LowerOptions::bounds_check_elim`, subscripts proven non-negative are
+/// not checked, and the ones which do not change within a loop are checked
+/// in a block of their own, entered before the loop when its condition holds.
+class ASTLowerVisitor : public ASTVisitor
+{
+public:
+    using BoundsCheckStats = ASTCodegenVisitor::BoundsCheckStats;
+
+    explicit ASTLowerVisitor(IRModule& module, LowerOptions options = {}) :
+        module(module),
+        options(options)
+    {
+    }
+
+    /// \returns the bounds checks elided from each function, if
+    /// `LowerOptions::bounds_check_elim` is enabled.
+    auto get_bounds_check_stats() const -> const std::vector<BoundsCheckStats>&
+    {
+        return bounds_check_stats;
+    }
+
+    void visit_program(ASTProgram& program) override;
+
+    void visit_var_decl(ASTVarDecl& decl) override;
+    void visit_fun_decl(ASTFunDecl& decl) override;
+
+    void visit_compound_stmt(ASTCompoundStmt& stmt) override;
+    void visit_selection_stmt(ASTSelectionStmt& stmt) override;
+    void visit_iteration_stmt(ASTIterationStmt& stmt) override;
+    void visit_return_stmt(ASTReturnStmt& stmt) override;
+
+    void visit_number_expr(ASTNumber& expr) override;
+    void visit_var_expr(ASTVarRef& expr) override;
+    void visit_call_expr(ASTFunCall& expr) override;
+    void visit_binary_expr(ASTBinaryExpr& expr) override;
+
+private:
+    /// \returns the value of an expression.
+    auto lower_expr(ASTExpr& expr) -> IRValue;
+
+    /// Appends a check of a subscript.
+    void emit_check(IRValue index);
+
+    /// \returns the address of the variable or element referenced.
+    auto lower_address(ASTVarRef& var_ref) -> IRValue;
+
+    /// \returns the address of a variable, or of the first element of an array.
+    auto lower_base_address(ASTVarDecl& decl) -> IRValue;
+
+    /// \returns the function corresponding to a declaration.
+    auto function_of(ASTFunDecl& decl) -> IRFunction*;
+
+    /// Appends an instruction into the current block. Instructions following a
+    /// terminator are placed in a new block.
+    auto emit(IRInst inst) -> IRInst&;
+
+    /// Appends an instruction defining a value of the given type.
+    auto emit_value(IRInst inst, IRType type) -> IRValue;
+
+    /// Appends a jump to `target`.
+    void emit_jump(IRBlock* target);
+
+    /// Lays out a block, which becomes the current one.
+    auto start_block(std::unique_ptr<IRBlock> block) -> IRBlock*;
+
+private:
+    IRModule& module;
+    LowerOptions options;
+    BoundsCheckInfo bounds;
+    std::vector<BoundsCheckStats> bounds_check_stats;
+    std::unordered_map<ASTFunDecl*, IRFunction*> functions;
+    std::unordered_map<ASTVarDecl*, IRGlobal*> globals;
+    std::unordered_map<ASTVarDecl*, IRSlot*> slots;
+
+    IRFunction* function = nullptr;
+    IRBlock* block = nullptr;
+    int32_t current_local_pos = 0;
+
+    /// The value of the most recently visited expression.
+    IRValue result = ir_no_value;
+};
+}
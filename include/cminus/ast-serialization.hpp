@@ -0,0 +1,208 @@
+#pragma once
+#include <cminus/ast-visitor.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace cminus
+{
+/// Layout of the binary AST format.
+///
+/// A serialized AST is a header followed by three tables:
+///
+///     | header | node records | child lists | string table |
+///
+/// + The node records are fixed-size and are referenced by their index in
+///   the table. Every node appears after its childrens, except for the body
+///   of a function, which appears after the function (so recursive calls can
+///   refer to it).
+/// + The child lists hold node indices of variable sized childrens (e.g. the
+///   statements of a compound statement or the arguments of a call).
+/// + The string table holds the names of declarations. Names are referenced
+///   as views into the mapped file, thus they are never copied.
+///
+/// The format is host-endian and is meant as a cache for the same machine,
+/// not as an interchange format.
+namespace astfmt
+{
+constexpr char magic[4] = {'C', 'M', 'A', 'S'};
+constexpr uint32_t version = 1;
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+/// Denotes the absence of a child node.
+constexpr uint32_t no_node = UINT32_MAX;
+
+enum class NodeKind : uint8_t
+{
+    VarDecl,
+    ParmVarDecl,
+    FunDecl,
+    NullStmt,
+    CompoundStmt,
+    SelectionStmt,
+    IterationStmt,
+    ReturnStmt,
+    Number,
+    VarRef,
+    FunCall,
+    BinaryExpr,
+    AssignExpr,
+};
+
+enum NodeFlags : uint8_t
+{
+    flag_is_array = (1 << 0), //< for `VarDecl` and `ParmVarDecl`
+    flag_is_void = (1 << 1),  //< for `FunDecl`
+    flag_has_body = (1 << 2), //< for `FunDecl`
+};
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t num_nodes;
+    uint32_t nodes_offset;
+    uint32_t num_list_items;
+    uint32_t lists_offset;
+    uint32_t strtab_size;
+    uint32_t strtab_offset;
+    uint32_t program_list; //< index into the child lists
+    uint32_t program_num_decls;
+};
+
+/// The meaning of `child` depends on the kind of node:
+///
+/// + VarDecl, ParmVarDecl: `{array_size, -, -}`
+/// + FunDecl: `{params_list, num_params, body}`
+/// + CompoundStmt: `{list, num_decls, num_stmts}` (decls come first in list)
+/// + SelectionStmt: `{cond, then, else}`
+/// + IterationStmt: `{cond, body, -}`
+/// + ReturnStmt: `{expr, -, -}`
+/// + Number: `{value, -, -}`
+/// + VarRef: `{decl, index, -}`
+/// + FunCall: `{decl, args_list, num_args}`
+/// + BinaryExpr, AssignExpr: `{left, right, -}` (operation in `op`)
+///
+/// The string (`str_offset`, `str_size`) is the name of declarations and
+/// references or the lexeme of numbers.
+struct NodeRecord
+{
+    NodeKind kind;
+    uint8_t flags;
+    uint16_t op;
+    uint32_t str_offset;
+    uint32_t str_size;
+    uint32_t child[3];
+};
+
+static_assert(sizeof(Header) == 44);
+static_assert(sizeof(NodeRecord) == 24);
+}
+
+/// Serializes a semantically analyzed AST into the binary AST format.
+///
+/// References to declarations are kept resolved, hence reading the AST
+/// back requires no semantic analysis.
+class ASTSerializerVisitor : public ASTVisitor
+{
+public:
+    explicit ASTSerializerVisitor(std::string& dest) :
+        dest(dest)
+    {
+    }
+
+    void visit_program(ASTProgram& program) override;
+
+    void visit_var_decl(ASTVarDecl& decl) override;
+    void visit_parm_decl(ASTParmVarDecl& decl) override;
+    void visit_fun_decl(ASTFunDecl& decl) override;
+
+    void visit_null_stmt(ASTNullStmt& stmt) override;
+    void visit_compound_stmt(ASTCompoundStmt& stmt) override;
+    void visit_selection_stmt(ASTSelectionStmt& stmt) override;
+    void visit_iteration_stmt(ASTIterationStmt& stmt) override;
+    void visit_return_stmt(ASTReturnStmt& stmt) override;
+
+    void visit_number_expr(ASTNumber& expr) override;
+    void visit_var_expr(ASTVarRef& expr) override;
+    void visit_call_expr(ASTFunCall& expr) override;
+    void visit_binary_expr(ASTBinaryExpr& expr) override;
+
+private:
+    /// Appends a node record and returns its index.
+    uint32_t add_node(astfmt::NodeKind kind, SourceRange str,
+                      uint32_t child0 = astfmt::no_node,
+                      uint32_t child1 = astfmt::no_node,
+                      uint32_t child2 = astfmt::no_node);
+
+    /// Appends a child list and returns the index of its first item.
+    uint32_t add_list(const std::vector<uint32_t>& items);
+
+    /// Interns a string into the string table.
+    uint32_t add_string(SourceRange str);
+
+    /// Gets the node index of a declaration, serializing it if needed.
+    ///
+    /// Declarations not in the program (i.e. builtins) are serialized on
+    /// their first reference.
+    uint32_t decl_index(ASTDecl& decl);
+
+    /// Visits an optional node and returns its index.
+    uint32_t visit_optional(ASTStmt* stmt);
+
+private:
+    std::string& dest;
+
+    std::vector<astfmt::NodeRecord> nodes;
+    std::vector<uint32_t> lists;
+    std::string strtab;
+    std::unordered_map<SourceRange, uint32_t> strings;
+    std::unordered_map<ASTDecl*, uint32_t> decls;
+
+    /// Index of the most recently serialized node.
+    uint32_t last_node = astfmt::no_node;
+};
+
+/// A binary AST mapped into memory.
+///
+/// Names in the loaded tree are views into the mapping, hence this object
+/// must outlive the tree returned by `load_program`.
+class ASTFile
+{
+public:
+    ASTFile(const ASTFile&) = delete;
+    ASTFile& operator=(const ASTFile&) = delete;
+
+    ASTFile(ASTFile&&) noexcept;
+    ASTFile& operator=(ASTFile&&) noexcept;
+
+    ~ASTFile();
+
+    /// Maps a binary AST from a file stream.
+    ///
+    /// Streams which cannot be mapped (e.g. pipes) are read into memory.
+    ///
+    /// \returns The mapped file or `std::nullopt` when a stream failure
+    ///          occurs. Call `std::ferror` for error details.
+    static auto from_stream(std::FILE* stream) -> std::optional<ASTFile>;
+
+    /// Builds the tree described by the mapped file.
+    ///
+    /// \returns the program or `nullptr` if the file is not a valid binary
+    ///          AST of the current version.
+    auto load_program() const -> std::shared_ptr<ASTProgram>;
+
+private:
+    explicit ASTFile(const char* data, size_t size, bool is_mapped);
+
+    template<typename T>
+    auto table(uint32_t offset, uint32_t count) const -> const T*;
+
+private:
+    const char* data;
+    size_t size;
+    bool is_mapped; //< otherwise `data` is owned by new[]
+};
+}
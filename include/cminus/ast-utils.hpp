@@ -0,0 +1,20 @@
+#pragma once
+#include <cminus/ast.hpp>
+#include <optional>
+
+namespace cminus
+{
+/// \returns the value of a number expression or `std::nullopt` if the
+/// expression is not a number.
+auto number_value(ASTExpr& expr) -> std::optional<int32_t>;
+
+/// Checks whether evaluating an expression has no observable effect.
+///
+/// Subscripts are only known to be in bounds when the index is a
+/// non-negative constant, since just the lower bound is checked.
+bool is_pure(ASTExpr& expr);
+
+/// Checks whether control never flows past a statement, that is, whether
+/// every path through it reaches a return or loops forever.
+bool always_returns(ASTStmt& stmt);
+}
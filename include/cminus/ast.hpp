@@ -406,6 +406,13 @@ public:
         return expr;
     }
 
+    /// Replaces the subscript expression.
+    void set_index(std::shared_ptr<ASTExpr> index)
+    {
+        assert(this->expr != nullptr && index != nullptr);
+        this->expr = std::move(index);
+    }
+
     auto expr_kind() const -> ExprKind override
     {
         return ExprKind::VarRef;
@@ -499,9 +506,10 @@ public:
 public:
     explicit ASTBinaryExpr(std::shared_ptr<ASTExpr> left,
                            std::shared_ptr<ASTExpr> right,
-                           Operation op) :
+                           Operation op,
+                           SourceLocation op_loc = nullptr) :
         left(std::move(left)),
-        right(std::move(right)), op(op)
+        right(std::move(right)), op(op), op_loc(op_loc)
     {
         assert(this->left != nullptr && this->right != nullptr);
     }
@@ -515,6 +523,27 @@ public:
     auto get_right() -> std::shared_ptr<ASTExpr> { return right; }
     auto get_operation() const -> Operation { return op; }
 
+    /// \returns the location of the operator or `nullptr` if unknown
+    /// (e.g. the tree was not built from source).
+    auto op_location() const -> SourceLocation { return op_loc; }
+
+    /// Replaces the left operand.
+    ///
+    /// The left operand of an assignment must remain a variable reference.
+    void set_left(std::shared_ptr<ASTExpr> expr)
+    {
+        assert(expr != nullptr);
+        assert(op != Operation::Assign || expr->expr_kind() == ExprKind::VarRef);
+        this->left = std::move(expr);
+    }
+
+    /// Replaces the right operand.
+    void set_right(std::shared_ptr<ASTExpr> expr)
+    {
+        assert(expr != nullptr);
+        this->right = std::move(expr);
+    }
+
     auto expr_kind() const -> ExprKind override
     {
         return ExprKind::BinaryExpr;
@@ -539,6 +568,7 @@ private:
     std::shared_ptr<ASTExpr> left;
     std::shared_ptr<ASTExpr> right;
     Operation op;
+    SourceLocation op_loc;
 };
 
 /// Node of an assignment expression.
@@ -546,8 +576,9 @@ class ASTAssignExpr : public ASTBinaryExpr
 {
 public:
     explicit ASTAssignExpr(std::shared_ptr<ASTVarRef> left,
-                           std::shared_ptr<ASTExpr> right) :
-        ASTBinaryExpr(std::move(left), std::move(right), Operation::Assign)
+                           std::shared_ptr<ASTExpr> right,
+                           SourceLocation op_loc = nullptr) :
+        ASTBinaryExpr(std::move(left), std::move(right), Operation::Assign, op_loc)
     {
     }
 
@@ -589,6 +620,13 @@ public:
     auto stmt_begin() { return stms.begin(); }
     auto stmt_end() { return stms.end(); }
 
+    /// Removes the statements in the range `[first, last)`.
+    void stmt_erase(std::vector<std::shared_ptr<ASTStmt>>::iterator first,
+                    std::vector<std::shared_ptr<ASTStmt>>::iterator last)
+    {
+        this->stms.erase(first, last);
+    }
+
     auto stmt_kind() const -> StmtKind override
     {
         return StmtKind::CompoundStmt;
@@ -621,6 +659,27 @@ public:
     auto get_then() -> std::shared_ptr<ASTStmt> { return stmt1; }
     auto get_else() -> std::shared_ptr<ASTStmt> { return stmt2; }
 
+    /// Replaces the condition.
+    void set_cond(std::shared_ptr<ASTExpr> cond)
+    {
+        assert(cond != nullptr);
+        this->expr = std::move(cond);
+    }
+
+    /// Replaces the statement executed when the condition holds.
+    void set_then(std::shared_ptr<ASTStmt> stmt)
+    {
+        assert(stmt != nullptr);
+        this->stmt1 = std::move(stmt);
+    }
+
+    /// Replaces the statement executed otherwise, which must exist.
+    void set_else(std::shared_ptr<ASTStmt> stmt)
+    {
+        assert(this->stmt2 != nullptr && stmt != nullptr);
+        this->stmt2 = std::move(stmt);
+    }
+
     auto stmt_kind() const -> StmtKind override
     {
         return StmtKind::SelectionStmt;
@@ -651,6 +710,20 @@ public:
     auto get_cond() -> std::shared_ptr<ASTExpr> { return expr; }
     auto get_body() -> std::shared_ptr<ASTStmt> { return stmt; }
 
+    /// Replaces the condition.
+    void set_cond(std::shared_ptr<ASTExpr> cond)
+    {
+        assert(cond != nullptr);
+        this->expr = std::move(cond);
+    }
+
+    /// Replaces the loop body.
+    void set_body(std::shared_ptr<ASTStmt> body)
+    {
+        assert(body != nullptr);
+        this->stmt = std::move(body);
+    }
+
     auto stmt_kind() const -> StmtKind override
     {
         return StmtKind::IterationStmt;
@@ -670,14 +743,27 @@ private:
 class ASTReturnStmt : public ASTStmt
 {
 public:
-    explicit ASTReturnStmt(std::shared_ptr<ASTExpr> expr) :
-        expr(std::move(expr))
+    explicit ASTReturnStmt(std::shared_ptr<ASTExpr> expr,
+                           SourceLocation loc = nullptr) :
+        expr(std::move(expr)),
+        loc(loc)
     {
     }
 
     /// \returns the return expression or `nullptr` if none.
     auto get_expr() -> std::shared_ptr<ASTExpr> { return expr; }
 
+    /// Replaces the return expression.
+    void set_expr(std::shared_ptr<ASTExpr> expr)
+    {
+        assert(this->expr != nullptr && expr != nullptr);
+        this->expr = std::move(expr);
+    }
+
+    /// \returns the location of the return keyword or `nullptr` if unknown
+    /// (e.g. the tree was not built from source).
+    auto location() const -> SourceLocation { return loc; }
+
     auto stmt_kind() const -> StmtKind override
     {
         return StmtKind::ReturnStmt;
@@ -690,5 +776,6 @@ public:
 
 private:
     std::shared_ptr<ASTExpr> expr; //< may be null
+    SourceLocation loc;
 };
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cminus/mem-report.hpp>
 #include <cminus/sourceman.hpp>
 #include <functional>
 #include <memory>
@@ -77,6 +78,7 @@ public:
                                DiagnosticManager& manager) :
         manager(manager)
     {
+        MemScope mem_scope(MemTag::Diagnostics);
         diag_ptr.reset(new Diagnostic{source, loc, code});
     }
 
@@ -92,6 +94,7 @@ public:
     template<typename Arg>
     DiagnosticBuilder& arg(Arg&& arg)
     {
+        MemScope mem_scope(MemTag::Diagnostics);
         diag_ptr->args.emplace_back(std::forward<Arg>(arg));
         return *this;
     }
@@ -99,6 +102,7 @@ public:
     /// Appends a range to be highlighted on the diagnostic.
     DiagnosticBuilder& range(SourceRange sr)
     {
+        MemScope mem_scope(MemTag::Diagnostics);
         diag_ptr->ranges.emplace_back(std::move(sr));
         return *this;
     }
@@ -151,11 +155,39 @@ protected:
     void emit(std::unique_ptr<Diagnostic> diag_ptr);
 
     friend class DiagnosticBuilder;
+    friend class DiagnosticBuffer;
 
 private:
     std::function<bool(const Diagnostic&)> curr_diag_handler;
 };
 
+/// A diagnostic manager which holds the reported diagnostics back, so they
+/// can be propagated later on into another manager.
+///
+/// This allows diagnostics produced concurrently to be propagated in a
+/// deterministic order.
+class DiagnosticBuffer : public DiagnosticManager
+{
+public:
+    explicit DiagnosticBuffer();
+
+    /// \returns the number of diagnostics reported into this buffer so far.
+    auto size() const -> size_t { return diags.size(); }
+
+    /// Propagates the buffered diagnostics into `diagman`.
+    void flush_into(DiagnosticManager& diagman) { flush_into(diagman, size()); }
+
+    /// Propagates the buffered diagnostics into `diagman`, up to (but not
+    /// including) the `last`-th diagnostic reported into this buffer.
+    ///
+    /// Diagnostics are never propagated twice.
+    void flush_into(DiagnosticManager& diagman, size_t last);
+
+private:
+    std::vector<std::unique_ptr<Diagnostic>> diags;
+    size_t num_flushed = 0;
+};
+
 // The builder must be a small object.
 static_assert(sizeof(DiagnosticBuilder) <= 2 * sizeof(size_t));
 }
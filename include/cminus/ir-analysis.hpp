@@ -0,0 +1,90 @@
+#pragma once
+#include <cminus/ir.hpp>
+
+namespace cminus
+{
+/// \returns the predecessors of each block of a function, indexed by the
+/// identifier of the blocks.
+auto compute_predecessors(IRFunction& function) -> std::vector<std::vector<IRBlock*>>;
+
+/// The dominator tree of a function, whose blocks must all be reachable
+/// from the entry block.
+///
+/// A block dominates another when every path from the entry into the latter
+/// goes through the former. The immediate dominators are computed by the
+/// iterative algorithm of Cooper, Harvey and Kennedy ("A Simple, Fast
+/// Dominance Algorithm"), which also gives the dominance frontiers.
+class DominatorTree
+{
+public:
+    explicit DominatorTree(IRFunction& function);
+
+    /// \returns the immediate dominator of a block or `nullptr` for the entry.
+    auto get_idom(const IRBlock& block) const -> IRBlock*
+    {
+        return idoms[block.get_id()];
+    }
+
+    /// \returns the blocks immediately dominated by a block.
+    auto get_children(const IRBlock& block) const -> const std::vector<IRBlock*>&
+    {
+        return children[block.get_id()];
+    }
+
+    /// \returns the blocks where the dominance of a block ends, that is, the
+    /// blocks not strictly dominated by it with a predecessor dominated by it.
+    auto get_frontier(const IRBlock& block) const -> const std::vector<IRBlock*>&
+    {
+        return frontiers[block.get_id()];
+    }
+
+    /// \returns the predecessors of a block.
+    auto get_preds(const IRBlock& block) const -> const std::vector<IRBlock*>&
+    {
+        return preds[block.get_id()];
+    }
+
+    /// \returns the blocks in reverse postorder of a depth-first search from
+    /// the entry, in which blocks come before the ones they dominate.
+    auto get_rpo() const -> const std::vector<IRBlock*>& { return rpo; }
+
+    /// Checks whether `a` dominates `b`. Every block dominates itself.
+    bool dominates(const IRBlock& a, const IRBlock& b) const;
+
+private:
+    std::vector<std::vector<IRBlock*>> preds;
+    std::vector<IRBlock*> idoms;
+    std::vector<std::vector<IRBlock*>> children;
+    std::vector<std::vector<IRBlock*>> frontiers;
+    std::vector<IRBlock*> rpo;
+    std::vector<int32_t> rpo_index;
+};
+
+/// A natural loop, that is, the blocks reaching the source of a back edge
+/// (an edge into a block dominating its source, the header of the loop)
+/// without going through the header.
+struct IRLoop
+{
+    IRBlock* header;
+    std::vector<IRBlock*> blocks;  //< in reverse postorder, thus the header first
+    std::vector<IRBlock*> latches; //< sources of the back edges
+    std::vector<bool> contains;    //< indexed by the identifier of the blocks
+};
+
+/// \returns the natural loops of a function, inner loops before the ones
+/// containing them. Back edges into the same header make a single loop.
+auto find_loops(const DominatorTree& domtree) -> std::vector<IRLoop>;
+
+/// The values live at the boundaries of each block of a function.
+///
+/// The operands of a phi are live out of the corresponding predecessor,
+/// but not into the block of the phi, which defines its result.
+struct Liveness
+{
+    std::vector<std::vector<bool>> live_in;  //< indexed by block and value
+    std::vector<std::vector<bool>> live_out; //< indexed by block and value
+};
+
+/// \returns the values live at the boundaries of each block of a function.
+auto compute_liveness(IRFunction& function) -> Liveness;
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <cminus/ast-codegen-visitor.hpp>
+#include <cminus/ir-analysis.hpp>
+#include <cminus/ir-regalloc.hpp>
+#include <cminus/ir.hpp>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace cminus
+{
+/// Optimizations performed by the code generator from the intermediate
+/// representation.
+struct IRCodegenOptions
+{
+    /// Keeps values in registers (see `IRCodegen`).
+    bool regalloc = false;
+
+    /// Multiplies and divides by constants with shifts and the like rather
+    /// than `mult` and `div`. Only applies along with `regalloc`.
+    bool strength_reduce = false;
+};
+
+/// This is a code generator for MIPS from the intermediate representation.
+///
+/// The generated code follows the O32 ABI, as the one of `ASTCodegenVisitor`.
+///
+/// By default values are computed into $v0. A value is moved out of it as
+/// soon as its next use is not the instruction expecting it there: left
+/// operands (and addresses of stores or subscripts) are saved into the
+/// temporary block of the frame and reloaded into $t0 by the instruction
+/// using them, while arguments are moved into $a0-$a3 or the output block.
+/// Temporary space is reserved for the whole tree of each instruction
+/// spilling its left operand, thus the code for modules produced by
+/// `ASTLowerVisitor` is the same as the one `ASTCodegenVisitor` produces
+/// without optimizations. In this mode every value must be used within the
+/// block defining it, by instructions following the definition in the order
+/// described above.
+///
+/// With `IRCodegenOptions::regalloc`, functions must be in SSA form, and
+/// values are kept in the registers given by `allocate_registers`, or in the
+/// spill area (the temporary block) of the frame. Phis are resolved by moves
+/// at the end of the predecessors. When the predecessor has other successors
+/// and some operand is not already in place, the moves are done before the
+/// branch if they overwrite nothing it or the other successor reads, or else
+/// in a stub jumped into by the branch. Comparisons used only by the branch right after them are not
+/// computed, but branched on. Calls whose result is returned right away jump
+/// into the callee, or past the prologue when calling the function itself.
+/// Functions making no other calls do not save $ra, and have no stack frame
+/// unless they need one.
+class IRCodegen
+{
+public:
+    using FrameInfo = ASTCodegenVisitor::FrameInfo;
+
+    explicit IRCodegen(std::string& dest, IRCodegenOptions options = {}) :
+        dest(dest),
+        options(options)
+    {
+    }
+
+    void emit_module(IRModule& module);
+
+private:
+    /// A use of a value by the `arg`-th operand of an instruction.
+    struct ValueUse
+    {
+        IRInst* inst;
+        size_t arg;
+    };
+
+    /// A register or a word of the frame, or the instruction computing a
+    /// value which lives in neither.
+    struct Location
+    {
+        int reg = -1;
+        int32_t frame_offset = -1;     //< if not a register
+        const IRInst* remat = nullptr; //< if rematerialized
+
+        bool operator==(const Location& other) const
+        {
+            return reg == other.reg && frame_offset == other.frame_offset
+                   && remat == other.remat;
+        }
+    };
+
+    /// The moves resolving the phis of a block entered from an edge which
+    /// is not its only one, placed out of line.
+    struct EdgeStub
+    {
+        int32_t label;
+        IRBlock* from;
+        IRBlock* to;
+    };
+
+    /// A copy into the first location from the second.
+    using Move = std::pair<Location, Location>;
+
+    /// A conditional branch instruction but for its target.
+    struct BranchCond
+    {
+        const char* mnemonic;
+        int rs;
+        int rt = -1; //< unless comparing against zero
+    };
+
+    void emit_function(IRModule& module, IRFunction& function);
+
+    /// Computes the layout of the frame of a function and the temporary
+    /// slot of each instruction spilling its left operand.
+    void layout_frame(IRFunction& function);
+
+    /// Gives labels to blocks entered other than by falling through.
+    void label_targets(IRModule& module, IRFunction& function);
+
+    void emit_block(IRFunction& function, IRBlock& block, IRBlock* next);
+    void emit_inst(IRFunction& function, IRInst& inst, IRBlock* next);
+
+    /// Moves the value in $v0 out of it if its next use expects it elsewhere.
+    void move_out_of_v0();
+
+    void emit_allocated_function(IRModule& module, IRFunction& function);
+    void emit_allocated_inst(IRModule& module, IRFunction& function,
+                             IRBlock& block, IRInst& inst, IRBlock* next);
+
+    /// Receives a parameter into its value.
+    void emit_param(IRInst& inst);
+
+    /// Restores the registers saved by the prologue and pops the frame.
+    void emit_frame_teardown();
+
+    /// Emits what a branch needs before its branch instructions.
+    ///
+    /// \returns the branch instructions jumping when its condition holds
+    /// and when it does not.
+    auto emit_branch_conds(const IRInst& branch) -> std::pair<BranchCond, BranchCond>;
+
+    /// Emits a branch into `target`, or into a stub resolving its phis
+    /// unless they need no moves or the moves may be done before the branch,
+    /// where control may flow into `other` instead.
+    void emit_branch_to(IRModule& module, const BranchCond& cond,
+                        IRBlock& block, IRBlock& target, IRBlock& other);
+
+    /// Checks whether moves into the phis of the target of a branch may be
+    /// done before it, that is, they do not overwrite the operands of the
+    /// branch or what the other successor `other` reads.
+    bool can_move_before_branch(const std::vector<Move>& moves, const BranchCond& cond,
+                                IRBlock& block, IRBlock& other) const;
+
+    /// \returns the moves into the phis of `to` when entered from `from`,
+    /// but for the ones whose value is already in place.
+    auto phi_moves(IRBlock& from, IRBlock& to) const -> std::vector<Move>;
+
+    /// Emits the moves into the phis of `to` when entered from `from`.
+    void emit_phi_moves(IRBlock& from, IRBlock& to);
+
+    /// Emits moves which read all of their sources before writing any of
+    /// their destinations.
+    void emit_parallel_moves(std::vector<Move> moves);
+
+    /// Computes a rematerialized value into `rd`.
+    void emit_remat(int rd, const IRInst& inst);
+
+    /// Emits a multiplication or division by a constant without `mult` or
+    /// `div`, unless it is cheaper with them.
+    ///
+    /// \returns whether it did.
+    bool emit_reduced_op(const IRInst& inst);
+
+    /// \returns the location of a value.
+    auto location_of(IRValue value) const -> Location;
+
+    /// \returns the register holding an operand, which is loaded into
+    /// `scratch` when it lives in the frame, or computed into it when it
+    /// is rematerialized.
+    int use_reg(IRValue value, int scratch);
+
+    /// \returns the register a result is computed into.
+    int def_reg(IRValue value);
+
+    /// Stores a result computed into a scratch register into the frame.
+    void finish_def(IRValue value);
+
+    /// Copies between two locations, through `scratch` if both are words
+    /// of the frame.
+    void emit_move(Location to, Location from, int scratch);
+
+    void emit_binary_op(IROp op, int rd, int rs, int rt);
+    void emit_jump(int32_t label);
+    void emit_frame_sw(int reg, int32_t frame_offset);
+    void emit_frame_lw(int reg, int32_t frame_offset);
+
+    /// \returns the offset of a slot from the stack pointer.
+    int32_t slot_offset(IRSlot& slot) const;
+
+    /// Gets the name of the register number `reg`.
+    static auto regname(int reg) -> const char*;
+
+private:
+    std::string& dest;
+    IRCodegenOptions options;
+
+    FrameInfo frame;
+    std::unordered_map<const IRInst*, int32_t> temp_pos;
+    std::vector<std::vector<ValueUse>> uses;
+    std::vector<size_t> num_used;
+    IRValue v0_value = ir_no_value;
+    int32_t exit_label = -1;
+    int32_t entry_label = -1; //< past the prologue, for self tail calls
+    std::vector<std::optional<Location>> param_locs;
+
+    IRRegisterAssignment assignment;
+    Liveness liveness;
+    std::unordered_map<const IRSlot*, int32_t> local_pos;
+    std::vector<EdgeStub> edge_stubs;
+    std::unordered_map<const IRInst*, const IRInst*> fused_compares; //< by branch
+    std::unordered_set<const IRInst*> fused_insts;
+    std::vector<bool> zero_values;
+    std::vector<const IRInst*> value_defs;
+};
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cminus/ir.hpp>
+
+namespace cminus
+{
+/// Removes the blocks which cannot be reached from the entry of a function,
+/// such as the ones holding statements after a return.
+///
+/// \returns the number of blocks removed.
+auto remove_unreachable_blocks(IRFunction& function) -> size_t;
+
+/// Rotates loops, such that their condition is tested at the bottom.
+///
+/// Blocks jumping back into a block ending in a branch get a copy of its
+/// instructions in place of the jump, thus the original block is only a
+/// guard tested before entering the loop, and each iteration takes a single
+/// branch. Only small blocks whose values are all defined within them are
+/// copied, which is always the case before promoting slots.
+///
+/// \returns the number of jumps replaced.
+auto rotate_loops(IRFunction& function) -> size_t;
+
+/// Promotes the slots of scalar variables into values in SSA form, that is,
+/// values defined by a single instruction, merged by phis where different
+/// definitions reach the same block.
+///
+/// The address of a scalar can never be taken in cminus, thus every scalar
+/// local and parameter is promoted, and its loads and stores disappear.
+/// Phis are placed on the iterated dominance frontier of the blocks storing
+/// into a slot, and the ones left unused or merging a single value are
+/// removed afterwards. Locals read before being assigned to evaluate to
+/// zero.
+///
+/// Every block of the function must be reachable from its entry.
+///
+/// \returns the number of slots promoted.
+auto promote_slots(IRFunction& function) -> size_t;
+
+/// Removes the instructions computing a value which is already computed
+/// wherever they are reached, that is, by an instruction dominating them.
+///
+/// Pure expressions are numbered over the dominator tree, such that
+/// expressions with the same operation and operands, or swapped operands
+/// when the operation allows, get the same number. Subscript checks of an
+/// index already checked are removed as well. A load reuses the value of a
+/// load or store of the same address before it, within the same block or
+/// blocks entered only from it, unless a store or call is in between, which
+/// may write to any array. The function must be in SSA form.
+///
+/// \returns the number of instructions removed.
+auto number_values(IRFunction& function) -> size_t;
+
+/// Moves the instructions of loops computing the same value in every
+/// iteration, such as the addresses of arrays, into the block entering the
+/// loop, so that they are computed once.
+///
+/// Only instructions with no effect but their result are moved, since the
+/// block entering a loop may also skip it, and the ones computing the same
+/// value are moved as one. Constants are copied instead, to be kept as
+/// immediates of the instructions of the loop. The function must be in SSA
+/// form.
+///
+/// \returns the number of instructions moved.
+auto hoist_loop_invariants(IRFunction& function) -> size_t;
+
+/// Reduces the strength of the subscripts of loops indexed by an induction
+/// variable, that is, a value stepped by a constant in each iteration.
+///
+/// Addresses computed as `base + 4 * i` from a base not changing within the
+/// loop become a pointer, which is stepped by four times as much as `i`.
+/// Subscripts of the same base share their pointer, and the ones indexed by
+/// `i` plus a constant add it to the pointer. The function must be in SSA
+/// form, with invariants hoisted out of loops.
+///
+/// \returns the number of pointers created.
+auto reduce_induction_variables(IRFunction& function) -> size_t;
+
+/// Removes the instructions computing a value which is never used, such as
+/// the ones assigning to a local which is overwritten before being read.
+///
+/// Stores, calls and terminators are kept along with every value they
+/// depend on, as are subscript checks, except the ones of a constant index
+/// which is not negative. Anything else is removed, including phis only
+/// used by each other within loops. The function must be in SSA form.
+///
+/// \returns the number of instructions removed.
+auto remove_dead_values(IRFunction& function) -> size_t;
+
+/// Runs the optimization passes over every function of a module.
+void optimize_ir(IRModule& module);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cminus/ir.hpp>
+#include <unordered_set>
+
+namespace cminus
+{
+/// Registers and stack slots assigned to the values of a function.
+struct IRRegisterAssignment
+{
+    /// The register holding each value or `-1` if it lives in the spill area.
+    std::vector<int> regs;
+    /// The offset into the spill area of each value which lives there.
+    std::vector<int32_t> spill_pos;
+    /// Whether each value is computed again by every use instead, which
+    /// only constants, addresses and cheap arithmetic whose operands are in
+    /// registers are.
+    std::vector<bool> rematerialized;
+    /// The size of the spill area, in bytes.
+    int32_t spill_size = 0;
+    /// The callee-saved registers holding values.
+    std::vector<int> saved_regs;
+    /// Whether the function makes any call but for tail calls.
+    bool has_calls = false;
+    /// The calls whose result is returned right after them, which jump into
+    /// the callee, thus no value lives across them.
+    std::unordered_set<const IRInst*> tail_calls;
+};
+
+/// Assigns registers to the values of a function in SSA form by linear scan
+/// over their live intervals.
+///
+/// Instructions are numbered in the order the blocks are laid out, and the
+/// interval of a value covers every point it is live at, including the ends
+/// of the predecessors passing it to a phi. Values live across calls use the
+/// callee-saved registers ($s0-$s7), and the others prefer the caller-saved
+/// ones ($t1-$t9). When the registers run out, the value whose interval ends
+/// last is spilled, that is, it lives in the spill area of the frame, unless
+/// some constant, address or cheap arithmetic may be computed again by its
+/// uses instead. Arithmetic is only computed again when its operands are
+/// live throughout its interval and stay in registers. A phi
+/// and its operands take the same register whenever it is free, so the phi
+/// needs no moves.
+///
+/// Since the operands of an instruction are read before its result is
+/// written, a value may take the register of an operand dying there.
+auto allocate_registers(IRFunction& function) -> IRRegisterAssignment;
+}
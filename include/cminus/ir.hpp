@@ -0,0 +1,355 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cminus
+{
+/// A value of the intermediate representation, that is, the number of the
+/// virtual register holding it.
+using IRValue = int32_t;
+
+/// The absence of a value (e.g. the destination of a store).
+constexpr IRValue ir_no_value = -1;
+
+/// The type of a value of the intermediate representation.
+enum class IRType : uint8_t
+{
+    I32, //< a 32-bit integer
+    Ptr, //< the address of a word
+};
+
+/// The operations of the intermediate representation.
+///
+/// Operands are listed in the order they are held by `IRInst::args`.
+enum class IROp : uint8_t
+{
+    Const,      //< dest = imm
+    Param,      //< dest = value of the imm-th parameter on entry
+    FrameAddr,  //< dest = address of slot
+    GlobalAddr, //< dest = address of global
+    Load,       //< dest = word at address
+    Store,      //< word at address = value
+    ElemAddr,   //< dest = base + 4 * index
+    Check,      //< leaves the program if index < 0
+    Add,        //< dest = lhs + rhs
+    Sub,        //< dest = lhs - rhs
+    Mul,        //< dest = lhs * rhs
+    Div,        //< dest = lhs / rhs
+    Lt,         //< dest = lhs < rhs
+    Le,         //< dest = lhs <= rhs
+    Gt,         //< dest = lhs > rhs
+    Ge,         //< dest = lhs >= rhs
+    Eq,         //< dest = lhs == rhs
+    Ne,         //< dest = lhs != rhs
+    Call,       //< dest = callee(args...), dest is absent for void callees
+    Phi,        //< dest = args[i] when entered from incoming[i]
+    Jump,       //< goes to targets[0]
+    Branch,     //< goes to targets[0] if cond != 0, otherwise to targets[1]
+    Return,     //< returns from the function, with a value if any
+};
+
+class IRBlock;
+class IRFunction;
+
+/// A global variable.
+struct IRGlobal
+{
+    std::string name;
+    int32_t size = 4; //< in bytes
+};
+
+/// A word or array of the stack frame of a function.
+///
+/// Parameters have a slot of their own, which holds their value (or the
+/// address of the array, for array parameters) when the function is entered.
+struct IRSlot
+{
+    int32_t id = 0;
+    std::string name;
+    int32_t size = 4;         //< in bytes
+    int32_t offset = 0;       //< into the local block, for locals
+    int32_t param_index = -1; //< index of the parameter or -1 for locals
+    IRType type = IRType::I32; //< type of the values held, for scalars
+
+    bool is_param() const { return param_index != -1; }
+};
+
+/// An instruction of the intermediate representation.
+struct IRInst
+{
+    IROp op;
+    IRValue dest = ir_no_value;
+    std::vector<IRValue> args;
+
+    int32_t imm = 0;                   //< constant of `Const`
+    IRSlot* slot = nullptr;            //< slot of `FrameAddr`
+    IRGlobal* global = nullptr;        //< global of `GlobalAddr`
+    IRFunction* callee = nullptr;      //< callee of `Call`
+    IRBlock* targets[2] = {nullptr, nullptr}; //< successors of a terminator
+    std::vector<IRBlock*> incoming;           //< predecessors of the operands of `Phi`
+
+    explicit IRInst(IROp op) :
+        op(op)
+    {
+    }
+
+    /// Checks whether this instruction ends a basic block.
+    bool is_terminator() const
+    {
+        return op == IROp::Jump || op == IROp::Branch || op == IROp::Return;
+    }
+
+    /// Checks whether this is one of the arithmetic or relational operations.
+    bool is_binary() const
+    {
+        return op >= IROp::Add && op <= IROp::Ne;
+    }
+
+    /// Checks whether this is one of the relational operations.
+    bool is_comparison() const
+    {
+        return op >= IROp::Lt && op <= IROp::Ne;
+    }
+};
+
+/// A basic block, that is, a sequence of instructions ended by a terminator
+/// which is only entered at its beginning.
+class IRBlock
+{
+public:
+    explicit IRBlock(int32_t label) :
+        label(label)
+    {
+    }
+
+    /// \returns the position of this block in the layout of its function or
+    /// `-1` if it is not laid out yet.
+    auto get_id() const -> int32_t { return this->id; }
+
+    /// \returns the assembly label of this block or `-1` if it has none.
+    ///
+    /// Blocks which are only entered by falling through from the preceding
+    /// block need no label.
+    auto get_label() const -> int32_t { return this->label; }
+
+    void set_label(int32_t label) { this->label = label; }
+
+    auto begin() { return insts.begin(); }
+    auto end() { return insts.end(); }
+    auto size() const -> size_t { return insts.size(); }
+    bool empty() const { return insts.empty(); }
+
+    auto back() -> IRInst& { return insts.back(); }
+
+    /// \returns the blocks control may flow into after this one.
+    auto successors() const -> std::vector<IRBlock*>
+    {
+        std::vector<IRBlock*> result;
+        if(is_terminated())
+        {
+            for(auto target : insts.back().targets)
+            {
+                if(target && std::find(result.begin(), result.end(), target) == result.end())
+                    result.push_back(target);
+            }
+        }
+        return result;
+    }
+
+    /// Checks whether this block ends in a terminator.
+    bool is_terminated() const
+    {
+        return !insts.empty() && insts.back().is_terminator();
+    }
+
+    /// Appends an instruction to the end of this block.
+    auto append(IRInst inst) -> IRInst&
+    {
+        assert(!is_terminated());
+        insts.push_back(std::move(inst));
+        return insts.back();
+    }
+
+    /// Removes the last instruction.
+    void pop_back() { insts.pop_back(); }
+
+    /// Inserts an instruction before the `pos`-th one.
+    auto insert(size_t pos, IRInst inst) -> IRInst&
+    {
+        assert(pos <= insts.size());
+        return *insts.insert(insts.begin() + pos, std::move(inst));
+    }
+
+    /// Removes the instructions satisfying a predicate.
+    template<typename Pred>
+    void remove_if(Pred pred)
+    {
+        insts.erase(std::remove_if(insts.begin(), insts.end(), pred), insts.end());
+    }
+
+private:
+    friend class IRFunction;
+
+    int32_t id = -1;
+    int32_t label;
+    std::vector<IRInst> insts;
+};
+
+/// A function of the intermediate representation.
+///
+/// The blocks are kept in the order they are laid out in the generated code,
+/// thus the first block is the entry of the function. A block falls through
+/// into the next one when its terminator targets it.
+class IRFunction
+{
+public:
+    explicit IRFunction(std::string name, int32_t num_params, bool is_void) :
+        name(std::move(name)),
+        num_params(num_params), is_void_retn(is_void)
+    {
+    }
+
+    auto get_name() const -> const std::string& { return this->name; }
+    auto get_num_params() const -> int32_t { return this->num_params; }
+    bool is_void() const { return this->is_void_retn; }
+
+    /// Checks whether this function is defined elsewhere (i.e. by the runtime).
+    bool is_external() const { return blocks.empty(); }
+
+    auto block_begin() { return blocks.begin(); }
+    auto block_end() { return blocks.end(); }
+    auto num_blocks() const -> size_t { return blocks.size(); }
+
+    auto slot_begin() { return slots.begin(); }
+    auto slot_end() { return slots.end(); }
+
+    /// \returns the type of a value.
+    auto type_of(IRValue value) const -> IRType
+    {
+        assert(value >= 0 && static_cast<size_t>(value) < value_types.size());
+        return value_types[value];
+    }
+
+    /// \returns the number of values defined by this function.
+    auto num_values() const -> int32_t
+    {
+        return static_cast<int32_t>(value_types.size());
+    }
+
+    /// Creates a new value of the given type.
+    auto new_value(IRType type) -> IRValue
+    {
+        value_types.push_back(type);
+        return static_cast<IRValue>(value_types.size() - 1);
+    }
+
+    /// Creates a block which is not yet laid out.
+    auto new_block(int32_t label = -1) -> std::unique_ptr<IRBlock>
+    {
+        return std::make_unique<IRBlock>(label);
+    }
+
+    /// Lays out a block after the last block of this function.
+    auto append_block(std::unique_ptr<IRBlock> block) -> IRBlock*
+    {
+        block->id = static_cast<int32_t>(blocks.size());
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
+
+    /// \returns the block entered when the function is called.
+    auto get_entry() -> IRBlock& { return *blocks.front(); }
+
+    /// Removes the blocks satisfying a predicate, which nothing must
+    /// branch into anymore.
+    template<typename Pred>
+    void remove_blocks_if(Pred pred)
+    {
+        blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                    [&](const auto& block) { return pred(*block); }),
+                     blocks.end());
+        for(size_t i = 0; i < blocks.size(); ++i)
+            blocks[i]->id = static_cast<int32_t>(i);
+    }
+
+    /// Creates a new slot in the stack frame.
+    auto new_slot(std::string name, int32_t size) -> IRSlot*
+    {
+        auto slot = std::make_unique<IRSlot>();
+        slot->id = static_cast<int32_t>(slots.size());
+        slot->name = std::move(name);
+        slot->size = size;
+        slots.push_back(std::move(slot));
+        return slots.back().get();
+    }
+
+    /// \returns the size of the local block of the stack frame, in which the
+    /// slots of locals are placed.
+    auto get_local_size() const -> int32_t { return this->local_size; }
+    void set_local_size(int32_t size) { this->local_size = size; }
+
+    /// \returns the label jumped into when returning from the middle of the
+    /// function.
+    auto get_exit_label() const -> int32_t { return this->exit_label; }
+    void set_exit_label(int32_t label) { this->exit_label = label; }
+
+    /// \returns the label jumped into when a subscript check fails or `-1` if
+    /// there are no checks.
+    auto get_trap_label() const -> int32_t { return this->trap_label; }
+    void set_trap_label(int32_t label) { this->trap_label = label; }
+
+private:
+    std::string name;
+    int32_t num_params;
+    bool is_void_retn;
+
+    std::vector<std::unique_ptr<IRBlock>> blocks;
+    std::vector<std::unique_ptr<IRSlot>> slots;
+    std::vector<IRType> value_types;
+
+    int32_t local_size = 0;
+    int32_t exit_label = -1;
+    int32_t trap_label = -1;
+};
+
+/// A program in the intermediate representation.
+class IRModule
+{
+public:
+    auto global_begin() { return globals.begin(); }
+    auto global_end() { return globals.end(); }
+
+    auto function_begin() { return functions.begin(); }
+    auto function_end() { return functions.end(); }
+
+    auto new_global(std::string name, int32_t size) -> IRGlobal*
+    {
+        globals.push_back(std::make_unique<IRGlobal>(IRGlobal{std::move(name), size}));
+        return globals.back().get();
+    }
+
+    auto new_function(std::string name, int32_t num_params, bool is_void) -> IRFunction*
+    {
+        functions.push_back(std::make_unique<IRFunction>(std::move(name), num_params, is_void));
+        return functions.back().get();
+    }
+
+    /// Generates a label number, unique within the module.
+    auto new_label() -> int32_t { return ++this->last_label; }
+
+private:
+    std::vector<std::unique_ptr<IRGlobal>> globals;
+    std::vector<std::unique_ptr<IRFunction>> functions;
+    int32_t last_label = 0;
+};
+
+/// \returns the mnemonic of an operation, as printed by `print_ir`.
+auto ir_op_name(IROp op) -> const char*;
+
+/// Appends the textual form of a module into `dest`.
+void print_ir(IRModule& module, std::string& dest);
+}
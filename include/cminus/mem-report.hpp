@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace cminus
+{
+/// The compiler subsystems which memory usage is accounted for.
+enum class MemTag : uint8_t
+{
+    Other,       //< anything not in a subsystem scope
+    Source,      //< source text and line table
+    Diagnostics, //< diagnostic objects
+    AST,         //< tree nodes, their control blocks and child vectors
+    Symbols,     //< scopes and symbol tables
+    IR,          //< intermediate representation
+    Codegen,     //< code generation structures and output buffer
+    Output,      //< other output buffers (e.g. AST dumps)
+
+    Count,
+};
+
+/// Memory usage of a subsystem.
+struct MemStats
+{
+    size_t num_allocs = 0;
+    size_t num_frees = 0;
+    size_t bytes_allocated = 0; //< accumulated
+    size_t bytes_live = 0;
+    size_t bytes_peak = 0;
+};
+
+/// Attributes the allocations of the current thread to a subsystem
+/// while this object is alive.
+///
+/// Allocations are accounted for by the global allocation functions
+/// (`operator new` and friends) once `enable_mem_tracking` is called. They
+/// keep a small header in front of the allocated block, so deallocations
+/// are charged back to the same subsystem.
+class MemScope
+{
+public:
+    explicit MemScope(MemTag tag);
+    ~MemScope();
+
+    MemScope(const MemScope&) = delete;
+    MemScope& operator=(const MemScope&) = delete;
+
+private:
+    MemTag prev_tag;
+};
+
+/// Starts accounting for allocations, which costs a few atomic operations
+/// on counters shared by every thread per allocation.
+///
+/// Blocks allocated before this are not accounted for, even when freed.
+void enable_mem_tracking();
+
+/// \returns the memory usage of a subsystem so far.
+auto mem_stats(MemTag tag) -> MemStats;
+
+/// \returns the memory usage of the whole compiler so far.
+auto mem_stats_total() -> MemStats;
+
+/// Prints a table with the memory usage of each subsystem.
+void mem_report(std::FILE* stream);
+}
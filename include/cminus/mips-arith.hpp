@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace cminus
+{
+/// Emits the multiplication of `rs` by a constant into `rd` with shifts,
+/// additions and subtractions, using $t0 as a scratch register.
+///
+/// \returns whether it did, which it does not when a `mult` is cheaper.
+bool emit_multiply_by(std::string& dest, int rd, int rs, int32_t factor);
+
+/// Emits the signed division of `rs` by a constant into `rd` with shifts or
+/// a multiplication by a magic number, using $t0 as a scratch register.
+///
+/// \returns whether it did, which it does not for a zero divisor, whose
+/// trap must still happen at runtime by a `div`.
+bool emit_divide_by(std::string& dest, int rd, int rs, int32_t divisor);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cminus
+{
+/// A line of MIPS assembly code.
+struct MipsLine
+{
+    enum class Kind
+    {
+        Instruction,
+        Label,
+        Directive,
+    };
+
+    Kind kind;
+
+    /// The mnemonic of an instruction, the name of a label (without the
+    /// colon) or the whole text of a directive.
+    std::string text;
+
+    /// The operands of an instruction, as written.
+    std::vector<std::string> operands;
+};
+
+/// Splits MIPS assembly code into lines. A label followed by something else
+/// in the same line is split into two lines.
+auto parse_mips(std::string_view code) -> std::vector<MipsLine>;
+
+/// Writes lines of MIPS assembly code, one per line.
+void print_mips(const std::vector<MipsLine>& lines, std::string& dest);
+
+/// How much a peephole rule saved.
+struct PeepholeStats
+{
+    const char* rule;
+    size_t num_hits = 0;        //< times the rule was applied
+    size_t num_lines_saved = 0; //< lines removed by the rule
+};
+
+/// This is a peephole optimizer for the MIPS code of the code generators.
+///
+/// The code is taken as a list of lines and rewritten by the rules of a
+/// table of patterns, each matching a short sequence of consecutive lines
+/// with placeholders for mnemonics and operands, until none of them apply.
+/// Rules removing the definition of a register only apply when the register
+/// is dead afterwards, which is known from a liveness analysis over the
+/// control flow of each function. Calls are assumed to follow the O32 ABI,
+/// while the registers read by returns and calls to other code are the ones
+/// the ABI could have them read.
+class PeepholeOptimizer
+{
+public:
+    PeepholeOptimizer();
+
+    /// Optimizes the code of a whole module in place.
+    void optimize(std::string& code);
+
+    /// Optimizes the lines of a whole module in place.
+    void optimize(std::vector<MipsLine>& lines);
+
+    /// \returns how much each rule saved, in the order of the table.
+    auto get_stats() const -> std::vector<PeepholeStats>;
+
+private:
+    /// Optimizes the lines of a single function in place.
+    void optimize_function(std::vector<MipsLine>& lines);
+
+private:
+    std::vector<size_t> rule_hits;
+};
+
+/// How much the scheduler reordered.
+struct ScheduleStats
+{
+    size_t num_slots = 0;           //< delay slots
+    size_t num_slots_filled = 0;    //< delay slots not holding a nop
+    size_t num_load_uses = 0;       //< loads followed by a use of their result
+    size_t num_load_uses_split = 0; //< such loads given another instruction in between
+};
+
+/// This is a scheduler for targets executing the instruction following a
+/// branch, jump or call (its delay slot) before control is transferred.
+///
+/// The code is rewritten for the assembler to take it as is (in the
+/// `noreorder` mode). Within each basic block, an instruction is first moved
+/// in between every load and the instruction using its result right after,
+/// which would otherwise stall the pipeline, then into the delay slot of the
+/// transfer of control ending the block, which otherwise holds a nop. Moved
+/// instructions do not depend on the ones they cross, and are assembled into
+/// a single machine instruction.
+class MipsScheduler
+{
+public:
+    /// Schedules the code of a whole module in place.
+    void schedule(std::string& code);
+
+    /// Schedules the lines of a whole module in place.
+    void schedule(std::vector<MipsLine>& lines);
+
+    auto get_stats() const -> ScheduleStats { return stats; }
+
+private:
+    /// Schedules a basic block, which may end in a transfer of control.
+    void schedule_block(std::vector<MipsLine>& block, bool has_transfer);
+
+private:
+    ScheduleStats stats;
+};
+}
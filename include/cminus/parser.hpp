@@ -1,6 +1,9 @@
 #include <cminus/diagnostics.hpp>
+#include <cminus/mem-report.hpp>
 #include <cminus/scanner.hpp>
 #include <cminus/semantics.hpp>
+#include <cminus/utility/scope_guard.hpp>
+#include <utility>
 
 namespace cminus
 {
@@ -17,13 +20,34 @@ public:
     explicit Parser(Scanner& scanner,
                     Semantics& sema,
                     DiagnosticManager& diagman) :
-        scanner(scanner),
+        scanner(&scanner),
+        source(scanner.get_source()),
         sema(sema),
         diagman(diagman)
     {
-        peek_word = scanner.next_word();
-        for(auto& lw : lookahead_words)
-            lw = scanner.next_word();
+        fill_stream();
+    }
+
+    /// Creates a parser over words that were already scanned.
+    ///
+    /// The stream of words ends with `Category::Eof` just after `words`.
+    explicit Parser(const SourceFile& source,
+                    ArrayView<const Word> words,
+                    Semantics& sema,
+                    DiagnosticManager& diagman) :
+        source(source),
+        sema(sema),
+        diagman(diagman),
+        words_begin(words.begin()),
+        words_next(words.begin()),
+        words_end(words.end())
+    {
+        if(!words.empty())
+        {
+            auto last_word = words[words.size() - 1].lexeme;
+            this->eof_word = Word(Category::Eof, last_word.end(), last_word.end());
+        }
+        fill_stream();
     }
 
     Parser(const Parser&) = delete;
@@ -31,12 +55,45 @@ public:
 
     auto parse_program() -> std::shared_ptr<ASTProgram>;
 
+    /// Parses a program, parsing the bodies of its functions concurrently.
+    ///
+    /// The program is scanned up front. Top-level declarations and function
+    /// signatures are then parsed in order, and the bodies (found by brace
+    /// matching) are parsed in parallel, each by its own parser. The tree
+    /// and diagnostics are the same as the ones of `parse_program`.
+    ///
+    /// Small programs, and programs which fail to scan or whose braces do not
+    /// match, are simply parsed by `parse_program`.
+    static auto parse_program_parallel(SourceFile& source, DiagnosticManager& diagman)
+            -> std::shared_ptr<ASTProgram>;
+
 private:
+    /// Programs with less function bodies than this are parsed sequentially.
+    static constexpr size_t min_parallel_bodies = 32;
+
     auto parse_declaration() -> std::shared_ptr<ASTDecl>;
     auto parse_var_declaration() -> std::shared_ptr<ASTVarDecl>;
     auto parse_fun_declaration() -> std::shared_ptr<ASTFunDecl>;
+    auto parse_fun_start() -> std::shared_ptr<ASTFunDecl>;
+    auto parse_params(ASTFunDecl& fun_decl) -> bool;
     auto parse_param() -> std::shared_ptr<ASTParmVarDecl>;
 
+    /// Parses a function declaration up to (but not including) its body.
+    auto parse_fun_signature() -> std::shared_ptr<ASTFunDecl>;
+
+    /// Parses the body of a function whose signature was parsed by
+    /// `parse_fun_signature`, possibly by another parser.
+    auto parse_fun_body(std::shared_ptr<ASTFunDecl> fun_decl)
+            -> std::shared_ptr<ASTFunDecl>;
+
+    /// Skips the compound statement starting at the peek word, without
+    /// parsing it.
+    ///
+    /// Only possible on parsers over scanned words.
+    ///
+    /// \returns the words of the compound statement.
+    auto skip_compound_stmt() -> ArrayView<const Word>;
+
     auto parse_statement() -> std::shared_ptr<ASTStmt>;
     auto parse_expr_stmt() -> std::shared_ptr<ASTStmt>;
     auto parse_compound_stmt(ScopeFlags) -> std::shared_ptr<ASTCompoundStmt>;
@@ -72,10 +129,30 @@ private:
         auto ate_word = std::exchange(peek_word, lookahead_words[0]);
         std::move(&lookahead_words[1], &lookahead_words[num_lws],
                   lookahead_words);
-        lookahead_words[num_lws - 1] = scanner.next_word();
+        lookahead_words[num_lws - 1] = next_word();
+        ++this->num_consumed;
         return ate_word;
     }
 
+    /// \returns the next word from the scanner or the scanned words.
+    auto next_word() -> Word
+    {
+        if(scanner)
+            return scanner->next_word();
+        else if(words_next != words_end)
+            return *words_next++;
+        else
+            return eof_word;
+    }
+
+    /// Reads the peek word and the lookahead words.
+    void fill_stream()
+    {
+        peek_word = next_word();
+        for(auto& lw : lookahead_words)
+            lw = next_word();
+    }
+
     /// Tries to consume the next word from the stream.
     ///
     /// \returns the word if the category matches with any in `args...`,
@@ -98,7 +175,7 @@ private:
     {
         if(peek_word.category != category)
         {
-            diagman.report(scanner.get_source(), peek_word.location(),
+            diagman.report(source, peek_word.location(),
                            Diag::parser_expected_token, category);
             return std::nullopt;
         }
@@ -107,14 +184,39 @@ private:
 
     auto expect_and_consume_type() -> std::optional<Word>;
 
+    /// Truncates a scratch stack back to `size` once the returned guard
+    /// goes out of scope.
+    template<typename T>
+    static auto scratch_guard(std::vector<T>& stack, size_t size)
+    {
+        return ScopeGuard([&stack, size] { stack.resize(size); });
+    }
+
 private:
-    Scanner& scanner;
+    Scanner* scanner = nullptr; //< null when parsing scanned words
+    const SourceFile& source;
     Semantics& sema;
     DiagnosticManager& diagman;
 
+    // The scanned words being parsed, if any.
+    const Word* words_begin = nullptr;
+    const Word* words_next = nullptr;
+    const Word* words_end = nullptr;
+    Word eof_word;
+
+    /// The number of words consumed so far.
+    size_t num_consumed = 0;
+
     /// The next word to be consumed from the stream.
     Word peek_word;
     /// Some more words after the peek word.
     Word lookahead_words[2];
+
+    // Scratch stacks for collecting the childrens of nodes being parsed.
+    // They are shared by nested nodes (each one owns the top of the stack)
+    // so no allocation takes place once they have grown big enough.
+    std::vector<std::shared_ptr<ASTVarDecl>> scratch_decls;
+    std::vector<std::shared_ptr<ASTStmt>> scratch_stms;
+    std::vector<std::shared_ptr<ASTExpr>> scratch_args;
 };
 }
@@ -0,0 +1,37 @@
+#pragma once
+#include <cminus/ast.hpp>
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cminus
+{
+/// The bounds checks of a function which need not be performed in place.
+///
+/// Only negative subscripts are checked at runtime, since the size of array
+/// parameters is unknown (see `ASTCodegenVisitor`).
+struct BoundsCheckInfo
+{
+    /// Subscripts whose index is proven to be non-negative.
+    std::unordered_set<ASTVarRef*> redundant;
+
+    /// Subscripts whose index is checked once before entering a loop.
+    std::unordered_set<ASTVarRef*> hoisted;
+
+    /// The subscripts checked before entering each loop, in evaluation order.
+    std::unordered_map<ASTIterationStmt*, std::vector<ASTVarRef*>> loop_checks;
+
+    /// Number of subscripts in the function.
+    size_t num_subscripts = 0;
+};
+
+/// Finds the bounds checks of a function which may be elided.
+///
+/// An interval analysis over the scalar locals and parameters of the
+/// function proves which subscripts are non-negative. Checks of subscripts
+/// whose index does not change within a loop are moved before the loop as
+/// long as they would be performed before anything observable happens
+/// in its first iteration.
+auto analyze_bounds_checks(ASTFunDecl& decl) -> BoundsCheckInfo;
+}
@@ -2,6 +2,7 @@
 #include <cminus/ast.hpp>
 #include <cminus/diagnostics.hpp>
 #include <cminus/sourceman.hpp>
+#include <cminus/utility/array_view.hpp>
 #include <unordered_map>
 
 namespace cminus
@@ -40,33 +41,54 @@ constexpr bool operator!(ScopeFlags value)
     return !(static_cast<uint32_t>(value));
 }
 
-/// This stores scope information, including a symbol table.
-class Scope
+/// This is the symbol table of every scope in the current scope chain.
+///
+/// Instead of a table per scope, a single open addressing table keyed by
+/// name is used. Each name points to a stack of declarations (the top being
+/// the visible one, shadowing the others). Every insertion is recorded in
+/// an undo log, which is unwound once its scope is left.
+///
+/// Hence, lookups take constant time regardless of the scope depth, and
+/// entering a scope allocates nothing.
+///
+/// A table may also be chained to a read-only view of an outer table, in
+/// which names not found in the table itself are looked up.
+class SymbolTable
 {
 public:
-    explicit Scope(ScopeFlags flags, std::unique_ptr<Scope> parent_a) :
-        parent_scope(std::move(parent_a)), flags(flags)
-    {
-        assert(!!(flags & ScopeFlags::FunScope) ? !!(flags & ScopeFlags::CompoundStmt) : true);
-    }
+    explicit SymbolTable(ScopeFlags flags);
+
+    /// Creates a table chained to the first `num_outer_symbols` symbols
+    /// inserted into `outer`. Both tables must not change while chained.
+    explicit SymbolTable(const SymbolTable& outer, size_t num_outer_symbols,
+                         ScopeFlags flags);
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /// Enters a new innermost scope.
+    void enter_scope(ScopeFlags flags);
+
+    /// Leaves the innermost scope, forgetting its symbols.
+    void leave_scope();
 
-    Scope(const Scope&) = delete;
-    Scope& operator=(const Scope&) = delete;
+    /// \returns the number of scopes in the scope chain.
+    auto depth() const -> size_t { return scopes.size(); }
 
-    /// Detaches and returns the parent scope.
-    auto detach() -> std::unique_ptr<Scope>;
+    /// \returns the number of symbols in the scope chain.
+    auto size() const -> size_t { return bindings.size(); }
 
     /// Performs a symbol lookup.
     ///
     /// \returns the symbol information or `nullptr` if no such symbol exists.
     auto lookup(SourceRange name) const -> std::shared_ptr<ASTDecl>;
 
-    /// Performs a symbol lookup exclusively on this scope.
+    /// Performs a symbol lookup exclusively on the innermost scope.
     ///
-    /// In other words, the lookup request is not propagated to the parent scope.
+    /// In other words, the lookup request is not propagated to the outer scopes.
     auto lookup_exclusive(SourceRange name) const -> std::shared_ptr<ASTDecl>;
 
-    /// Inserts a new symbol into this scope.
+    /// Inserts a new symbol into the innermost scope.
     ///
     /// If this is a redeclaration, no changes are made to the symbol table.
     ///
@@ -76,13 +98,62 @@ public:
     auto insert(SourceRange name, std::shared_ptr<ASTDecl> decl)
             -> std::pair<std::shared_ptr<ASTDecl>, bool>;
 
-    /// Checks whether this is the scope of function parameters.
-    bool is_params_scope() const { return !!(flags & ScopeFlags::FunParamsScope); }
+    /// Checks whether the innermost scope is the scope of function parameters.
+    bool is_params_scope() const { return is_params_scope(scopes.size() - 1); }
 
 private:
-    std::unique_ptr<Scope> parent_scope;
-    std::unordered_map<SourceRange, std::shared_ptr<ASTDecl>> symbols;
-    ScopeFlags flags;
+    static constexpr uint32_t no_binding = UINT32_MAX;
+
+    struct Slot
+    {
+        SourceRange name;
+        uint32_t top = no_binding; //< innermost binding of the name
+        bool used = false;
+    };
+
+    struct Binding
+    {
+        std::shared_ptr<ASTDecl> decl;
+        uint32_t slot;     //< slot of the name in the table
+        uint32_t shadowed; //< binding shadowed by this one
+        uint32_t scope;    //< depth of the scope (minus one) of the binding
+    };
+
+    struct ScopeInfo
+    {
+        ScopeFlags flags;
+        uint32_t first_binding; //< position of the scope in the undo log
+    };
+
+    bool is_params_scope(size_t scope) const
+    {
+        return !!(scopes[scope].flags & ScopeFlags::FunParamsScope);
+    }
+
+    /// \returns the innermost binding of a name or `nullptr` if none.
+    auto find_binding(SourceRange name) const -> const Binding*;
+
+    /// Performs a symbol lookup on the first `num_symbols` symbols only.
+    auto lookup_first(SourceRange name, size_t num_symbols) const
+            -> std::shared_ptr<ASTDecl>;
+
+    /// \returns the slot index for a name, which may be an unused slot.
+    auto find_slot(SourceRange name) const -> size_t;
+
+    /// Doubles the capacity of the table.
+    void grow();
+
+private:
+    std::vector<Slot> slots;
+    size_t num_used_slots = 0;
+
+    /// The undo log. Bindings of inner scopes come last.
+    std::vector<Binding> bindings;
+
+    std::vector<ScopeInfo> scopes;
+
+    const SymbolTable* outer = nullptr;
+    size_t num_outer_symbols = 0;
 };
 
 /// The semantic analyzer performs context-sensitive analysis, type-checking,
@@ -93,6 +164,15 @@ public:
     explicit Semantics(SourceFile& source,
                        DiagnosticManager& diagman);
 
+    /// Creates an analyzer for a function body which is parsed apart from
+    /// the top-level declarations (e.g. on another thread).
+    ///
+    /// Only the first `num_visible_symbols` top-level symbols of `global_sema`
+    /// are visible, which must not change while this analyzer is alive.
+    explicit Semantics(const Semantics& global_sema,
+                       size_t num_visible_symbols,
+                       DiagnosticManager& diagman);
+
     Semantics(const Semantics&) = delete;
     Semantics& operator=(const Semantics&) = delete;
 
@@ -100,9 +180,17 @@ public:
     auto act_on_program_start() -> std::shared_ptr<ASTProgram>;
 
     /// Acts once the parser finishes parsing.
+    ///
+    /// The bodies of the functions are type checked at this point.
     auto act_on_program_end(std::shared_ptr<ASTProgram> program)
             -> std::shared_ptr<ASTProgram>;
 
+    /// Acts once the parser gives up on the program.
+    ///
+    /// The bodies of the functions parsed so far are type checked at this
+    /// point, so their errors are still reported.
+    void act_on_program_error(ASTProgram& program);
+
     /// Acts on a program-level declaration.
     void act_on_top_level_decl(const std::shared_ptr<ASTProgram>& program,
                                std::shared_ptr<ASTDecl> decl);
@@ -122,6 +210,12 @@ public:
     auto act_on_fun_decl_end(std::shared_ptr<ASTFunDecl>)
             -> std::shared_ptr<ASTFunDecl>;
 
+    /// Acts on the body of a function parsed apart from its signature,
+    /// before the body is parsed.
+    ///
+    /// The parameters are brought into the current scope once again.
+    void act_on_fun_body_start(ASTFunDecl& decl);
+
     /// Acts on the declaration of a parameter.
     auto act_on_param_decl(const Word& type, const Word& name, bool is_array)
             -> std::shared_ptr<ASTParmVarDecl>;
@@ -134,8 +228,10 @@ public:
             -> std::shared_ptr<ASTExpr>;
 
     /// Acts on a compound statement.
-    auto act_on_compound_stmt(std::vector<std::shared_ptr<ASTVarDecl>> decls,
-                              std::vector<std::shared_ptr<ASTStmt>> stms)
+    ///
+    /// The childrens are moved out of the views.
+    auto act_on_compound_stmt(ArrayView<std::shared_ptr<ASTVarDecl>> decls,
+                              ArrayView<std::shared_ptr<ASTStmt>> stms)
             -> std::shared_ptr<ASTCompoundStmt>;
 
     /// Acts on a selection statement.
@@ -179,16 +275,18 @@ public:
             -> std::shared_ptr<ASTVarRef>;
 
     /// Acts on a function call.
+    ///
+    /// The arguments are moved out of the view.
     auto act_on_call(const Word& name,
-                     std::vector<std::shared_ptr<ASTExpr>> args,
+                     ArrayView<std::shared_ptr<ASTExpr>> args,
                      SourceLocation rparenloc)
             -> std::shared_ptr<ASTFunCall>;
 
     /// Converts a word into a number.
     int32_t number_from_word(const Word& word);
 
-    /// Gets the current scope.
-    Scope& get_scope();
+    /// Gets the symbol table of the current scope chain.
+    SymbolTable& get_symbols();
 
 protected:
     friend class ParseScope;
@@ -204,6 +302,16 @@ protected:
     void leave_scope();
 
 private:
+    /// Type checks the body of every function in the program.
+    ///
+    /// Names were already resolved while parsing, and the declarations are
+    /// not changed anymore, so the bodies are checked concurrently. The
+    /// diagnostics are still propagated in source order.
+    void check_fun_bodies(ASTProgram& program);
+
+    /// Programs with less function bodies than this are checked sequentially.
+    static constexpr size_t min_parallel_bodies = 32;
+
     auto make_builtin(Category retn_type,
                       std::string name,
                       std::vector<std::string> params)
@@ -212,17 +320,15 @@ private:
 private:
     SourceFile& source;
     DiagnosticManager& diagman;
-    std::unique_ptr<Scope> current_scope;
+    SymbolTable symbols;
 
     std::shared_ptr<ASTFunDecl> fun_println;
     std::shared_ptr<ASTFunDecl> fun_input;
-
-    bool is_current_fun_void = true;
 };
 
 /// This object retains the ownership of a semantic scope.
 ///
-/// Once this object is destroyed, the owned scope gets detached from
+/// Once this object is destroyed, the owned scope gets left in
 /// the semantic context as well.
 class ParseScope
 {
@@ -231,13 +337,12 @@ public:
         sema(sema)
     {
         this->sema.enter_scope(flags);
-        this->handle = std::addressof(sema.get_scope());
+        this->depth = sema.get_symbols().depth();
     }
 
     ~ParseScope()
     {
-        auto current_handle = std::addressof(sema.get_scope());
-        assert(current_handle == handle);
+        assert(sema.get_symbols().depth() == depth);
         this->sema.leave_scope();
     }
 
@@ -248,7 +353,7 @@ public:
     ParseScope& operator=(ParseScope&&) = delete;
 
 private:
-    Scope* handle;
+    size_t depth;
     Semantics& sema;
 };
 }
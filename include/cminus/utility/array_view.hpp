@@ -0,0 +1,46 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace cminus
+{
+/// A non-owning view into a contiguous sequence of objects.
+///
+/// The viewed sequence must outlive the view.
+template<typename T>
+class ArrayView
+{
+public:
+    constexpr ArrayView() noexcept = default;
+
+    constexpr ArrayView(T* data, size_t size) noexcept :
+        data_(data), size_(size)
+    {
+    }
+
+    /// Views the elements of a vector from `first` onwards.
+    template<typename Alloc>
+    ArrayView(std::vector<T, Alloc>& vec, size_t first = 0) noexcept :
+        ArrayView(vec.data() + first, vec.size() - first)
+    {
+        assert(first <= vec.size());
+    }
+
+    constexpr auto begin() const noexcept -> T* { return data_; }
+    constexpr auto end() const noexcept -> T* { return data_ + size_; }
+
+    constexpr auto size() const noexcept -> size_t { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+
+    constexpr auto operator[](size_t index) const -> T&
+    {
+        assert(index < size_);
+        return data_[index];
+    }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+}
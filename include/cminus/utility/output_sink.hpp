@@ -0,0 +1,133 @@
+#pragma once
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace cminus
+{
+/// A fixed-size output buffer which is flushed into a file stream or a
+/// string as it fills up.
+///
+/// Writing into a stream uses bounded memory and lets output begin before
+/// everything has been produced. Once a write into the stream fails, the
+/// remaining output is discarded and `flush` reports the failure.
+class OutputSink
+{
+public:
+    explicit OutputSink(std::FILE* stream) :
+        stream(stream)
+    {
+    }
+
+    explicit OutputSink(std::string& dest) :
+        dest(&dest)
+    {
+    }
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    ~OutputSink() { flush(); }
+
+    /// Checks whether nothing has ever been written into this sink.
+    bool empty() const { return !written && size == 0; }
+
+    void push_back(char c)
+    {
+        if(size == sizeof(buffer))
+            drain();
+        this->buffer[size++] = c;
+    }
+
+    void append(std::string_view str)
+    {
+        if(str.size() > sizeof(buffer) - size)
+        {
+            drain();
+            if(str.size() > sizeof(buffer))
+            {
+                write_out(str.data(), str.size());
+                return;
+            }
+        }
+        std::memcpy(&buffer[size], str.data(), str.size());
+        this->size += str.size();
+    }
+
+    void append(size_t count, char c)
+    {
+        for(size_t i = 0; i < count; ++i)
+            push_back(c);
+    }
+
+    OutputSink& operator+=(char c)
+    {
+        push_back(c);
+        return *this;
+    }
+
+    OutputSink& operator+=(std::string_view str)
+    {
+        append(str);
+        return *this;
+    }
+
+    /// Writes the buffered data into the destination.
+    ///
+    /// \returns whether everything written so far reached the destination.
+    bool flush()
+    {
+        drain();
+        if(stream && !failed && std::fflush(stream) != 0)
+            this->failed = true;
+        return !failed;
+    }
+
+private:
+    void drain()
+    {
+        if(size != 0)
+        {
+            write_out(buffer, size);
+            this->size = 0;
+        }
+    }
+
+    void write_out(const char* data, size_t count)
+    {
+        this->written = true;
+        if(dest)
+        {
+            dest->append(data, count);
+            return;
+        }
+
+        // Writes interrupted by a signal are retried, any other short
+        // write is an error.
+        while(count != 0 && !failed)
+        {
+            const auto ncount = std::fwrite(data, 1, count, stream);
+            data += ncount;
+            count -= ncount;
+            if(count != 0)
+            {
+                if(std::ferror(stream) && errno == EINTR)
+                    std::clearerr(stream);
+                else
+                    this->failed = true;
+            }
+        }
+    }
+
+private:
+    std::FILE* stream = nullptr;
+    std::string* dest = nullptr;
+
+    bool written = false;
+    bool failed = false;
+    size_t size = 0;
+    char buffer[4096];
+};
+}
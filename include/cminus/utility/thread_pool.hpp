@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace cminus
+{
+/// A fixed set of worker threads for running data parallel loops.
+///
+/// The thread calling `parallel_for` takes part in the loop as well, so a
+/// pool without workers simply runs the loop sequentially.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t num_workers)
+    {
+        for(size_t i = 0; i < num_workers; ++i)
+            this->workers.emplace_back([this] { work(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            this->stopping = true;
+        }
+        wakeup.notify_all();
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    /// \returns a pool shared by the whole compiler with one thread per
+    /// hardware thread. The workers are only spawned on first use.
+    static auto shared() -> ThreadPool&
+    {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    /// \returns the number of threads running a loop, including the caller.
+    auto num_threads() const -> size_t { return workers.size() + 1; }
+
+    /// Calls `fn(i)` for every `i` in `[0, count)` and waits for all the calls
+    /// to return. The calls are distributed among the threads in any order.
+    ///
+    /// \note this must not be called from within a loop of the same pool.
+    template<typename Fn>
+    void parallel_for(size_t count, Fn&& fn)
+    {
+        if(workers.empty() || count <= 1)
+        {
+            for(size_t i = 0; i < count; ++i)
+                fn(i);
+            return;
+        }
+
+        using Callable = std::remove_reference_t<Fn>;
+
+        std::unique_lock lock(mutex);
+        this->job_fn = [](void* context, size_t i) { (*static_cast<Callable*>(context))(i); };
+        this->job_context = const_cast<void*>(static_cast<const void*>(std::addressof(fn)));
+        this->job_count = count;
+        this->next_index.store(0, std::memory_order_relaxed);
+        this->num_pending = workers.size();
+        ++this->generation;
+        lock.unlock();
+
+        wakeup.notify_all();
+        run_job();
+
+        // Every worker must be done with this job before it goes out of scope.
+        lock.lock();
+        finished.wait(lock, [this] { return num_pending == 0; });
+    }
+
+private:
+    void work()
+    {
+        uint64_t seen_generation = 0;
+        std::unique_lock lock(mutex);
+        while(true)
+        {
+            wakeup.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if(stopping)
+                return;
+
+            seen_generation = generation;
+            lock.unlock();
+            run_job();
+            lock.lock();
+
+            if(--this->num_pending == 0)
+                finished.notify_one();
+        }
+    }
+
+    void run_job()
+    {
+        size_t i;
+        while((i = next_index.fetch_add(1, std::memory_order_relaxed)) < job_count)
+            job_fn(job_context, i);
+    }
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    bool stopping = false;
+    uint64_t generation = 0;
+    size_t num_pending = 0;
+
+    // The current job. Only changes while no worker is running it.
+    void (*job_fn)(void*, size_t) = nullptr;
+    void* job_context = nullptr;
+    size_t job_count = 0;
+    std::atomic<size_t> next_index{0};
+};
+}
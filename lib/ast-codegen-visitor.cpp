@@ -1,14 +1,479 @@
+#include <algorithm>
 #include <cminus/ast-codegen-visitor.hpp>
+#include <cminus/mem-report.hpp>
+#include <cminus/mips-arith.hpp>
 
+constexpr auto REG_0 = 0;
 constexpr auto REG_V0 = 2;
 constexpr auto REG_T0 = 8;
 constexpr auto REG_A0 = 4;
 constexpr auto REG_RA = 31;
 
+/// Registers available to variables not live across calls ($t1-$t9).
+///
+/// $t0 is kept as a scratch register for the code generator.
+constexpr int temp_var_regs[] = {9, 10, 11, 12, 13, 14, 15, 24, 25};
+
+/// Callee-saved registers available to variables ($s0-$s7).
+constexpr int saved_var_regs[] = {16, 17, 18, 19, 20, 21, 22, 23};
+
 namespace
 {
 using namespace cminus;
 
+using VarRegMap = std::unordered_map<ASTVarDecl*, int>;
+using ExprLabel = ASTCodegenVisitor::ExprLabel;
+using ExprLabelMap = std::unordered_map<ASTExpr*, ExprLabel>;
+using RegisterInfo = ASTCodegenVisitor::RegisterInfo;
+
+/// Checks whether an expression assigns to a variable.
+class AssignmentFinderVisitor : public ASTVisitor
+{
+public:
+    explicit AssignmentFinderVisitor(ASTVarDecl& var) :
+        var(var)
+    {
+    }
+
+    bool found() const { return this->found_; }
+
+    void visit_binary_expr(ASTBinaryExpr& expr) override
+    {
+        if(expr.get_operation() == ASTBinaryExpr::Operation::Assign
+           && expr.get_left()->as_var_expr()->get_decl().get() == &var)
+        {
+            this->found_ = true;
+            return;
+        }
+        walk_binary_expr(expr);
+    }
+
+private:
+    ASTVarDecl& var;
+    bool found_ = false;
+};
+
+/// \returns the call whose result is returned by a statement or `nullptr`.
+auto tail_call_of(ASTReturnStmt& stmt) -> ASTFunCall*
+{
+    auto expr = stmt.get_expr();
+    if(!expr || expr->expr_kind() != ExprKind::FunCall)
+        return nullptr;
+    return static_cast<ASTFunCall*>(expr.get());
+}
+
+/// Finds whether a function returns the result of calling itself.
+class SelfTailCallFinderVisitor : public ASTVisitor
+{
+public:
+    explicit SelfTailCallFinderVisitor(ASTFunDecl& fun) :
+        fun(fun)
+    {
+    }
+
+    bool found() const { return this->found_; }
+
+    void visit_return_stmt(ASTReturnStmt& stmt) override
+    {
+        if(auto call = tail_call_of(stmt); call && call->get_decl().get() == &fun)
+            this->found_ = true;
+    }
+
+private:
+    ASTFunDecl& fun;
+    bool found_ = false;
+};
+
+/// Finds whether a function call is performed.
+class CallFinderVisitor : public ASTVisitor
+{
+public:
+    bool found() const { return this->found_; }
+
+    void visit_call_expr(ASTFunCall&) override
+    {
+        this->found_ = true;
+    }
+
+private:
+    bool found_ = false;
+};
+
+/// \returns the register of a variable assigned to by `expr` or `-1` if
+/// the assignment is not into a variable kept in a register.
+int register_assign_target(const VarRegMap& var_regs, ASTBinaryExpr& expr)
+{
+    if(expr.get_operation() != ASTBinaryExpr::Operation::Assign)
+        return -1;
+
+    auto var_ref = expr.get_left()->as_var_expr();
+    auto it = var_regs.find(var_ref->get_decl().get());
+    return it != var_regs.end() && !var_ref->get_index() ? it->second : -1;
+}
+
+/// \returns the register holding the left operand of `expr` or `-1` if it
+/// must be saved into temporary space while the right operand is evaluated.
+///
+/// This is the case of variables kept in registers which are not assigned
+/// to by the right operand.
+int register_left_operand(const VarRegMap& var_regs, ASTBinaryExpr& expr)
+{
+    if(expr.get_operation() == ASTBinaryExpr::Operation::Assign)
+        return -1;
+
+    auto var_ref = expr.get_left()->as_var_expr();
+    if(var_ref == nullptr || var_ref->get_index())
+        return -1;
+
+    auto var_decl = var_ref->get_decl();
+    auto it = var_regs.find(var_decl.get());
+    if(it == var_regs.end())
+        return -1;
+
+    AssignmentFinderVisitor finder(*var_decl);
+    finder.visit_expr(*expr.get_right());
+    return finder.found() ? -1 : it->second;
+}
+
+/// Checks whether an expression is a number or a scalar variable, both of
+/// which can be loaded into a register by a single instruction.
+bool is_leaf(ASTExpr& expr)
+{
+    switch(expr.expr_kind())
+    {
+        case ExprKind::Number:
+            return true;
+        case ExprKind::VarRef:
+        {
+            auto& var_ref = static_cast<ASTVarRef&>(expr);
+            return !var_ref.get_index() && !var_ref.get_decl()->is_array();
+        }
+        default:
+            return false;
+    }
+}
+
+bool is_zero(ASTExpr& expr)
+{
+    return expr.expr_kind() == ExprKind::Number && static_cast<ASTNumber&>(expr).get_value() == 0;
+}
+
+bool is_comparison(ASTBinaryExpr::Operation op)
+{
+    switch(op)
+    {
+        case ASTBinaryExpr::Operation::Less:
+        case ASTBinaryExpr::Operation::LessEqual:
+        case ASTBinaryExpr::Operation::Greater:
+        case ASTBinaryExpr::Operation::GreaterEqual:
+        case ASTBinaryExpr::Operation::Equal:
+        case ASTBinaryExpr::Operation::NotEqual:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// \returns the comparison which holds whenever `op` does not.
+auto negate(ASTBinaryExpr::Operation op) -> ASTBinaryExpr::Operation
+{
+    switch(op)
+    {
+        case ASTBinaryExpr::Operation::Less:
+            return ASTBinaryExpr::Operation::GreaterEqual;
+        case ASTBinaryExpr::Operation::LessEqual:
+            return ASTBinaryExpr::Operation::Greater;
+        case ASTBinaryExpr::Operation::Greater:
+            return ASTBinaryExpr::Operation::LessEqual;
+        case ASTBinaryExpr::Operation::GreaterEqual:
+            return ASTBinaryExpr::Operation::Less;
+        case ASTBinaryExpr::Operation::Equal:
+            return ASTBinaryExpr::Operation::NotEqual;
+        case ASTBinaryExpr::Operation::NotEqual:
+            return ASTBinaryExpr::Operation::Equal;
+        default:
+            assert(false);
+            return op;
+    }
+}
+
+/// How the operands of a binary expression are evaluated.
+enum class OperandPlan
+{
+    AssignRegister, //< right operand is moved into the variable register
+    StoreDirect,    //< right operand is stored into the variable
+    LeftInRegister, //< left operand is a variable kept in a register
+    LeftLeaf,       //< left operand is loaded into $t0 after the right one
+    RightLeaf,      //< right operand is loaded into $t0 after the left one
+    RightConstant,  //< right operand is a constant multiplier or divisor
+    LeftFirst,      //< left operand is held in an expression register
+    RightFirst,     //< right operand is evaluated first and held in a register
+    Spill,          //< left operand is held in the temporary block
+};
+
+/// \returns how the operands of `expr` are evaluated when `num_free_regs`
+/// expression registers are available.
+///
+/// Both the frame allocator and the code generator follow this plan, so the
+/// temporary block is only as large as the spilled operands require.
+auto plan_binary_expr(const CodegenOptions& options, const RegisterInfo& regs,
+                      ASTBinaryExpr& expr, size_t num_free_regs) -> OperandPlan
+{
+    auto& left = *expr.get_left();
+    auto& right = *expr.get_right();
+
+    if(expr.get_operation() == ASTBinaryExpr::Operation::Assign)
+    {
+        if(register_assign_target(regs.var_regs, expr) != -1)
+            return OperandPlan::AssignRegister;
+        if(!options.expr_regs)
+            return OperandPlan::Spill;
+        if(!static_cast<ASTVarRef&>(left).get_index())
+            return OperandPlan::StoreDirect;
+        if(num_free_regs > 0 && !regs.expr_labels.at(&right).has_call)
+            return OperandPlan::LeftFirst;
+        return OperandPlan::Spill;
+    }
+
+    if(options.strength_reduce && right.expr_kind() == ExprKind::Number
+       && (expr.get_operation() == ASTBinaryExpr::Operation::Multiply
+           || expr.get_operation() == ASTBinaryExpr::Operation::Divide))
+        return OperandPlan::RightConstant;
+
+    if(register_left_operand(regs.var_regs, expr) != -1)
+        return OperandPlan::LeftInRegister;
+    if(!options.expr_regs)
+        return OperandPlan::Spill;
+    if(is_leaf(right))
+        return OperandPlan::RightLeaf;
+
+    // Operands may only be evaluated out of order when nothing observable
+    // happens in between.
+    const auto& left_label = regs.expr_labels.at(&left);
+    const auto& right_label = regs.expr_labels.at(&right);
+    const auto reorderable = !left_label.has_side_effects && !right_label.has_side_effects;
+
+    if(is_leaf(left) && reorderable)
+        return OperandPlan::LeftLeaf;
+
+    if(num_free_regs > 0)
+    {
+        if(reorderable && right_label.need > left_label.need)
+            return OperandPlan::RightFirst;
+        if(!right_label.has_call)
+            return OperandPlan::LeftFirst;
+    }
+
+    return OperandPlan::Spill;
+}
+
+/// Labels the expressions of a function with their Sethi-Ullman number,
+/// that is, the number of expression registers needed to evaluate them
+/// without spilling, following `plan_binary_expr`.
+class ExprLabelVisitor : public ASTVisitor
+{
+public:
+    explicit ExprLabelVisitor(const VarRegMap& var_regs, ExprLabelMap& out_labels) :
+        var_regs(var_regs),
+        labels(out_labels)
+    {
+    }
+
+    void visit_number_expr(ASTNumber& expr) override
+    {
+        this->labels[&expr] = ExprLabel{};
+    }
+
+    void visit_var_expr(ASTVarRef& expr) override
+    {
+        walk_var_expr(expr);
+        auto index = expr.get_index();
+        this->labels[&expr] = index ? labels[index.get()] : ExprLabel{};
+    }
+
+    void visit_call_expr(ASTFunCall& expr) override
+    {
+        walk_call_expr(expr);
+
+        ExprLabel label;
+        label.has_call = true;
+        label.has_side_effects = true;
+        for(auto it = expr.arg_begin(); it != expr.arg_end(); ++it)
+            label.need = std::max(label.need, labels[it->get()].need);
+        this->labels[&expr] = label;
+    }
+
+    void visit_binary_expr(ASTBinaryExpr& expr) override
+    {
+        walk_binary_expr(expr);
+
+        const auto& left = labels[expr.get_left().get()];
+        const auto& right = labels[expr.get_right().get()];
+        const auto is_assign = (expr.get_operation() == ASTBinaryExpr::Operation::Assign);
+
+        ExprLabel label;
+        label.has_call = left.has_call || right.has_call;
+        label.has_side_effects = is_assign || left.has_side_effects || right.has_side_effects;
+
+        if(is_assign)
+        {
+            const auto has_index = expr.get_left()->as_var_expr()->get_index() != nullptr;
+            label.need = has_index ? std::max(left.need, right.need + 1) : right.need;
+        }
+        else if(is_leaf(*expr.get_right()))
+            label.need = left.need;
+        else if(register_left_operand(var_regs, expr) != -1)
+            label.need = right.need;
+        else if(!left.has_side_effects && !right.has_side_effects)
+            label.need = (left.need == right.need ? left.need + 1 : std::max(left.need, right.need));
+        else
+            label.need = std::max(left.need, right.need + 1);
+
+        this->labels[&expr] = label;
+    }
+
+private:
+    const VarRegMap& var_regs;
+    ExprLabelMap& labels;
+};
+
+/// Computes the live intervals of the variables of a function that may
+/// be kept in registers, that is, scalars and array parameters.
+///
+/// Program points are numbered in the order the code generator evaluates
+/// them. The interval of a variable goes from its first to its last
+/// reference, widened to cover the loops it is referenced in, since its
+/// value must survive the back edge.
+class LiveIntervalVisitor : public ASTVisitor
+{
+public:
+    struct Interval
+    {
+        ASTVarDecl* var;
+        int32_t start = -1;
+        int32_t end = -1;
+        bool crosses_call = false; //< whether it must survive a call
+    };
+
+    /// \returns the intervals of the referenced variables of a function
+    /// sorted by their start point.
+    auto compute(ASTFunDecl& decl) -> std::vector<Interval>
+    {
+        for(auto it = decl.parm_begin(); it != decl.parm_end(); ++it)
+        {
+            auto var_decl = static_cast<ASTVarDecl*>((*it).get());
+            add_candidate(*var_decl);
+            touch(*var_decl);
+        }
+
+        visit_compound_stmt(*decl.get_body());
+
+        std::vector<Interval> result;
+        for(auto& interval : intervals)
+        {
+            if(interval.start != -1)
+                result.push_back(interval);
+        }
+
+        for(bool changed = true; changed;)
+        {
+            changed = false;
+            for(auto& interval : result)
+            {
+                for(auto [begin, end] : loops)
+                {
+                    if(interval.start <= end && interval.end >= begin
+                       && (interval.start > begin || interval.end < end))
+                    {
+                        interval.start = std::min(interval.start, begin);
+                        interval.end = std::max(interval.end, end);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for(auto& interval : result)
+        {
+            auto call = std::upper_bound(calls.begin(), calls.end(), interval.start);
+            interval.crosses_call = (call != calls.end() && *call < interval.end);
+        }
+
+        std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+            return a.start < b.start;
+        });
+        return result;
+    }
+
+    void visit_var_decl(ASTVarDecl& decl) override
+    {
+        if(!decl.is_array())
+            add_candidate(decl);
+    }
+
+    void visit_iteration_stmt(ASTIterationStmt& stmt) override
+    {
+        const auto begin = next_pos++;
+        walk_iteration_stmt(stmt);
+        this->loops.emplace_back(begin, next_pos++);
+    }
+
+    void visit_binary_expr(ASTBinaryExpr& expr) override
+    {
+        // The variable is defined after the value is computed. Similarly, a
+        // left operand kept in a register is only read after the right
+        // operand is evaluated (see `register_left_operand`).
+        auto var_ref = expr.get_left()->as_var_expr();
+        if(var_ref != nullptr && !var_ref->get_index())
+        {
+            visit_expr(*expr.get_right());
+            touch(*var_ref->get_decl());
+            return;
+        }
+        walk_binary_expr(expr);
+    }
+
+    void visit_var_expr(ASTVarRef& var_ref) override
+    {
+        // The base address may be read after the index is evaluated.
+        walk_var_expr(var_ref);
+        touch(*var_ref.get_decl());
+    }
+
+    void visit_call_expr(ASTFunCall& expr) override
+    {
+        walk_call_expr(expr);
+        this->calls.push_back(next_pos++);
+    }
+
+private:
+    void add_candidate(ASTVarDecl& decl)
+    {
+        this->index_of.emplace(&decl, intervals.size());
+        this->intervals.push_back(Interval{&decl});
+    }
+
+    void touch(ASTVarDecl& decl)
+    {
+        auto it = index_of.find(&decl);
+        if(it != index_of.end())
+        {
+            auto& interval = intervals[it->second];
+            if(interval.start == -1)
+                interval.start = next_pos;
+            interval.end = next_pos;
+        }
+        ++this->next_pos;
+    }
+
+private:
+    std::unordered_map<ASTVarDecl*, size_t> index_of;
+    std::vector<Interval> intervals;
+    std::vector<std::pair<int32_t, int32_t>> loops;
+    std::vector<int32_t> calls;
+    int32_t next_pos = 0;
+};
+
 /// This is a stack frame allocator.
 ///
 /// For each function definition, it calculates the suitable size (and offsets)
@@ -26,7 +491,8 @@ using namespace cminus;
 /// + The input block contains the arguments to the function. The first four
 ///   arguments are in the callee stack frame while the rest is in the caller's.
 /// + The local block contains automatic variables.
-/// + The saved block is used for saving the procedure return address ($ra).
+/// + The saved block is used for saving the procedure return address ($ra)
+///   and the callee-saved registers used by the procedure.
 /// + The temporaries block holds data used for computing nested expressions.
 ///   This is essentially a stack where the stack top pointer is known by the
 ///   code generator (so we don't need an additional register for that).
@@ -40,16 +506,21 @@ public:
 
     explicit FrameAllocatorVisitor(
             std::unordered_map<ASTFunDecl*, FrameInfo>& out_frames,
-            std::unordered_map<ASTVarDecl*, int32_t>& out_local_pos) :
+            std::unordered_map<ASTVarDecl*, int32_t>& out_local_pos,
+            const CodegenOptions& options,
+            const RegisterInfo& regs) :
         frames(out_frames),
-        local_pos(out_local_pos)
+        local_pos(out_local_pos),
+        options(options),
+        regs(regs)
     {
     }
 
     void visit_fun_decl(ASTFunDecl& decl) override
     {
         this->frame = FrameInfo{};
-        this->frame.saved_size = 4; // $ra
+        const auto num_saved_regs = (regs.is_leaf ? 0 : 1) + regs.saved_regs.size();
+        this->frame.saved_size = 4 * num_saved_regs; // $ra and $s*
 
         // Calculate the size of the other blocks by recursing into the body.
         this->inside_function = true;
@@ -59,11 +530,18 @@ public:
         // Calculate size of input block and assign offset to param vars.
         // Must be after recursing into the body so we have the size of
         // the local block already computed.
-        for(auto it = decl.parm_begin(); it != decl.parm_end(); ++it)
+        //
+        // Leaf functions keep the parameters passed in registers there, so
+        // only the ones passed on the stack have a place.
+        for(size_t i = 0; i < decl.get_num_params(); ++i)
         {
-            auto var_decl = static_cast<ASTVarDecl*>((*it).get());
+            if(regs.is_leaf && i < 4)
+                continue;
+
+            auto var_decl = static_cast<ASTVarDecl*>(decl.get_param(i).get());
             this->local_pos[var_decl] = frame.local_size + frame.input_size;
-            this->frame.input_size = std::min(16, frame.input_size + 4);
+            if(!regs.is_leaf)
+                this->frame.input_size = std::min(16, frame.input_size + 4);
         }
 
         this->frames[&decl] = std::move(this->frame);
@@ -79,7 +557,7 @@ public:
 
     void visit_var_decl(ASTVarDecl& decl) override
     {
-        if(inside_function)
+        if(inside_function && !regs.var_regs.count(&decl))
         {
             auto num_elms = (!decl.is_array() ? 1 : decl.get_array_size()->get_value());
             this->local_pos[&decl] = current_local_pos;
@@ -101,17 +579,38 @@ public:
 
     void visit_binary_expr(ASTBinaryExpr& expr) override
     {
-        // binary expressions need 4 bytes of temporary space to be evaluated.
-        const auto temp_bytes = 4;
-        temp_enter(temp_bytes);
-        walk_binary_expr(expr);
-        temp_leave(temp_bytes);
+        // binary expressions need 4 bytes of temporary space to be evaluated,
+        // unless their operands are kept in registers.
+        const auto num_free_regs = regs.expr_regs.size() - num_used_expr_regs;
+        switch(plan_binary_expr(options, regs, expr, num_free_regs))
+        {
+            case OperandPlan::Spill:
+                temp_enter(4);
+                walk_binary_expr(expr);
+                temp_leave(4);
+                break;
+            case OperandPlan::LeftFirst:
+                visit_expr(*expr.get_left());
+                ++this->num_used_expr_regs;
+                visit_expr(*expr.get_right());
+                --this->num_used_expr_regs;
+                break;
+            case OperandPlan::RightFirst:
+                visit_expr(*expr.get_right());
+                ++this->num_used_expr_regs;
+                visit_expr(*expr.get_left());
+                --this->num_used_expr_regs;
+                break;
+            default:
+                walk_binary_expr(expr);
+                break;
+        }
     }
 
     void visit_var_expr(ASTVarRef& var_ref) override
     {
         // variable references also need 4 bytes of temporary space sometimes.
-        const auto temp_bytes = var_ref.get_index() ? 4 : 0;
+        const auto temp_bytes = var_ref.get_index() && !options.expr_regs ? 4 : 0;
         temp_enter(temp_bytes);
         walk_var_expr(var_ref);
         temp_leave(temp_bytes);
@@ -135,18 +634,39 @@ private:
     std::unordered_map<ASTFunDecl*, FrameInfo>& frames;
     std::unordered_map<ASTVarDecl*, int32_t>& local_pos;
 
+    // Input structures.
+    const CodegenOptions& options;
+    const RegisterInfo& regs;
+
     // Auxiliar variables for computing the above structures.
     FrameInfo frame;
     bool inside_function = false;
     int32_t current_local_pos = 0;
     int32_t current_temp_pos = 0;
+    size_t num_used_expr_regs = 0;
 };
 }
 
 namespace cminus
 {
+auto CodegenOptions::from_level(int level) -> CodegenOptions
+{
+    CodegenOptions options;
+    options.regalloc = (level >= 1);
+    options.expr_regs = (level >= 1);
+    options.strength_reduce = (level >= 1);
+    options.bounds_check_elim = (level >= 1);
+    options.leaf_frames = (level >= 1);
+    options.tail_calls = (level >= 1);
+    options.fused_branches = (level >= 1);
+    options.rotate_loops = (level >= 1);
+    return options;
+}
+
 void ASTCodegenVisitor::visit_program(ASTProgram& program)
 {
+    MemScope mem_scope(MemTag::Codegen);
+
     dest += ".data\n";
     dest += ".align 2\n";
     for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
@@ -155,13 +675,27 @@ void ASTCodegenVisitor::visit_program(ASTProgram& program)
             visit_var_decl(*var_decl);
     }
 
-    auto frame_allocator = FrameAllocatorVisitor(this->frames, this->local_pos);
+    auto frame_allocator = FrameAllocatorVisitor(this->frames, this->local_pos,
+                                                 this->options, this->regs);
 
     dest += "\n.text\n";
     for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
     {
         if(auto fun_decl = (*it)->as_fun_decl())
         {
+            if(options.bounds_check_elim)
+            {
+                this->bounds = analyze_bounds_checks(*fun_decl);
+
+                BoundsCheckStats stats;
+                stats.function = fun_decl->get_name();
+                stats.num_checks = bounds.num_subscripts;
+                stats.num_removed = bounds.redundant.size();
+                stats.num_hoisted = bounds.hoisted.size();
+                this->bounds_check_stats.push_back(std::move(stats));
+            }
+
+            allocate_registers(*fun_decl);
             frame_allocator.visit_fun_decl(*fun_decl);
             visit_fun_decl(*fun_decl);
         }
@@ -194,9 +728,12 @@ void ASTCodegenVisitor::visit_fun_decl(ASTFunDecl& decl)
     auto frame_size_s = std::to_string(current_frame.total_size());
 
     const auto RA_OFFSET = current_frame.saved_offset(0);
+    const auto S_OFFSET = current_frame.saved_offset(regs.is_leaf ? 0 : 4);
 
     this->inside_function = true;
+    this->current_function = &decl;
     this->function_label_goto_ob = -1;
+    this->function_entry_label = -1;
 
     /*
     dest += "# ";
@@ -216,12 +753,58 @@ void ASTCodegenVisitor::visit_fun_decl(ASTFunDecl& decl)
     dest += ":\n";
 
     // Function prologue.
-    dest += "addiu $sp, $sp, -";
-    dest += frame_size_s;
-    dest += "\n";
-    emit_frame_sw(REG_RA, RA_OFFSET);
-    for(size_t i = 0; i < 4 && i < decl.get_num_params(); ++i)
-        emit_frame_sw(REG_A0 + i, current_frame.input_offset(4 * i));
+    if(current_frame.total_size() != 0)
+    {
+        dest += "addiu $sp, $sp, -";
+        dest += frame_size_s;
+        dest += "\n";
+    }
+    if(!regs.is_leaf)
+        emit_frame_sw(REG_RA, RA_OFFSET);
+    for(size_t i = 0; i < regs.saved_regs.size(); ++i)
+        emit_frame_sw(regs.saved_regs[i], S_OFFSET + 4 * i);
+
+    // Self tail calls jump here with the new arguments in place.
+    if(options.tail_calls)
+    {
+        SelfTailCallFinderVisitor finder(decl);
+        finder.visit_compound_stmt(*decl.get_body());
+        if(finder.found())
+        {
+            this->function_entry_label = next_label_id();
+            dest += ".L";
+            dest += std::to_string(function_entry_label);
+            dest += ":\n";
+        }
+    }
+
+    for(size_t i = 0; i < decl.get_num_params(); ++i)
+    {
+        auto var_decl = static_cast<ASTVarDecl*>(decl.get_param(i).get());
+        if(regs.is_leaf && i < 4)
+        {
+            // Kept where it was passed.
+        }
+        else if(auto reg = reg_of(*var_decl); reg != -1)
+        {
+            if(i < 4)
+            {
+                dest += "move $";
+                dest += regname(reg);
+                dest += ", $";
+                dest += regname(REG_A0 + i);
+                dest += '\n';
+            }
+            else
+            {
+                emit_frame_lw(reg, current_frame.local_offset(local_pos[var_decl]));
+            }
+        }
+        else if(i < 4)
+        {
+            emit_frame_sw(REG_A0 + i, current_frame.input_offset(4 * i));
+        }
+    }
 
     this->function_epilogue_label = next_label_id();
 
@@ -232,11 +815,7 @@ void ASTCodegenVisitor::visit_fun_decl(ASTFunDecl& decl)
     dest += std::to_string(function_epilogue_label);
     dest += ":\n";
 
-    emit_frame_lw(REG_RA, RA_OFFSET);
-    dest += "addiu $sp, $sp, ";
-    dest += frame_size_s;
-    dest += "\n";
-
+    emit_frame_teardown();
     dest += "jr $ra\n";
 
     // We need to generate this stub at the bottom of the function
@@ -251,6 +830,24 @@ void ASTCodegenVisitor::visit_fun_decl(ASTFunDecl& decl)
     }
 
     this->inside_function = false;
+    this->current_function = nullptr;
+}
+
+void ASTCodegenVisitor::emit_frame_teardown()
+{
+    const auto frame_size = current_frame.total_size();
+    const auto s_offset = current_frame.saved_offset(regs.is_leaf ? 0 : 4);
+
+    if(!regs.is_leaf)
+        emit_frame_lw(REG_RA, current_frame.saved_offset(0));
+    for(size_t i = 0; i < regs.saved_regs.size(); ++i)
+        emit_frame_lw(regs.saved_regs[i], s_offset + 4 * i);
+    if(frame_size != 0)
+    {
+        dest += "addiu $sp, $sp, ";
+        dest += std::to_string(frame_size);
+        dest += "\n";
+    }
 }
 
 void ASTCodegenVisitor::visit_null_stmt(ASTNullStmt&)
@@ -268,11 +865,7 @@ void ASTCodegenVisitor::visit_selection_stmt(ASTSelectionStmt& if_stmt)
     const auto false_label = next_label_id();
     int32_t fi_label = -1;
 
-    visit_expr(*if_stmt.get_cond());
-
-    dest += "beq $v0, $0, .L";
-    dest += std::to_string(false_label);
-    dest += '\n';
+    emit_cond_branch(*if_stmt.get_cond(), false, false_label);
 
     visit_stmt(*if_stmt.get_then());
 
@@ -301,18 +894,67 @@ void ASTCodegenVisitor::visit_selection_stmt(ASTSelectionStmt& if_stmt)
 
 void ASTCodegenVisitor::visit_iteration_stmt(ASTIterationStmt& while_stmt)
 {
+    auto const loop_checks = bounds.loop_checks.find(&while_stmt);
+
+    if(options.rotate_loops)
+    {
+        auto const body_label = next_label_id();
+        auto const fi_label = next_label_id();
+
+        // The condition is tested once before entering the loop, where the
+        // subscripts which do not change within it are checked, and then
+        // at the bottom of each iteration.
+        emit_cond_branch(*while_stmt.get_cond(), false, fi_label);
+
+        if(loop_checks != bounds.loop_checks.end())
+        {
+            for(auto var_ref : loop_checks->second)
+            {
+                visit_expr(*var_ref->get_index());
+                emit_bounds_check();
+            }
+        }
+
+        dest += ".L";
+        dest += std::to_string(body_label);
+        dest += ":\n";
+
+        visit_stmt(*while_stmt.get_body());
+        emit_cond_branch(*while_stmt.get_cond(), true, body_label);
+
+        dest += ".L";
+        dest += std::to_string(fi_label);
+        dest += ":\n";
+        return;
+    }
+
     auto const if_label = next_label_id();
     auto const fi_label = next_label_id();
 
+    // Subscripts which do not change within the loop are checked once,
+    // provided the loop is entered at all.
+    if(loop_checks != bounds.loop_checks.end())
+    {
+        const auto skip_label = next_label_id();
+
+        emit_cond_branch(*while_stmt.get_cond(), false, skip_label);
+
+        for(auto var_ref : loop_checks->second)
+        {
+            visit_expr(*var_ref->get_index());
+            emit_bounds_check();
+        }
+
+        dest += ".L";
+        dest += std::to_string(skip_label);
+        dest += ":\n";
+    }
+
     dest += ".L";
     dest += std::to_string(if_label);
     dest += ":\n";
 
-    visit_expr(*while_stmt.get_cond());
-
-    dest += "beq $v0, $0, .L";
-    dest += std::to_string(fi_label);
-    dest += '\n';
+    emit_cond_branch(*while_stmt.get_cond(), false, fi_label);
 
     visit_stmt(*while_stmt.get_body());
 
@@ -327,6 +969,35 @@ void ASTCodegenVisitor::visit_iteration_stmt(ASTIterationStmt& while_stmt)
 
 void ASTCodegenVisitor::visit_return_stmt(ASTReturnStmt& retn_stmt)
 {
+    if(auto call = tail_call_of(retn_stmt); call && can_tail_call(*call))
+    {
+        emit_call_args(*call);
+
+        if(call->get_decl().get() == current_function)
+        {
+            // The arguments passed on the stack go where our caller put ours.
+            const auto num_args = current_function->get_num_params();
+            for(size_t i = 4; i < num_args; ++i)
+            {
+                const auto offset = static_cast<int32_t>(4 * (i - 4));
+                emit_frame_lw(REG_T0, current_frame.output_offset(offset));
+                emit_frame_sw(REG_T0, current_frame.total_size() + offset);
+            }
+
+            dest += "j .L";
+            dest += std::to_string(function_entry_label);
+            dest += '\n';
+        }
+        else
+        {
+            emit_frame_teardown();
+            dest += "j ";
+            dest += call->get_decl()->get_name();
+            dest += '\n';
+        }
+        return;
+    }
+
     if(retn_stmt.get_expr())
         visit_expr(*retn_stmt.get_expr());
 
@@ -338,66 +1009,349 @@ void ASTCodegenVisitor::visit_return_stmt(ASTReturnStmt& retn_stmt)
 
 void ASTCodegenVisitor::visit_binary_expr(ASTBinaryExpr& expr)
 {
-    const auto temp_bytes = 4;
-    const auto temp_pos = temp_alloc(temp_bytes);
+    emit_binary_expr(expr, -1, false);
+}
 
-    if(expr.get_operation() == ASTBinaryExpr::Operation::Assign)
+void ASTCodegenVisitor::emit_cond_branch(ASTExpr& cond, bool when, int32_t label)
+{
+    if(options.fused_branches && cond.expr_kind() == ExprKind::BinaryExpr)
     {
-        load_address_of(*expr.get_left()->as_var_expr());
+        auto& expr = static_cast<ASTBinaryExpr&>(cond);
+        if(is_comparison(expr.get_operation()))
+        {
+            emit_binary_expr(expr, label, when);
+            return;
+        }
     }
-    else
+
+    visit_expr(cond);
+
+    dest += (when ? "bne" : "beq");
+    dest += " $v0, $0, .L";
+    dest += std::to_string(label);
+    dest += '\n';
+}
+
+void ASTCodegenVisitor::emit_binary_expr(ASTBinaryExpr& expr, int32_t branch_label,
+                                         bool branch_when)
+{
+    const auto op = expr.get_operation();
+    auto& left = *expr.get_left();
+    auto& right = *expr.get_right();
+
+    // Jumping when the comparison holds is not jumping when it does not.
+    const auto branch_op = (branch_label != -1 && branch_when ? negate(op) : op);
+    const auto emit_op = [&](int lhs, int rhs) {
+        if(branch_label != -1)
+            emit_compare_branch(branch_op, lhs, rhs, branch_label);
+        else
+            emit_binary_op(op, lhs, rhs);
+    };
+
+    // Comparisons against zero branch on the other operand alone.
+    if(branch_label != -1 && (is_zero(left) || is_zero(right)))
     {
-        visit_expr(*expr.get_left());
+        auto& other = is_zero(right) ? left : right;
+        auto reg = REG_V0;
+        if(is_leaf(other))
+            reg = load_leaf(REG_V0, other);
+        else
+            visit_expr(other);
+
+        if(is_zero(right))
+            emit_compare_branch(branch_op, reg, REG_0, branch_label);
+        else
+            emit_compare_branch(branch_op, REG_0, reg, branch_label);
+        return;
     }
 
-    emit_frame_sw(REG_V0, temp_pos);
-    visit_expr(*expr.get_right());
-    emit_frame_lw(REG_T0, temp_pos);
+    const auto num_free_regs = regs.expr_regs.size() - num_used_expr_regs;
+    switch(plan_binary_expr(options, regs, expr, num_free_regs))
+    {
+        case OperandPlan::AssignRegister:
+        {
+            visit_expr(right);
+            dest += "move $";
+            dest += regname(register_assign_target(regs.var_regs, expr));
+            dest += ", $v0\n";
+            break;
+        }
+        case OperandPlan::StoreDirect:
+        {
+            visit_expr(right);
+            store_into(*static_cast<ASTVarRef&>(left).get_decl());
+            break;
+        }
+        case OperandPlan::LeftInRegister:
+        {
+            visit_expr(right);
+            emit_op(register_left_operand(regs.var_regs, expr), REG_V0);
+            break;
+        }
+        case OperandPlan::LeftLeaf:
+        {
+            visit_expr(right);
+            emit_op(load_leaf(REG_T0, left), REG_V0);
+            break;
+        }
+        case OperandPlan::RightLeaf:
+        {
+            visit_expr(left);
+            emit_op(REG_V0, load_leaf(REG_T0, right));
+            break;
+        }
+        case OperandPlan::RightConstant:
+        {
+            auto lhs = REG_V0;
+            if(is_leaf(left) && left.expr_kind() == ExprKind::VarRef)
+                lhs = load_leaf(REG_V0, left);
+            else
+                visit_expr(left);
+
+            const auto value = static_cast<ASTNumber&>(right).get_value();
+            if(op == ASTBinaryExpr::Operation::Multiply)
+                emit_multiply_by(lhs, value);
+            else
+                emit_divide_by(lhs, value);
+            break;
+        }
+        case OperandPlan::LeftFirst:
+        {
+            if(op == ASTBinaryExpr::Operation::Assign)
+                load_address_of(static_cast<ASTVarRef&>(left));
+            else
+                visit_expr(left);
+
+            const auto reg = regs.expr_regs[num_used_expr_regs++];
+            dest += "move $";
+            dest += regname(reg);
+            dest += ", $v0\n";
+
+            visit_expr(right);
+            --this->num_used_expr_regs;
+            emit_op(reg, REG_V0);
+            break;
+        }
+        case OperandPlan::RightFirst:
+        {
+            visit_expr(right);
 
-    switch(expr.get_operation())
+            const auto reg = regs.expr_regs[num_used_expr_regs++];
+            dest += "move $";
+            dest += regname(reg);
+            dest += ", $v0\n";
+
+            visit_expr(left);
+            --this->num_used_expr_regs;
+            emit_op(REG_V0, reg);
+            break;
+        }
+        case OperandPlan::Spill:
+        {
+            const auto temp_bytes = 4;
+            const auto temp_pos = temp_alloc(temp_bytes);
+
+            if(op == ASTBinaryExpr::Operation::Assign)
+                load_address_of(static_cast<ASTVarRef&>(left));
+            else
+                visit_expr(left);
+
+            emit_frame_sw(REG_V0, temp_pos);
+            visit_expr(right);
+            emit_frame_lw(REG_T0, temp_pos);
+            emit_op(REG_T0, REG_V0);
+
+            temp_free(temp_pos, temp_bytes);
+            break;
+        }
+    }
+}
+
+void ASTCodegenVisitor::emit_binary_op(ASTBinaryExpr::Operation op, int lhs, int rhs)
+{
+    const auto emit = [&](const char* mnemonic, int a, int b) {
+        dest += mnemonic;
+        dest += " $";
+        dest += regname(a);
+        dest += ", $";
+        dest += regname(b);
+        dest += '\n';
+    };
+
+    const auto emit_v0 = [&](const char* mnemonic, int a, int b) {
+        dest += mnemonic;
+        dest += " $v0, $";
+        dest += regname(a);
+        dest += ", $";
+        dest += regname(b);
+        dest += '\n';
+    };
+
+    switch(op)
     {
         case ASTBinaryExpr::Operation::Plus:
-            dest += "addu $v0, $t0, $v0\n";
+            emit_v0("addu", lhs, rhs);
             break;
         case ASTBinaryExpr::Operation::Minus:
-            dest += "subu $v0, $t0, $v0\n";
+            emit_v0("subu", lhs, rhs);
             break;
         case ASTBinaryExpr::Operation::Multiply:
-            dest += "mult $t0, $v0\n";
+            emit("mult", lhs, rhs);
             dest += "mflo $v0\n";
             break;
         case ASTBinaryExpr::Operation::Divide:
-            dest += "div $t0, $v0\n";
+            emit("div", lhs, rhs);
             dest += "mflo $v0\n";
             break;
         case ASTBinaryExpr::Operation::Less:
-            dest += "slt $v0, $t0, $v0\n";
+            emit_v0("slt", lhs, rhs);
             break;
         case ASTBinaryExpr::Operation::LessEqual:
-            dest += "slt $v0, $v0, $t0\n";
+            emit_v0("slt", rhs, lhs);
             dest += "xori $v0, $v0, 1\n";
             break;
         case ASTBinaryExpr::Operation::Greater:
-            dest += "slt $v0, $v0, $t0\n";
+            emit_v0("slt", rhs, lhs);
             break;
         case ASTBinaryExpr::Operation::GreaterEqual:
-            dest += "slt $v0, $t0, $v0\n";
+            emit_v0("slt", lhs, rhs);
             dest += "xori $v0, $v0, 1\n";
             break;
         case ASTBinaryExpr::Operation::Equal:
-            dest += "xor $v0, $t0, $v0\n";
+            emit_v0("xor", lhs, rhs);
             dest += "sltiu $v0, $v0, 1\n";
             break;
         case ASTBinaryExpr::Operation::NotEqual:
-            dest += "xor $v0, $t0, $v0\n";
+            emit_v0("xor", lhs, rhs);
             dest += "sltu $v0, $0, $v0\n";
             break;
         case ASTBinaryExpr::Operation::Assign:
-            dest += "sw $v0, 0($t0)\n";
+            // lhs holds the address and rhs the value.
+            dest += "sw $";
+            dest += regname(rhs);
+            dest += ", 0($";
+            dest += regname(lhs);
+            dest += ")\n";
             break;
     }
+}
+
+void ASTCodegenVisitor::emit_compare_branch(ASTBinaryExpr::Operation op, int lhs, int rhs,
+                                            int32_t label)
+{
+    using Operation = ASTBinaryExpr::Operation;
 
-    temp_free(temp_pos, temp_bytes);
+    const auto emit_branch = [&](const char* mnemonic, int a, int b) {
+        dest += mnemonic;
+        dest += " $";
+        dest += regname(a);
+        if(b != -1)
+        {
+            dest += ", $";
+            dest += regname(b);
+        }
+        dest += ", .L";
+        dest += std::to_string(label);
+        dest += '\n';
+    };
+
+    const auto emit_slt = [&](int a, int b) {
+        dest += "slt $v0, $";
+        dest += regname(a);
+        dest += ", $";
+        dest += regname(b);
+        dest += '\n';
+    };
+
+    if(op != Operation::Equal && op != Operation::NotEqual && (lhs == REG_0 || rhs == REG_0))
+    {
+        // Compare the other operand against zero.
+        if(lhs == REG_0)
+        {
+            std::swap(lhs, rhs);
+            switch(op)
+            {
+                case Operation::Less:
+                    op = Operation::Greater;
+                    break;
+                case Operation::LessEqual:
+                    op = Operation::GreaterEqual;
+                    break;
+                case Operation::Greater:
+                    op = Operation::Less;
+                    break;
+                default:
+                    op = Operation::LessEqual;
+                    break;
+            }
+        }
+
+        switch(op)
+        {
+            case Operation::Less:
+                emit_branch("bgez", lhs, -1);
+                break;
+            case Operation::LessEqual:
+                emit_branch("bgtz", lhs, -1);
+                break;
+            case Operation::Greater:
+                emit_branch("blez", lhs, -1);
+                break;
+            default:
+                emit_branch("bltz", lhs, -1);
+                break;
+        }
+        return;
+    }
+
+    switch(op)
+    {
+        case Operation::Equal:
+            emit_branch("bne", lhs, rhs);
+            break;
+        case Operation::NotEqual:
+            emit_branch("beq", lhs, rhs);
+            break;
+        case Operation::Less:
+            emit_slt(lhs, rhs);
+            emit_branch("beq", REG_V0, REG_0);
+            break;
+        case Operation::LessEqual:
+            emit_slt(rhs, lhs);
+            emit_branch("bne", REG_V0, REG_0);
+            break;
+        case Operation::Greater:
+            emit_slt(rhs, lhs);
+            emit_branch("beq", REG_V0, REG_0);
+            break;
+        case Operation::GreaterEqual:
+            emit_slt(lhs, rhs);
+            emit_branch("bne", REG_V0, REG_0);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+void ASTCodegenVisitor::emit_multiply_by(int src, int32_t factor)
+{
+    if(!cminus::emit_multiply_by(dest, REG_V0, src, factor))
+    {
+        dest += "li $t0, ";
+        dest += std::to_string(factor);
+        dest += '\n';
+        emit_binary_op(ASTBinaryExpr::Operation::Multiply, src, REG_T0);
+    }
+}
+
+void ASTCodegenVisitor::emit_divide_by(int src, int32_t divisor)
+{
+    if(!cminus::emit_divide_by(dest, REG_V0, src, divisor))
+    {
+        dest += "li $t0, 0\n";
+        emit_binary_op(ASTBinaryExpr::Operation::Divide, src, REG_T0);
+    }
 }
 
 void ASTCodegenVisitor::visit_number_expr(ASTNumber& num)
@@ -409,6 +1363,20 @@ void ASTCodegenVisitor::visit_number_expr(ASTNumber& num)
 
 void ASTCodegenVisitor::visit_var_expr(ASTVarRef& var)
 {
+    auto var_decl = var.get_decl();
+    if(!var.get_index() && (options.expr_regs || reg_of(*var_decl) != -1))
+    {
+        auto reg = var_decl->is_array() ? load_base_address(REG_V0, *var_decl)
+                                        : load_leaf(REG_V0, var);
+        if(reg != REG_V0)
+        {
+            dest += "move $v0, $";
+            dest += regname(reg);
+            dest += '\n';
+        }
+        return;
+    }
+
     load_address_of(var);
     if(var.type() != ExprType::Array)
         dest += "lw $v0, 0($v0)\n";
@@ -416,8 +1384,41 @@ void ASTCodegenVisitor::visit_var_expr(ASTVarRef& var)
 
 void ASTCodegenVisitor::visit_call_expr(ASTFunCall& fun_call)
 {
+    emit_call_args(fun_call);
+
+    dest += "jal ";
+    dest += fun_call.get_decl()->get_name();
+    dest += '\n';
+}
+
+bool ASTCodegenVisitor::can_tail_call(ASTFunCall& fun_call)
+{
+    if(!options.tail_calls)
+        return false;
+
+    // Our caller only made room for as many arguments as we take.
     auto fun_decl = fun_call.get_decl();
+    if(fun_decl.get() != current_function && fun_decl->get_num_params() > 4)
+        return false;
+
+    // Local arrays do not outlive our frame, nor may they be shared with
+    // a new activation of ourselves.
+    for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it)
+    {
+        if(auto var_ref = (*it)->as_var_expr(); var_ref && !var_ref->get_index())
+        {
+            auto var_decl = var_ref->get_decl();
+            if(var_decl->is_array() && !var_decl->is_pointer()
+               && local_pos.count(var_decl.get()))
+                return false;
+        }
+    }
 
+    return true;
+}
+
+void ASTCodegenVisitor::emit_call_args(ASTFunCall& fun_call)
+{
     size_t argcount = 0;
     for(auto it = fun_call.arg_begin();
         it != fun_call.arg_end();
@@ -436,10 +1437,6 @@ void ASTCodegenVisitor::visit_call_expr(ASTFunCall& fun_call)
             emit_frame_sw(REG_V0, current_frame.output_offset(4 * (argcount - 4)));
         }
     }
-
-    dest += "jal ";
-    dest += fun_decl->get_name();
-    dest += '\n';
 }
 
 void ASTCodegenVisitor::visit_type(ExprType type)
@@ -456,8 +1453,33 @@ void ASTCodegenVisitor::load_address_of(ASTVarRef& var_ref)
 {
     auto var_decl = var_ref.get_decl();
 
+    // The base address is computed after the index, so that it does not need
+    // to be held while the index is evaluated.
+    if(options.expr_regs)
+    {
+        auto index_expr = var_ref.get_index();
+        assert(index_expr != nullptr);
+
+        visit_expr(*index_expr);
+        if(!bounds.redundant.count(&var_ref) && !bounds.hoisted.count(&var_ref))
+            emit_bounds_check();
+
+        dest += "sll $v0, $v0, 2\n";
+        emit_binary_op(ASTBinaryExpr::Operation::Plus,
+                       load_base_address(REG_T0, *var_decl), REG_V0);
+        return;
+    }
+
     auto it = local_pos.find(var_decl.get());
-    if(it != local_pos.end())
+    if(auto reg = reg_of(*var_decl); reg != -1)
+    {
+        // Only array parameters are in registers and have an address.
+        assert(var_decl->is_pointer());
+        dest += "move $v0, $";
+        dest += regname(reg);
+        dest += '\n';
+    }
+    else if(it != local_pos.end())
     {
         auto frame_offset = current_frame.local_offset(it->second);
         dest += "addiu $v0, $sp, ";
@@ -480,16 +1502,16 @@ void ASTCodegenVisitor::load_address_of(ASTVarRef& var_ref)
         const auto temp_bytes = 4;
         const auto temp_pos = temp_alloc(temp_bytes);
 
-        if(this->function_label_goto_ob == -1)
+        const bool checked = !bounds.redundant.count(&var_ref)
+                             && !bounds.hoisted.count(&var_ref);
+
+        if(checked && this->function_label_goto_ob == -1)
             this->function_label_goto_ob = next_label_id();
 
         emit_frame_sw(REG_V0, temp_pos);
         visit_expr(*index_expr);
-
-        // Check negative index.
-        dest += "bltzal $v0, .L";
-        dest += std::to_string(function_label_goto_ob);
-        dest += '\n';
+        if(checked)
+            emit_bounds_check();
 
         dest += "sll $v0, $v0, 2\n";
         emit_frame_lw(REG_T0, temp_pos);
@@ -499,6 +1521,233 @@ void ASTCodegenVisitor::load_address_of(ASTVarRef& var_ref)
     }
 }
 
+void ASTCodegenVisitor::emit_bounds_check()
+{
+    if(this->function_label_goto_ob == -1)
+        this->function_label_goto_ob = next_label_id();
+
+    // Check negative index. The linking branch clobbers $ra even when not
+    // taken, thus it cannot be used by leaf functions, which do not save it.
+    dest += (regs.is_leaf ? "bltz $v0, .L" : "bltzal $v0, .L");
+    dest += std::to_string(function_label_goto_ob);
+    dest += '\n';
+}
+
+void ASTCodegenVisitor::allocate_registers(ASTFunDecl& decl)
+{
+    auto& var_regs = this->regs.var_regs;
+    auto& saved_regs = this->regs.saved_regs;
+    auto& expr_regs = this->regs.expr_regs;
+    auto& expr_labels = this->regs.expr_labels;
+
+    var_regs.clear();
+    saved_regs.clear();
+    expr_regs.clear();
+    expr_labels.clear();
+    this->regs.is_leaf = false;
+    this->num_used_expr_regs = 0;
+
+    // The argument registers are left alone by functions making no calls.
+    if(options.leaf_frames)
+    {
+        CallFinderVisitor call_finder;
+        call_finder.visit_compound_stmt(*decl.get_body());
+        this->regs.is_leaf = !call_finder.found();
+    }
+
+    if(regs.is_leaf)
+    {
+        for(size_t i = 0; i < std::min<size_t>(4, decl.get_num_params()); ++i)
+            var_regs[decl.get_param(i).get()] = REG_A0 + static_cast<int>(i);
+    }
+
+    if(options.regalloc)
+        allocate_var_registers(decl);
+
+    // The caller-saved registers left free by the variables are used for
+    // evaluating expressions.
+    if(options.expr_regs)
+    {
+        for(auto reg : temp_var_regs)
+        {
+            auto in_use = std::any_of(var_regs.begin(), var_regs.end(), [&](const auto& entry) {
+                return entry.second == reg;
+            });
+            if(!in_use)
+                expr_regs.push_back(reg);
+        }
+
+        ExprLabelVisitor(var_regs, expr_labels).visit_compound_stmt(*decl.get_body());
+    }
+}
+
+void ASTCodegenVisitor::allocate_var_registers(ASTFunDecl& decl)
+{
+    using Interval = LiveIntervalVisitor::Interval;
+
+    auto& var_regs = this->regs.var_regs;
+    auto& saved_regs = this->regs.saved_regs;
+
+    auto intervals = LiveIntervalVisitor().compute(decl);
+
+    // This is the classic linear scan allocator. Intervals are visited in
+    // order of their start point, and when no register is available the
+    // interval ending the furthest is spilled to the stack frame.
+    std::vector<std::pair<const Interval*, int>> active;
+    bool reg_used[32] = {};
+
+    auto take_free_reg = [&](const auto& regs) {
+        for(auto reg : regs)
+        {
+            if(!reg_used[reg])
+                return reg;
+        }
+        return -1;
+    };
+
+    for(const auto& interval : intervals)
+    {
+        // Parameters of leaf functions are already in registers.
+        if(var_regs.count(interval.var))
+            continue;
+
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](const auto& entry) {
+                                        if(entry.first->end >= interval.start)
+                                            return false;
+                                        reg_used[entry.second] = false;
+                                        return true;
+                                    }),
+                     active.end());
+
+        // Variables live across calls must be kept in callee-saved registers.
+        auto reg = (interval.crosses_call ? -1 : take_free_reg(temp_var_regs));
+        if(reg == -1)
+            reg = take_free_reg(saved_var_regs);
+
+        if(reg == -1)
+        {
+            auto victim = active.end();
+            for(auto it = active.begin(); it != active.end(); ++it)
+            {
+                const auto compatible = !interval.crosses_call
+                                        || std::count(std::begin(saved_var_regs),
+                                                      std::end(saved_var_regs), it->second);
+                if(compatible && (victim == active.end() || it->first->end > victim->first->end))
+                    victim = it;
+            }
+
+            if(victim == active.end() || victim->first->end <= interval.end)
+                continue;
+
+            reg = victim->second;
+            var_regs.erase(victim->first->var);
+            active.erase(victim);
+        }
+
+        reg_used[reg] = true;
+        var_regs[interval.var] = reg;
+        active.emplace_back(&interval, reg);
+    }
+
+    for(auto reg : saved_var_regs)
+    {
+        auto in_use = std::any_of(var_regs.begin(), var_regs.end(), [&](const auto& entry) {
+            return entry.second == reg;
+        });
+        if(in_use)
+            saved_regs.push_back(reg);
+    }
+}
+
+int ASTCodegenVisitor::reg_of(ASTVarDecl& decl) const
+{
+    auto it = regs.var_regs.find(&decl);
+    return it != regs.var_regs.end() ? it->second : -1;
+}
+
+int ASTCodegenVisitor::load_base_address(int reg, ASTVarDecl& decl)
+{
+    assert(decl.is_array());
+    const auto name = regname(reg);
+
+    if(auto var_reg = reg_of(decl); var_reg != -1)
+    {
+        return var_reg;
+    }
+    else if(auto it = local_pos.find(&decl); it != local_pos.end())
+    {
+        dest += (decl.is_pointer() ? "lw $" : "addiu $");
+        dest += name;
+        dest += (decl.is_pointer() ? ", " : ", $sp, ");
+        dest += std::to_string(current_frame.local_offset(it->second));
+        dest += (decl.is_pointer() ? "($sp)\n" : "\n");
+    }
+    else
+    {
+        dest += "la $";
+        dest += name;
+        dest += ", ";
+        dest += decl.get_name();
+        dest += '\n';
+    }
+    return reg;
+}
+
+int ASTCodegenVisitor::load_leaf(int reg, ASTExpr& leaf)
+{
+    assert(is_leaf(leaf));
+    const auto name = regname(reg);
+
+    if(leaf.expr_kind() == ExprKind::Number)
+    {
+        dest += "li $";
+        dest += name;
+        dest += ", ";
+        dest += std::to_string(static_cast<ASTNumber&>(leaf).get_value());
+        dest += '\n';
+        return reg;
+    }
+
+    auto var_decl = static_cast<ASTVarRef&>(leaf).get_decl();
+    if(auto var_reg = reg_of(*var_decl); var_reg != -1)
+        return var_reg;
+
+    if(auto it = local_pos.find(var_decl.get()); it != local_pos.end())
+    {
+        emit_frame_lw(reg, current_frame.local_offset(it->second));
+    }
+    else
+    {
+        dest += "la $";
+        dest += name;
+        dest += ", ";
+        dest += var_decl->get_name();
+        dest += "\nlw $";
+        dest += name;
+        dest += ", 0($";
+        dest += name;
+        dest += ")\n";
+    }
+    return reg;
+}
+
+void ASTCodegenVisitor::store_into(ASTVarDecl& decl)
+{
+    assert(!decl.is_array() && reg_of(decl) == -1);
+
+    if(auto it = local_pos.find(&decl); it != local_pos.end())
+    {
+        emit_frame_sw(REG_V0, current_frame.local_offset(it->second));
+    }
+    else
+    {
+        dest += "la $t0, ";
+        dest += decl.get_name();
+        dest += "\nsw $v0, 0($t0)\n";
+    }
+}
+
 uint32_t ASTCodegenVisitor::FrameInfo::total_size() const
 {
     return input_size + local_size + saved_size + temp_size + output_size;
@@ -0,0 +1,288 @@
+#include <cminus/ast-dead-code-visitor.hpp>
+#include <cminus/ast-utils.hpp>
+#include <cminus/mem-report.hpp>
+
+namespace
+{
+using namespace cminus;
+
+/// A set of variables, such as the ones live at some point.
+using VarSet = std::unordered_set<ASTVarDecl*>;
+
+/// Backward liveness analysis over the scalar locals and parameters of a
+/// function, finding the assignments whose value is never read.
+///
+/// Only assignments evaluated after everything else in their expression
+/// statement, condition or return (e.g. both in `x = y = f()`) may kill the
+/// variable assigned. The ones nested in other expressions are evaluated in
+/// an order which is up to the code generator, thus they are taken as reads.
+class LivenessAnalyzer
+{
+public:
+    explicit LivenessAnalyzer(const VarSet& globals) :
+        globals(globals)
+    {
+    }
+
+    void analyze(ASTFunDecl& decl)
+    {
+        VarSet live;
+        exec(*decl.get_body(), live);
+    }
+
+    /// Checks whether the value of an assignment is never read.
+    bool is_dead(ASTExpr& assign) const
+    {
+        return dead.count(&assign) != 0 && !needed.count(&assign);
+    }
+
+private:
+    /// Checks whether the variable is a scalar local or parameter.
+    bool is_tracked(ASTVarDecl* var) const
+    {
+        return !var->is_array() && !globals.count(var);
+    }
+
+    /// Turns the variables live after a statement into the ones live before.
+    void exec(ASTStmt& stmt, VarSet& live)
+    {
+        switch(stmt.stmt_kind())
+        {
+            case StmtKind::NullStmt:
+                break;
+            case StmtKind::ExprStmt:
+                eval(static_cast<ASTExpr&>(stmt), live, true);
+                break;
+            case StmtKind::CompoundStmt:
+            {
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(stmt);
+                for(auto it = comp_stmt.stmt_end(); it != comp_stmt.stmt_begin();)
+                    exec(**--it, live);
+                break;
+            }
+            case StmtKind::SelectionStmt:
+            {
+                auto& if_stmt = static_cast<ASTSelectionStmt&>(stmt);
+                VarSet else_live = live;
+                if(if_stmt.get_else())
+                    exec(*if_stmt.get_else(), else_live);
+                exec(*if_stmt.get_then(), live);
+                live.insert(else_live.begin(), else_live.end());
+                eval(*if_stmt.get_cond(), live, true);
+                break;
+            }
+            case StmtKind::IterationStmt:
+            {
+                // Iterate until the variables live before the condition are
+                // stable, which they are after as many iterations as there
+                // are variables at most.
+                auto& while_stmt = static_cast<ASTIterationStmt&>(stmt);
+                const VarSet exit_live = live;
+                eval(*while_stmt.get_cond(), live, true);
+                size_t num_live;
+                do
+                {
+                    num_live = live.size();
+                    exec(*while_stmt.get_body(), live);
+                    live.insert(exit_live.begin(), exit_live.end());
+                    eval(*while_stmt.get_cond(), live, true);
+                } while(num_live != live.size());
+                break;
+            }
+            case StmtKind::ReturnStmt:
+            {
+                auto& retn_stmt = static_cast<ASTReturnStmt&>(stmt);
+                live.clear();
+                if(auto expr = retn_stmt.get_expr())
+                    eval(*expr, live, true);
+                break;
+            }
+        }
+    }
+
+    /// Turns the variables live after an expression into the ones live
+    /// before, where `last` tells whether it is the last one evaluated
+    /// within its statement.
+    void eval(ASTExpr& expr, VarSet& live, bool last)
+    {
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+                break;
+            case ExprKind::VarRef:
+            {
+                auto& var_ref = static_cast<ASTVarRef&>(expr);
+                if(auto index = var_ref.get_index())
+                    eval(*index, live, false);
+                else if(is_tracked(var_ref.get_decl().get()))
+                    live.insert(var_ref.get_decl().get());
+                break;
+            }
+            case ExprKind::FunCall:
+            {
+                auto& fun_call = static_cast<ASTFunCall&>(expr);
+                for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it)
+                    eval(**it, live, false);
+                break;
+            }
+            case ExprKind::BinaryExpr:
+            case ExprKind::AssignExpr:
+            {
+                auto& binary_expr = static_cast<ASTBinaryExpr&>(expr);
+                auto& left = *binary_expr.get_left();
+                if(last && left.expr_kind() == ExprKind::VarRef)
+                {
+                    auto& var_ref = static_cast<ASTVarRef&>(left);
+                    auto var = var_ref.get_decl().get();
+                    if(expr.expr_kind() == ExprKind::AssignExpr && !var_ref.get_index()
+                       && is_tracked(var))
+                    {
+                        // The variable is only read back after being assigned.
+                        (live.count(var) ? needed : dead).insert(&expr);
+                        live.erase(var);
+                        eval(*binary_expr.get_right(), live, true);
+                        break;
+                    }
+                }
+                eval(left, live, false);
+                eval(*binary_expr.get_right(), live, false);
+                break;
+            }
+        }
+    }
+
+private:
+    const VarSet& globals;
+    std::unordered_set<ASTExpr*> dead;
+    std::unordered_set<ASTExpr*> needed;
+};
+
+/// Removes the statements which cannot be reached and the dead assignments
+/// found by a `LivenessAnalyzer`.
+class DeadCodeRemover
+{
+public:
+    explicit DeadCodeRemover(const LivenessAnalyzer& liveness) :
+        liveness(liveness)
+    {
+    }
+
+    /// \returns the statement replacing `stmt` or `nullptr` if nothing
+    /// is left of it.
+    auto remove(std::shared_ptr<ASTStmt> stmt) -> std::shared_ptr<ASTStmt>
+    {
+        switch(stmt->stmt_kind())
+        {
+            case StmtKind::NullStmt:
+                return nullptr;
+            case StmtKind::ExprStmt:
+            {
+                auto expr = strip(stmt->as_expr());
+                return is_pure(*expr) ? nullptr : expr;
+            }
+            case StmtKind::CompoundStmt:
+            {
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(*stmt);
+                auto out = comp_stmt.stmt_begin();
+                for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+                {
+                    if(auto inner = remove(*it))
+                    {
+                        *out++ = inner;
+                        if(always_returns(*inner))
+                            break;
+                    }
+                }
+                comp_stmt.stmt_erase(out, comp_stmt.stmt_end());
+                return stmt;
+            }
+            case StmtKind::SelectionStmt:
+            {
+                auto& if_stmt = static_cast<ASTSelectionStmt&>(*stmt);
+                auto cond = strip(if_stmt.get_cond());
+                auto then_stmt = remove(if_stmt.get_then());
+                auto else_stmt = (if_stmt.get_else() ? remove(if_stmt.get_else()) : nullptr);
+                if(auto value = number_value(*cond))
+                    return (*value != 0 ? then_stmt : else_stmt);
+                if(!then_stmt && !else_stmt)
+                    return is_pure(*cond) ? nullptr : cond;
+
+                if_stmt.set_cond(std::move(cond));
+                if_stmt.set_then(then_stmt ? then_stmt : std::make_shared<ASTNullStmt>());
+                if(if_stmt.get_else())
+                    if_stmt.set_else(else_stmt ? else_stmt : std::make_shared<ASTNullStmt>());
+                return stmt;
+            }
+            case StmtKind::IterationStmt:
+            {
+                auto& while_stmt = static_cast<ASTIterationStmt&>(*stmt);
+                auto cond = strip(while_stmt.get_cond());
+                if(number_value(*cond) == 0)
+                    return nullptr;
+
+                auto body = remove(while_stmt.get_body());
+                while_stmt.set_cond(std::move(cond));
+                while_stmt.set_body(body ? body : std::make_shared<ASTNullStmt>());
+                return stmt;
+            }
+            case StmtKind::ReturnStmt:
+            {
+                auto& retn_stmt = static_cast<ASTReturnStmt&>(*stmt);
+                if(auto expr = retn_stmt.get_expr())
+                    retn_stmt.set_expr(strip(std::move(expr)));
+                return stmt;
+            }
+        }
+        return stmt;
+    }
+
+private:
+    /// Replaces the dead assignments evaluated last in an expression by
+    /// their right-hand side.
+    auto strip(std::shared_ptr<ASTExpr> expr) -> std::shared_ptr<ASTExpr>
+    {
+        while(expr->expr_kind() == ExprKind::AssignExpr)
+        {
+            auto& assign = static_cast<ASTBinaryExpr&>(*expr);
+            if(!liveness.is_dead(*expr))
+            {
+                assign.set_right(strip(assign.get_right()));
+                break;
+            }
+            expr = assign.get_right();
+        }
+        return expr;
+    }
+
+private:
+    const LivenessAnalyzer& liveness;
+};
+}
+
+namespace cminus
+{
+void ASTDeadCodeVisitor::visit_program(ASTProgram& program)
+{
+    MemScope mem_scope(MemTag::AST);
+
+    this->globals.clear();
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+    {
+        if(auto var_decl = (*it)->as_var_decl())
+            this->globals.insert(var_decl.get());
+    }
+
+    walk_program(program);
+}
+
+void ASTDeadCodeVisitor::visit_fun_decl(ASTFunDecl& decl)
+{
+    auto body = decl.get_body();
+    if(!body)
+        return;
+
+    LivenessAnalyzer liveness(globals);
+    liveness.analyze(decl);
+    DeadCodeRemover(liveness).remove(body);
+}
+}
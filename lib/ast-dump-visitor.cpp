@@ -1,4 +1,5 @@
 #include <cminus/ast-dump-visitor.hpp>
+#include <cminus/mem-report.hpp>
 
 namespace cminus
 {
@@ -42,6 +43,8 @@ void ASTDumpVisitor::newline(size_t depth)
 
 void ASTDumpVisitor::visit_program(ASTProgram& program)
 {
+    MemScope mem_scope(MemTag::Output);
+
     newline(depth);
     dest += '[';
     dest += "program";
@@ -0,0 +1,222 @@
+#include <cminus/ast-fold-visitor.hpp>
+#include <cminus/ast-utils.hpp>
+#include <cminus/mem-report.hpp>
+#include <optional>
+
+namespace
+{
+using namespace cminus;
+using Operation = ASTBinaryExpr::Operation;
+
+/// Wraps a value around into the range of 32-bit integers.
+int32_t wrap(int64_t value)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+/// \returns the result of `lhs op rhs` or `std::nullopt` if it is
+/// undefined (i.e. a division by zero).
+auto evaluate(Operation op, int32_t lhs, int32_t rhs) -> std::optional<int32_t>
+{
+    const auto lhs64 = static_cast<int64_t>(lhs);
+    const auto rhs64 = static_cast<int64_t>(rhs);
+    switch(op)
+    {
+        case Operation::Plus:
+            return wrap(lhs64 + rhs64);
+        case Operation::Minus:
+            return wrap(lhs64 - rhs64);
+        case Operation::Multiply:
+            return wrap(lhs64 * rhs64);
+        case Operation::Divide:
+            if(rhs == 0)
+                return std::nullopt;
+            return wrap(lhs64 / rhs64);
+        case Operation::Less:
+            return lhs < rhs;
+        case Operation::LessEqual:
+            return lhs <= rhs;
+        case Operation::Greater:
+            return lhs > rhs;
+        case Operation::GreaterEqual:
+            return lhs >= rhs;
+        case Operation::Equal:
+            return lhs == rhs;
+        case Operation::NotEqual:
+            return lhs != rhs;
+        case Operation::Assign:
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+auto make_number(int32_t value, SourceRange range) -> std::shared_ptr<ASTExpr>
+{
+    return std::make_shared<ASTNumber>(value, range);
+}
+
+/// Simplifies a binary expression whose operands are already folded.
+///
+/// \returns the simplified expression, which may be `expr` itself.
+auto simplify(ASTBinaryExpr& expr) -> std::shared_ptr<ASTExpr>
+{
+    const auto op = expr.get_operation();
+    if(op == Operation::Assign)
+        return expr.as_expr();
+
+    auto left = expr.get_left();
+    auto right = expr.get_right();
+    auto lhs = number_value(*left);
+    auto rhs = number_value(*right);
+
+    if(lhs && rhs)
+    {
+        if(auto value = evaluate(op, *lhs, *rhs))
+            return make_number(*value, expr.source_range());
+        return expr.as_expr();
+    }
+
+    // Constants go to the right of commutative operations, so that chains
+    // of constants become adjacent.
+    if(lhs && (op == Operation::Plus || op == Operation::Multiply))
+    {
+        expr.set_left(right);
+        expr.set_right(left);
+        std::swap(left, right);
+        std::swap(lhs, rhs);
+    }
+
+    switch(op)
+    {
+        case Operation::Plus:
+        case Operation::Minus:
+        {
+            if(!rhs)
+                break;
+            if(*rhs == 0)
+                return left;
+
+            // (x + c1) + c2 => x + (c1 + c2), and likewise for subtractions.
+            auto left_expr = left->as_binary_expr();
+            if(!left_expr)
+                break;
+
+            const auto left_op = left_expr->get_operation();
+            auto left_rhs = number_value(*left_expr->get_right());
+            if(!left_rhs || (left_op != Operation::Plus && left_op != Operation::Minus))
+                break;
+
+            const auto addend = wrap((left_op == Operation::Plus ? int64_t{*left_rhs} : -int64_t{*left_rhs})
+                                     + (op == Operation::Plus ? int64_t{*rhs} : -int64_t{*rhs}));
+            if(addend == 0)
+                return left_expr->get_left();
+
+            return std::make_shared<ASTBinaryExpr>(left_expr->get_left(),
+                                                   make_number(addend, right->source_range()),
+                                                   Operation::Plus);
+        }
+        case Operation::Multiply:
+        {
+            if(!rhs)
+                break;
+
+            if(*rhs == 1)
+                return left;
+            if(*rhs == 0 && is_pure(*left))
+                return right;
+
+            // (x * c1) * c2 => x * (c1 * c2)
+            if(auto left_expr = left->as_binary_expr())
+            {
+                auto left_rhs = number_value(*left_expr->get_right());
+                if(left_rhs && left_expr->get_operation() == Operation::Multiply)
+                {
+                    auto factor = wrap(int64_t{*left_rhs} * int64_t{*rhs});
+                    return simplify(*std::make_shared<ASTBinaryExpr>(
+                            left_expr->get_left(), make_number(factor, right->source_range()),
+                            Operation::Multiply));
+                }
+            }
+            break;
+        }
+        case Operation::Divide:
+        {
+            if(rhs == 1)
+                return left;
+            break;
+        }
+        default:
+            break;
+    }
+
+    return expr.as_expr();
+}
+}
+
+namespace cminus
+{
+void ASTFoldVisitor::visit_program(ASTProgram& program)
+{
+    MemScope mem_scope(MemTag::AST);
+    walk_program(program);
+}
+
+void ASTFoldVisitor::visit_compound_stmt(ASTCompoundStmt& comp_stmt)
+{
+    for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+    {
+        if(auto expr = (*it)->as_expr_stmt())
+            *it = fold(std::move(expr));
+        else
+            visit_stmt(**it);
+    }
+}
+
+void ASTFoldVisitor::visit_selection_stmt(ASTSelectionStmt& if_stmt)
+{
+    if_stmt.set_cond(fold(if_stmt.get_cond()));
+    visit_stmt(*if_stmt.get_then());
+    if(auto else_stmt = if_stmt.get_else())
+        visit_stmt(*else_stmt);
+}
+
+void ASTFoldVisitor::visit_iteration_stmt(ASTIterationStmt& while_stmt)
+{
+    while_stmt.set_cond(fold(while_stmt.get_cond()));
+    visit_stmt(*while_stmt.get_body());
+}
+
+void ASTFoldVisitor::visit_return_stmt(ASTReturnStmt& retn_stmt)
+{
+    if(auto expr = retn_stmt.get_expr())
+        retn_stmt.set_expr(fold(std::move(expr)));
+}
+
+void ASTFoldVisitor::visit_var_expr(ASTVarRef& var_ref)
+{
+    if(auto index = var_ref.get_index())
+        var_ref.set_index(fold(std::move(index)));
+}
+
+void ASTFoldVisitor::visit_call_expr(ASTFunCall& fun_call)
+{
+    for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it)
+        *it = fold(std::move(*it));
+}
+
+void ASTFoldVisitor::visit_binary_expr(ASTBinaryExpr& expr)
+{
+    expr.set_left(fold(expr.get_left()));
+    expr.set_right(fold(expr.get_right()));
+    this->folded = simplify(expr);
+}
+
+auto ASTFoldVisitor::fold(std::shared_ptr<ASTExpr> expr) -> std::shared_ptr<ASTExpr>
+{
+    // Only binary expressions may fold into another node. The folded form of
+    // any children is moved out before we get here.
+    this->folded = nullptr;
+    visit_expr(*expr);
+    return this->folded ? std::move(this->folded) : expr;
+}
+}
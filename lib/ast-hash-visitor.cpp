@@ -0,0 +1,266 @@
+#include <cminus/ast-hash-visitor.hpp>
+
+namespace
+{
+using namespace cminus;
+
+/// Tags of the hashed nodes.
+///
+/// The values are part of the hash, thus they must never be changed.
+enum class HashTag : uint64_t
+{
+    Program = 1,
+    VarDecl = 2,
+    ParmVarDecl = 3,
+    FunDecl = 4,
+    NullStmt = 5,
+    CompoundStmt = 6,
+    SelectionStmt = 7,
+    IterationStmt = 8,
+    ReturnStmt = 9,
+    Number = 10,
+    GlobalRef = 11,
+    LocalRef = 12,
+    BuiltinRef = 13,
+    FunCall = 14,
+    BinaryExpr = 15,
+    None = 16,
+};
+
+/// The finalizer of splitmix64.
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/// Order sensitive combination of hashes.
+uint64_t combine(uint64_t seed, uint64_t value)
+{
+    return mix(seed ^ (mix(value) + 0x9e3779b97f4a7c15ULL));
+}
+
+uint64_t combine(uint64_t seed, HashTag tag)
+{
+    return combine(seed, static_cast<uint64_t>(tag));
+}
+
+/// Hashes a string (FNV-1a).
+uint64_t hash_string(SourceRange str)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(auto c : str)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+}
+
+namespace cminus
+{
+void ASTHashVisitor::visit_program(ASTProgram& program)
+{
+    // Top-level declarations may be referenced before being visited (e.g.
+    // recursive functions), so number them up front.
+    uint64_t level = 0;
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+        this->global_levels[it->get()] = level++;
+
+    auto hash = combine(0, HashTag::Program);
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+    {
+        visit_decl(**it);
+        hash = combine(hash, last_hash);
+    }
+    this->last_hash = hash;
+}
+
+void ASTHashVisitor::visit_var_decl(ASTVarDecl& decl)
+{
+    auto hash = combine(0, HashTag::VarDecl);
+    hash = combine(hash, decl.is_array());
+    if(auto size = decl.get_array_size())
+        hash = combine(hash, static_cast<uint32_t>(size->get_value()));
+
+    if(!global_levels.count(&decl))
+        bind_local(decl);
+
+    this->last_hash = hash;
+}
+
+void ASTHashVisitor::visit_parm_decl(ASTParmVarDecl& decl)
+{
+    auto hash = combine(0, HashTag::ParmVarDecl);
+    hash = combine(hash, decl.is_array());
+    bind_local(decl);
+    this->last_hash = hash;
+}
+
+void ASTHashVisitor::visit_fun_decl(ASTFunDecl& decl)
+{
+    const auto outer_num_locals = local_stack.size();
+
+    auto hash = combine(0, HashTag::FunDecl);
+    hash = combine(hash, decl.is_void());
+    hash = combine(hash, decl.get_num_params());
+    for(auto it = decl.parm_begin(); it != decl.parm_end(); ++it)
+    {
+        visit_parm_decl(**it);
+        hash = combine(hash, last_hash);
+    }
+
+    hash = combine(hash, hash_optional(decl.get_body().get()));
+
+    for(auto i = outer_num_locals; i < local_stack.size(); ++i)
+        this->local_levels.erase(local_stack[i]);
+    this->local_stack.resize(outer_num_locals);
+
+    this->last_hash = hash;
+}
+
+void ASTHashVisitor::visit_null_stmt(ASTNullStmt& stmt)
+{
+    record(stmt, combine(0, HashTag::NullStmt));
+}
+
+void ASTHashVisitor::visit_compound_stmt(ASTCompoundStmt& comp_stmt)
+{
+    const auto outer_num_locals = local_stack.size();
+
+    auto hash = combine(0, HashTag::CompoundStmt);
+    for(auto it = comp_stmt.decl_begin(); it != comp_stmt.decl_end(); ++it)
+    {
+        visit_var_decl(**it);
+        hash = combine(hash, last_hash);
+    }
+
+    // Separates declarations from statements.
+    hash = combine(hash, HashTag::None);
+
+    for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+    {
+        visit_stmt(**it);
+        hash = combine(hash, last_hash);
+    }
+
+    for(auto i = outer_num_locals; i < local_stack.size(); ++i)
+        this->local_levels.erase(local_stack[i]);
+    this->local_stack.resize(outer_num_locals);
+
+    record(comp_stmt, hash);
+}
+
+void ASTHashVisitor::visit_selection_stmt(ASTSelectionStmt& if_stmt)
+{
+    auto hash = combine(0, HashTag::SelectionStmt);
+    hash = combine(hash, hash_optional(if_stmt.get_cond().get()));
+    hash = combine(hash, hash_optional(if_stmt.get_then().get()));
+    hash = combine(hash, hash_optional(if_stmt.get_else().get()));
+    record(if_stmt, hash);
+}
+
+void ASTHashVisitor::visit_iteration_stmt(ASTIterationStmt& while_stmt)
+{
+    auto hash = combine(0, HashTag::IterationStmt);
+    hash = combine(hash, hash_optional(while_stmt.get_cond().get()));
+    hash = combine(hash, hash_optional(while_stmt.get_body().get()));
+    record(while_stmt, hash);
+}
+
+void ASTHashVisitor::visit_return_stmt(ASTReturnStmt& retn_stmt)
+{
+    auto hash = combine(0, HashTag::ReturnStmt);
+    hash = combine(hash, hash_optional(retn_stmt.get_expr().get()));
+    record(retn_stmt, hash);
+}
+
+void ASTHashVisitor::visit_number_expr(ASTNumber& num)
+{
+    auto hash = combine(0, HashTag::Number);
+    hash = combine(hash, static_cast<uint32_t>(num.get_value()));
+    record(num, hash);
+}
+
+void ASTHashVisitor::visit_var_expr(ASTVarRef& var_ref)
+{
+    auto decl = var_ref.get_decl().get();
+
+    uint64_t hash;
+    auto it = local_levels.find(decl);
+    if(it != local_levels.end())
+    {
+        const auto de_bruijn_index = local_stack.size() - 1 - it->second;
+        hash = combine(combine(0, HashTag::LocalRef), de_bruijn_index);
+    }
+    else
+    {
+        assert(global_levels.count(decl));
+        hash = combine(combine(0, HashTag::GlobalRef), global_levels[decl]);
+    }
+
+    hash = combine(hash, hash_optional(var_ref.get_index().get()));
+    record(var_ref, hash);
+}
+
+void ASTHashVisitor::visit_call_expr(ASTFunCall& fun_call)
+{
+    auto decl = fun_call.get_decl();
+
+    auto hash = combine(0, HashTag::FunCall);
+    auto it = global_levels.find(decl.get());
+    if(it != global_levels.end())
+        hash = combine(combine(hash, HashTag::GlobalRef), it->second);
+    else
+        hash = combine(combine(hash, HashTag::BuiltinRef), hash_string(decl->get_name()));
+
+    for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it)
+    {
+        visit_expr(**it);
+        hash = combine(hash, last_hash);
+    }
+
+    record(fun_call, hash);
+}
+
+void ASTHashVisitor::visit_binary_expr(ASTBinaryExpr& expr)
+{
+    auto hash = combine(0, HashTag::BinaryExpr);
+    hash = combine(hash, static_cast<uint64_t>(expr.get_operation()));
+    hash = combine(hash, hash_optional(expr.get_left().get()));
+    hash = combine(hash, hash_optional(expr.get_right().get()));
+    record(expr, hash);
+}
+
+uint64_t ASTHashVisitor::hash_of(const ASTStmt& stmt) const
+{
+    auto it = subtree_hashes.find(&stmt);
+    assert(it != subtree_hashes.end());
+    return it->second;
+}
+
+uint64_t ASTHashVisitor::hash_optional(ASTStmt* stmt)
+{
+    if(stmt == nullptr)
+        return combine(0, HashTag::None);
+    visit_stmt(*stmt);
+    return last_hash;
+}
+
+void ASTHashVisitor::bind_local(const ASTVarDecl& decl)
+{
+    this->local_levels[&decl] = local_stack.size();
+    this->local_stack.push_back(&decl);
+}
+
+void ASTHashVisitor::record(const ASTStmt& stmt, uint64_t hash)
+{
+    this->subtree_hashes[&stmt] = hash;
+    this->last_hash = hash;
+}
+}
@@ -0,0 +1,743 @@
+#include <cminus/ast-inline-visitor.hpp>
+#include <cminus/ast-utils.hpp>
+#include <cminus/mem-report.hpp>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+using namespace cminus;
+
+/// Counts the nodes of a function body, which approximates the size of
+/// its code.
+class CostVisitor : public ASTVisitor
+{
+public:
+    auto get_cost() const -> size_t { return this->cost; }
+
+    void visit_var_decl(ASTVarDecl&) override { ++this->cost; }
+    void visit_null_stmt(ASTNullStmt&) override { ++this->cost; }
+    void visit_number_expr(ASTNumber&) override { ++this->cost; }
+
+    void visit_compound_stmt(ASTCompoundStmt& stmt) override
+    {
+        ++this->cost;
+        walk_compound_stmt(stmt);
+    }
+
+    void visit_selection_stmt(ASTSelectionStmt& stmt) override
+    {
+        ++this->cost;
+        walk_selection_stmt(stmt);
+    }
+
+    void visit_iteration_stmt(ASTIterationStmt& stmt) override
+    {
+        ++this->cost;
+        walk_iteration_stmt(stmt);
+    }
+
+    void visit_return_stmt(ASTReturnStmt& stmt) override
+    {
+        ++this->cost;
+        walk_return_stmt(stmt);
+    }
+
+    void visit_var_expr(ASTVarRef& expr) override
+    {
+        ++this->cost;
+        walk_var_expr(expr);
+    }
+
+    void visit_call_expr(ASTFunCall& expr) override
+    {
+        ++this->cost;
+        walk_call_expr(expr);
+    }
+
+    void visit_binary_expr(ASTBinaryExpr& expr) override
+    {
+        ++this->cost;
+        walk_binary_expr(expr);
+    }
+
+private:
+    size_t cost = 0;
+};
+
+/// Finds whether a function is called.
+class CallToFinderVisitor : public ASTVisitor
+{
+public:
+    explicit CallToFinderVisitor(ASTFunDecl& fun) :
+        fun(fun)
+    {
+    }
+
+    bool found() const { return this->found_; }
+
+    void visit_call_expr(ASTFunCall& call) override
+    {
+        if(call.get_decl().get() == &fun)
+            this->found_ = true;
+        walk_call_expr(call);
+    }
+
+private:
+    ASTFunDecl& fun;
+    bool found_ = false;
+};
+
+/// Finds whether a return statement is present.
+class ReturnFinderVisitor : public ASTVisitor
+{
+public:
+    bool found() const { return this->found_; }
+
+    void visit_return_stmt(ASTReturnStmt&) override
+    {
+        this->found_ = true;
+    }
+
+private:
+    bool found_ = false;
+};
+
+bool contains_return(ASTStmt& stmt)
+{
+    ReturnFinderVisitor finder;
+    finder.visit_stmt(stmt);
+    return finder.found();
+}
+
+/// Clones the body of a callee, remapping its variables and turning its
+/// returns into assignments to a result variable.
+///
+/// Returns must be in tail position for this to work. Statements following
+/// a statement which returns on some paths are moved into the branches that
+/// do not return, which is refused when more than one such branch exists to
+/// avoid growing the code. Returns from loops are refused as well.
+class BodyCloner
+{
+public:
+    /// Creates a cloner whose returns assign to `result` or, if null,
+    /// evaluate their expression for its effects only.
+    explicit BodyCloner(std::shared_ptr<ASTVarDecl> result) :
+        result(std::move(result))
+    {
+    }
+
+    /// Checks whether a return could not be moved into tail position.
+    bool has_failed() const { return this->failed; }
+
+    /// Makes references to `from` refer to `to` in the clone.
+    void map(ASTVarDecl& from, std::shared_ptr<ASTVarDecl> to)
+    {
+        this->vars[&from] = std::move(to);
+    }
+
+    auto clone_body(ASTCompoundStmt& body) -> std::shared_ptr<ASTStmt>
+    {
+        auto stmts = clone_seq({&body});
+        return stmts.front();
+    }
+
+    auto clone_expr(ASTExpr& expr) -> std::shared_ptr<ASTExpr>
+    {
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+            {
+                auto& number = static_cast<ASTNumber&>(expr);
+                return std::make_shared<ASTNumber>(number.get_value(), number.source_range());
+            }
+            case ExprKind::VarRef:
+                return clone_var_ref(static_cast<ASTVarRef&>(expr));
+            case ExprKind::FunCall:
+            {
+                auto& call = static_cast<ASTFunCall&>(expr);
+                std::vector<std::shared_ptr<ASTExpr>> args;
+                for(auto it = call.arg_begin(); it != call.arg_end(); ++it)
+                    args.push_back(clone_expr(**it));
+                return std::make_shared<ASTFunCall>(call.get_decl(), std::move(args),
+                                                    call.source_range());
+            }
+            case ExprKind::BinaryExpr:
+            {
+                auto& binary = static_cast<ASTBinaryExpr&>(expr);
+                return std::make_shared<ASTBinaryExpr>(clone_expr(*binary.get_left()),
+                                                       clone_expr(*binary.get_right()),
+                                                       binary.get_operation());
+            }
+            case ExprKind::AssignExpr:
+            {
+                auto& assign = static_cast<ASTBinaryExpr&>(expr);
+                auto& left = static_cast<ASTVarRef&>(*assign.get_left());
+                return std::make_shared<ASTAssignExpr>(clone_var_ref(left),
+                                                       clone_expr(*assign.get_right()));
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    auto clone_var_ref(ASTVarRef& var_ref) -> std::shared_ptr<ASTVarRef>
+    {
+        auto decl = var_ref.get_decl();
+        if(auto it = vars.find(decl.get()); it != vars.end())
+            decl = it->second;
+
+        auto index = var_ref.get_index();
+        return std::make_shared<ASTVarRef>(std::move(decl),
+                                           index ? clone_expr(*index) : nullptr,
+                                           var_ref.source_range());
+    }
+
+    auto clone_decls(ASTCompoundStmt& comp_stmt) -> std::vector<std::shared_ptr<ASTVarDecl>>
+    {
+        std::vector<std::shared_ptr<ASTVarDecl>> decls;
+        for(auto it = comp_stmt.decl_begin(); it != comp_stmt.decl_end(); ++it)
+        {
+            auto& decl = **it;
+            auto clone = std::make_shared<ASTVarDecl>(decl.get_name(), decl.is_array(),
+                                                      decl.get_array_size());
+            map(decl, clone);
+            decls.push_back(std::move(clone));
+        }
+        return decls;
+    }
+
+    auto clone_return(ASTReturnStmt& retn_stmt) -> std::shared_ptr<ASTStmt>
+    {
+        auto expr = retn_stmt.get_expr();
+        if(!expr)
+            return std::make_shared<ASTNullStmt>();
+        if(!result)
+            return clone_expr(*expr);
+
+        auto var_ref = std::make_shared<ASTVarRef>(result, nullptr, expr->source_range());
+        return std::make_shared<ASTAssignExpr>(std::move(var_ref), clone_expr(*expr));
+    }
+
+    auto clone_stmt(ASTStmt& stmt) -> std::shared_ptr<ASTStmt>
+    {
+        switch(stmt.stmt_kind())
+        {
+            case StmtKind::NullStmt:
+                return std::make_shared<ASTNullStmt>();
+            case StmtKind::ExprStmt:
+                return clone_expr(*stmt.as_expr());
+            case StmtKind::CompoundStmt:
+            {
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(stmt);
+                auto decls = clone_decls(comp_stmt);
+                std::vector<std::shared_ptr<ASTStmt>> stmts;
+                for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+                    stmts.push_back(clone_stmt(**it));
+                return std::make_shared<ASTCompoundStmt>(std::move(decls), std::move(stmts));
+            }
+            case StmtKind::SelectionStmt:
+            {
+                auto& if_stmt = static_cast<ASTSelectionStmt&>(stmt);
+                auto else_stmt = if_stmt.get_else();
+                return std::make_shared<ASTSelectionStmt>(
+                        clone_expr(*if_stmt.get_cond()), clone_stmt(*if_stmt.get_then()),
+                        else_stmt ? clone_stmt(*else_stmt) : nullptr);
+            }
+            case StmtKind::IterationStmt:
+            {
+                auto& while_stmt = static_cast<ASTIterationStmt&>(stmt);
+                if(contains_return(*while_stmt.get_body()))
+                    this->failed = true;
+                return std::make_shared<ASTIterationStmt>(clone_expr(*while_stmt.get_cond()),
+                                                          clone_stmt(*while_stmt.get_body()));
+            }
+            case StmtKind::ReturnStmt:
+                return clone_return(static_cast<ASTReturnStmt&>(stmt));
+        }
+        return nullptr;
+    }
+
+    /// Clones a sequence of statements, dropping whatever follows a return.
+    auto clone_seq(const std::vector<ASTStmt*>& seq) -> std::vector<std::shared_ptr<ASTStmt>>
+    {
+        std::vector<std::shared_ptr<ASTStmt>> stmts;
+        for(size_t i = 0; i < seq.size(); ++i)
+        {
+            auto& stmt = *seq[i];
+            const auto rest = std::vector<ASTStmt*>(seq.begin() + i + 1, seq.end());
+
+            if(!contains_return(stmt) || stmt.stmt_kind() == StmtKind::IterationStmt)
+            {
+                stmts.push_back(clone_stmt(stmt));
+                continue;
+            }
+
+            if(stmt.stmt_kind() == StmtKind::CompoundStmt)
+            {
+                // Move the rest of the sequence into the compound statement.
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(stmt);
+                auto decls = clone_decls(comp_stmt);
+                auto inner = std::vector<ASTStmt*>();
+                for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+                    inner.push_back(it->get());
+                inner.insert(inner.end(), rest.begin(), rest.end());
+                stmts.push_back(std::make_shared<ASTCompoundStmt>(std::move(decls),
+                                                                  clone_seq(inner)));
+            }
+            else if(stmt.stmt_kind() == StmtKind::SelectionStmt)
+            {
+                // Move the rest of the sequence into the branches which may
+                // complete normally.
+                auto& if_stmt = static_cast<ASTSelectionStmt&>(stmt);
+                auto then_stmt = if_stmt.get_then().get();
+                auto else_stmt = if_stmt.get_else().get();
+                if(!rest.empty() && !always_returns(*then_stmt)
+                   && !(else_stmt && always_returns(*else_stmt)))
+                {
+                    this->failed = true;
+                }
+
+                auto cond = clone_expr(*if_stmt.get_cond());
+                auto then_clone = clone_branch(then_stmt, rest);
+                auto else_clone = (else_stmt || !rest.empty()) ? clone_branch(else_stmt, rest)
+                                                               : nullptr;
+                stmts.push_back(std::make_shared<ASTSelectionStmt>(
+                        std::move(cond), std::move(then_clone), std::move(else_clone)));
+            }
+            else
+            {
+                stmts.push_back(clone_stmt(stmt));
+            }
+            break;
+        }
+        return stmts;
+    }
+
+    /// Clones a branch followed by a sequence of statements.
+    auto clone_branch(ASTStmt* branch, const std::vector<ASTStmt*>& rest)
+            -> std::shared_ptr<ASTStmt>
+    {
+        auto seq = std::vector<ASTStmt*>();
+        if(branch)
+            seq.push_back(branch);
+        seq.insert(seq.end(), rest.begin(), rest.end());
+
+        auto stmts = clone_seq(seq);
+        if(stmts.size() == 1)
+            return stmts.front();
+        return std::make_shared<ASTCompoundStmt>(std::vector<std::shared_ptr<ASTVarDecl>>(),
+                                                 std::move(stmts));
+    }
+
+private:
+    std::shared_ptr<ASTVarDecl> result;
+    std::unordered_map<ASTVarDecl*, std::shared_ptr<ASTVarDecl>> vars;
+    bool failed = false;
+};
+
+/// \returns the expression evaluated by a statement or `nullptr` if the
+/// statement evaluates none which calls may be inlined from.
+auto root_expr(ASTStmt& stmt) -> std::shared_ptr<ASTExpr>
+{
+    switch(stmt.stmt_kind())
+    {
+        case StmtKind::ExprStmt:
+            return stmt.as_expr();
+        case StmtKind::SelectionStmt:
+            return static_cast<ASTSelectionStmt&>(stmt).get_cond();
+        case StmtKind::ReturnStmt:
+            return static_cast<ASTReturnStmt&>(stmt).get_expr();
+        default:
+            return nullptr;
+    }
+}
+
+/// Replaces the expression evaluated by a statement.
+///
+/// \returns the statement with the replaced expression.
+auto set_root_expr(std::shared_ptr<ASTStmt> stmt, std::shared_ptr<ASTExpr> expr)
+        -> std::shared_ptr<ASTStmt>
+{
+    switch(stmt->stmt_kind())
+    {
+        case StmtKind::ExprStmt:
+            return expr;
+        case StmtKind::SelectionStmt:
+            static_cast<ASTSelectionStmt&>(*stmt).set_cond(std::move(expr));
+            return stmt;
+        case StmtKind::ReturnStmt:
+            static_cast<ASTReturnStmt&>(*stmt).set_expr(std::move(expr));
+            return stmt;
+        default:
+            assert(false);
+            return stmt;
+    }
+}
+
+/// Replaces a call within an expression.
+///
+/// \returns whether the call was found.
+bool replace_call(std::shared_ptr<ASTExpr>& expr, ASTFunCall& call,
+                  const std::shared_ptr<ASTExpr>& with)
+{
+    if(expr.get() == &call)
+    {
+        expr = with;
+        return true;
+    }
+
+    switch(expr->expr_kind())
+    {
+        case ExprKind::Number:
+            return false;
+        case ExprKind::VarRef:
+        {
+            auto& var_ref = static_cast<ASTVarRef&>(*expr);
+            auto index = var_ref.get_index();
+            if(!index || !replace_call(index, call, with))
+                return false;
+            var_ref.set_index(std::move(index));
+            return true;
+        }
+        case ExprKind::FunCall:
+        {
+            auto& fun_call = static_cast<ASTFunCall&>(*expr);
+            for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it)
+            {
+                if(replace_call(*it, call, with))
+                    return true;
+            }
+            return false;
+        }
+        case ExprKind::BinaryExpr:
+        case ExprKind::AssignExpr:
+        {
+            auto& binary = static_cast<ASTBinaryExpr&>(*expr);
+            if(auto left = binary.get_left(); replace_call(left, call, with))
+            {
+                binary.set_left(std::move(left));
+                return true;
+            }
+            if(auto right = binary.get_right(); replace_call(right, call, with))
+            {
+                binary.set_right(std::move(right));
+                return true;
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+/// Inlines the calls made by the body of a function.
+class FunctionInliner
+{
+public:
+    explicit FunctionInliner(const std::unordered_set<ASTVarDecl*>& globals,
+                             std::function<bool(ASTFunDecl&)> is_inlinable) :
+        globals(globals),
+        is_inlinable(std::move(is_inlinable))
+    {
+    }
+
+    auto get_num_inlined() const -> size_t { return this->num_inlined; }
+
+    /// Inlines the calls of a statement and of its children.
+    ///
+    /// \returns the statement which replaces `stmt`.
+    auto rewrite(std::shared_ptr<ASTStmt> stmt) -> std::shared_ptr<ASTStmt>
+    {
+        switch(stmt->stmt_kind())
+        {
+            case StmtKind::CompoundStmt:
+            {
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(*stmt);
+                for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+                    *it = rewrite(*it);
+                return stmt;
+            }
+            case StmtKind::SelectionStmt:
+            {
+                auto& if_stmt = static_cast<ASTSelectionStmt&>(*stmt);
+                if_stmt.set_then(rewrite(if_stmt.get_then()));
+                if(auto else_stmt = if_stmt.get_else())
+                    if_stmt.set_else(rewrite(std::move(else_stmt)));
+                return inline_calls(std::move(stmt));
+            }
+            case StmtKind::IterationStmt:
+            {
+                // Calls in the condition are evaluated once per iteration,
+                // so they are left alone.
+                auto& while_stmt = static_cast<ASTIterationStmt&>(*stmt);
+                while_stmt.set_body(rewrite(while_stmt.get_body()));
+                return stmt;
+            }
+            case StmtKind::ExprStmt:
+            case StmtKind::ReturnStmt:
+                return inline_calls(std::move(stmt));
+            case StmtKind::NullStmt:
+                return stmt;
+        }
+        return stmt;
+    }
+
+private:
+    /// Checks whether a variable is a scalar of the function being rewritten,
+    /// which the callees cannot change.
+    bool is_local_scalar(ASTVarDecl& decl) const
+    {
+        return !decl.is_array() && !globals.count(&decl);
+    }
+
+    /// Finds the first inlinable call of an expression performed before
+    /// anything observable, which may thus be performed before the
+    /// expression is evaluated.
+    ///
+    /// The subscripts which must be checked before the call is performed
+    /// are pushed into `guards`.
+    auto find_leading_call(ASTExpr& expr, std::vector<ASTVarRef*>& guards) -> ASTFunCall*
+    {
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+                return nullptr;
+            case ExprKind::VarRef:
+            {
+                auto& var_ref = static_cast<ASTVarRef&>(expr);
+                if(auto index = var_ref.get_index())
+                {
+                    if(auto call = find_leading_call(*index, guards))
+                        return call;
+                    this->blocked = true;
+                }
+                else if(!var_ref.get_decl()->is_array() && !is_local_scalar(*var_ref.get_decl()))
+                {
+                    this->blocked = true;
+                }
+                return nullptr;
+            }
+            case ExprKind::FunCall:
+            {
+                auto& call = static_cast<ASTFunCall&>(expr);
+                if(is_inlinable(*call.get_decl()))
+                    return &call;
+                for(auto it = call.arg_begin(); it != call.arg_end() && !blocked; ++it)
+                {
+                    if(auto found = find_leading_call(**it, guards))
+                        return found;
+                }
+                this->blocked = true;
+                return nullptr;
+            }
+            case ExprKind::BinaryExpr:
+            {
+                auto& binary = static_cast<ASTBinaryExpr&>(expr);
+                if(auto call = find_leading_call(*binary.get_left(), guards); call || blocked)
+                    return call;
+                return find_leading_call(*binary.get_right(), guards);
+            }
+            case ExprKind::AssignExpr:
+            {
+                // The address of a subscript is computed, and checked, before
+                // the value is. The check is repeated before the call.
+                auto& assign = static_cast<ASTBinaryExpr&>(expr);
+                auto& target = static_cast<ASTVarRef&>(*assign.get_left());
+                if(auto index = target.get_index())
+                {
+                    if(auto call = find_leading_call(*index, guards); call || blocked)
+                        return call;
+                    guards.push_back(&target);
+                }
+
+                if(auto call = find_leading_call(*assign.get_right(), guards))
+                    return call;
+
+                if(target.get_index())
+                    guards.pop_back();
+                this->blocked = true;
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    /// Inlines the calls of a statement performed before anything observable.
+    ///
+    /// \returns the statement which replaces `stmt`.
+    auto inline_calls(std::shared_ptr<ASTStmt> stmt) -> std::shared_ptr<ASTStmt>
+    {
+        std::vector<std::shared_ptr<ASTVarDecl>> decls;
+        std::vector<std::shared_ptr<ASTStmt>> stmts;
+
+        while(stmt)
+        {
+            auto root = root_expr(*stmt);
+            if(!root)
+                break;
+
+            std::vector<ASTVarRef*> guards;
+            this->blocked = false;
+            auto found = find_leading_call(*root, guards);
+            if(!found)
+                break;
+
+            // Keep the call alive while it is replaced.
+            auto call = found->as_call_expr();
+
+            for(auto guard : guards)
+            {
+                BodyCloner cloner(nullptr);
+                stmts.push_back(std::make_shared<ASTVarRef>(guard->get_decl(),
+                                                            cloner.clone_expr(*guard->get_index()),
+                                                            guard->source_range()));
+            }
+
+            std::shared_ptr<ASTVarDecl> result;
+            if(stmt->stmt_kind() == StmtKind::ExprStmt && root == call)
+            {
+                // The result is unused.
+                stmt = nullptr;
+            }
+            else if(auto target = assign_target(*stmt);
+                    target && root->as_binary_expr()->get_right() == call)
+            {
+                // Let the callee return into the assigned variable.
+                result = target;
+                stmt = nullptr;
+            }
+            else
+            {
+                result = std::make_shared<ASTVarDecl>(call->get_decl()->get_name(), false, nullptr);
+                decls.push_back(result);
+
+                auto var_ref = std::make_shared<ASTVarRef>(result, nullptr, call->source_range());
+                replace_call(root, *call, var_ref);
+                stmt = set_root_expr(std::move(stmt), std::move(root));
+            }
+
+            expand(*call, std::move(result), decls, stmts);
+        }
+
+        if(decls.empty() && stmts.empty())
+            return stmt;
+        if(stmt)
+            stmts.push_back(std::move(stmt));
+        return std::make_shared<ASTCompoundStmt>(std::move(decls), std::move(stmts));
+    }
+
+    /// \returns the variable assigned to by an expression statement if it is
+    /// a scalar of the function being rewritten, or `nullptr`.
+    auto assign_target(ASTStmt& stmt) -> std::shared_ptr<ASTVarDecl>
+    {
+        if(stmt.stmt_kind() != StmtKind::ExprStmt)
+            return nullptr;
+
+        auto expr = stmt.as_expr();
+        if(expr->expr_kind() != ExprKind::AssignExpr)
+            return nullptr;
+
+        auto& target = static_cast<ASTVarRef&>(*expr->as_binary_expr()->get_left());
+        if(target.get_index() || !is_local_scalar(*target.get_decl()))
+            return nullptr;
+        return target.get_decl();
+    }
+
+    /// Produces the declarations and statements performing a call, whose
+    /// result is assigned to `result` (if not null).
+    void expand(ASTFunCall& call, std::shared_ptr<ASTVarDecl> result,
+                std::vector<std::shared_ptr<ASTVarDecl>>& decls,
+                std::vector<std::shared_ptr<ASTStmt>>& stmts)
+    {
+        auto callee = call.get_decl();
+        BodyCloner cloner(std::move(result));
+
+        size_t i = 0;
+        for(auto it = call.arg_begin(); it != call.arg_end(); ++it, ++i)
+        {
+            auto param = callee->get_param(i);
+            if(param->is_array())
+            {
+                // Arrays are passed by reference, so refer to the argument.
+                cloner.map(*param, static_cast<ASTVarRef&>(**it).get_decl());
+                continue;
+            }
+
+            auto var = std::make_shared<ASTVarDecl>(param->get_name(), false, nullptr);
+            cloner.map(*param, var);
+            decls.push_back(var);
+
+            auto var_ref = std::make_shared<ASTVarRef>(var, nullptr, param->get_name());
+            stmts.push_back(inline_calls(std::make_shared<ASTAssignExpr>(std::move(var_ref), *it)));
+        }
+
+        stmts.push_back(cloner.clone_body(*callee->get_body()));
+        assert(!cloner.has_failed());
+        ++this->num_inlined;
+    }
+
+private:
+    const std::unordered_set<ASTVarDecl*>& globals;
+    std::function<bool(ASTFunDecl&)> is_inlinable;
+    size_t num_inlined = 0;
+
+    /// Whether something observable was found by `find_leading_call`.
+    bool blocked = false;
+};
+}
+
+namespace cminus
+{
+void ASTInlineVisitor::visit_program(ASTProgram& program)
+{
+    MemScope mem_scope(MemTag::AST);
+
+    this->globals.clear();
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+    {
+        if(auto var_decl = (*it)->as_var_decl())
+            this->globals.insert(var_decl.get());
+    }
+
+    walk_program(program);
+}
+
+void ASTInlineVisitor::visit_fun_decl(ASTFunDecl& decl)
+{
+    auto body = decl.get_body();
+    if(!body)
+        return;
+
+    FunctionInliner inliner(globals, [this](ASTFunDecl& callee) {
+        return is_inlinable(callee);
+    });
+    inliner.rewrite(body);
+    this->num_inlined += inliner.get_num_inlined();
+}
+
+bool ASTInlineVisitor::is_inlinable(ASTFunDecl& decl)
+{
+    if(auto it = inlinable.find(&decl); it != inlinable.end())
+        return it->second;
+
+    auto& result = inlinable[&decl];
+    auto body = decl.get_body();
+    if(!body)
+        return result = false;
+
+    CallToFinderVisitor recursion_finder(decl);
+    recursion_finder.visit_stmt(*body);
+    if(recursion_finder.found())
+        return result = false;
+
+    CostVisitor cost;
+    cost.visit_stmt(*body);
+    if(cost.get_cost() > max_cost)
+        return result = false;
+
+    BodyCloner cloner(nullptr);
+    cloner.clone_body(*body);
+    return result = !cloner.has_failed();
+}
+}
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cminus/ast-lower-visitor.hpp>
+#include <cminus/mem-report.hpp>
+
+namespace
+{
+using namespace cminus;
+using Operation = ASTBinaryExpr::Operation;
+
+/// \returns the operation of the intermediate representation performing
+/// a binary operation other than assignment.
+auto binary_op(Operation op) -> IROp
+{
+    switch(op)
+    {
+        case Operation::Plus:
+            return IROp::Add;
+        case Operation::Minus:
+            return IROp::Sub;
+        case Operation::Multiply:
+            return IROp::Mul;
+        case Operation::Divide:
+            return IROp::Div;
+        case Operation::Less:
+            return IROp::Lt;
+        case Operation::LessEqual:
+            return IROp::Le;
+        case Operation::Greater:
+            return IROp::Gt;
+        case Operation::GreaterEqual:
+            return IROp::Ge;
+        case Operation::Equal:
+            return IROp::Eq;
+        case Operation::NotEqual:
+            return IROp::Ne;
+        case Operation::Assign:
+            break;
+    }
+    assert(false);
+    return IROp::Add;
+}
+
+/// \returns the size in bytes of a variable.
+int32_t size_of(ASTVarDecl& decl)
+{
+    if(decl.is_pointer())
+        return 4;
+    return 4 * (!decl.is_array() ? 1 : decl.get_array_size()->get_value());
+}
+}
+
+namespace cminus
+{
+void ASTLowerVisitor::visit_program(ASTProgram& program)
+{
+    MemScope mem_scope(MemTag::IR);
+
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+    {
+        if(auto var_decl = (*it)->as_var_decl())
+        {
+            auto name = std::string(var_decl->get_name());
+            this->globals[var_decl.get()] = module.new_global(std::move(name), size_of(*var_decl));
+        }
+    }
+
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+    {
+        if(auto fun_decl = (*it)->as_fun_decl())
+            visit_fun_decl(*fun_decl);
+    }
+}
+
+void ASTLowerVisitor::visit_var_decl(ASTVarDecl& decl)
+{
+    auto slot = function->new_slot(std::string(decl.get_name()), size_of(decl));
+    slot->offset = current_local_pos;
+    this->current_local_pos += slot->size;
+    this->slots[&decl] = slot;
+}
+
+void ASTLowerVisitor::visit_fun_decl(ASTFunDecl& decl)
+{
+    this->function = function_of(decl);
+    this->current_local_pos = 0;
+
+    for(size_t i = 0; i < decl.get_num_params(); ++i)
+    {
+        auto var_decl = static_cast<ASTVarDecl*>(decl.get_param(i).get());
+        auto slot = function->new_slot(std::string(var_decl->get_name()), 4);
+        slot->param_index = static_cast<int32_t>(i);
+        slot->type = (var_decl->is_pointer() ? IRType::Ptr : IRType::I32);
+        this->slots[var_decl] = slot;
+    }
+
+    this->bounds = BoundsCheckInfo{};
+    if(options.bounds_check_elim)
+    {
+        this->bounds = analyze_bounds_checks(decl);
+
+        BoundsCheckStats stats;
+        stats.function = decl.get_name();
+        stats.num_checks = bounds.num_subscripts;
+        stats.num_removed = bounds.redundant.size();
+        stats.num_hoisted = bounds.hoisted.size();
+        this->bounds_check_stats.push_back(std::move(stats));
+    }
+
+    function->set_exit_label(module.new_label());
+    start_block(function->new_block());
+
+    visit_compound_stmt(*decl.get_body());
+
+    // Falling off the end of the function returns from it.
+    emit(IRInst(IROp::Return));
+
+    this->function = nullptr;
+    this->block = nullptr;
+}
+
+void ASTLowerVisitor::visit_compound_stmt(ASTCompoundStmt& stmt)
+{
+    const auto outer_local_pos = current_local_pos;
+    walk_compound_stmt(stmt);
+    function->set_local_size(std::max(function->get_local_size(), current_local_pos));
+    this->current_local_pos = outer_local_pos;
+}
+
+void ASTLowerVisitor::visit_selection_stmt(ASTSelectionStmt& stmt)
+{
+    auto false_block = function->new_block(module.new_label());
+    auto then_block = function->new_block();
+
+    IRInst branch(IROp::Branch);
+    branch.args.push_back(lower_expr(*stmt.get_cond()));
+    branch.targets[0] = then_block.get();
+    branch.targets[1] = false_block.get();
+    emit(std::move(branch));
+
+    start_block(std::move(then_block));
+    visit_stmt(*stmt.get_then());
+
+    if(stmt.get_else())
+    {
+        auto fi_block = function->new_block(module.new_label());
+        emit_jump(fi_block.get());
+
+        start_block(std::move(false_block));
+        visit_stmt(*stmt.get_else());
+        emit_jump(fi_block.get());
+
+        start_block(std::move(fi_block));
+    }
+    else
+    {
+        emit_jump(false_block.get());
+        start_block(std::move(false_block));
+    }
+}
+
+void ASTLowerVisitor::visit_iteration_stmt(ASTIterationStmt& stmt)
+{
+    auto cond_block = function->new_block(module.new_label());
+    auto exit_block = function->new_block(module.new_label());
+    auto body_block = function->new_block();
+
+    // Subscripts which do not change within the loop are checked once,
+    // provided the loop is entered at all.
+    if(auto loop_checks = bounds.loop_checks.find(&stmt); loop_checks != bounds.loop_checks.end())
+    {
+        auto checks_block = function->new_block();
+
+        IRInst branch(IROp::Branch);
+        branch.args.push_back(lower_expr(*stmt.get_cond()));
+        branch.targets[0] = checks_block.get();
+        branch.targets[1] = cond_block.get();
+        emit(std::move(branch));
+
+        start_block(std::move(checks_block));
+        for(auto var_ref : loop_checks->second)
+            emit_check(lower_expr(*var_ref->get_index()));
+    }
+
+    emit_jump(cond_block.get());
+    auto header = start_block(std::move(cond_block));
+
+    IRInst branch(IROp::Branch);
+    branch.args.push_back(lower_expr(*stmt.get_cond()));
+    branch.targets[0] = body_block.get();
+    branch.targets[1] = exit_block.get();
+    emit(std::move(branch));
+
+    start_block(std::move(body_block));
+    visit_stmt(*stmt.get_body());
+    emit_jump(header);
+
+    start_block(std::move(exit_block));
+}
+
+void ASTLowerVisitor::visit_return_stmt(ASTReturnStmt& stmt)
+{
+    IRInst ret(IROp::Return);
+    if(stmt.get_expr())
+        ret.args.push_back(lower_expr(*stmt.get_expr()));
+    emit(std::move(ret));
+}
+
+void ASTLowerVisitor::visit_number_expr(ASTNumber& expr)
+{
+    IRInst inst(IROp::Const);
+    inst.imm = expr.get_value();
+    this->result = emit_value(std::move(inst), IRType::I32);
+}
+
+void ASTLowerVisitor::visit_var_expr(ASTVarRef& expr)
+{
+    auto address = lower_address(expr);
+    if(expr.type() == ExprType::Array)
+    {
+        this->result = address;
+        return;
+    }
+
+    IRInst load(IROp::Load);
+    load.args.push_back(address);
+    this->result = emit_value(std::move(load), IRType::I32);
+}
+
+void ASTLowerVisitor::visit_call_expr(ASTFunCall& expr)
+{
+    auto fun_decl = expr.get_decl();
+
+    IRInst call(IROp::Call);
+    call.callee = function_of(*fun_decl);
+    for(auto it = expr.arg_begin(); it != expr.arg_end(); ++it)
+        call.args.push_back(lower_expr(**it));
+
+    if(fun_decl->is_void())
+    {
+        emit(std::move(call));
+        this->result = ir_no_value;
+    }
+    else
+    {
+        this->result = emit_value(std::move(call), IRType::I32);
+    }
+}
+
+void ASTLowerVisitor::visit_binary_expr(ASTBinaryExpr& expr)
+{
+    if(expr.get_operation() == Operation::Assign)
+    {
+        auto address = lower_address(*expr.get_left()->as_var_expr());
+        auto value = lower_expr(*expr.get_right());
+
+        IRInst store(IROp::Store);
+        store.args.push_back(address);
+        store.args.push_back(value);
+        emit(std::move(store));
+
+        // The assignment evaluates to the assigned value.
+        this->result = value;
+        return;
+    }
+
+    IRInst inst(binary_op(expr.get_operation()));
+    inst.args.push_back(lower_expr(*expr.get_left()));
+    inst.args.push_back(lower_expr(*expr.get_right()));
+    this->result = emit_value(std::move(inst), IRType::I32);
+}
+
+auto ASTLowerVisitor::lower_expr(ASTExpr& expr) -> IRValue
+{
+    visit_expr(expr);
+    return this->result;
+}
+
+auto ASTLowerVisitor::lower_address(ASTVarRef& var_ref) -> IRValue
+{
+    auto base = lower_base_address(*var_ref.get_decl());
+
+    auto index_expr = var_ref.get_index();
+    if(!index_expr)
+        return base;
+
+    // The trap is labeled before anything in the index is, as in the code
+    // of `ASTCodegenVisitor`.
+    const auto checked = !bounds.redundant.count(&var_ref) && !bounds.hoisted.count(&var_ref);
+    if(checked && function->get_trap_label() == -1)
+        function->set_trap_label(module.new_label());
+
+    auto index = lower_expr(*index_expr);
+    if(checked)
+        emit_check(index);
+
+    IRInst elem_addr(IROp::ElemAddr);
+    elem_addr.args.push_back(base);
+    elem_addr.args.push_back(index);
+    return emit_value(std::move(elem_addr), IRType::Ptr);
+}
+
+void ASTLowerVisitor::emit_check(IRValue index)
+{
+    if(function->get_trap_label() == -1)
+        function->set_trap_label(module.new_label());
+
+    IRInst check(IROp::Check);
+    check.args.push_back(index);
+    emit(std::move(check));
+}
+
+auto ASTLowerVisitor::lower_base_address(ASTVarDecl& decl) -> IRValue
+{
+    if(auto it = slots.find(&decl); it != slots.end())
+    {
+        IRInst frame_addr(IROp::FrameAddr);
+        frame_addr.slot = it->second;
+        auto address = emit_value(std::move(frame_addr), IRType::Ptr);
+
+        // Array parameters hold the address of the array.
+        if(!decl.is_pointer())
+            return address;
+
+        IRInst load(IROp::Load);
+        load.args.push_back(address);
+        return emit_value(std::move(load), IRType::Ptr);
+    }
+
+    IRInst global_addr(IROp::GlobalAddr);
+    global_addr.global = globals.at(&decl);
+    return emit_value(std::move(global_addr), IRType::Ptr);
+}
+
+auto ASTLowerVisitor::function_of(ASTFunDecl& decl) -> IRFunction*
+{
+    auto& result = this->functions[&decl];
+    if(result == nullptr)
+    {
+        result = module.new_function(std::string(decl.get_name()),
+                                     static_cast<int32_t>(decl.get_num_params()),
+                                     decl.is_void());
+    }
+    return result;
+}
+
+auto ASTLowerVisitor::emit(IRInst inst) -> IRInst&
+{
+    if(block->is_terminated())
+        start_block(function->new_block());
+    return block->append(std::move(inst));
+}
+
+auto ASTLowerVisitor::emit_value(IRInst inst, IRType type) -> IRValue
+{
+    inst.dest = function->new_value(type);
+    return emit(std::move(inst)).dest;
+}
+
+void ASTLowerVisitor::emit_jump(IRBlock* target)
+{
+    IRInst jump(IROp::Jump);
+    jump.targets[0] = target;
+    emit(std::move(jump));
+}
+
+auto ASTLowerVisitor::start_block(std::unique_ptr<IRBlock> block) -> IRBlock*
+{
+    this->block = function->append_block(std::move(block));
+    return this->block;
+}
+}
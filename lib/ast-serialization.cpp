@@ -0,0 +1,563 @@
+#include <cminus/ast-serialization.hpp>
+#include <cminus/mem-report.hpp>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utility>
+
+namespace cminus
+{
+using astfmt::NodeKind;
+using astfmt::NodeRecord;
+
+void ASTSerializerVisitor::visit_program(ASTProgram& program)
+{
+    MemScope mem_scope(MemTag::Output);
+
+    std::vector<uint32_t> program_decls;
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+        program_decls.push_back(decl_index(**it));
+
+    const auto program_list = add_list(program_decls);
+
+    astfmt::Header header{};
+    std::memcpy(header.magic, astfmt::magic, sizeof(header.magic));
+    header.version = astfmt::version;
+    header.byte_order = astfmt::byte_order_mark;
+    header.num_nodes = static_cast<uint32_t>(nodes.size());
+    header.nodes_offset = sizeof(header);
+    header.num_list_items = static_cast<uint32_t>(lists.size());
+    header.lists_offset = header.nodes_offset + header.num_nodes * sizeof(NodeRecord);
+    header.strtab_size = static_cast<uint32_t>(strtab.size());
+    header.strtab_offset = header.lists_offset + header.num_list_items * sizeof(uint32_t);
+    header.program_list = program_list;
+    header.program_num_decls = static_cast<uint32_t>(program_decls.size());
+
+    dest.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    dest.append(reinterpret_cast<const char*>(nodes.data()),
+                nodes.size() * sizeof(NodeRecord));
+    dest.append(reinterpret_cast<const char*>(lists.data()),
+                lists.size() * sizeof(uint32_t));
+    dest.append(strtab);
+}
+
+void ASTSerializerVisitor::visit_var_decl(ASTVarDecl& decl)
+{
+    auto array_size = visit_optional(decl.get_array_size().get());
+    this->last_node = add_node(NodeKind::VarDecl, decl.get_name(), array_size);
+    if(decl.is_array())
+        this->nodes[last_node].flags |= astfmt::flag_is_array;
+    this->decls[&decl] = last_node;
+}
+
+void ASTSerializerVisitor::visit_parm_decl(ASTParmVarDecl& decl)
+{
+    this->last_node = add_node(NodeKind::ParmVarDecl, decl.get_name());
+    if(decl.is_array())
+        this->nodes[last_node].flags |= astfmt::flag_is_array;
+    this->decls[&decl] = last_node;
+}
+
+void ASTSerializerVisitor::visit_fun_decl(ASTFunDecl& decl)
+{
+    std::vector<uint32_t> params;
+    for(auto it = decl.parm_begin(); it != decl.parm_end(); ++it)
+        params.push_back(decl_index(**it));
+
+    const auto params_list = add_list(params);
+    const auto fun_node = add_node(NodeKind::FunDecl, decl.get_name(),
+                                   params_list,
+                                   static_cast<uint32_t>(params.size()));
+    if(decl.is_void())
+        this->nodes[fun_node].flags |= astfmt::flag_is_void;
+
+    // The function must be known before its body is serialized, since the
+    // body may call the function recursively.
+    this->decls[&decl] = fun_node;
+
+    if(auto body = decl.get_body())
+    {
+        visit_compound_stmt(*body);
+        this->nodes[fun_node].flags |= astfmt::flag_has_body;
+        this->nodes[fun_node].child[2] = last_node;
+    }
+
+    this->last_node = fun_node;
+}
+
+void ASTSerializerVisitor::visit_null_stmt(ASTNullStmt&)
+{
+    this->last_node = add_node(NodeKind::NullStmt, SourceRange());
+}
+
+void ASTSerializerVisitor::visit_compound_stmt(ASTCompoundStmt& comp_stmt)
+{
+    std::vector<uint32_t> items;
+    for(auto it = comp_stmt.decl_begin(); it != comp_stmt.decl_end(); ++it)
+        items.push_back(decl_index(**it));
+
+    const auto num_decls = static_cast<uint32_t>(items.size());
+    for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+    {
+        visit_stmt(**it);
+        items.push_back(last_node);
+    }
+
+    const auto num_stmts = static_cast<uint32_t>(items.size()) - num_decls;
+    const auto list = add_list(items);
+    this->last_node = add_node(NodeKind::CompoundStmt, SourceRange(),
+                               list, num_decls, num_stmts);
+}
+
+void ASTSerializerVisitor::visit_selection_stmt(ASTSelectionStmt& if_stmt)
+{
+    auto cond = visit_optional(if_stmt.get_cond().get());
+    auto then_stmt = visit_optional(if_stmt.get_then().get());
+    auto else_stmt = visit_optional(if_stmt.get_else().get());
+    this->last_node = add_node(NodeKind::SelectionStmt, SourceRange(),
+                               cond, then_stmt, else_stmt);
+}
+
+void ASTSerializerVisitor::visit_iteration_stmt(ASTIterationStmt& while_stmt)
+{
+    auto cond = visit_optional(while_stmt.get_cond().get());
+    auto body = visit_optional(while_stmt.get_body().get());
+    this->last_node = add_node(NodeKind::IterationStmt, SourceRange(),
+                               cond, body);
+}
+
+void ASTSerializerVisitor::visit_return_stmt(ASTReturnStmt& retn_stmt)
+{
+    auto expr = visit_optional(retn_stmt.get_expr().get());
+    this->last_node = add_node(NodeKind::ReturnStmt, SourceRange(), expr);
+}
+
+void ASTSerializerVisitor::visit_number_expr(ASTNumber& num)
+{
+    this->last_node = add_node(NodeKind::Number, num.source_range(),
+                               static_cast<uint32_t>(num.get_value()));
+}
+
+void ASTSerializerVisitor::visit_var_expr(ASTVarRef& var_ref)
+{
+    auto decl = decl_index(*var_ref.get_decl());
+    auto index = visit_optional(var_ref.get_index().get());
+    this->last_node = add_node(NodeKind::VarRef, var_ref.source_range(),
+                               decl, index);
+}
+
+void ASTSerializerVisitor::visit_call_expr(ASTFunCall& fun_call)
+{
+    auto decl = decl_index(*fun_call.get_decl());
+
+    std::vector<uint32_t> args;
+    for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it)
+    {
+        visit_expr(**it);
+        args.push_back(last_node);
+    }
+
+    const auto args_list = add_list(args);
+    this->last_node = add_node(NodeKind::FunCall, fun_call.get_decl()->get_name(),
+                               decl, args_list,
+                               static_cast<uint32_t>(args.size()));
+}
+
+void ASTSerializerVisitor::visit_binary_expr(ASTBinaryExpr& expr)
+{
+    auto left = visit_optional(expr.get_left().get());
+    auto right = visit_optional(expr.get_right().get());
+
+    auto kind = (expr.expr_kind() == ExprKind::AssignExpr ? NodeKind::AssignExpr
+                                                           : NodeKind::BinaryExpr);
+    this->last_node = add_node(kind, SourceRange(), left, right);
+    this->nodes[last_node].op = static_cast<uint16_t>(expr.get_operation());
+}
+
+uint32_t ASTSerializerVisitor::add_node(NodeKind kind, SourceRange str,
+                                        uint32_t child0, uint32_t child1,
+                                        uint32_t child2)
+{
+    NodeRecord record{};
+    record.kind = kind;
+    record.str_offset = add_string(str);
+    record.str_size = static_cast<uint32_t>(str.size());
+    record.child[0] = child0;
+    record.child[1] = child1;
+    record.child[2] = child2;
+    this->nodes.push_back(record);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+uint32_t ASTSerializerVisitor::add_list(const std::vector<uint32_t>& items)
+{
+    auto index = static_cast<uint32_t>(lists.size());
+    this->lists.insert(lists.end(), items.begin(), items.end());
+    return index;
+}
+
+uint32_t ASTSerializerVisitor::add_string(SourceRange str)
+{
+    if(str.empty())
+        return 0;
+
+    auto it = strings.find(str);
+    if(it != strings.end())
+        return it->second;
+
+    auto offset = static_cast<uint32_t>(strtab.size());
+    this->strtab.append(str.data(), str.size());
+    this->strings.emplace(str, offset);
+    return offset;
+}
+
+uint32_t ASTSerializerVisitor::decl_index(ASTDecl& decl)
+{
+    auto it = decls.find(&decl);
+    if(it != decls.end())
+        return it->second;
+
+    visit_decl(decl);
+    return last_node;
+}
+
+uint32_t ASTSerializerVisitor::visit_optional(ASTStmt* stmt)
+{
+    if(stmt == nullptr)
+        return astfmt::no_node;
+    visit_stmt(*stmt);
+    return last_node;
+}
+
+ASTFile::ASTFile(const char* data, size_t size, bool is_mapped) :
+    data(data), size(size), is_mapped(is_mapped)
+{
+}
+
+ASTFile::ASTFile(ASTFile&& rhs) noexcept :
+    data(std::exchange(rhs.data, nullptr)),
+    size(std::exchange(rhs.size, 0)),
+    is_mapped(rhs.is_mapped)
+{
+}
+
+ASTFile& ASTFile::operator=(ASTFile&& rhs) noexcept
+{
+    std::swap(this->data, rhs.data);
+    std::swap(this->size, rhs.size);
+    std::swap(this->is_mapped, rhs.is_mapped);
+    return *this;
+}
+
+ASTFile::~ASTFile()
+{
+    if(data == nullptr)
+        return;
+
+    if(is_mapped)
+        munmap(const_cast<char*>(data), size);
+    else
+        delete[] data;
+}
+
+auto ASTFile::from_stream(std::FILE* stream) -> std::optional<ASTFile>
+{
+    struct stat st;
+    const int fd = fileno(stream);
+    if(fd != -1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        const auto map_size = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED)
+            return ASTFile(static_cast<const char*>(map), map_size, true);
+    }
+
+    // Cannot be mapped, fallback to reading the stream.
+    MemScope mem_scope(MemTag::Source);
+
+    std::string buffer;
+    char block[4096];
+    while(auto ncount = std::fread(block, 1, sizeof(block), stream))
+        buffer.append(block, ncount);
+
+    if(std::ferror(stream))
+        return std::nullopt;
+
+    auto owned = new char[buffer.size() + 1];
+    std::memcpy(owned, buffer.data(), buffer.size());
+    return ASTFile(owned, buffer.size(), false);
+}
+
+template<typename T>
+auto ASTFile::table(uint32_t offset, uint32_t count) const -> const T*
+{
+    if(offset > size || offset % alignof(T) != 0
+       || count > (size - offset) / sizeof(T))
+        return nullptr;
+    return reinterpret_cast<const T*>(data + offset);
+}
+
+auto ASTFile::load_program() const -> std::shared_ptr<ASTProgram>
+{
+    MemScope mem_scope(MemTag::AST);
+
+    auto header = table<astfmt::Header>(0, 1);
+    if(!header
+       || std::memcmp(header->magic, astfmt::magic, sizeof(astfmt::magic)) != 0
+       || header->version != astfmt::version
+       || header->byte_order != astfmt::byte_order_mark)
+        return nullptr;
+
+    auto records = table<NodeRecord>(header->nodes_offset, header->num_nodes);
+    auto lists = table<uint32_t>(header->lists_offset, header->num_list_items);
+    auto strtab = table<char>(header->strtab_offset, header->strtab_size);
+    if(!records || !lists || !strtab)
+        return nullptr;
+
+    const auto num_nodes = header->num_nodes;
+
+    // Each node is either a declaration or a statement (expressions included).
+    std::vector<std::shared_ptr<ASTDecl>> decls(num_nodes);
+    std::vector<std::shared_ptr<ASTStmt>> stms(num_nodes);
+    std::vector<uint32_t> fun_bodies;
+
+    // Node references must point backwards (but for function bodies),
+    // thus a reference to a node not yet built is a malformed file.
+    auto get_list = [&](uint32_t first, uint32_t count) -> const uint32_t* {
+        if(first > header->num_list_items || count > header->num_list_items - first)
+            return nullptr;
+        return lists + first;
+    };
+    auto get_stmt = [&](uint32_t i, uint32_t self) -> std::shared_ptr<ASTStmt> {
+        return (i < self) ? stms[i] : nullptr;
+    };
+    auto get_expr = [&](uint32_t i, uint32_t self) -> std::shared_ptr<ASTExpr> {
+        auto stmt = get_stmt(i, self);
+        return stmt ? stmt->as_expr() : nullptr;
+    };
+    auto get_decl = [&](uint32_t i, uint32_t self) -> std::shared_ptr<ASTDecl> {
+        return (i < self) ? decls[i] : nullptr;
+    };
+
+    for(uint32_t i = 0; i < num_nodes; ++i)
+    {
+        const auto& rec = records[i];
+        if(rec.str_offset > header->strtab_size
+           || rec.str_size > header->strtab_size - rec.str_offset)
+            return nullptr;
+
+        const auto str = SourceRange(strtab + rec.str_offset, rec.str_size);
+        const bool is_array = (rec.flags & astfmt::flag_is_array) != 0;
+
+        switch(rec.kind)
+        {
+            case NodeKind::VarDecl:
+            {
+                std::shared_ptr<ASTNumber> array_size;
+                if(rec.child[0] != astfmt::no_node)
+                {
+                    auto expr = get_expr(rec.child[0], i);
+                    if(!expr || !(array_size = expr->as_number_expr()))
+                        return nullptr;
+                }
+                if(is_array != !!array_size)
+                    return nullptr;
+                decls[i] = std::make_shared<ASTVarDecl>(str, is_array,
+                                                        std::move(array_size));
+                break;
+            }
+            case NodeKind::ParmVarDecl:
+            {
+                decls[i] = std::make_shared<ASTParmVarDecl>(str, is_array);
+                break;
+            }
+            case NodeKind::FunDecl:
+            {
+                const bool is_void = (rec.flags & astfmt::flag_is_void) != 0;
+                auto params = get_list(rec.child[0], rec.child[1]);
+                if(!params)
+                    return nullptr;
+
+                auto fun_decl = std::make_shared<ASTFunDecl>(is_void, str);
+                for(uint32_t p = 0; p < rec.child[1]; ++p)
+                {
+                    auto decl = get_decl(params[p], i);
+                    auto parm_decl = decl ? decl->as_parm_var_decl() : nullptr;
+                    if(!parm_decl)
+                        return nullptr;
+                    fun_decl->add_param(std::move(parm_decl));
+                }
+
+                if(rec.flags & astfmt::flag_has_body)
+                    fun_bodies.push_back(i);
+
+                decls[i] = std::move(fun_decl);
+                break;
+            }
+            case NodeKind::NullStmt:
+            {
+                stms[i] = std::make_shared<ASTNullStmt>();
+                break;
+            }
+            case NodeKind::CompoundStmt:
+            {
+                const auto num_decls = rec.child[1];
+                const auto num_stmts = rec.child[2];
+                if(num_stmts > UINT32_MAX - num_decls)
+                    return nullptr;
+
+                auto items = get_list(rec.child[0], num_decls + num_stmts);
+                if(!items)
+                    return nullptr;
+
+                std::vector<std::shared_ptr<ASTVarDecl>> local_decls;
+                std::vector<std::shared_ptr<ASTStmt>> local_stms;
+                local_decls.reserve(num_decls);
+                local_stms.reserve(num_stmts);
+
+                for(uint32_t d = 0; d < num_decls; ++d)
+                {
+                    auto decl = get_decl(items[d], i);
+                    auto var_decl = decl ? decl->as_var_decl() : nullptr;
+                    if(!var_decl)
+                        return nullptr;
+                    local_decls.push_back(std::move(var_decl));
+                }
+
+                for(uint32_t s = 0; s < num_stmts; ++s)
+                {
+                    auto stmt = get_stmt(items[num_decls + s], i);
+                    if(!stmt)
+                        return nullptr;
+                    local_stms.push_back(std::move(stmt));
+                }
+
+                stms[i] = std::make_shared<ASTCompoundStmt>(std::move(local_decls),
+                                                            std::move(local_stms));
+                break;
+            }
+            case NodeKind::SelectionStmt:
+            {
+                auto cond = get_expr(rec.child[0], i);
+                auto then_stmt = get_stmt(rec.child[1], i);
+                auto else_stmt = get_stmt(rec.child[2], i);
+                if(!cond || !then_stmt || (!else_stmt && rec.child[2] != astfmt::no_node))
+                    return nullptr;
+                stms[i] = std::make_shared<ASTSelectionStmt>(std::move(cond),
+                                                             std::move(then_stmt),
+                                                             std::move(else_stmt));
+                break;
+            }
+            case NodeKind::IterationStmt:
+            {
+                auto cond = get_expr(rec.child[0], i);
+                auto body = get_stmt(rec.child[1], i);
+                if(!cond || !body)
+                    return nullptr;
+                stms[i] = std::make_shared<ASTIterationStmt>(std::move(cond),
+                                                             std::move(body));
+                break;
+            }
+            case NodeKind::ReturnStmt:
+            {
+                auto expr = get_expr(rec.child[0], i);
+                if(!expr && rec.child[0] != astfmt::no_node)
+                    return nullptr;
+                stms[i] = std::make_shared<ASTReturnStmt>(std::move(expr));
+                break;
+            }
+            case NodeKind::Number:
+            {
+                auto value = static_cast<int32_t>(rec.child[0]);
+                stms[i] = std::make_shared<ASTNumber>(value, str);
+                break;
+            }
+            case NodeKind::VarRef:
+            {
+                auto decl = get_decl(rec.child[0], i);
+                auto var_decl = decl ? decl->as_var_decl() : nullptr;
+                auto index = get_expr(rec.child[1], i);
+                if(!var_decl || (!index && rec.child[1] != astfmt::no_node))
+                    return nullptr;
+                stms[i] = std::make_shared<ASTVarRef>(std::move(var_decl),
+                                                      std::move(index), str);
+                break;
+            }
+            case NodeKind::FunCall:
+            {
+                auto decl = get_decl(rec.child[0], i);
+                auto fun_decl = decl ? decl->as_fun_decl() : nullptr;
+                auto arg_items = get_list(rec.child[1], rec.child[2]);
+                if(!fun_decl || !arg_items)
+                    return nullptr;
+
+                std::vector<std::shared_ptr<ASTExpr>> args;
+                args.reserve(rec.child[2]);
+                for(uint32_t a = 0; a < rec.child[2]; ++a)
+                {
+                    auto arg = get_expr(arg_items[a], i);
+                    if(!arg)
+                        return nullptr;
+                    args.push_back(std::move(arg));
+                }
+
+                stms[i] = std::make_shared<ASTFunCall>(std::move(fun_decl),
+                                                       std::move(args), str);
+                break;
+            }
+            case NodeKind::BinaryExpr:
+            case NodeKind::AssignExpr:
+            {
+                auto left = get_expr(rec.child[0], i);
+                auto right = get_expr(rec.child[1], i);
+                if(!left || !right || rec.op > uint16_t(ASTBinaryExpr::Operation::Assign))
+                    return nullptr;
+
+                const auto op = static_cast<ASTBinaryExpr::Operation>(rec.op);
+                if(rec.kind == NodeKind::AssignExpr)
+                {
+                    auto lvalue = left->as_var_expr();
+                    if(!lvalue || op != ASTBinaryExpr::Operation::Assign)
+                        return nullptr;
+                    stms[i] = std::make_shared<ASTAssignExpr>(std::move(lvalue),
+                                                              std::move(right));
+                }
+                else
+                {
+                    stms[i] = std::make_shared<ASTBinaryExpr>(std::move(left),
+                                                              std::move(right), op);
+                }
+                break;
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    // Function bodies are the only forward references.
+    for(auto i : fun_bodies)
+    {
+        auto body_index = records[i].child[2];
+        auto body = (body_index > i && body_index < num_nodes) ? stms[body_index] : nullptr;
+        auto comp_stmt = body ? body->as_compound_stmt() : nullptr;
+        if(!comp_stmt)
+            return nullptr;
+        decls[i]->as_fun_decl()->set_body(std::move(comp_stmt));
+    }
+
+    auto program_decls = get_list(header->program_list, header->program_num_decls);
+    if(!program_decls)
+        return nullptr;
+
+    auto program = std::make_shared<ASTProgram>();
+    for(uint32_t d = 0; d < header->program_num_decls; ++d)
+    {
+        auto decl = program_decls[d] < num_nodes ? decls[program_decls[d]] : nullptr;
+        if(!decl)
+            return nullptr;
+        program->add_decl(std::move(decl));
+    }
+
+    return program;
+}
+}
@@ -0,0 +1,65 @@
+#include <cminus/ast-utils.hpp>
+
+namespace cminus
+{
+auto number_value(ASTExpr& expr) -> std::optional<int32_t>
+{
+    if(expr.expr_kind() != ExprKind::Number)
+        return std::nullopt;
+    return static_cast<ASTNumber&>(expr).get_value();
+}
+
+bool is_pure(ASTExpr& expr)
+{
+    switch(expr.expr_kind())
+    {
+        case ExprKind::Number:
+            return true;
+        case ExprKind::VarRef:
+        {
+            auto index = static_cast<ASTVarRef&>(expr).get_index();
+            return !index || number_value(*index).value_or(-1) >= 0;
+        }
+        case ExprKind::BinaryExpr:
+        {
+            auto& binary_expr = static_cast<ASTBinaryExpr&>(expr);
+            return is_pure(*binary_expr.get_left()) && is_pure(*binary_expr.get_right());
+        }
+        default:
+            return false;
+    }
+}
+
+bool always_returns(ASTStmt& stmt)
+{
+    switch(stmt.stmt_kind())
+    {
+        case StmtKind::ReturnStmt:
+            return true;
+        case StmtKind::CompoundStmt:
+        {
+            auto& comp_stmt = static_cast<ASTCompoundStmt&>(stmt);
+            for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+            {
+                if(always_returns(**it))
+                    return true;
+            }
+            return false;
+        }
+        case StmtKind::SelectionStmt:
+        {
+            auto& if_stmt = static_cast<ASTSelectionStmt&>(stmt);
+            return if_stmt.get_else() && always_returns(*if_stmt.get_then())
+                   && always_returns(*if_stmt.get_else());
+        }
+        case StmtKind::IterationStmt:
+        {
+            // There are no breaks, thus loops are only left by their condition.
+            auto& while_stmt = static_cast<ASTIterationStmt&>(stmt);
+            return number_value(*while_stmt.get_cond()).value_or(0) != 0;
+        }
+        default:
+            return false;
+    }
+}
+}
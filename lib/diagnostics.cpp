@@ -15,6 +15,7 @@ void DiagnosticManager::emit(std::unique_ptr<Diagnostic> diag_ptr)
 
 void DiagnosticManager::handler(std::function<bool(const Diagnostic&)> handler)
 {
+    MemScope mem_scope(MemTag::Diagnostics);
     auto old_handler = std::move(this->curr_diag_handler);
     this->curr_diag_handler = [old_handler = std::move(old_handler),
                                handler = std::move(handler)](const Diagnostic& diag) {
@@ -28,6 +29,23 @@ void DiagnosticManager::handler(std::function<bool(const Diagnostic&)> handler)
 
 DiagnosticBuilder::~DiagnosticBuilder()
 {
+    MemScope mem_scope(MemTag::Diagnostics);
     this->manager.emit(std::move(diag_ptr));
 }
+
+DiagnosticBuffer::DiagnosticBuffer()
+{
+    this->handler([this](const Diagnostic& diag) {
+        MemScope mem_scope(MemTag::Diagnostics);
+        this->diags.push_back(std::make_unique<Diagnostic>(diag));
+        return false;
+    });
+}
+
+void DiagnosticBuffer::flush_into(DiagnosticManager& diagman, size_t last)
+{
+    assert(last <= diags.size());
+    for(; num_flushed < last; ++num_flushed)
+        diagman.emit(std::move(diags[num_flushed]));
+}
 }
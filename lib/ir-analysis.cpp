@@ -0,0 +1,257 @@
+#include <cminus/ir-analysis.hpp>
+
+namespace cminus
+{
+auto compute_predecessors(IRFunction& function) -> std::vector<std::vector<IRBlock*>>
+{
+    std::vector<std::vector<IRBlock*>> preds(function.num_blocks());
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto succ : (*it)->successors())
+            preds[succ->get_id()].push_back(it->get());
+    }
+    return preds;
+}
+
+DominatorTree::DominatorTree(IRFunction& function) :
+    preds(compute_predecessors(function)),
+    idoms(function.num_blocks(), nullptr),
+    children(function.num_blocks()),
+    frontiers(function.num_blocks()),
+    rpo_index(function.num_blocks(), -1)
+{
+    // Depth-first search for the postorder, without recursion since
+    // functions may have many blocks.
+    std::vector<IRBlock*> postorder;
+    std::vector<std::pair<IRBlock*, size_t>> stack;
+    std::vector<bool> visited(function.num_blocks(), false);
+
+    auto& entry = function.get_entry();
+    visited[entry.get_id()] = true;
+    stack.emplace_back(&entry, 0);
+    while(!stack.empty())
+    {
+        auto [block, next_succ] = stack.back();
+        auto succs = block->successors();
+        if(next_succ < succs.size())
+        {
+            ++stack.back().second;
+            auto succ = succs[next_succ];
+            if(!visited[succ->get_id()])
+            {
+                visited[succ->get_id()] = true;
+                stack.emplace_back(succ, 0);
+            }
+        }
+        else
+        {
+            postorder.push_back(block);
+            stack.pop_back();
+        }
+    }
+
+    this->rpo.assign(postorder.rbegin(), postorder.rend());
+    for(size_t i = 0; i < rpo.size(); ++i)
+        this->rpo_index[rpo[i]->get_id()] = static_cast<int32_t>(i);
+
+    const auto intersect = [&](IRBlock* a, IRBlock* b) {
+        while(a != b)
+        {
+            while(rpo_index[a->get_id()] > rpo_index[b->get_id()])
+                a = idoms[a->get_id()];
+            while(rpo_index[b->get_id()] > rpo_index[a->get_id()])
+                b = idoms[b->get_id()];
+        }
+        return a;
+    };
+
+    // The entry is its own immediate dominator while iterating.
+    this->idoms[entry.get_id()] = &entry;
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(size_t i = 1; i < rpo.size(); ++i)
+        {
+            auto block = rpo[i];
+            IRBlock* new_idom = nullptr;
+            for(auto pred : preds[block->get_id()])
+            {
+                if(idoms[pred->get_id()] == nullptr)
+                    continue;
+                new_idom = (new_idom ? intersect(pred, new_idom) : pred);
+            }
+
+            if(idoms[block->get_id()] != new_idom)
+            {
+                this->idoms[block->get_id()] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    this->idoms[entry.get_id()] = nullptr;
+
+    for(auto block : rpo)
+    {
+        if(auto idom = idoms[block->get_id()])
+            this->children[idom->get_id()].push_back(block);
+    }
+
+    // Walk up from the predecessors of each join point until its immediate
+    // dominator, which is where its dominance frontier membership ends.
+    for(auto block : rpo)
+    {
+        const auto& block_preds = preds[block->get_id()];
+        if(block_preds.size() < 2)
+            continue;
+
+        for(auto pred : block_preds)
+        {
+            for(auto runner = pred; runner != idoms[block->get_id()]; runner = idoms[runner->get_id()])
+            {
+                auto& frontier = frontiers[runner->get_id()];
+                if(std::find(frontier.begin(), frontier.end(), block) == frontier.end())
+                    frontier.push_back(block);
+            }
+        }
+    }
+}
+
+bool DominatorTree::dominates(const IRBlock& a, const IRBlock& b) const
+{
+    for(auto runner = &b; runner != nullptr; runner = idoms[runner->get_id()])
+    {
+        if(runner == &a)
+            return true;
+    }
+    return false;
+}
+
+auto find_loops(const DominatorTree& domtree) -> std::vector<IRLoop>
+{
+    const auto& rpo = domtree.get_rpo();
+
+    std::vector<IRLoop> loops;
+    for(auto header : rpo)
+    {
+        IRLoop loop;
+        loop.header = header;
+        for(auto pred : domtree.get_preds(*header))
+        {
+            if(domtree.dominates(*header, *pred))
+                loop.latches.push_back(pred);
+        }
+
+        if(loop.latches.empty())
+            continue;
+
+        // Walk backwards from the latches, stopping at the header.
+        loop.contains.assign(rpo.size(), false);
+        loop.contains[header->get_id()] = true;
+        std::vector<IRBlock*> worklist = loop.latches;
+        while(!worklist.empty())
+        {
+            auto block = worklist.back();
+            worklist.pop_back();
+            if(loop.contains[block->get_id()] && block != header)
+                continue;
+
+            loop.contains[block->get_id()] = true;
+            for(auto pred : domtree.get_preds(*block))
+            {
+                if(block != header && !loop.contains[pred->get_id()])
+                    worklist.push_back(pred);
+            }
+        }
+
+        for(auto block : rpo)
+        {
+            if(loop.contains[block->get_id()])
+                loop.blocks.push_back(block);
+        }
+        loops.push_back(std::move(loop));
+    }
+
+    // A loop nested in another has fewer blocks than it.
+    std::stable_sort(loops.begin(), loops.end(), [](const IRLoop& a, const IRLoop& b) {
+        return a.blocks.size() < b.blocks.size();
+    });
+    return loops;
+}
+
+auto compute_liveness(IRFunction& function) -> Liveness
+{
+    const auto num_blocks = function.num_blocks();
+    const auto num_values = static_cast<size_t>(function.num_values());
+
+    Liveness result;
+    result.live_in.assign(num_blocks, std::vector<bool>(num_values, false));
+    result.live_out.assign(num_blocks, std::vector<bool>(num_values, false));
+
+    // The values used before being defined in each block (upward exposed)
+    // and the ones defined in it.
+    std::vector<std::vector<bool>> uses(num_blocks, std::vector<bool>(num_values, false));
+    std::vector<std::vector<bool>> defs(num_blocks, std::vector<bool>(num_values, false));
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        auto& block_uses = uses[block.get_id()];
+        auto& block_defs = defs[block.get_id()];
+        for(auto& inst : block)
+        {
+            if(inst.op != IROp::Phi)
+            {
+                for(auto arg : inst.args)
+                {
+                    if(!block_defs[arg])
+                        block_uses[arg] = true;
+                }
+            }
+            if(inst.dest != ir_no_value)
+                block_defs[inst.dest] = true;
+        }
+    }
+
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(auto it = function.block_end(); it != function.block_begin();)
+        {
+            auto& block = **--it;
+            auto& live_out = result.live_out[block.get_id()];
+            auto& live_in = result.live_in[block.get_id()];
+
+            for(auto succ : block.successors())
+            {
+                const auto& succ_in = result.live_in[succ->get_id()];
+                for(size_t v = 0; v < num_values; ++v)
+                {
+                    if(succ_in[v] && !live_out[v])
+                        live_out[v] = changed = true;
+                }
+
+                for(auto& inst : *succ)
+                {
+                    if(inst.op != IROp::Phi)
+                        break;
+                    for(size_t i = 0; i < inst.args.size(); ++i)
+                    {
+                        if(inst.incoming[i] == &block && !live_out[inst.args[i]])
+                            live_out[inst.args[i]] = changed = true;
+                    }
+                }
+            }
+
+            const auto& block_uses = uses[block.get_id()];
+            const auto& block_defs = defs[block.get_id()];
+            for(size_t v = 0; v < num_values; ++v)
+            {
+                const bool live = block_uses[v] || (live_out[v] && !block_defs[v]);
+                if(live && !live_in[v])
+                    live_in[v] = changed = true;
+            }
+        }
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,1151 @@
+#include <algorithm>
+#include <cminus/ir-codegen.hpp>
+#include <cminus/mem-report.hpp>
+#include <cminus/mips-arith.hpp>
+
+namespace
+{
+using namespace cminus;
+
+constexpr auto REG_0 = 0;
+constexpr auto REG_V0 = 2;
+constexpr auto REG_V1 = 3;
+constexpr auto REG_A0 = 4;
+constexpr auto REG_T0 = 8;
+constexpr auto REG_SP = 29;
+constexpr auto REG_RA = 31;
+
+/// Checks whether an instruction takes its first operand from the
+/// temporary block, that is, whether the operand must survive the
+/// evaluation of the second one.
+bool spills_left(const IRInst& inst)
+{
+    return inst.is_binary() || inst.op == IROp::Store || inst.op == IROp::ElemAddr;
+}
+
+/// A range of instructions of a block, holding a temporary slot.
+struct TempRange
+{
+    size_t start;
+    size_t end;
+    const IRInst* inst;
+};
+}
+
+namespace cminus
+{
+void IRCodegen::emit_module(IRModule& module)
+{
+    MemScope mem_scope(MemTag::Codegen);
+
+    dest += ".data\n";
+    dest += ".align 2\n";
+    for(auto it = module.global_begin(); it != module.global_end(); ++it)
+    {
+        dest += (*it)->name;
+        dest += ": .space ";
+        dest += std::to_string((*it)->size);
+        dest += '\n';
+    }
+
+    dest += "\n.text\n";
+    for(auto it = module.function_begin(); it != module.function_end(); ++it)
+    {
+        if(!(*it)->is_external())
+            emit_function(module, **it);
+    }
+}
+
+void IRCodegen::emit_function(IRModule& module, IRFunction& function)
+{
+    if(options.regalloc)
+    {
+        emit_allocated_function(module, function);
+        return;
+    }
+
+    layout_frame(function);
+    label_targets(module, function);
+    this->exit_label = function.get_exit_label();
+
+    dest += function.get_name();
+    dest += ":\n";
+
+    // Function prologue.
+    dest += "addiu $sp, $sp, -";
+    dest += std::to_string(frame.total_size());
+    dest += '\n';
+    emit_frame_sw(REG_RA, frame.saved_offset(0));
+    for(int32_t i = 0; i < std::min(4, function.get_num_params()); ++i)
+        emit_frame_sw(REG_A0 + i, frame.input_offset(4 * i));
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto next = std::next(it);
+        emit_block(function, **it, next != function.block_end() ? next->get() : nullptr);
+    }
+
+    // Function epilogue.
+    dest += ".L";
+    dest += std::to_string(exit_label);
+    dest += ":\n";
+    emit_frame_lw(REG_RA, frame.saved_offset(0));
+    dest += "addiu $sp, $sp, ";
+    dest += std::to_string(frame.total_size());
+    dest += '\n';
+    dest += "jr $ra\n";
+
+    // See `ASTCodegenVisitor` on why this stub is needed.
+    if(function.get_trap_label() != -1)
+    {
+        dest += ".L";
+        dest += std::to_string(function.get_trap_label());
+        dest += ":\n";
+        dest += "j __crt_out_of_bounds\n";
+    }
+}
+
+void IRCodegen::layout_frame(IRFunction& function)
+{
+    this->frame = FrameInfo{};
+    this->frame.saved_size = 4; // $ra
+    this->frame.local_size = function.get_local_size();
+    this->frame.input_size = std::min(16, 4 * function.get_num_params());
+
+    this->temp_pos.clear();
+    this->uses.assign(function.num_values(), {});
+    this->num_used.assign(function.num_values(), 0);
+
+    // The tree of an instruction spans from the first instruction of the
+    // trees of its operands up to itself. The operand of a store belongs to
+    // the store afterwards, since the assignment evaluates to it.
+    std::vector<size_t> tree_start(function.num_values(), 0);
+    std::vector<TempRange> ranges;
+    int32_t num_temps = 0;
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        ranges.clear();
+
+        size_t pos = 0;
+        for(auto& inst : block)
+        {
+            auto start = pos;
+            for(size_t i = 0; i < inst.args.size(); ++i)
+            {
+                this->uses[inst.args[i]].push_back(ValueUse{&inst, i});
+                start = std::min(start, tree_start[inst.args[i]]);
+            }
+
+            if(inst.dest != ir_no_value)
+                tree_start[inst.dest] = start;
+            if(inst.op == IROp::Store)
+                tree_start[inst.args[1]] = start;
+            if(spills_left(inst))
+                ranges.push_back(TempRange{start, pos, &inst});
+
+            if(inst.op == IROp::Call && inst.args.size() > 4)
+            {
+                const auto requires_output = static_cast<int32_t>(4 * (inst.args.size() - 4));
+                this->frame.output_size = std::max(frame.output_size, requires_output);
+            }
+            ++pos;
+        }
+
+        // The temporary slot of an instruction is below the slots of the
+        // instructions whose trees enclose its own.
+        std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b) {
+            return a.start != b.start ? a.start < b.start : a.end > b.end;
+        });
+
+        std::vector<const TempRange*> enclosing;
+        for(auto& range : ranges)
+        {
+            while(!enclosing.empty() && enclosing.back()->end < range.start)
+                enclosing.pop_back();
+            const auto depth = static_cast<int32_t>(enclosing.size());
+            this->temp_pos[range.inst] = 4 * depth;
+            num_temps = std::max(num_temps, depth + 1);
+            enclosing.push_back(&range);
+        }
+    }
+
+    this->frame.temp_size = 4 * num_temps;
+    for(auto& [inst, pos] : temp_pos)
+        pos = frame.temp_offset(pos);
+}
+
+void IRCodegen::label_targets(IRModule& module, IRFunction& function)
+{
+    const auto needs_label = [&](IRBlock* target) {
+        if(target->get_label() == -1)
+            target->set_label(module.new_label());
+    };
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        if(!block.is_terminated())
+            continue;
+
+        auto next = std::next(it);
+        auto next_block = (next != function.block_end() ? next->get() : nullptr);
+        auto& term = block.back();
+        for(auto target : term.targets)
+        {
+            if(target && target != next_block)
+                needs_label(target);
+        }
+    }
+}
+
+void IRCodegen::emit_block(IRFunction& function, IRBlock& block, IRBlock* next)
+{
+    if(block.get_label() != -1)
+    {
+        dest += ".L";
+        dest += std::to_string(block.get_label());
+        dest += ":\n";
+    }
+
+    this->v0_value = ir_no_value;
+    for(auto& inst : block)
+    {
+        emit_inst(function, inst, next);
+        move_out_of_v0();
+    }
+}
+
+void IRCodegen::emit_inst(IRFunction& function, IRInst& inst, IRBlock* next)
+{
+    // Operands are expected in $v0, except those moved out of it.
+    for(size_t i = 0; i < inst.args.size(); ++i)
+    {
+        assert(inst.op == IROp::Call || (i == 0 && spills_left(inst))
+               || inst.args[i] == v0_value);
+        ++this->num_used[inst.args[i]];
+    }
+
+    // Subscripts scale the index before reloading the base address.
+    if(spills_left(inst) && inst.op != IROp::ElemAddr)
+        emit_frame_lw(REG_T0, temp_pos.at(&inst));
+
+    switch(inst.op)
+    {
+        case IROp::Const:
+            dest += "li $v0, ";
+            dest += std::to_string(inst.imm);
+            dest += '\n';
+            break;
+        case IROp::FrameAddr:
+            dest += "addiu $v0, $sp, ";
+            dest += std::to_string(slot_offset(*inst.slot));
+            dest += '\n';
+            break;
+        case IROp::GlobalAddr:
+            dest += "la $v0, ";
+            dest += inst.global->name;
+            dest += '\n';
+            break;
+        case IROp::Load:
+            dest += "lw $v0, 0($v0)\n";
+            break;
+        case IROp::Store:
+            dest += "sw $v0, 0($t0)\n";
+            break;
+        case IROp::ElemAddr:
+            dest += "sll $v0, $v0, 2\n";
+            emit_frame_lw(REG_T0, temp_pos.at(&inst));
+            dest += "addu $v0, $t0, $v0\n";
+            break;
+        case IROp::Check:
+            dest += "bltzal $v0, .L";
+            dest += std::to_string(function.get_trap_label());
+            dest += '\n';
+            break;
+        case IROp::Call:
+            dest += "jal ";
+            dest += inst.callee->get_name();
+            dest += '\n';
+            break;
+        case IROp::Jump:
+            if(inst.targets[0] != next)
+                emit_jump(inst.targets[0]->get_label());
+            break;
+        case IROp::Branch:
+            if(inst.targets[0] == next)
+            {
+                dest += "beq $v0, $0, .L";
+                dest += std::to_string(inst.targets[1]->get_label());
+                dest += '\n';
+            }
+            else
+            {
+                dest += "bne $v0, $0, .L";
+                dest += std::to_string(inst.targets[0]->get_label());
+                dest += '\n';
+                if(inst.targets[1] != next)
+                    emit_jump(inst.targets[1]->get_label());
+            }
+            break;
+        case IROp::Return:
+            if(next != nullptr)
+                emit_jump(exit_label);
+            break;
+        default:
+            assert(inst.is_binary());
+            emit_binary_op(inst.op, REG_V0, REG_T0, REG_V0);
+            break;
+    }
+
+    // A store leaves the stored value in $v0.
+    if(inst.dest != ir_no_value)
+        this->v0_value = inst.dest;
+    else if(inst.op == IROp::Call)
+        this->v0_value = ir_no_value;
+}
+
+void IRCodegen::move_out_of_v0()
+{
+    if(v0_value == ir_no_value)
+        return;
+
+    const auto& value_uses = uses[v0_value];
+    const auto next_use = num_used[v0_value];
+    if(next_use == value_uses.size())
+        return;
+
+    const auto& use = value_uses[next_use];
+    if(use.inst->op == IROp::Call)
+    {
+        if(use.arg < 4)
+        {
+            dest += "add $";
+            dest += regname(REG_A0 + static_cast<int>(use.arg));
+            dest += ", $v0, $0\n";
+        }
+        else
+        {
+            emit_frame_sw(REG_V0, frame.output_offset(static_cast<int32_t>(4 * (use.arg - 4))));
+        }
+    }
+    else if(use.arg == 0 && spills_left(*use.inst))
+    {
+        emit_frame_sw(REG_V0, temp_pos.at(use.inst));
+    }
+    else
+    {
+        return;
+    }
+
+    this->v0_value = ir_no_value;
+}
+
+
+void IRCodegen::emit_allocated_function(IRModule& module, IRFunction& function)
+{
+    this->assignment = allocate_registers(function);
+    this->exit_label = function.get_exit_label();
+    this->edge_stubs.clear();
+
+    // Only the slots still referenced take place in the frame, that is,
+    // the ones of arrays.
+    this->frame = FrameInfo{};
+    this->local_pos.clear();
+    bool has_param_slots = false;
+    std::vector<IRSlot*> param_slots;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op == IROp::FrameAddr)
+            {
+                if(inst.slot->is_param())
+                {
+                    has_param_slots = true;
+                    param_slots.push_back(inst.slot);
+                }
+                else if(local_pos.emplace(inst.slot, frame.local_size).second)
+                    this->frame.local_size += inst.slot->size;
+            }
+            else if(inst.op == IROp::Call && inst.args.size() > 4
+                    && !assignment.tail_calls.count(&inst))
+            {
+                const auto requires_output = static_cast<int32_t>(4 * (inst.args.size() - 4));
+                this->frame.output_size = std::max(frame.output_size, requires_output);
+            }
+        }
+    }
+
+    const auto num_saved_regs = (assignment.has_calls ? 1 : 0) + assignment.saved_regs.size();
+    this->frame.saved_size = static_cast<int32_t>(4 * num_saved_regs); // $ra and $s*
+    this->frame.temp_size = assignment.spill_size;
+    if(has_param_slots)
+        this->frame.input_size = std::min(16, 4 * function.get_num_params());
+
+    // Comparisons only used by the branch right after them are fused into it.
+    std::vector<size_t> num_uses(function.num_values(), 0);
+    this->liveness = compute_liveness(function);
+    this->value_defs.assign(function.num_values(), nullptr);
+    this->zero_values.assign(function.num_values(), false);
+    this->fused_compares.clear();
+    this->fused_insts.clear();
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            for(auto arg : inst.args)
+                ++num_uses[arg];
+            if(inst.dest != ir_no_value)
+                this->value_defs[inst.dest] = &inst;
+            if(inst.op == IROp::Const && inst.imm == 0)
+                this->zero_values[inst.dest] = true;
+        }
+    }
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        if(block.size() < 2)
+            continue;
+
+        auto& branch = *std::prev(block.end());
+        auto& compare = *std::prev(block.end(), 2);
+        if(branch.op == IROp::Branch && compare.is_comparison()
+           && branch.args[0] == compare.dest && num_uses[compare.dest] == 1)
+        {
+            this->fused_compares.emplace(&branch, &compare);
+            this->fused_insts.insert(&compare);
+        }
+    }
+
+    label_targets(module, function);
+
+    dest += function.get_name();
+    dest += ":\n";
+
+    // Function prologue.
+    const auto s_offset = frame.saved_offset(assignment.has_calls ? 4 : 0);
+    if(frame.total_size() != 0)
+    {
+        dest += "addiu $sp, $sp, -";
+        dest += std::to_string(frame.total_size());
+        dest += '\n';
+    }
+    if(assignment.has_calls)
+        emit_frame_sw(REG_RA, frame.saved_offset(0));
+    for(size_t i = 0; i < assignment.saved_regs.size(); ++i)
+        emit_frame_sw(assignment.saved_regs[i], s_offset + 4 * i);
+    if(has_param_slots)
+    {
+        for(int32_t i = 0; i < std::min(4, function.get_num_params()); ++i)
+            emit_frame_sw(REG_A0 + i, frame.input_offset(4 * i));
+    }
+
+    // Parameters are received by the prologue, into the locations self tail
+    // calls pass their arguments into before jumping past it.
+    this->param_locs.assign(function.get_num_params(), std::nullopt);
+    for(auto slot : param_slots)
+        this->param_locs[slot->param_index] = Location{-1, slot_offset(*slot)};
+    for(auto& inst : function.get_entry())
+    {
+        if(inst.op == IROp::Param)
+        {
+            emit_param(inst);
+            this->param_locs[inst.imm] = location_of(inst.dest);
+        }
+    }
+
+    this->entry_label = -1;
+    if(std::any_of(assignment.tail_calls.begin(), assignment.tail_calls.end(),
+                   [&](const IRInst* call) { return call->callee == &function; }))
+    {
+        this->entry_label = module.new_label();
+        dest += ".L";
+        dest += std::to_string(entry_label);
+        dest += ":\n";
+    }
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        auto next = std::next(it);
+        auto next_block = (next != function.block_end() ? next->get() : nullptr);
+
+        if(block.get_label() != -1)
+        {
+            dest += ".L";
+            dest += std::to_string(block.get_label());
+            dest += ":\n";
+        }
+
+        for(auto& inst : block)
+            emit_allocated_inst(module, function, block, inst, next_block);
+    }
+
+    // Function epilogue.
+    dest += ".L";
+    dest += std::to_string(exit_label);
+    dest += ":\n";
+    emit_frame_teardown();
+    dest += "jr $ra\n";
+
+    if(function.get_trap_label() != -1)
+    {
+        dest += ".L";
+        dest += std::to_string(function.get_trap_label());
+        dest += ":\n";
+        dest += "j __crt_out_of_bounds\n";
+    }
+
+    for(auto& stub : edge_stubs)
+    {
+        dest += ".L";
+        dest += std::to_string(stub.label);
+        dest += ":\n";
+        emit_phi_moves(*stub.from, *stub.to);
+        emit_jump(stub.to->get_label());
+    }
+}
+
+void IRCodegen::emit_frame_teardown()
+{
+    const auto s_offset = frame.saved_offset(assignment.has_calls ? 4 : 0);
+    if(assignment.has_calls)
+        emit_frame_lw(REG_RA, frame.saved_offset(0));
+    for(size_t i = 0; i < assignment.saved_regs.size(); ++i)
+        emit_frame_lw(assignment.saved_regs[i], s_offset + 4 * i);
+    if(frame.total_size() != 0)
+    {
+        dest += "addiu $sp, $sp, ";
+        dest += std::to_string(frame.total_size());
+        dest += '\n';
+    }
+}
+
+void IRCodegen::emit_param(IRInst& inst)
+{
+    const auto rd = def_reg(inst.dest);
+    if(inst.imm < 4)
+    {
+        dest += "move $";
+        dest += regname(rd);
+        dest += ", $";
+        dest += regname(REG_A0 + inst.imm);
+        dest += '\n';
+    }
+    else
+    {
+        emit_frame_lw(rd, frame.total_size() + 4 * (inst.imm - 4));
+    }
+    finish_def(inst.dest);
+}
+
+void IRCodegen::emit_allocated_inst(IRModule& module, IRFunction& function,
+                                    IRBlock& block, IRInst& inst, IRBlock* next)
+{
+    switch(inst.op)
+    {
+        case IROp::Phi:
+            // Resolved by the predecessors.
+            break;
+        case IROp::Param:
+            // Received by the prologue.
+            break;
+        case IROp::Const:
+        case IROp::FrameAddr:
+        case IROp::GlobalAddr:
+            // Rematerialized values are computed by their uses instead.
+            if(!assignment.rematerialized[inst.dest])
+            {
+                emit_remat(def_reg(inst.dest), inst);
+                finish_def(inst.dest);
+            }
+            break;
+        case IROp::Load:
+        {
+            const auto rs = use_reg(inst.args[0], REG_V1);
+            const auto rd = def_reg(inst.dest);
+            dest += "lw $";
+            dest += regname(rd);
+            dest += ", 0($";
+            dest += regname(rs);
+            dest += ")\n";
+            finish_def(inst.dest);
+            break;
+        }
+        case IROp::Store:
+        {
+            const auto rs = use_reg(inst.args[0], REG_V1);
+            const auto rt = use_reg(inst.args[1], REG_T0);
+            dest += "sw $";
+            dest += regname(rt);
+            dest += ", 0($";
+            dest += regname(rs);
+            dest += ")\n";
+            break;
+        }
+        case IROp::ElemAddr:
+        {
+            const auto index = use_reg(inst.args[1], REG_T0);
+            dest += "sll $t0, $";
+            dest += regname(index);
+            dest += ", 2\n";
+            emit_binary_op(IROp::Add, def_reg(inst.dest), use_reg(inst.args[0], REG_V1), REG_T0);
+            finish_def(inst.dest);
+            break;
+        }
+        case IROp::Check:
+        {
+            // Unlike bltzal, this does not clobber $ra, which may be unsaved.
+            const auto index = use_reg(inst.args[0], REG_T0);
+            dest += "bltz $";
+            dest += regname(index);
+            dest += ", .L";
+            dest += std::to_string(function.get_trap_label());
+            dest += '\n';
+            break;
+        }
+        case IROp::Call:
+        {
+            const auto is_tail_call = assignment.tail_calls.count(&inst) != 0;
+            if(is_tail_call && inst.callee == &function)
+            {
+                // The arguments replace the parameters where the prologue
+                // left them, thus all of them are written at once.
+                std::vector<Move> moves;
+                for(size_t i = 0; i < inst.args.size(); ++i)
+                {
+                    if(param_locs[i] && !(*param_locs[i] == location_of(inst.args[i])))
+                        moves.emplace_back(*param_locs[i], location_of(inst.args[i]));
+                }
+                emit_parallel_moves(std::move(moves));
+                emit_jump(entry_label);
+                break;
+            }
+
+            // Only self tail calls pass arguments on the stack.
+            for(size_t i = 0; i < inst.args.size(); ++i)
+            {
+                Location to;
+                if(i < 4)
+                    to.reg = REG_A0 + static_cast<int>(i);
+                else
+                    to.frame_offset = frame.output_offset(static_cast<int32_t>(4 * (i - 4)));
+                emit_move(to, location_of(inst.args[i]), REG_T0);
+            }
+
+            if(is_tail_call)
+            {
+                emit_frame_teardown();
+                dest += "j ";
+                dest += inst.callee->get_name();
+                dest += '\n';
+                break;
+            }
+
+            dest += "jal ";
+            dest += inst.callee->get_name();
+            dest += '\n';
+
+            if(inst.dest != ir_no_value)
+                emit_move(location_of(inst.dest), Location{REG_V0}, REG_T0);
+            break;
+        }
+        case IROp::Jump:
+            emit_phi_moves(block, *inst.targets[0]);
+            if(inst.targets[0] != next)
+                emit_jump(inst.targets[0]->get_label());
+            break;
+        case IROp::Branch:
+        {
+            auto& if_true = *inst.targets[0];
+            auto& if_false = *inst.targets[1];
+            const auto [on_true, on_false] = emit_branch_conds(inst);
+            if(&if_false == next)
+            {
+                emit_branch_to(module, on_true, block, if_true, if_false);
+                emit_phi_moves(block, if_false);
+            }
+            else if(&if_true == next)
+            {
+                emit_branch_to(module, on_false, block, if_false, if_true);
+                emit_phi_moves(block, if_true);
+            }
+            else
+            {
+                emit_branch_to(module, on_true, block, if_true, if_false);
+                emit_phi_moves(block, if_false);
+                emit_jump(if_false.get_label());
+            }
+            break;
+        }
+        case IROp::Return:
+            // Tail calls already left the function.
+            if(block.size() >= 2 && assignment.tail_calls.count(&*std::prev(block.end(), 2)))
+                break;
+            if(!inst.args.empty())
+                emit_move(Location{REG_V0}, location_of(inst.args[0]), REG_T0);
+            if(next != nullptr)
+                emit_jump(exit_label);
+            break;
+        default:
+        {
+            assert(inst.is_binary());
+            if(fused_insts.count(&inst) || assignment.rematerialized[inst.dest])
+                break;
+            if(options.strength_reduce && emit_reduced_op(inst))
+                break;
+
+            const auto rs = use_reg(inst.args[0], REG_V1);
+            const auto rt = use_reg(inst.args[1], REG_T0);
+            emit_binary_op(inst.op, def_reg(inst.dest), rs, rt);
+            finish_def(inst.dest);
+            break;
+        }
+    }
+}
+
+auto IRCodegen::emit_branch_conds(const IRInst& branch) -> std::pair<BranchCond, BranchCond>
+{
+    auto it = fused_compares.find(&branch);
+    if(it == fused_compares.end())
+    {
+        const auto cond = use_reg(branch.args[0], REG_T0);
+        return {BranchCond{"bne", cond, REG_0}, BranchCond{"beq", cond, REG_0}};
+    }
+
+    auto& compare = *it->second;
+    auto op = compare.op;
+    auto lhs = zero_values[compare.args[0]] ? REG_0 : use_reg(compare.args[0], REG_V1);
+    auto rhs = zero_values[compare.args[1]] ? REG_0 : use_reg(compare.args[1], REG_T0);
+
+    if(op == IROp::Eq)
+        return {BranchCond{"beq", lhs, rhs}, BranchCond{"bne", lhs, rhs}};
+    if(op == IROp::Ne)
+        return {BranchCond{"bne", lhs, rhs}, BranchCond{"beq", lhs, rhs}};
+
+    if(lhs == REG_0 && rhs != REG_0)
+    {
+        // Compare the other operand against zero.
+        std::swap(lhs, rhs);
+        op = (op == IROp::Lt ? IROp::Gt : op == IROp::Gt ? IROp::Lt
+              : op == IROp::Le ? IROp::Ge : IROp::Le);
+    }
+
+    if(rhs == REG_0)
+    {
+        switch(op)
+        {
+            case IROp::Lt:
+                return {BranchCond{"bltz", lhs}, BranchCond{"bgez", lhs}};
+            case IROp::Le:
+                return {BranchCond{"blez", lhs}, BranchCond{"bgtz", lhs}};
+            case IROp::Gt:
+                return {BranchCond{"bgtz", lhs}, BranchCond{"blez", lhs}};
+            default:
+                return {BranchCond{"bgez", lhs}, BranchCond{"bltz", lhs}};
+        }
+    }
+
+    // Less and greater hold when $v0 is set, the others when it is not.
+    const auto is_strict = (op == IROp::Lt || op == IROp::Gt);
+    const auto swapped = (op == IROp::Le || op == IROp::Gt);
+    dest += "slt $v0, $";
+    dest += regname(swapped ? rhs : lhs);
+    dest += ", $";
+    dest += regname(swapped ? lhs : rhs);
+    dest += '\n';
+
+    const BranchCond if_set{"bne", REG_V0, REG_0};
+    const BranchCond if_clear{"beq", REG_V0, REG_0};
+    return is_strict ? std::make_pair(if_set, if_clear) : std::make_pair(if_clear, if_set);
+}
+
+void IRCodegen::emit_branch_to(IRModule& module, const BranchCond& cond,
+                               IRBlock& block, IRBlock& target, IRBlock& other)
+{
+    auto label = target.get_label();
+    auto moves = phi_moves(block, target);
+    if(!moves.empty() && can_move_before_branch(moves, cond, block, other))
+    {
+        emit_parallel_moves(std::move(moves));
+    }
+    else if(!moves.empty())
+    {
+        label = module.new_label();
+        this->edge_stubs.push_back(EdgeStub{label, &block, &target});
+    }
+
+    dest += cond.mnemonic;
+    dest += " $";
+    dest += regname(cond.rs);
+    if(cond.rt != -1)
+    {
+        dest += ", $";
+        dest += regname(cond.rt);
+    }
+    dest += ", .L";
+    dest += std::to_string(label);
+    dest += '\n';
+}
+
+bool IRCodegen::can_move_before_branch(const std::vector<Move>& moves, const BranchCond& cond,
+                                       IRBlock& block, IRBlock& other) const
+{
+    // The moves go through $t0 and $v1.
+    const auto is_written = [&](int reg) {
+        return reg == REG_T0 || reg == REG_V1
+               || std::any_of(moves.begin(), moves.end(),
+                              [&](const Move& move) { return move.first.reg == reg; });
+    };
+    if(is_written(cond.rs) || (cond.rt != -1 && is_written(cond.rt)))
+        return false;
+
+    // Nor may they overwrite what the other successor reads.
+    std::vector<Location> read;
+    const auto& live_in = liveness.live_in[other.get_id()];
+    for(size_t v = 0; v < live_in.size(); ++v)
+    {
+        if(live_in[v])
+            read.push_back(location_of(static_cast<IRValue>(v)));
+    }
+    for(auto& inst : other)
+    {
+        if(inst.op != IROp::Phi)
+            break;
+        const auto it = std::find(inst.incoming.begin(), inst.incoming.end(), &block);
+        read.push_back(location_of(inst.args[it - inst.incoming.begin()]));
+    }
+
+    return std::none_of(moves.begin(), moves.end(), [&](const Move& move) {
+        return std::find(read.begin(), read.end(), move.first) != read.end();
+    });
+}
+
+auto IRCodegen::phi_moves(IRBlock& from, IRBlock& to) const -> std::vector<Move>
+{
+    std::vector<Move> moves;
+    for(auto& inst : to)
+    {
+        if(inst.op != IROp::Phi)
+            break;
+
+        const auto it = std::find(inst.incoming.begin(), inst.incoming.end(), &from);
+        assert(it != inst.incoming.end());
+        const auto arg = inst.args[it - inst.incoming.begin()];
+        if(!(location_of(inst.dest) == location_of(arg)))
+            moves.emplace_back(location_of(inst.dest), location_of(arg));
+    }
+    return moves;
+}
+
+void IRCodegen::emit_phi_moves(IRBlock& from, IRBlock& to)
+{
+    emit_parallel_moves(phi_moves(from, to));
+}
+
+void IRCodegen::emit_parallel_moves(std::vector<Move> moves)
+{
+    // Some moves may need to wait for others reading their destination, and
+    // cycles are broken through $t0.
+    while(!moves.empty())
+    {
+        const auto is_read = [&](const Location& loc) {
+            return std::any_of(moves.begin(), moves.end(), [&](const auto& move) {
+                return move.second == loc;
+            });
+        };
+
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](const auto& move) {
+            return !is_read(move.first);
+        });
+
+        if(ready != moves.end())
+        {
+            emit_move(ready->first, ready->second, REG_V1);
+            moves.erase(ready);
+            continue;
+        }
+
+        const auto blocked = moves.front().first;
+        emit_move(Location{REG_T0}, blocked, REG_V1);
+        for(auto& move : moves)
+        {
+            if(move.second == blocked)
+                move.second = Location{REG_T0};
+        }
+    }
+}
+
+void IRCodegen::emit_remat(int rd, const IRInst& inst)
+{
+    switch(inst.op)
+    {
+        case IROp::Const:
+            dest += "li $";
+            dest += regname(rd);
+            dest += ", ";
+            dest += std::to_string(inst.imm);
+            dest += '\n';
+            break;
+        case IROp::FrameAddr:
+            dest += "addiu $";
+            dest += regname(rd);
+            dest += ", $sp, ";
+            dest += std::to_string(slot_offset(*inst.slot));
+            dest += '\n';
+            break;
+        case IROp::GlobalAddr:
+            dest += "la $";
+            dest += regname(rd);
+            dest += ", ";
+            dest += inst.global->name;
+            dest += '\n';
+            break;
+        default:
+            // The operands are kept in registers.
+            assert(inst.is_binary());
+            emit_binary_op(inst.op, rd, assignment.regs[inst.args[0]],
+                           assignment.regs[inst.args[1]]);
+            break;
+    }
+}
+
+bool IRCodegen::emit_reduced_op(const IRInst& inst)
+{
+    const auto constant_of = [&](IRValue value) -> const IRInst* {
+        const auto def = value_defs[value];
+        return def && def->op == IROp::Const ? def : nullptr;
+    };
+
+    if(inst.op != IROp::Mul && inst.op != IROp::Div)
+        return false;
+
+    auto value = inst.args[0];
+    auto constant = constant_of(inst.args[1]);
+    if(!constant && inst.op == IROp::Mul)
+    {
+        value = inst.args[1];
+        constant = constant_of(inst.args[0]);
+    }
+    if(!constant)
+        return false;
+
+    // The operand is only loaded once the reduced code is known to exist.
+    const auto loc = location_of(value);
+    const auto rs = (loc.reg != -1 ? loc.reg : REG_V1);
+    const auto rd = def_reg(inst.dest);
+    std::string code;
+    const auto reduced = (inst.op == IROp::Mul ? emit_multiply_by(code, rd, rs, constant->imm)
+                                               : emit_divide_by(code, rd, rs, constant->imm));
+    if(!reduced)
+        return false;
+
+    use_reg(value, REG_V1);
+    dest += code;
+    finish_def(inst.dest);
+    return true;
+}
+
+auto IRCodegen::location_of(IRValue value) const -> Location
+{
+    Location loc;
+    loc.reg = assignment.regs[value];
+    if(assignment.rematerialized[value])
+        loc.remat = value_defs[value];
+    else if(loc.reg == -1)
+        loc.frame_offset = frame.temp_offset(assignment.spill_pos[value]);
+    return loc;
+}
+
+int IRCodegen::use_reg(IRValue value, int scratch)
+{
+    const auto loc = location_of(value);
+    if(loc.reg != -1)
+        return loc.reg;
+    if(loc.remat)
+        emit_remat(scratch, *loc.remat);
+    else
+        emit_frame_lw(scratch, loc.frame_offset);
+    return scratch;
+}
+
+int IRCodegen::def_reg(IRValue value)
+{
+    const auto reg = assignment.regs[value];
+    return reg != -1 ? reg : REG_V0;
+}
+
+void IRCodegen::finish_def(IRValue value)
+{
+    const auto loc = location_of(value);
+    if(loc.reg == -1)
+        emit_frame_sw(REG_V0, loc.frame_offset);
+}
+
+void IRCodegen::emit_move(Location to, Location from, int scratch)
+{
+    if(to == from)
+        return;
+
+    if(from.remat)
+    {
+        emit_remat(to.reg != -1 ? to.reg : scratch, *from.remat);
+        if(to.reg == -1)
+            emit_frame_sw(scratch, to.frame_offset);
+    }
+    else if(to.reg != -1 && from.reg != -1)
+    {
+        dest += "move $";
+        dest += regname(to.reg);
+        dest += ", $";
+        dest += regname(from.reg);
+        dest += '\n';
+    }
+    else if(to.reg != -1)
+    {
+        emit_frame_lw(to.reg, from.frame_offset);
+    }
+    else if(from.reg != -1)
+    {
+        emit_frame_sw(from.reg, to.frame_offset);
+    }
+    else
+    {
+        emit_frame_lw(scratch, from.frame_offset);
+        emit_frame_sw(scratch, to.frame_offset);
+    }
+}
+
+void IRCodegen::emit_binary_op(IROp op, int rd, int rs, int rt)
+{
+    const auto emit = [&](const char* mnemonic, int a, int b, int c) {
+        dest += mnemonic;
+        dest += " $";
+        dest += regname(a);
+        dest += ", $";
+        dest += regname(b);
+        dest += ", $";
+        dest += regname(c);
+        dest += '\n';
+    };
+
+    const auto emit_imm = [&](const char* mnemonic, int a, int b, const char* imm) {
+        dest += mnemonic;
+        dest += " $";
+        dest += regname(a);
+        dest += ", $";
+        dest += regname(b);
+        dest += ", ";
+        dest += imm;
+        dest += '\n';
+    };
+
+    const auto emit_lo = [&](const char* mnemonic) {
+        dest += mnemonic;
+        dest += " $";
+        dest += regname(rs);
+        dest += ", $";
+        dest += regname(rt);
+        dest += "\nmflo $";
+        dest += regname(rd);
+        dest += '\n';
+    };
+
+    switch(op)
+    {
+        case IROp::Add:
+            emit("addu", rd, rs, rt);
+            break;
+        case IROp::Sub:
+            emit("subu", rd, rs, rt);
+            break;
+        case IROp::Mul:
+            emit_lo("mult");
+            break;
+        case IROp::Div:
+            emit_lo("div");
+            break;
+        case IROp::Lt:
+            emit("slt", rd, rs, rt);
+            break;
+        case IROp::Le:
+            emit("slt", rd, rt, rs);
+            emit_imm("xori", rd, rd, "1");
+            break;
+        case IROp::Gt:
+            emit("slt", rd, rt, rs);
+            break;
+        case IROp::Ge:
+            emit("slt", rd, rs, rt);
+            emit_imm("xori", rd, rd, "1");
+            break;
+        case IROp::Eq:
+            emit("xor", rd, rs, rt);
+            emit_imm("sltiu", rd, rd, "1");
+            break;
+        case IROp::Ne:
+            emit("xor", rd, rs, rt);
+            emit("sltu", rd, REG_0, rd);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+void IRCodegen::emit_jump(int32_t label)
+{
+    dest += "j .L";
+    dest += std::to_string(label);
+    dest += '\n';
+}
+
+void IRCodegen::emit_frame_sw(int reg, int32_t frame_offset)
+{
+    dest += "sw $";
+    dest += regname(reg);
+    dest += ", ";
+    dest += std::to_string(frame_offset);
+    dest += "($sp)\n";
+}
+
+void IRCodegen::emit_frame_lw(int reg, int32_t frame_offset)
+{
+    dest += "lw $";
+    dest += regname(reg);
+    dest += ", ";
+    dest += std::to_string(frame_offset);
+    dest += "($sp)\n";
+}
+
+int32_t IRCodegen::slot_offset(IRSlot& slot) const
+{
+    if(slot.is_param())
+    {
+        // Parameters past the fourth are where the caller put them. Without
+        // register allocation, as in `ASTCodegenVisitor`, parameters past the
+        // fifth are found where the fifth is.
+        if(options.regalloc && slot.param_index >= 4)
+            return frame.total_size() + 4 * (slot.param_index - 4);
+        return frame.input_offset(std::min(16, 4 * slot.param_index));
+    }
+
+    if(options.regalloc)
+        return frame.local_offset(local_pos.at(&slot));
+    return frame.local_offset(slot.offset);
+}
+
+auto IRCodegen::regname(int reg) -> const char*
+{
+    static constexpr const char* names[] = {
+        "0", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+        "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+        "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+        "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+    };
+    assert(reg >= 0 && reg <= 31);
+    return names[reg];
+}
+}
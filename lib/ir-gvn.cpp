@@ -0,0 +1,206 @@
+#include <cminus/ir-analysis.hpp>
+#include <cminus/ir-passes.hpp>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+using namespace cminus;
+
+/// An operand of an expression, either a value or the constant held by it,
+/// since the same constant may be defined by many instructions.
+using OperandKey = std::pair<bool, int32_t>;
+
+/// An operation and what it operates on.
+using ExprKey = std::tuple<IROp, int32_t, const void*, OperandKey, OperandKey>;
+
+/// Numbers the values of a function, walking the dominator tree so that the
+/// expressions computed by the dominators of each block are available.
+///
+/// Loads are available after a load or store of the same address with no
+/// store nor call in between. Since addresses of different value may still
+/// alias, stores make any other load unavailable.
+class ValueNumberer
+{
+public:
+    explicit ValueNumberer(IRFunction& function, const DominatorTree& domtree) :
+        domtree(domtree),
+        replacement(function.num_values(), ir_no_value),
+        consts(function.num_values(), std::nullopt),
+        memory_out(function.num_blocks())
+    {
+        for(auto it = function.block_begin(); it != function.block_end(); ++it)
+        {
+            for(auto& inst : **it)
+            {
+                if(inst.op == IROp::Const)
+                    this->consts[inst.dest] = inst.imm;
+            }
+        }
+    }
+
+    void number(IRBlock& block)
+    {
+        // Loads of the immediate dominator stay available when it is the
+        // only way into the block.
+        std::unordered_map<IRValue, IRValue> memory;
+        const auto& preds = domtree.get_preds(block);
+        if(preds.size() == 1 && preds[0] == domtree.get_idom(block))
+            memory = memory_out[preds[0]->get_id()];
+
+        std::vector<ExprKey> inserted;
+        for(auto& inst : block)
+        {
+            if(inst.op != IROp::Phi)
+            {
+                for(auto& arg : inst.args)
+                    arg = resolve(arg);
+            }
+
+            switch(inst.op)
+            {
+                case IROp::Load:
+                {
+                    auto [it, is_new] = memory.emplace(inst.args[0], inst.dest);
+                    if(!is_new)
+                        replace(inst, it->second);
+                    break;
+                }
+                case IROp::Store:
+                    memory.clear();
+                    memory.emplace(inst.args[0], inst.args[1]);
+                    break;
+                case IROp::Call:
+                    memory.clear();
+                    break;
+                case IROp::Check:
+                case IROp::FrameAddr:
+                case IROp::GlobalAddr:
+                case IROp::ElemAddr:
+                    number_expr(inst, inserted);
+                    break;
+                default:
+                    if(inst.is_binary())
+                        number_expr(inst, inserted);
+                    break;
+            }
+        }
+
+        this->memory_out[block.get_id()] = std::move(memory);
+
+        for(auto child : domtree.get_children(block))
+            number(*child);
+
+        for(auto& key : inserted)
+            this->exprs.erase(key);
+    }
+
+    /// Checks whether an instruction was found redundant.
+    bool is_redundant(const IRInst& inst) const
+    {
+        return redundant.count(&inst) != 0;
+    }
+
+    /// \returns the value replacing another.
+    auto resolve(IRValue value) const -> IRValue
+    {
+        while(replacement[value] != ir_no_value)
+            value = replacement[value];
+        return value;
+    }
+
+private:
+    void number_expr(IRInst& inst, std::vector<ExprKey>& inserted)
+    {
+        const auto key = key_of(inst);
+        auto [it, is_new] = exprs.emplace(key, inst.dest);
+        if(is_new)
+            inserted.push_back(key);
+        else
+            replace(inst, it->second);
+    }
+
+    void replace(IRInst& inst, IRValue value)
+    {
+        if(inst.dest != ir_no_value)
+            this->replacement[inst.dest] = value;
+        this->redundant.insert(&inst);
+    }
+
+    auto key_of(const IRInst& inst) const -> ExprKey
+    {
+        const auto operand = [&](size_t i) -> OperandKey {
+            if(i >= inst.args.size())
+                return {false, ir_no_value};
+            if(auto imm = consts[inst.args[i]])
+                return {true, *imm};
+            return {false, inst.args[i]};
+        };
+
+        auto op = inst.op;
+        auto lhs = operand(0);
+        auto rhs = operand(1);
+        const auto pointer = (inst.slot ? static_cast<const void*>(inst.slot) : inst.global);
+
+        // Operations computing the same with their operands swapped.
+        switch(op)
+        {
+            case IROp::Add:
+            case IROp::Mul:
+            case IROp::Eq:
+            case IROp::Ne:
+                if(rhs < lhs)
+                    std::swap(lhs, rhs);
+                break;
+            case IROp::Gt:
+                op = IROp::Lt;
+                std::swap(lhs, rhs);
+                break;
+            case IROp::Ge:
+                op = IROp::Le;
+                std::swap(lhs, rhs);
+                break;
+            default:
+                break;
+        }
+        return ExprKey{op, inst.imm, pointer, lhs, rhs};
+    }
+
+private:
+    const DominatorTree& domtree;
+    std::vector<IRValue> replacement;
+    std::vector<std::optional<int32_t>> consts;
+    std::map<ExprKey, IRValue> exprs;
+    std::vector<std::unordered_map<IRValue, IRValue>> memory_out;
+    std::unordered_set<const IRInst*> redundant;
+};
+}
+
+namespace cminus
+{
+auto number_values(IRFunction& function) -> size_t
+{
+    const DominatorTree domtree(function);
+    ValueNumberer numberer(function, domtree);
+    numberer.number(function.get_entry());
+
+    size_t num_removed = 0;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        const auto size = (*it)->size();
+        (*it)->remove_if([&](const IRInst& inst) { return numberer.is_redundant(inst); });
+        num_removed += size - (*it)->size();
+
+        // Operands of phis may come from blocks numbered later.
+        for(auto& inst : **it)
+        {
+            for(auto& arg : inst.args)
+                arg = numberer.resolve(arg);
+        }
+    }
+    return num_removed;
+}
+}
@@ -0,0 +1,442 @@
+#include <cminus/ir-analysis.hpp>
+#include <cminus/ir-passes.hpp>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+using namespace cminus;
+
+/// Pointer induction variables created per loop at most, since each of them
+/// takes a register for the whole loop.
+constexpr size_t max_pointer_ivs = 4;
+
+/// \returns the block defining each value.
+auto find_def_blocks(IRFunction& function) -> std::vector<IRBlock*>
+{
+    std::vector<IRBlock*> def_blocks(function.num_values(), nullptr);
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.dest != ir_no_value)
+                def_blocks[inst.dest] = it->get();
+        }
+    }
+    return def_blocks;
+}
+
+/// \returns the constant held by each value, if defined by `Const`.
+auto find_consts(IRFunction& function) -> std::unordered_map<IRValue, int32_t>
+{
+    std::unordered_map<IRValue, int32_t> consts;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op == IROp::Const)
+                consts.emplace(inst.dest, inst.imm);
+        }
+    }
+    return consts;
+}
+
+/// \returns the only predecessor of the header of a loop from outside of it
+/// or `nullptr` if there are many.
+auto find_preheader(const DominatorTree& domtree, const IRLoop& loop) -> IRBlock*
+{
+    IRBlock* preheader = nullptr;
+    for(auto pred : domtree.get_preds(*loop.header))
+    {
+        if(loop.contains[pred->get_id()])
+            continue;
+        if(preheader != nullptr)
+            return nullptr;
+        preheader = pred;
+    }
+    return preheader;
+}
+
+/// \returns the position instructions are appended to a block in, which is
+/// before its terminator and the comparison it may branch on, since the
+/// code generator fuses the two.
+auto end_position(IRBlock& block) -> size_t
+{
+    auto pos = block.size() - 1;
+    auto& terminator = block.back();
+    if(terminator.op == IROp::Branch && pos > 0
+       && (block.begin() + (pos - 1))->dest == terminator.args[0])
+        --pos;
+    return pos;
+}
+
+/// Checks whether an instruction only computes its result, and may thus be
+/// executed even where the original program would not.
+bool is_speculatable(const IRInst& inst)
+{
+    switch(inst.op)
+    {
+        case IROp::Const:
+        case IROp::FrameAddr:
+        case IROp::GlobalAddr:
+        case IROp::ElemAddr:
+        case IROp::Add:
+        case IROp::Sub:
+        case IROp::Mul:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Removes the constants which are not used anymore.
+void remove_unused_consts(IRFunction& function)
+{
+    std::vector<bool> used(function.num_values(), false);
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            for(auto arg : inst.args)
+                used[arg] = true;
+        }
+    }
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        (*it)->remove_if([&](const IRInst& inst) {
+            return inst.op == IROp::Const && !used[inst.dest];
+        });
+    }
+}
+
+/// Replaces the operands of every instruction as given by `replacement`.
+void replace_uses(IRFunction& function, const std::vector<IRValue>& replacement)
+{
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            for(auto& arg : inst.args)
+            {
+                while(static_cast<size_t>(arg) < replacement.size() && replacement[arg] != ir_no_value)
+                    arg = replacement[arg];
+            }
+        }
+    }
+}
+
+/// A phi of the header of a loop which is stepped by a constant amount
+/// in each iteration.
+struct InductionVar
+{
+    IRValue phi;
+    IRValue init; //< from the preheader
+    IRValue next; //< from the latches
+    int32_t step;
+};
+
+/// \returns the amount an instruction adds to `value` if it adds a constant
+/// to it.
+auto constant_offset(const IRInst& inst, IRValue value,
+                     const std::unordered_map<IRValue, int32_t>& consts) -> std::optional<int32_t>
+{
+    if(inst.op != IROp::Add && inst.op != IROp::Sub)
+        return std::nullopt;
+
+    auto other = ir_no_value;
+    if(inst.args[0] == value)
+        other = inst.args[1];
+    else if(inst.args[1] == value && inst.op == IROp::Add)
+        other = inst.args[0];
+
+    auto it = consts.find(other);
+    if(it == consts.end())
+        return std::nullopt;
+    return inst.op == IROp::Add ? it->second : -it->second;
+}
+}
+
+namespace cminus
+{
+auto hoist_loop_invariants(IRFunction& function) -> size_t
+{
+    using InstKey = std::tuple<IROp, int32_t, const void*, std::vector<IRValue>>;
+
+    const DominatorTree domtree(function);
+    auto def_blocks = find_def_blocks(function);
+    const auto consts = find_consts(function);
+    std::vector<IRValue> replacement(function.num_values(), ir_no_value);
+
+    const auto resolve = [&](IRValue value) {
+        while(replacement[value] != ir_no_value)
+            value = replacement[value];
+        return value;
+    };
+
+    size_t num_hoisted = 0;
+    for(auto& loop : find_loops(domtree))
+    {
+        auto preheader = find_preheader(domtree, loop);
+        if(preheader == nullptr)
+            continue;
+
+        // Instructions computing the same value are hoisted once. Constants
+        // stay in the loop as well, since they may become immediates there.
+        std::vector<IRInst> hoisted;
+        std::map<InstKey, IRValue> hoisted_keys;
+        std::vector<bool> moved(function.num_values(), false);
+
+        const auto is_invariant = [&](IRValue value) {
+            return !loop.contains[def_blocks[value]->get_id()];
+        };
+
+        const auto hoist = [&](IRInst inst) {
+            const auto pointer = (inst.slot ? static_cast<const void*>(inst.slot) : inst.global);
+            const auto [it, inserted] = hoisted_keys.emplace(InstKey{inst.op, inst.imm, pointer, inst.args},
+                                                             inst.dest);
+            if(inserted)
+                hoisted.push_back(std::move(inst));
+            return it->second;
+        };
+
+        for(auto block : loop.blocks)
+        {
+            for(auto& inst : *block)
+            {
+                if(inst.op == IROp::Const || !is_speculatable(inst))
+                    continue;
+
+                for(auto& arg : inst.args)
+                    arg = resolve(arg);
+
+                const auto invariant = std::all_of(inst.args.begin(), inst.args.end(), [&](IRValue arg) {
+                    return is_invariant(arg) || moved[arg] || consts.count(arg);
+                });
+                if(!invariant)
+                    continue;
+
+                IRInst copy = inst;
+                for(auto& arg : copy.args)
+                {
+                    if(is_invariant(arg) || moved[arg])
+                        continue;
+
+                    // A constant of the loop, copied along.
+                    IRInst constant(IROp::Const);
+                    constant.imm = consts.at(arg);
+                    constant.dest = function.new_value(IRType::I32);
+                    arg = hoist(std::move(constant));
+                }
+
+                const auto value = hoist(std::move(copy));
+                if(value != inst.dest)
+                {
+                    replacement.resize(function.num_values(), ir_no_value);
+                    replacement[inst.dest] = value;
+                }
+                moved.resize(function.num_values(), false);
+                moved[inst.dest] = true;
+                ++num_hoisted;
+            }
+
+            block->remove_if([&](const IRInst& inst) {
+                return inst.dest != ir_no_value && static_cast<size_t>(inst.dest) < moved.size()
+                       && moved[inst.dest];
+            });
+        }
+
+        auto pos = end_position(*preheader);
+        def_blocks.resize(function.num_values(), nullptr);
+        replacement.resize(function.num_values(), ir_no_value);
+        for(auto& inst : hoisted)
+        {
+            def_blocks[inst.dest] = preheader;
+            preheader->insert(pos++, std::move(inst));
+        }
+        replace_uses(function, replacement);
+    }
+
+    remove_unused_consts(function);
+    return num_hoisted;
+}
+
+auto reduce_induction_variables(IRFunction& function) -> size_t
+{
+    const DominatorTree domtree(function);
+    auto def_blocks = find_def_blocks(function);
+    auto consts = find_consts(function);
+
+    size_t num_reduced = 0;
+    for(auto& loop : find_loops(domtree))
+    {
+        auto preheader = find_preheader(domtree, loop);
+        if(preheader == nullptr)
+            continue;
+
+        const auto is_invariant = [&](IRValue value) {
+            return !loop.contains[def_blocks[value]->get_id()];
+        };
+
+        const auto find_def = [&](IRValue value) -> IRInst* {
+            auto block = def_blocks[value];
+            auto it = std::find_if(block->begin(), block->end(),
+                                   [&](const IRInst& inst) { return inst.dest == value; });
+            return &*it;
+        };
+
+        // The phis stepped by a constant, from the same value on every back edge.
+        std::vector<InductionVar> ivs;
+        for(auto& phi : *loop.header)
+        {
+            if(phi.op != IROp::Phi)
+                break;
+
+            InductionVar iv{phi.dest, ir_no_value, ir_no_value, 0};
+            bool is_iv = true;
+            for(size_t i = 0; i < phi.args.size(); ++i)
+            {
+                auto& value = (phi.incoming[i] == preheader ? iv.init : iv.next);
+                is_iv = is_iv && (value == ir_no_value || value == phi.args[i]);
+                value = phi.args[i];
+            }
+
+            if(!is_iv || iv.next == ir_no_value || iv.init == ir_no_value || is_invariant(iv.next))
+                continue;
+
+            if(auto step = constant_offset(*find_def(iv.next), phi.dest, consts))
+            {
+                iv.step = *step;
+                ivs.push_back(iv);
+            }
+        }
+
+        // Subscripts of an invariant base by an induction variable (plus a
+        // constant) become a pointer stepped along with it, shared by the
+        // subscripts of the same base.
+        struct PointerIV
+        {
+            size_t iv;
+            IRValue base;
+            IRValue phi;
+            IRValue next;
+        };
+
+        std::vector<PointerIV> pointers;
+        std::vector<IRValue> replacement(function.num_values(), ir_no_value);
+        std::vector<std::pair<IRBlock*, std::pair<size_t, IRInst>>> insertions;
+
+        for(auto block : loop.blocks)
+        {
+            for(size_t pos = 0; pos < block->size(); ++pos)
+            {
+                auto& inst = *(block->begin() + pos);
+                if(inst.op != IROp::ElemAddr || !is_invariant(inst.args[0]))
+                    continue;
+
+                size_t iv_index = 0;
+                std::optional<int32_t> offset;
+                for(; iv_index < ivs.size() && !offset; ++iv_index)
+                {
+                    if(inst.args[1] == ivs[iv_index].phi)
+                        offset = 0;
+                    else if(!is_invariant(inst.args[1]))
+                        offset = constant_offset(*find_def(inst.args[1]), ivs[iv_index].phi, consts);
+                }
+                if(!offset)
+                    continue;
+                --iv_index;
+
+                auto pointer = std::find_if(pointers.begin(), pointers.end(), [&](const PointerIV& other) {
+                    return other.iv == iv_index && other.base == inst.args[0];
+                });
+                if(pointer == pointers.end())
+                {
+                    if(pointers.size() == max_pointer_ivs)
+                        continue;
+                    pointer = pointers.insert(pointers.end(), PointerIV{iv_index, inst.args[0],
+                                                                        function.new_value(IRType::Ptr),
+                                                                        function.new_value(IRType::Ptr)});
+                }
+
+                if(*offset == 0)
+                {
+                    replacement.resize(function.num_values(), ir_no_value);
+                    replacement[inst.dest] = pointer->phi;
+                    continue;
+                }
+
+                IRInst step(IROp::Const);
+                step.imm = 4 * *offset;
+                step.dest = function.new_value(IRType::I32);
+                inst.op = IROp::Add;
+                inst.args = {pointer->phi, step.dest};
+                insertions.emplace_back(block, std::make_pair(pos, std::move(step)));
+            }
+        }
+
+        if(pointers.empty())
+            continue;
+
+        for(auto& pointer : pointers)
+        {
+            const auto& iv = ivs[pointer.iv];
+
+            IRInst init(IROp::ElemAddr);
+            init.dest = function.new_value(IRType::Ptr);
+            init.args = {pointer.base, iv.init};
+
+            IRInst phi(IROp::Phi);
+            phi.dest = pointer.phi;
+            auto& iv_phi = *find_def(iv.phi);
+            phi.incoming = iv_phi.incoming;
+            for(auto pred : phi.incoming)
+                phi.args.push_back(pred == preheader ? init.dest : pointer.next);
+
+            IRInst step(IROp::Const);
+            step.imm = 4 * iv.step;
+            step.dest = function.new_value(IRType::I32);
+
+            IRInst next(IROp::Add);
+            next.dest = pointer.next;
+            next.args = {pointer.phi, step.dest};
+
+            auto next_block = def_blocks[iv.next];
+            const auto next_pos = static_cast<size_t>(find_def(iv.next) - &*next_block->begin()) + 1;
+            insertions.emplace_back(preheader, std::make_pair(end_position(*preheader), std::move(init)));
+            insertions.emplace_back(loop.header, std::make_pair(0, std::move(phi)));
+            insertions.emplace_back(next_block, std::make_pair(next_pos, std::move(next)));
+            insertions.emplace_back(next_block, std::make_pair(next_pos, std::move(step)));
+        }
+
+        // Insert from the bottom of each block, so positions stay valid.
+        std::stable_sort(insertions.begin(), insertions.end(), [](const auto& a, const auto& b) {
+            return a.second.first > b.second.first;
+        });
+        def_blocks.resize(function.num_values(), nullptr);
+        for(auto& [block, insertion] : insertions)
+        {
+            auto& [pos, inst] = insertion;
+            def_blocks[inst.dest] = block;
+            if(inst.op == IROp::Const)
+                consts.emplace(inst.dest, inst.imm);
+            block->insert(pos, std::move(inst));
+        }
+
+        for(auto block : loop.blocks)
+        {
+            block->remove_if([&](const IRInst& inst) {
+                return inst.dest != ir_no_value && static_cast<size_t>(inst.dest) < replacement.size()
+                       && replacement[inst.dest] != ir_no_value;
+            });
+        }
+        replace_uses(function, replacement);
+        num_reduced += pointers.size();
+    }
+
+    remove_unused_consts(function);
+    return num_reduced;
+}
+}
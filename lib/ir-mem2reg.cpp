@@ -0,0 +1,335 @@
+#include <cminus/ir-analysis.hpp>
+#include <cminus/ir-passes.hpp>
+#include <unordered_map>
+
+namespace
+{
+using namespace cminus;
+
+/// Renames the loads and stores of promoted slots into values, walking the
+/// dominator tree so that the definition of a slot reaching each point is
+/// on the top of its stack.
+class SlotRenamer
+{
+public:
+    explicit SlotRenamer(const DominatorTree& domtree,
+                         const std::vector<IRSlot*>& addr_slots,
+                         const std::vector<bool>& promoted,
+                         const std::unordered_map<IRValue, IRSlot*>& phi_slots,
+                         std::vector<IRValue>& out_replacement) :
+        domtree(domtree),
+        addr_slots(addr_slots),
+        promoted(promoted),
+        phi_slots(phi_slots),
+        replacement(out_replacement),
+        defs(promoted.size())
+    {
+    }
+
+    /// Sets the definition of a slot on entry of the function.
+    void define_on_entry(IRSlot& slot, IRValue value)
+    {
+        this->defs[slot.id].push_back(value);
+    }
+
+    void rename(IRBlock& block)
+    {
+        std::vector<int32_t> pushed;
+        for(auto& inst : block)
+        {
+            if(inst.op == IROp::Phi)
+            {
+                if(auto it = phi_slots.find(inst.dest); it != phi_slots.end())
+                {
+                    this->defs[it->second->id].push_back(inst.dest);
+                    pushed.push_back(it->second->id);
+                }
+                continue;
+            }
+
+            for(auto& arg : inst.args)
+                arg = resolve(arg);
+
+            if(auto slot = promoted_slot_of_address(inst))
+            {
+                if(inst.op == IROp::Load)
+                {
+                    this->replacement[inst.dest] = defs[slot->id].back();
+                }
+                else if(inst.op == IROp::Store)
+                {
+                    this->defs[slot->id].push_back(inst.args[1]);
+                    pushed.push_back(slot->id);
+                }
+            }
+        }
+
+        for(auto succ : block.successors())
+        {
+            for(auto& inst : *succ)
+            {
+                if(inst.op != IROp::Phi)
+                    break;
+                if(auto it = phi_slots.find(inst.dest); it != phi_slots.end())
+                {
+                    inst.args.push_back(defs[it->second->id].back());
+                    inst.incoming.push_back(&block);
+                }
+            }
+        }
+
+        for(auto child : domtree.get_children(block))
+            rename(*child);
+
+        for(auto slot_id : pushed)
+            this->defs[slot_id].pop_back();
+    }
+
+    /// \returns the promoted slot accessed by a load or store or `nullptr`.
+    auto promoted_slot_of_address(const IRInst& inst) const -> IRSlot*
+    {
+        if(inst.op != IROp::Load && inst.op != IROp::Store)
+            return nullptr;
+        auto slot = addr_slots[inst.args[0]];
+        return slot && promoted[slot->id] ? slot : nullptr;
+    }
+
+    /// \returns the value replacing another.
+    auto resolve(IRValue value) const -> IRValue
+    {
+        while(replacement[value] != ir_no_value)
+            value = replacement[value];
+        return value;
+    }
+
+private:
+    const DominatorTree& domtree;
+    const std::vector<IRSlot*>& addr_slots;
+    const std::vector<bool>& promoted;
+    const std::unordered_map<IRValue, IRSlot*>& phi_slots;
+    std::vector<IRValue>& replacement;
+    std::vector<std::vector<IRValue>> defs;
+};
+
+/// Counts the uses of each value of a function, except by the phis
+/// defining them.
+auto count_uses(IRFunction& function) -> std::vector<size_t>
+{
+    std::vector<size_t> num_uses(function.num_values(), 0);
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            for(auto arg : inst.args)
+            {
+                if(arg != inst.dest)
+                    ++num_uses[arg];
+            }
+        }
+    }
+    return num_uses;
+}
+}
+
+namespace cminus
+{
+auto promote_slots(IRFunction& function) -> size_t
+{
+    const auto num_slots = static_cast<size_t>(std::distance(function.slot_begin(),
+                                                             function.slot_end()));
+
+    // A slot is promoted when its address is only used for loading from it
+    // and storing into it, which is always the case of scalars.
+    std::vector<IRSlot*> addr_slots(function.num_values(), nullptr);
+    std::vector<bool> promoted(num_slots, false);
+    for(auto it = function.slot_begin(); it != function.slot_end(); ++it)
+        promoted[(*it)->id] = ((*it)->size == 4);
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op == IROp::FrameAddr)
+                addr_slots[inst.dest] = inst.slot;
+
+            for(size_t i = 0; i < inst.args.size(); ++i)
+            {
+                auto slot = addr_slots[inst.args[i]];
+                if(slot && !((inst.op == IROp::Load || inst.op == IROp::Store) && i == 0))
+                    promoted[slot->id] = false;
+            }
+        }
+    }
+
+    const auto num_promoted = static_cast<size_t>(std::count(promoted.begin(), promoted.end(), true));
+    if(num_promoted == 0)
+        return 0;
+
+    DominatorTree domtree(function);
+
+    // Place phis on the iterated dominance frontier of the stores.
+    std::unordered_map<IRValue, IRSlot*> phi_slots;
+    std::vector<std::vector<IRBlock*>> def_blocks(num_slots);
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op == IROp::Store)
+            {
+                auto slot = addr_slots[inst.args[0]];
+                if(slot && promoted[slot->id])
+                    def_blocks[slot->id].push_back(it->get());
+            }
+        }
+    }
+
+    std::vector<int32_t> has_phi(function.num_blocks(), -1);
+    std::vector<int32_t> in_worklist(function.num_blocks(), -1);
+    for(auto it = function.slot_begin(); it != function.slot_end(); ++it)
+    {
+        auto& slot = **it;
+        if(!promoted[slot.id])
+            continue;
+
+        auto worklist = def_blocks[slot.id];
+        for(auto block : worklist)
+            in_worklist[block->get_id()] = slot.id;
+
+        while(!worklist.empty())
+        {
+            auto block = worklist.back();
+            worklist.pop_back();
+            for(auto frontier : domtree.get_frontier(*block))
+            {
+                if(has_phi[frontier->get_id()] == slot.id)
+                    continue;
+
+                IRInst phi(IROp::Phi);
+                phi.dest = function.new_value(slot.type);
+                phi_slots[phi.dest] = &slot;
+                frontier->insert(0, std::move(phi));
+                has_phi[frontier->get_id()] = slot.id;
+
+                if(in_worklist[frontier->get_id()] != slot.id)
+                {
+                    in_worklist[frontier->get_id()] = slot.id;
+                    worklist.push_back(frontier);
+                }
+            }
+        }
+    }
+
+    // Values may be replaced by the ones defined by the new instructions.
+    std::vector<IRValue> replacement(function.num_values(), ir_no_value);
+    SlotRenamer renamer(domtree, addr_slots, promoted, phi_slots, replacement);
+
+    // Parameters are received into values, and locals start as zero.
+    auto& entry = function.get_entry();
+    size_t entry_pos = 0;
+    IRValue zero = ir_no_value;
+    for(auto it = function.slot_begin(); it != function.slot_end(); ++it)
+    {
+        auto& slot = **it;
+        if(!promoted[slot.id])
+            continue;
+
+        if(slot.is_param())
+        {
+            IRInst param(IROp::Param);
+            param.dest = function.new_value(slot.type);
+            param.imm = slot.param_index;
+            renamer.define_on_entry(slot, param.dest);
+            entry.insert(entry_pos++, std::move(param));
+        }
+        else
+        {
+            if(zero == ir_no_value)
+            {
+                IRInst constant(IROp::Const);
+                constant.dest = zero = function.new_value(IRType::I32);
+                entry.insert(entry_pos++, std::move(constant));
+            }
+            renamer.define_on_entry(slot, zero);
+        }
+    }
+
+    addr_slots.resize(function.num_values(), nullptr);
+    replacement.resize(function.num_values(), ir_no_value);
+    renamer.rename(entry);
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        (*it)->remove_if([&](const IRInst& inst) {
+            return renamer.promoted_slot_of_address(inst)
+                   || (inst.op == IROp::FrameAddr && promoted[inst.slot->id]);
+        });
+    }
+
+    // Remove the phis merging a single value besides themselves, which may
+    // turn others into such phis.
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(auto it = function.block_begin(); it != function.block_end(); ++it)
+        {
+            for(auto& inst : **it)
+            {
+                if(inst.op != IROp::Phi || replacement[inst.dest] != ir_no_value)
+                    continue;
+
+                IRValue unique = ir_no_value;
+                bool is_trivial = true;
+                for(auto arg : inst.args)
+                {
+                    arg = renamer.resolve(arg);
+                    if(arg == inst.dest || arg == unique)
+                        continue;
+                    if(unique != ir_no_value)
+                        is_trivial = false;
+                    unique = arg;
+                }
+
+                if(is_trivial && unique != ir_no_value)
+                {
+                    replacement[inst.dest] = unique;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        (*it)->remove_if([&](const IRInst& inst) {
+            return inst.op == IROp::Phi && replacement[inst.dest] != ir_no_value;
+        });
+        for(auto& inst : **it)
+        {
+            for(auto& arg : inst.args)
+                arg = renamer.resolve(arg);
+        }
+    }
+
+    // Remove the phis and entry values left unused.
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        auto num_uses = count_uses(function);
+        for(auto it = function.block_begin(); it != function.block_end(); ++it)
+        {
+            (*it)->remove_if([&](const IRInst& inst) {
+                const bool is_new = (inst.op == IROp::Phi || inst.op == IROp::Param
+                                     || (inst.op == IROp::Const && inst.dest == zero));
+                if(is_new && num_uses[inst.dest] == 0)
+                {
+                    changed = true;
+                    return true;
+                }
+                return false;
+            });
+        }
+    }
+
+    return num_promoted;
+}
+}
@@ -0,0 +1,191 @@
+#include <cminus/ir-passes.hpp>
+#include <cminus/mem-report.hpp>
+#include <unordered_map>
+
+namespace cminus
+{
+auto remove_unreachable_blocks(IRFunction& function) -> size_t
+{
+    std::vector<bool> reachable(function.num_blocks(), false);
+    std::vector<IRBlock*> worklist;
+
+    reachable[function.get_entry().get_id()] = true;
+    worklist.push_back(&function.get_entry());
+    while(!worklist.empty())
+    {
+        auto block = worklist.back();
+        worklist.pop_back();
+        for(auto succ : block->successors())
+        {
+            if(!reachable[succ->get_id()])
+            {
+                reachable[succ->get_id()] = true;
+                worklist.push_back(succ);
+            }
+        }
+    }
+
+    // Phis may no longer be entered from the removed blocks.
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        if(!reachable[(*it)->get_id()])
+            continue;
+
+        for(auto& inst : **it)
+        {
+            if(inst.op != IROp::Phi)
+                break;
+            for(size_t i = inst.args.size(); i-- > 0;)
+            {
+                if(!reachable[inst.incoming[i]->get_id()])
+                {
+                    inst.args.erase(inst.args.begin() + i);
+                    inst.incoming.erase(inst.incoming.begin() + i);
+                }
+            }
+        }
+    }
+
+    const auto num_blocks = function.num_blocks();
+    function.remove_blocks_if([&](const IRBlock& block) {
+        return !reachable[block.get_id()];
+    });
+    return num_blocks - function.num_blocks();
+}
+
+auto rotate_loops(IRFunction& function) -> size_t
+{
+    // Bigger blocks are left alone, since they would grow the code more
+    // than it is worth.
+    constexpr size_t max_copied_size = 16;
+
+    size_t num_rotated = 0;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        if(block.empty() || block.back().op != IROp::Jump)
+            continue;
+
+        auto& header = *block.back().targets[0];
+        if(header.get_id() >= block.get_id() || header.back().op != IROp::Branch
+           || header.size() > max_copied_size)
+            continue;
+
+        std::unordered_map<IRValue, IRValue> renamed;
+        const auto is_local = std::all_of(header.begin(), header.end(), [&](const IRInst& inst) {
+            const auto defined_before = std::all_of(inst.args.begin(), inst.args.end(),
+                                                    [&](IRValue arg) { return renamed.count(arg); });
+            if(inst.dest != ir_no_value)
+                renamed.emplace(inst.dest, ir_no_value);
+            return inst.op != IROp::Phi && defined_before;
+        });
+        if(!is_local)
+            continue;
+
+        block.pop_back();
+        for(auto& inst : header)
+        {
+            IRInst copy = inst;
+            if(copy.dest != ir_no_value)
+                renamed[inst.dest] = copy.dest = function.new_value(function.type_of(inst.dest));
+            for(auto& arg : copy.args)
+                arg = renamed[arg];
+            block.append(std::move(copy));
+        }
+        ++num_rotated;
+    }
+    return num_rotated;
+}
+
+auto remove_dead_values(IRFunction& function) -> size_t
+{
+    std::vector<const IRInst*> defs(function.num_values(), nullptr);
+    std::unordered_map<IRValue, int32_t> consts;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.dest != ir_no_value)
+                defs[inst.dest] = &inst;
+            if(inst.op == IROp::Const)
+                consts.emplace(inst.dest, inst.imm);
+        }
+    }
+
+    // Checks of a constant index pass or fail the same way every time, and
+    // the failing ones are kept.
+    const auto has_effect = [&](const IRInst& inst) {
+        switch(inst.op)
+        {
+            case IROp::Store:
+            case IROp::Call:
+            case IROp::Jump:
+            case IROp::Branch:
+            case IROp::Return:
+                return true;
+            case IROp::Check:
+            {
+                auto it = consts.find(inst.args[0]);
+                return it == consts.end() || it->second < 0;
+            }
+            default:
+                return false;
+        }
+    };
+
+    // Mark the values used by the instructions with an effect, and the ones
+    // used in computing those, and so on.
+    std::vector<bool> live(function.num_values(), false);
+    std::vector<IRValue> worklist;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(has_effect(inst))
+                worklist.insert(worklist.end(), inst.args.begin(), inst.args.end());
+        }
+    }
+    while(!worklist.empty())
+    {
+        const auto value = worklist.back();
+        worklist.pop_back();
+        if(live[value])
+            continue;
+
+        live[value] = true;
+        if(auto def = defs[value])
+            worklist.insert(worklist.end(), def->args.begin(), def->args.end());
+    }
+
+    size_t num_removed = 0;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        const auto size = (*it)->size();
+        (*it)->remove_if([&](const IRInst& inst) {
+            return !has_effect(inst) && (inst.dest == ir_no_value || !live[inst.dest]);
+        });
+        num_removed += size - (*it)->size();
+    }
+    return num_removed;
+}
+
+void optimize_ir(IRModule& module)
+{
+    MemScope mem_scope(MemTag::IR);
+
+    for(auto it = module.function_begin(); it != module.function_end(); ++it)
+    {
+        auto& function = **it;
+        if(function.is_external())
+            continue;
+
+        remove_unreachable_blocks(function);
+        rotate_loops(function);
+        promote_slots(function);
+        number_values(function);
+        hoist_loop_invariants(function);
+        reduce_induction_variables(function);
+        remove_dead_values(function);
+    }
+}
+}
@@ -0,0 +1,385 @@
+#include <cminus/ir-analysis.hpp>
+#include <cminus/ir-regalloc.hpp>
+#include <limits>
+#include <unordered_set>
+
+namespace
+{
+using namespace cminus;
+
+/// Registers available to values not live across calls ($t1-$t9).
+///
+/// $t0, $v0 and $v1 are kept as scratch registers for the code generator.
+constexpr int temp_value_regs[] = {9, 10, 11, 12, 13, 14, 15, 24, 25};
+
+/// Callee-saved registers available to values ($s0-$s7).
+constexpr int saved_value_regs[] = {16, 17, 18, 19, 20, 21, 22, 23};
+
+bool is_saved_reg(int reg)
+{
+    return reg >= 16 && reg <= 23;
+}
+
+/// The points of a function a value is live at.
+struct Interval
+{
+    IRValue value;
+    int32_t start = std::numeric_limits<int32_t>::max();
+    int32_t end = -1;
+    bool crosses_call = false;       //< whether it must survive a call
+    bool rematerializable = false;   //< whether it may be computed again by its uses
+
+    void cover(int32_t pos)
+    {
+        this->start = std::min(start, pos);
+        this->end = std::max(end, pos);
+    }
+};
+
+/// \returns the calls whose result the function returns right after them,
+/// which may jump into their callee instead.
+auto find_tail_calls(IRFunction& function) -> std::unordered_set<const IRInst*>
+{
+    // Local arrays do not outlive the frame, nor may they be shared with a
+    // new activation of the function, thus calls passing them are kept.
+    std::vector<bool> local_addr(function.num_values(), false);
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(auto it = function.block_begin(); it != function.block_end(); ++it)
+        {
+            for(auto& inst : **it)
+            {
+                if(inst.dest == ir_no_value || local_addr[inst.dest])
+                    continue;
+
+                const auto derived = (inst.op == IROp::Phi || inst.op == IROp::ElemAddr
+                                      || inst.op == IROp::Add || inst.op == IROp::Sub);
+                if((inst.op == IROp::FrameAddr && !inst.slot->is_param())
+                   || (derived && std::any_of(inst.args.begin(), inst.args.end(),
+                                              [&](IRValue arg) { return local_addr[arg]; })))
+                {
+                    local_addr[inst.dest] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::unordered_set<const IRInst*> tail_calls;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        if(block.size() < 2)
+            continue;
+
+        auto& retn = *std::prev(block.end());
+        auto& call = *std::prev(block.end(), 2);
+        if(retn.op != IROp::Return || call.op != IROp::Call
+           || (!retn.args.empty() && retn.args[0] != call.dest))
+            continue;
+
+        // Our caller only made room for as many arguments as we take.
+        if(call.callee != &function && call.callee->get_num_params() > 4)
+            continue;
+
+        if(std::none_of(call.args.begin(), call.args.end(),
+                        [&](IRValue arg) { return local_addr[arg]; }))
+            tail_calls.insert(&call);
+    }
+    return tail_calls;
+}
+
+/// Checks whether an operation is computed again by the uses of its result
+/// rather than spilled, when its operands are at hand. Multiplications and
+/// divisions cost more than reloading their result.
+bool is_cheap_binary(IROp op)
+{
+    return op == IROp::Add || op == IROp::Sub || (op >= IROp::Lt && op <= IROp::Ne);
+}
+
+/// \returns the live intervals of the values of a function, indexed by value.
+///
+/// Each block takes a point for its phis, followed by a point for each of
+/// its other instructions. Phi operands are used on the terminator of the
+/// corresponding predecessor, where they are moved into the phi.
+auto compute_intervals(IRFunction& function, const std::unordered_set<const IRInst*>& tail_calls)
+    -> std::vector<Interval>
+{
+    const auto liveness = compute_liveness(function);
+
+    std::vector<Interval> intervals(function.num_values());
+    for(size_t v = 0; v < intervals.size(); ++v)
+        intervals[v].value = static_cast<IRValue>(v);
+
+    std::vector<int32_t> block_start(function.num_blocks());
+    std::vector<int32_t> block_end(function.num_blocks());
+    std::vector<int32_t> call_points;
+
+    int32_t pos = 0;
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        block_start[block.get_id()] = pos++;
+        for(auto& inst : block)
+        {
+            if(inst.op == IROp::Phi)
+            {
+                // Phis of a block are all written at once, thus they must not
+                // share registers with each other.
+                intervals[inst.dest].cover(block_start[block.get_id()]);
+                intervals[inst.dest].cover(block_start[block.get_id()] + 1);
+                continue;
+            }
+
+            for(auto arg : inst.args)
+                intervals[arg].cover(pos);
+            if(inst.dest != ir_no_value)
+            {
+                intervals[inst.dest].cover(pos);
+                intervals[inst.dest].rematerializable = (inst.op == IROp::Const
+                                                         || inst.op == IROp::FrameAddr
+                                                         || inst.op == IROp::GlobalAddr);
+            }
+            if(inst.op == IROp::Call && !tail_calls.count(&inst))
+                call_points.push_back(pos);
+            ++pos;
+        }
+        block_end[block.get_id()] = pos - 1;
+    }
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        const auto id = block.get_id();
+        for(size_t v = 0; v < intervals.size(); ++v)
+        {
+            if(liveness.live_in[id][v])
+                intervals[v].cover(block_start[id]);
+            if(liveness.live_out[id][v])
+                intervals[v].cover(block_end[id]);
+        }
+
+        for(auto& inst : block)
+        {
+            if(inst.op != IROp::Phi)
+                break;
+            for(size_t i = 0; i < inst.args.size(); ++i)
+                intervals[inst.args[i]].cover(block_end[inst.incoming[i]->get_id()]);
+        }
+    }
+
+    for(auto& interval : intervals)
+    {
+        auto call = std::upper_bound(call_points.begin(), call_points.end(), interval.start);
+        interval.crosses_call = (call != call_points.end() && *call < interval.end);
+    }
+
+    // Cheap arithmetic may be computed again wherever its operands are live
+    // throughout its interval. Values moved all at once, into phis or into
+    // the parameters by a self tail call, are left alone, since their moves
+    // do not know which registers computing them reads.
+    std::vector<bool> moved_at_once(function.num_values(), false);
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op == IROp::Phi || (tail_calls.count(&inst) && inst.callee == &function))
+            {
+                for(auto arg : inst.args)
+                    moved_at_once[arg] = true;
+            }
+        }
+    }
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(!is_cheap_binary(inst.op) || moved_at_once[inst.dest])
+                continue;
+
+            auto& interval = intervals[inst.dest];
+            interval.rematerializable = std::all_of(
+                    inst.args.begin(), inst.args.end(), [&](IRValue arg) {
+                        return intervals[arg].start <= interval.start
+                               && intervals[arg].end >= interval.end;
+                    });
+        }
+    }
+
+    return intervals;
+}
+
+/// \returns the values each value is moved from or into by phis, indexed
+/// by value.
+auto compute_phi_related(IRFunction& function) -> std::vector<std::vector<IRValue>>
+{
+    std::vector<std::vector<IRValue>> related(function.num_values());
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op != IROp::Phi)
+                break;
+            for(auto arg : inst.args)
+            {
+                related[inst.dest].push_back(arg);
+                related[arg].push_back(inst.dest);
+            }
+        }
+    }
+    return related;
+}
+}
+
+namespace cminus
+{
+auto allocate_registers(IRFunction& function) -> IRRegisterAssignment
+{
+    IRRegisterAssignment result;
+    result.regs.assign(function.num_values(), -1);
+    result.spill_pos.assign(function.num_values(), -1);
+    result.rematerialized.assign(function.num_values(), false);
+
+    result.tail_calls = find_tail_calls(function);
+    for(auto it = function.block_begin(); it != function.block_end() && !result.has_calls; ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.op == IROp::Call && !result.tail_calls.count(&inst))
+                result.has_calls = true;
+        }
+    }
+
+    auto intervals = compute_intervals(function, result.tail_calls);
+    intervals.erase(std::remove_if(intervals.begin(), intervals.end(),
+                                   [](const Interval& interval) { return interval.end == -1; }),
+                    intervals.end());
+    std::sort(intervals.begin(), intervals.end(), [](const auto& a, const auto& b) {
+        return a.start != b.start ? a.start < b.start : a.value < b.value;
+    });
+
+    std::vector<int> free_temp_regs(std::rbegin(temp_value_regs), std::rend(temp_value_regs));
+    std::vector<int> free_saved_regs(std::rbegin(saved_value_regs), std::rend(saved_value_regs));
+    std::vector<const Interval*> active;
+    std::vector<bool> saved_used(32, false);
+    const auto related = compute_phi_related(function);
+
+    // Takes the register of a value moved from or into this one by a phi,
+    // if it is free, so the move is not needed.
+    const auto take_related_reg = [&](const Interval& interval) {
+        for(auto other : related[interval.value])
+        {
+            const auto reg = result.regs[other];
+            if(reg == -1 || (interval.crosses_call && !is_saved_reg(reg)))
+                continue;
+
+            auto& free_regs = (is_saved_reg(reg) ? free_saved_regs : free_temp_regs);
+            auto it = std::find(free_regs.begin(), free_regs.end(), reg);
+            if(it != free_regs.end())
+            {
+                free_regs.erase(it);
+                return reg;
+            }
+        }
+        return -1;
+    };
+
+    // Constants, addresses and cheap arithmetic are computed again by their
+    // uses rather than kept in the spill area.
+    const auto spill_to_memory = [&](IRValue value) {
+        result.spill_pos[value] = result.spill_size;
+        result.spill_size += 4;
+    };
+    const auto spill = [&](const Interval& interval) {
+        result.regs[interval.value] = -1;
+        if(interval.rematerializable)
+            result.rematerialized[interval.value] = true;
+        else
+            spill_to_memory(interval.value);
+    };
+
+    for(auto& interval : intervals)
+    {
+        // Expire the intervals ending before this one starts, whose registers
+        // become free again.
+        active.erase(std::remove_if(active.begin(), active.end(), [&](const Interval* other) {
+                         if(other->end > interval.start)
+                             return false;
+                         const auto reg = result.regs[other->value];
+                         (is_saved_reg(reg) ? free_saved_regs : free_temp_regs).push_back(reg);
+                         return true;
+                     }),
+                     active.end());
+
+        int reg = take_related_reg(interval);
+        if(reg == -1 && !interval.crosses_call && !free_temp_regs.empty())
+        {
+            reg = free_temp_regs.back();
+            free_temp_regs.pop_back();
+        }
+        else if(reg == -1 && !free_saved_regs.empty())
+        {
+            reg = free_saved_regs.back();
+            free_saved_regs.pop_back();
+        }
+        else if(reg == -1)
+        {
+            // Take the register of the active interval ending last, if it
+            // ends after this one and its register may hold this value. The
+            // ones which are cheap to compute again are taken first.
+            const auto spill_weight = [](const Interval* other) {
+                return std::make_pair(other->rematerializable, other->end);
+            };
+            auto victim = active.end();
+            for(auto it = active.begin(); it != active.end(); ++it)
+            {
+                if(interval.crosses_call && !is_saved_reg(result.regs[(*it)->value]))
+                    continue;
+                if(victim == active.end() || spill_weight(*it) > spill_weight(*victim))
+                    victim = it;
+            }
+
+            if(interval.rematerializable || victim == active.end()
+               || (!(*victim)->rematerializable && (*victim)->end <= interval.end))
+            {
+                spill(interval);
+                continue;
+            }
+
+            reg = result.regs[(*victim)->value];
+            spill(**victim);
+            active.erase(victim);
+        }
+
+        result.regs[interval.value] = reg;
+        if(is_saved_reg(reg))
+            saved_used[reg] = true;
+        active.push_back(&interval);
+    }
+
+    // Arithmetic is only computed again from operands kept in registers,
+    // which were not spilled after it.
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        for(auto& inst : **it)
+        {
+            if(inst.is_binary() && result.rematerialized[inst.dest]
+               && std::any_of(inst.args.begin(), inst.args.end(),
+                              [&](IRValue arg) { return result.regs[arg] == -1; }))
+            {
+                result.rematerialized[inst.dest] = false;
+                spill_to_memory(inst.dest);
+            }
+        }
+    }
+
+    for(auto reg : saved_value_regs)
+    {
+        if(saved_used[reg])
+            result.saved_regs.push_back(reg);
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,215 @@
+#include <cminus/ir.hpp>
+
+namespace
+{
+using namespace cminus;
+
+void print_value(IRValue value, std::string& dest)
+{
+    dest += '%';
+    dest += std::to_string(value);
+}
+
+void print_block_ref(IRBlock& block, std::string& dest)
+{
+    dest += "bb";
+    dest += std::to_string(block.get_id());
+}
+
+void print_slot_ref(IRSlot& slot, std::string& dest)
+{
+    dest += '$';
+    dest += std::to_string(slot.id);
+}
+
+void print_inst(IRFunction& function, IRInst& inst, std::string& dest)
+{
+    dest += "    ";
+    if(inst.dest != ir_no_value)
+    {
+        print_value(inst.dest, dest);
+        dest += (function.type_of(inst.dest) == IRType::Ptr ? ":ptr = " : ":i32 = ");
+    }
+
+    dest += ir_op_name(inst.op);
+
+    switch(inst.op)
+    {
+        case IROp::Const:
+        case IROp::Param:
+            dest += ' ';
+            dest += std::to_string(inst.imm);
+            break;
+        case IROp::FrameAddr:
+            dest += ' ';
+            print_slot_ref(*inst.slot, dest);
+            break;
+        case IROp::GlobalAddr:
+            dest += " @";
+            dest += inst.global->name;
+            break;
+        case IROp::Call:
+            dest += " @";
+            dest += inst.callee->get_name();
+            dest += '(';
+            for(size_t i = 0; i < inst.args.size(); ++i)
+            {
+                if(i != 0)
+                    dest += ", ";
+                print_value(inst.args[i], dest);
+            }
+            dest += ')';
+            break;
+        case IROp::Phi:
+            for(size_t i = 0; i < inst.args.size(); ++i)
+            {
+                dest += (i == 0 ? " [" : ", [");
+                print_value(inst.args[i], dest);
+                dest += ", ";
+                print_block_ref(*inst.incoming[i], dest);
+                dest += ']';
+            }
+            break;
+        default:
+            for(size_t i = 0; i < inst.args.size(); ++i)
+            {
+                dest += (i == 0 ? " " : ", ");
+                print_value(inst.args[i], dest);
+            }
+            break;
+    }
+
+    for(auto target : inst.targets)
+    {
+        if(target)
+        {
+            dest += (inst.args.empty() && target == inst.targets[0] ? " " : ", ");
+            print_block_ref(*target, dest);
+        }
+    }
+
+    dest += '\n';
+}
+
+void print_function(IRFunction& function, std::string& dest)
+{
+    dest += "\nfunction @";
+    dest += function.get_name();
+    dest += '(';
+    dest += std::to_string(function.get_num_params());
+    dest += (function.is_void() ? ") -> void\n" : ") -> i32\n");
+
+    for(auto it = function.slot_begin(); it != function.slot_end(); ++it)
+    {
+        auto& slot = **it;
+        dest += "    slot ";
+        print_slot_ref(slot, dest);
+        dest += ' ';
+        dest += slot.name;
+        if(slot.is_param())
+        {
+            dest += ": param ";
+            dest += std::to_string(slot.param_index);
+        }
+        else
+        {
+            dest += ": ";
+            dest += std::to_string(slot.size);
+            dest += " bytes at ";
+            dest += std::to_string(slot.offset);
+        }
+        dest += '\n';
+    }
+
+    for(auto it = function.block_begin(); it != function.block_end(); ++it)
+    {
+        auto& block = **it;
+        print_block_ref(block, dest);
+        dest += ':';
+        if(block.get_label() != -1)
+        {
+            dest += " ; .L";
+            dest += std::to_string(block.get_label());
+        }
+        dest += '\n';
+
+        for(auto& inst : block)
+            print_inst(function, inst, dest);
+    }
+}
+}
+
+namespace cminus
+{
+auto ir_op_name(IROp op) -> const char*
+{
+    switch(op)
+    {
+        case IROp::Const:
+            return "const";
+        case IROp::Param:
+            return "param";
+        case IROp::FrameAddr:
+            return "frameaddr";
+        case IROp::GlobalAddr:
+            return "globaladdr";
+        case IROp::Load:
+            return "load";
+        case IROp::Store:
+            return "store";
+        case IROp::ElemAddr:
+            return "elemaddr";
+        case IROp::Check:
+            return "check";
+        case IROp::Add:
+            return "add";
+        case IROp::Sub:
+            return "sub";
+        case IROp::Mul:
+            return "mul";
+        case IROp::Div:
+            return "div";
+        case IROp::Lt:
+            return "lt";
+        case IROp::Le:
+            return "le";
+        case IROp::Gt:
+            return "gt";
+        case IROp::Ge:
+            return "ge";
+        case IROp::Eq:
+            return "eq";
+        case IROp::Ne:
+            return "ne";
+        case IROp::Call:
+            return "call";
+        case IROp::Phi:
+            return "phi";
+        case IROp::Jump:
+            return "jmp";
+        case IROp::Branch:
+            return "br";
+        case IROp::Return:
+            return "ret";
+    }
+    return "?";
+}
+
+void print_ir(IRModule& module, std::string& dest)
+{
+    for(auto it = module.global_begin(); it != module.global_end(); ++it)
+    {
+        dest += "global @";
+        dest += (*it)->name;
+        dest += ", ";
+        dest += std::to_string((*it)->size);
+        dest += " bytes\n";
+    }
+
+    for(auto it = module.function_begin(); it != module.function_end(); ++it)
+    {
+        if(!(*it)->is_external())
+            print_function(**it, dest);
+    }
+}
+}
@@ -0,0 +1,307 @@
+#include <atomic>
+#include <cminus/mem-report.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace
+{
+using namespace cminus;
+
+/// Header kept in front of every allocated block.
+///
+/// Its size keeps the block aligned for any fundamental type. Over-aligned
+/// blocks are placed past the start of the allocation, which is `offset`
+/// bytes before the header.
+struct alignas(alignof(std::max_align_t)) AllocHeader
+{
+    size_t size;
+    uint32_t offset;
+    MemTag tag; //< `MemTag::Count` if allocated while not tracking
+};
+
+struct AtomicMemStats
+{
+    std::atomic<size_t> num_allocs{0};
+    std::atomic<size_t> num_frees{0};
+    std::atomic<size_t> bytes_allocated{0};
+    std::atomic<size_t> bytes_live{0};
+    std::atomic<size_t> bytes_peak{0};
+
+    void on_alloc(size_t size)
+    {
+        num_allocs.fetch_add(1, std::memory_order_relaxed);
+        bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+        auto live = size + bytes_live.fetch_add(size, std::memory_order_relaxed);
+        auto peak = bytes_peak.load(std::memory_order_relaxed);
+        while(live > peak
+              && !bytes_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void on_free(size_t size)
+    {
+        num_frees.fetch_add(1, std::memory_order_relaxed);
+        bytes_live.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    auto load() const -> MemStats
+    {
+        MemStats stats;
+        stats.num_allocs = num_allocs.load(std::memory_order_relaxed);
+        stats.num_frees = num_frees.load(std::memory_order_relaxed);
+        stats.bytes_allocated = bytes_allocated.load(std::memory_order_relaxed);
+        stats.bytes_live = bytes_live.load(std::memory_order_relaxed);
+        stats.bytes_peak = bytes_peak.load(std::memory_order_relaxed);
+        return stats;
+    }
+};
+
+// These are zero-initialized before any dynamic initialization takes place,
+// thus it is safe to allocate memory from static constructors.
+AtomicMemStats subsystem_stats[static_cast<size_t>(MemTag::Count)];
+AtomicMemStats total_stats;
+
+thread_local MemTag current_tag = MemTag::Other;
+
+/// Whether allocations are accounted for, which is off by default so that
+/// allocations do not contend on the counters above.
+std::atomic<bool> tracking{false};
+
+auto tag_name(MemTag tag) -> const char*
+{
+    switch(tag)
+    {
+        case MemTag::Other:
+            return "other";
+        case MemTag::Source:
+            return "source";
+        case MemTag::Diagnostics:
+            return "diagnostics";
+        case MemTag::AST:
+            return "ast";
+        case MemTag::Symbols:
+            return "symbols";
+        case MemTag::IR:
+            return "ir";
+        case MemTag::Codegen:
+            return "codegen";
+        case MemTag::Output:
+            return "output";
+        default:
+            return "?";
+    }
+}
+
+/// Fills the header of a block and accounts for its allocation.
+///
+/// \returns the address of the block past the header.
+void* track_alloc(void* base, AllocHeader* header, size_t size) noexcept
+{
+    header->size = size;
+    header->offset = static_cast<uint32_t>(reinterpret_cast<char*>(header) - static_cast<char*>(base));
+    header->tag = MemTag::Count;
+    if(tracking.load(std::memory_order_relaxed))
+    {
+        header->tag = current_tag;
+        subsystem_stats[static_cast<size_t>(header->tag)].on_alloc(size);
+        total_stats.on_alloc(size);
+    }
+    return header + 1;
+}
+
+void* tracked_alloc(size_t size) noexcept
+{
+    auto base = std::malloc(sizeof(AllocHeader) + size);
+    if(base == nullptr)
+        return nullptr;
+    return track_alloc(base, static_cast<AllocHeader*>(base), size);
+}
+
+void* tracked_alloc(size_t size, std::align_val_t alignment) noexcept
+{
+    const auto align = static_cast<size_t>(alignment);
+    if(align <= alignof(AllocHeader))
+        return tracked_alloc(size);
+
+    auto base = std::malloc(sizeof(AllocHeader) + align + size);
+    if(base == nullptr)
+        return nullptr;
+
+    const auto past_header = reinterpret_cast<uintptr_t>(base) + sizeof(AllocHeader);
+    const auto aligned = (past_header + align - 1) & ~(uintptr_t(align) - 1);
+    return track_alloc(base, reinterpret_cast<AllocHeader*>(aligned) - 1, size);
+}
+
+void tracked_free(void* ptr) noexcept
+{
+    if(ptr == nullptr)
+        return;
+
+    auto header = static_cast<AllocHeader*>(ptr) - 1;
+    if(header->tag != MemTag::Count)
+    {
+        subsystem_stats[static_cast<size_t>(header->tag)].on_free(header->size);
+        total_stats.on_free(header->size);
+    }
+    std::free(reinterpret_cast<char*>(header) - header->offset);
+}
+
+template<typename... Align>
+void* tracked_new(size_t size, Align... alignment)
+{
+    if(auto ptr = tracked_alloc(size ? size : 1, alignment...))
+        return ptr;
+    throw std::bad_alloc();
+}
+}
+
+void* operator new(size_t size)
+{
+    return tracked_new(size);
+}
+
+void* operator new[](size_t size)
+{
+    return tracked_new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return tracked_alloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return tracked_alloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    tracked_free(ptr);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return tracked_new(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return tracked_new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return tracked_alloc(size ? size : 1, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return tracked_alloc(size ? size : 1, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    tracked_free(ptr);
+}
+
+namespace cminus
+{
+void enable_mem_tracking()
+{
+    tracking.store(true, std::memory_order_relaxed);
+}
+
+MemScope::MemScope(MemTag tag) :
+    prev_tag(std::exchange(current_tag, tag))
+{
+}
+
+MemScope::~MemScope()
+{
+    current_tag = prev_tag;
+}
+
+auto mem_stats(MemTag tag) -> MemStats
+{
+    return subsystem_stats[static_cast<size_t>(tag)].load();
+}
+
+auto mem_stats_total() -> MemStats
+{
+    return total_stats.load();
+}
+
+void mem_report(std::FILE* stream)
+{
+    auto print_row = [&](const char* name, const MemStats& stats) {
+        std::fprintf(stream, "%-12s %10zu %10zu %14zu %14zu %14zu\n",
+                     name, stats.num_allocs, stats.num_frees,
+                     stats.bytes_allocated, stats.bytes_live, stats.bytes_peak);
+    };
+
+    std::fprintf(stream, "%-12s %10s %10s %14s %14s %14s\n",
+                 "subsystem", "allocs", "frees", "bytes", "live bytes", "peak bytes");
+
+    for(size_t i = 0; i < static_cast<size_t>(MemTag::Count); ++i)
+    {
+        auto tag = static_cast<MemTag>(i);
+        print_row(tag_name(tag), mem_stats(tag));
+    }
+
+    print_row("total", mem_stats_total());
+}
+}
@@ -0,0 +1,222 @@
+#include <cminus/mips-arith.hpp>
+
+namespace
+{
+constexpr auto REG_0 = 0;
+constexpr auto REG_T0 = 8;
+
+/// Constants for dividing by an integer with a multiplication.
+struct DivMagic
+{
+    int32_t multiplier;
+    int32_t shift;
+};
+
+/// \returns the constants for the signed division by `divisor`, which must
+/// not be `-1`, `0` nor `1`.
+///
+/// The quotient is the high word of the product of the dividend and the
+/// multiplier, corrected by the dividend when the signs of the divisor and
+/// the multiplier differ, and arithmetically shifted to the right by the
+/// shift. Adding one to negative results rounds them towards zero.
+///
+/// See Hacker's Delight (2nd ed.), section 10-4.
+auto signed_div_magic(int32_t divisor) -> DivMagic
+{
+    const uint32_t two31 = 0x80000000u;
+    const uint32_t d = static_cast<uint32_t>(divisor);
+    const uint32_t ad = (divisor < 0 ? 0u - d : d);
+    const uint32_t t = two31 + (d >> 31);
+    const uint32_t anc = t - 1 - t % ad; // absolute value of nc
+
+    int32_t p = 31;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc; // 2^p / |nc|
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;   // 2^p / |d|
+    uint32_t delta;
+    do
+    {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if(r1 >= anc)
+        {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if(r2 >= ad)
+        {
+            ++q2;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while(q1 < delta || (q1 == delta && r1 == 0));
+
+    const uint32_t multiplier = q2 + 1;
+    return DivMagic{static_cast<int32_t>(divisor < 0 ? 0u - multiplier : multiplier), p - 32};
+}
+
+/// Checks whether a value is a power of two.
+bool is_power_of_two(uint64_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+/// \returns the base two logarithm of a power of two.
+int32_t log2_of(uint64_t value)
+{
+    int32_t result = 0;
+    while(value >>= 1)
+        ++result;
+    return result;
+}
+
+auto regname(int reg) -> const char*
+{
+    static constexpr const char* names[] = {
+        "0", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+        "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+        "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+        "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+    };
+    return names[reg];
+}
+
+void emit_reg_op(std::string& dest, const char* mnemonic, int rd, int rs, int rt)
+{
+    dest += mnemonic;
+    dest += " $";
+    dest += regname(rd);
+    dest += ", $";
+    dest += regname(rs);
+    dest += ", $";
+    dest += regname(rt);
+    dest += '\n';
+}
+
+void emit_shift(std::string& dest, const char* mnemonic, int rd, int rs, int32_t amount)
+{
+    dest += mnemonic;
+    dest += " $";
+    dest += regname(rd);
+    dest += ", $";
+    dest += regname(rs);
+    dest += ", ";
+    dest += std::to_string(amount);
+    dest += '\n';
+}
+}
+
+namespace cminus
+{
+bool emit_multiply_by(std::string& dest, int rd, int rs, int32_t factor)
+{
+    // The product of the magnitude is negated afterwards. This is fine even
+    // for the most negative factor, as it all wraps around.
+    const uint32_t factor_bits = static_cast<uint32_t>(factor);
+    const uint64_t magnitude = (factor < 0 ? 0u - factor_bits : factor_bits);
+    const uint64_t low_bit = magnitude & (~magnitude + 1);
+
+    if(magnitude == 0)
+    {
+        dest += "li $";
+        dest += regname(rd);
+        dest += ", 0\n";
+        return true;
+    }
+    else if(is_power_of_two(magnitude))
+    {
+        // x * 2^a => x << a
+        const auto a = log2_of(magnitude);
+        if(a != 0)
+            emit_shift(dest, "sll", rd, rs, a);
+        else if(rs != rd)
+            emit_reg_op(dest, "addu", rd, rs, REG_0);
+    }
+    else if(is_power_of_two(magnitude - low_bit) || is_power_of_two(magnitude + low_bit))
+    {
+        // x * (2^a + 2^b) => (x << a) + (x << b)
+        // x * (2^a - 2^b) => (x << a) - (x << b)
+        const auto is_sum = is_power_of_two(magnitude - low_bit);
+        const auto a = log2_of(is_sum ? magnitude - low_bit : magnitude + low_bit);
+        const auto b = log2_of(low_bit);
+
+        emit_shift(dest, "sll", REG_T0, rs, a);
+        auto low_reg = rs;
+        if(b != 0)
+        {
+            emit_shift(dest, "sll", rd, rs, b);
+            low_reg = rd;
+        }
+        emit_reg_op(dest, is_sum ? "addu" : "subu", rd, REG_T0, low_reg);
+    }
+    else
+    {
+        return false;
+    }
+
+    if(factor < 0)
+        emit_reg_op(dest, "subu", rd, REG_0, rd);
+    return true;
+}
+
+bool emit_divide_by(std::string& dest, int rd, int rs, int32_t divisor)
+{
+    const uint32_t divisor_bits = static_cast<uint32_t>(divisor);
+    const uint64_t magnitude = (divisor < 0 ? 0u - divisor_bits : divisor_bits);
+
+    if(divisor == 0)
+    {
+        return false;
+    }
+    else if(magnitude == 1)
+    {
+        emit_reg_op(dest, "addu", rd, rs, REG_0);
+    }
+    else if(is_power_of_two(magnitude))
+    {
+        // Shifting rounds towards negative infinity, thus 2^k - 1 is added
+        // to negative dividends beforehand.
+        const auto k = log2_of(magnitude);
+        if(k == 1)
+        {
+            emit_shift(dest, "srl", REG_T0, rs, 31);
+        }
+        else
+        {
+            emit_shift(dest, "sra", REG_T0, rs, 31);
+            emit_shift(dest, "srl", REG_T0, REG_T0, 32 - k);
+        }
+        emit_reg_op(dest, "addu", REG_T0, rs, REG_T0);
+        emit_shift(dest, "sra", rd, REG_T0, k);
+    }
+    else
+    {
+        const auto magic = signed_div_magic(divisor);
+
+        dest += "li $t0, ";
+        dest += std::to_string(magic.multiplier);
+        dest += "\nmult $";
+        dest += regname(rs);
+        dest += ", $t0\n";
+        dest += "mfhi $t0\n";
+
+        if(divisor > 0 && magic.multiplier < 0)
+            emit_reg_op(dest, "addu", REG_T0, REG_T0, rs);
+        else if(divisor < 0 && magic.multiplier > 0)
+            emit_reg_op(dest, "subu", REG_T0, REG_T0, rs);
+
+        if(magic.shift != 0)
+            emit_shift(dest, "sra", REG_T0, REG_T0, magic.shift);
+
+        emit_shift(dest, "srl", rd, REG_T0, 31);
+        emit_reg_op(dest, "addu", rd, REG_T0, rd);
+        return true;
+    }
+
+    if(divisor < 0)
+        emit_reg_op(dest, "subu", rd, REG_0, rd);
+    return true;
+}
+}
@@ -0,0 +1,890 @@
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cminus/mips-peephole.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+
+namespace
+{
+using namespace cminus;
+
+/// A rewrite of a sequence of consecutive lines.
+///
+/// Patterns are written as assembly code. An operand `%N` matches any
+/// operand, which must be the same wherever `%N` appears in the rule, and a
+/// line `%N:` matches a label in the same way. The mnemonic `%op` matches
+/// any instruction computing its first operand from the others with no
+/// other effect (see `OpForm::Compute`).
+struct PeepholeRule
+{
+    const char* name;
+    std::vector<const char*> pattern;
+    std::vector<const char*> replacement;
+
+    /// Operands naming registers which must be dead after the pattern,
+    /// since the replacement does not define them.
+    std::vector<int> dead = {};
+
+    /// Pairs of operands of which the first must not read the register
+    /// named by the second.
+    std::vector<std::pair<int, int>> not_reading = {};
+
+    /// An operand which must be a signed immediate of 16 bits, if not -1.
+    int imm16 = -1;
+};
+
+// clang-format off
+const PeepholeRule peephole_rules[] = {
+    // A value reloaded from where it was just stored.
+    {"store-reload", {"sw %0, %1", "lw %0, %1"}, {"sw %0, %1"}},
+    {"store-reload", {"sw %0, %1", "lw %2, %1"}, {"sw %0, %1", "move %2, %0"}},
+
+    // Control reaches the target anyway.
+    {"jump-to-next", {"j %0", "%0:"}, {"%0:"}},
+    {"jump-to-next", {"j %0", "%1:", "%0:"}, {"%1:", "%0:"}},
+    {"jump-to-next", {"beq %0, %1, %2", "%2:"}, {"%2:"}},
+    {"jump-to-next", {"bne %0, %1, %2", "%2:"}, {"%2:"}},
+
+    // Control never reaches a jump right after another.
+    {"unreachable", {"j %0", "j %1"}, {"j %0"}},
+    {"unreachable", {"jr %0", "j %1"}, {"jr %0"}},
+
+    // Moves spelled as additions, which the rules below understand.
+    {"add-zero", {"add %0, %1, $0"}, {"move %0, %1"}},
+    {"self-move", {"move %0, %0"}, {}},
+
+    // A value never read.
+    {"dead-def", {"%op %0"}, {}, {0}},
+    {"dead-def", {"%op %0, %1"}, {}, {0}},
+    {"dead-def", {"%op %0, %1, %2"}, {}, {0}},
+
+    // A value computed into a register only to be moved into another.
+    {"forward-def", {"%op %0", "move %1, %0"}, {"%op %1"}, {0}},
+    {"forward-def", {"%op %0, %1", "move %2, %0"}, {"%op %2, %1"}, {0}},
+    {"forward-def", {"%op %0, %1, %2", "move %3, %0"}, {"%op %3, %1, %2"}, {0}},
+
+    // A register copied only to be read by the next instruction.
+    {"copy-propagation", {"move %0, %1", "%op %0, %0, %2"}, {"%op %0, %1, %2"}, {}, {{2, 0}}},
+    {"copy-propagation", {"move %0, %1", "%op %0, %2, %0"}, {"%op %0, %2, %1"}, {}, {{2, 0}}},
+    {"copy-propagation", {"move %0, %1", "%op %2, %0, %3"}, {"%op %2, %1, %3"}, {0}, {{3, 0}}},
+    {"copy-propagation", {"move %0, %1", "%op %2, %3, %0"}, {"%op %2, %3, %1"}, {0}, {{3, 0}}},
+    {"copy-propagation", {"move %0, %1", "%op %2, %0"}, {"%op %2, %1"}, {0}},
+    {"copy-propagation", {"move %0, %1", "sw %0, %2"}, {"sw %1, %2"}, {0}, {{2, 0}}},
+    {"copy-propagation", {"move %0, %1", "beq %0, %2, %3"}, {"beq %1, %2, %3"}, {0}, {{2, 0}}},
+    {"copy-propagation", {"move %0, %1", "bne %0, %2, %3"}, {"bne %1, %2, %3"}, {0}, {{2, 0}}},
+    {"copy-propagation", {"move %0, %1", "beq %2, %0, %3"}, {"beq %2, %1, %3"}, {0}, {{2, 0}}},
+    {"copy-propagation", {"move %0, %1", "bne %2, %0, %3"}, {"bne %2, %1, %3"}, {0}, {{2, 0}}},
+
+    // A constant loaded only to be an operand which could be immediate.
+    {"immediate-operand", {"li %0, %1", "addu %2, %3, %0"}, {"addiu %2, %3, %1"}, {0}, {{3, 0}}, 1},
+    {"immediate-operand", {"li %0, %1", "addu %2, %0, %3"}, {"addiu %2, %3, %1"}, {0}, {{3, 0}}, 1},
+    {"immediate-operand", {"li %0, %1", "slt %2, %3, %0"}, {"slti %2, %3, %1"}, {0}, {{3, 0}}, 1},
+    {"immediate-operand", {"li %0, %1", "addu %0, %2, %0"}, {"addiu %0, %2, %1"}, {}, {{2, 0}}, 1},
+    {"immediate-operand", {"li %0, %1", "addu %0, %0, %2"}, {"addiu %0, %2, %1"}, {}, {{2, 0}}, 1},
+    {"immediate-operand", {"li %0, %1", "slt %0, %2, %0"}, {"slti %0, %2, %1"}, {}, {{2, 0}}, 1},
+};
+// clang-format on
+
+constexpr size_t num_rules = std::size(peephole_rules);
+constexpr size_t max_pattern_size = 3;
+constexpr size_t num_placeholders = 10;
+
+/// How an instruction reads and writes registers and transfers control.
+enum class OpForm
+{
+    Compute,    //< writes its first operand, reads the others
+    Read,       //< reads its operands
+    Branch,     //< reads its operands but the last, a label it may jump to
+    BranchLink, //< like a branch, but also writes $ra
+    Jump,       //< jumps to the label in its operand
+    Call,       //< calls the function in its operand
+    Return,     //< jumps to the address in its operand
+};
+
+struct OpInfo
+{
+    std::string_view mnemonic;
+    OpForm form;
+};
+
+// clang-format off
+constexpr OpInfo op_infos[] = {
+    {"li", OpForm::Compute}, {"la", OpForm::Compute}, {"lui", OpForm::Compute},
+    {"move", OpForm::Compute}, {"lw", OpForm::Compute},
+    {"add", OpForm::Compute}, {"addu", OpForm::Compute}, {"addiu", OpForm::Compute},
+    {"sub", OpForm::Compute}, {"subu", OpForm::Compute},
+    {"and", OpForm::Compute}, {"andi", OpForm::Compute}, {"or", OpForm::Compute},
+    {"ori", OpForm::Compute}, {"xor", OpForm::Compute}, {"xori", OpForm::Compute},
+    {"nor", OpForm::Compute},
+    {"slt", OpForm::Compute}, {"slti", OpForm::Compute},
+    {"sltu", OpForm::Compute}, {"sltiu", OpForm::Compute},
+    {"sll", OpForm::Compute}, {"srl", OpForm::Compute}, {"sra", OpForm::Compute},
+    {"sllv", OpForm::Compute}, {"srlv", OpForm::Compute}, {"srav", OpForm::Compute},
+    {"mflo", OpForm::Compute}, {"mfhi", OpForm::Compute},
+    {"sw", OpForm::Read}, {"mult", OpForm::Read}, {"multu", OpForm::Read},
+    {"div", OpForm::Read}, {"divu", OpForm::Read},
+    {"beq", OpForm::Branch}, {"bne", OpForm::Branch},
+    {"bltz", OpForm::Branch}, {"bgez", OpForm::Branch},
+    {"blez", OpForm::Branch}, {"bgtz", OpForm::Branch},
+    {"bltzal", OpForm::BranchLink}, {"bgezal", OpForm::BranchLink},
+    {"j", OpForm::Jump}, {"jal", OpForm::Call}, {"jr", OpForm::Return},
+};
+// clang-format on
+
+auto find_op(std::string_view mnemonic) -> const OpInfo*
+{
+    auto it = std::find_if(std::begin(op_infos), std::end(op_infos),
+                           [&](const OpInfo& info) { return info.mnemonic == mnemonic; });
+    return it != std::end(op_infos) ? it : nullptr;
+}
+
+constexpr uint32_t reg_bit(int reg)
+{
+    return uint32_t(1) << reg;
+}
+
+constexpr uint32_t all_regs = ~uint32_t(0);
+constexpr uint32_t arg_regs = 0x000000f0;   // $a0-$a3
+constexpr uint32_t saved_regs = 0x00ff0000; // $s0-$s7
+
+/// Registers read by the caller once a function returns.
+constexpr uint32_t return_regs = reg_bit(2) | reg_bit(3) | saved_regs
+                                 | reg_bit(28) | reg_bit(29) | reg_bit(30) | reg_bit(31);
+
+/// \returns the number of the register named by an operand or -1.
+int reg_number(std::string_view operand)
+{
+    static constexpr std::string_view names[] = {
+        "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+        "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+        "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+        "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+    };
+
+    if(operand.size() < 2 || operand[0] != '$')
+        return -1;
+
+    operand.remove_prefix(1);
+    if(std::all_of(operand.begin(), operand.end(), [](char c) { return std::isdigit(c); }))
+    {
+        const auto reg = std::atoi(std::string(operand).c_str());
+        return reg < 32 ? reg : -1;
+    }
+
+    auto it = std::find(std::begin(names), std::end(names), operand);
+    return it != std::end(names) ? static_cast<int>(it - std::begin(names)) : -1;
+}
+
+/// \returns the registers read by an operand, which is a register or the
+/// base of an address.
+auto regs_read_by(std::string_view operand) -> uint32_t
+{
+    if(auto open = operand.find('('); open != std::string_view::npos)
+        operand = operand.substr(open + 1, operand.find(')') - open - 1);
+    const auto reg = reg_number(operand);
+    return reg > 0 ? reg_bit(reg) : 0;
+}
+
+bool is_local_label(std::string_view name)
+{
+    return name.size() >= 2 && name[0] == '.' && name[1] == 'L';
+}
+
+/// How a line reads and writes registers and transfers control.
+struct LineFlow
+{
+    uint32_t use = 0;
+    uint32_t def = 0;
+    bool falls_through = true;
+    size_t target = SIZE_MAX;  //< line of the label it may jump to
+    uint32_t exit_use = 0;     //< registers read by leaving the function
+};
+
+/// \returns the registers live after each line of a function.
+auto compute_liveness(const std::vector<MipsLine>& lines) -> std::vector<uint32_t>
+{
+    const auto num_lines = lines.size();
+
+    std::unordered_map<std::string_view, size_t> labels;
+    for(size_t i = 0; i < num_lines; ++i)
+    {
+        if(lines[i].kind == MipsLine::Kind::Label)
+            labels.emplace(lines[i].text, i);
+    }
+
+    // Jumps out of the function are assumed to be tail calls, unless into
+    // a local label, which could mean anything.
+    const auto set_target = [&](LineFlow& flow, std::string_view label) {
+        if(auto it = labels.find(label); it != labels.end())
+            flow.target = it->second;
+        else
+            flow.exit_use = is_local_label(label) ? all_regs : return_regs | arg_regs;
+    };
+
+    std::vector<LineFlow> flows(num_lines);
+    for(size_t i = 0; i < num_lines; ++i)
+    {
+        auto& line = lines[i];
+        auto& flow = flows[i];
+        if(line.kind == MipsLine::Kind::Label)
+            continue;
+
+        const auto info = find_op(line.text);
+        if(line.kind != MipsLine::Kind::Instruction || !info)
+        {
+            flow.use = all_regs;
+            continue;
+        }
+
+        const auto& ops = line.operands;
+        switch(info->form)
+        {
+            case OpForm::Compute:
+                if(!ops.empty() && reg_number(ops[0]) > 0)
+                    flow.def = reg_bit(reg_number(ops[0]));
+                for(size_t k = 1; k < ops.size(); ++k)
+                    flow.use |= regs_read_by(ops[k]);
+                break;
+            case OpForm::Read:
+                for(auto& op : ops)
+                    flow.use |= regs_read_by(op);
+                break;
+            case OpForm::Branch:
+            case OpForm::BranchLink:
+                for(size_t k = 0; k + 1 < ops.size(); ++k)
+                    flow.use |= regs_read_by(ops[k]);
+                if(info->form == OpForm::BranchLink)
+                    flow.def = reg_bit(31);
+                if(!ops.empty())
+                    set_target(flow, ops.back());
+                break;
+            case OpForm::Jump:
+                flow.falls_through = false;
+                if(!ops.empty())
+                    set_target(flow, ops.back());
+                break;
+            case OpForm::Call:
+                // Registers the callee may clobber but does not define are
+                // kept live, since the callee may be made by hand.
+                flow.use = arg_regs | reg_bit(28) | reg_bit(29);
+                flow.def = reg_bit(2) | reg_bit(31);
+                break;
+            case OpForm::Return:
+                flow.falls_through = false;
+                for(auto& op : ops)
+                    flow.use |= regs_read_by(op);
+                flow.exit_use = return_regs;
+                break;
+        }
+    }
+
+    std::vector<uint32_t> live_in(num_lines, 0);
+    std::vector<uint32_t> live_out(num_lines, 0);
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(size_t i = num_lines; i-- > 0;)
+        {
+            const auto& flow = flows[i];
+            auto out = flow.exit_use;
+            if(flow.falls_through)
+                out |= (i + 1 < num_lines ? live_in[i + 1] : all_regs);
+            if(flow.target != SIZE_MAX)
+                out |= live_in[flow.target];
+
+            const auto in = flow.use | (out & ~flow.def);
+            if(in != live_in[i] || out != live_out[i])
+            {
+                live_in[i] = in;
+                live_out[i] = out;
+                changed = true;
+            }
+        }
+    }
+
+    return live_out;
+}
+
+/// The lines of a rule, parsed.
+struct ParsedRule
+{
+    std::vector<MipsLine> pattern;
+    std::vector<MipsLine> replacement;
+};
+
+auto get_parsed_rules() -> const std::vector<ParsedRule>&
+{
+    static const auto parsed_rules = [] {
+        std::vector<ParsedRule> result;
+        for(auto& rule : peephole_rules)
+        {
+            ParsedRule parsed;
+            for(auto line : rule.pattern)
+                parsed.pattern.push_back(parse_mips(line).front());
+            for(auto line : rule.replacement)
+                parsed.replacement.push_back(parse_mips(line).front());
+            assert(parsed.pattern.size() <= max_pattern_size);
+            assert(parsed.replacement.size() <= parsed.pattern.size());
+            result.push_back(std::move(parsed));
+        }
+        return result;
+    }();
+    return parsed_rules;
+}
+
+/// What the placeholders of a rule matched.
+struct Bindings
+{
+    std::optional<std::string_view> operands[num_placeholders];
+    std::optional<std::string_view> mnemonic;
+
+    static int placeholder_index(std::string_view text)
+    {
+        if(text.size() == 2 && text[0] == '%' && std::isdigit(text[1]))
+            return text[1] - '0';
+        return -1;
+    }
+
+    bool bind(std::string_view pattern, std::string_view value)
+    {
+        const auto index = placeholder_index(pattern);
+        if(index == -1)
+            return pattern == value;
+        if(!operands[index])
+            this->operands[index] = value;
+        return *operands[index] == value;
+    }
+
+    auto substitute(std::string_view text) const -> std::string
+    {
+        if(text == "%op")
+            return std::string(*mnemonic);
+        const auto index = placeholder_index(text);
+        return std::string(index == -1 ? text : *operands[index]);
+    }
+};
+
+bool match_line(const MipsLine& pattern, const MipsLine& line, Bindings& bindings)
+{
+    if(pattern.kind != line.kind)
+        return false;
+
+    if(pattern.kind == MipsLine::Kind::Label)
+        return bindings.bind(pattern.text, line.text);
+
+    if(pattern.text == "%op")
+    {
+        const auto info = find_op(line.text);
+        if(!info || info->form != OpForm::Compute)
+            return false;
+        if(!bindings.mnemonic)
+            bindings.mnemonic = line.text;
+        if(*bindings.mnemonic != line.text)
+            return false;
+    }
+    else if(pattern.text != line.text)
+    {
+        return false;
+    }
+
+    if(pattern.operands.size() != line.operands.size())
+        return false;
+    for(size_t k = 0; k < pattern.operands.size(); ++k)
+    {
+        if(!bindings.bind(pattern.operands[k], line.operands[k]))
+            return false;
+    }
+    return true;
+}
+
+bool is_imm16(std::string_view text)
+{
+    const auto string = std::string(text);
+    char* end;
+    const auto value = std::strtol(string.c_str(), &end, 10);
+    return !string.empty() && *end == '\0' && value >= -32768 && value <= 32767;
+}
+
+/// \returns the lines replacing the ones at `pos` by a rule or nothing if
+/// the rule does not apply there.
+auto apply_rule(size_t rule_index, const std::vector<MipsLine>& lines, size_t pos, size_t end,
+                uint32_t live_after) -> std::optional<std::vector<MipsLine>>
+{
+    const auto& rule = peephole_rules[rule_index];
+    const auto& parsed = get_parsed_rules()[rule_index];
+    if(pos + parsed.pattern.size() > end)
+        return std::nullopt;
+
+    Bindings bindings;
+    for(size_t k = 0; k < parsed.pattern.size(); ++k)
+    {
+        if(!match_line(parsed.pattern[k], lines[pos + k], bindings))
+            return std::nullopt;
+    }
+
+    for(auto index : rule.dead)
+    {
+        const auto reg = reg_number(*bindings.operands[index]);
+        if(reg == -1 || (live_after & reg_bit(reg)))
+            return std::nullopt;
+    }
+
+    for(auto [reader, index] : rule.not_reading)
+    {
+        const auto reg = reg_number(*bindings.operands[index]);
+        if(reg == -1 || (regs_read_by(*bindings.operands[reader]) & reg_bit(reg)))
+            return std::nullopt;
+    }
+
+    if(rule.imm16 != -1 && !is_imm16(*bindings.operands[rule.imm16]))
+        return std::nullopt;
+
+    std::vector<MipsLine> replacement;
+    for(auto& line : parsed.replacement)
+    {
+        MipsLine& new_line = replacement.emplace_back();
+        new_line.kind = line.kind;
+        new_line.text = bindings.substitute(line.text);
+        for(auto& operand : line.operands)
+            new_line.operands.push_back(bindings.substitute(operand));
+    }
+    return replacement;
+}
+
+auto trim(std::string_view text) -> std::string_view
+{
+    while(!text.empty() && std::isspace(text.front()))
+        text.remove_prefix(1);
+    while(!text.empty() && std::isspace(text.back()))
+        text.remove_suffix(1);
+    return text;
+}
+
+/// \returns whether the assembler turns an instruction into a single
+/// machine instruction, thus it may be placed in a delay slot.
+bool is_single_instruction(const MipsLine& line)
+{
+    static constexpr std::string_view reg_ops[] = {
+        "move", "addu", "subu", "and", "or", "xor", "slt", "sltu", "sll", "srl", "sra",
+    };
+    static constexpr std::string_view imm_ops[] = {
+        "li", "addiu", "slti", "sltiu", "andi", "ori", "xori",
+    };
+
+    const auto& ops = line.operands;
+    if(std::find(std::begin(reg_ops), std::end(reg_ops), line.text) != std::end(reg_ops))
+        return true;
+
+    // Bigger constants need another instruction to load their upper half.
+    if(std::find(std::begin(imm_ops), std::end(imm_ops), line.text) != std::end(imm_ops))
+    {
+        const auto& imm = ops.back();
+        const bool zero_extended = (line.text == "andi" || line.text == "ori" || line.text == "xori");
+        return is_imm16(imm) && !(zero_extended && imm.front() == '-');
+    }
+
+    // Same for addresses given by a label.
+    if(line.text == "lw" || line.text == "sw")
+    {
+        const auto& address = ops.back();
+        const auto open = address.find('(');
+        return open != std::string::npos && (open == 0 || is_imm16(address.substr(0, open)));
+    }
+
+    return false;
+}
+
+/// What a line reads and writes, as far as reordering it is concerned.
+struct LineEffects
+{
+    uint32_t use = 0;
+    uint32_t def = 0;
+    bool loads = false;
+    bool stores = false;
+    bool movable = false;    //< may be moved into a delay slot
+    bool ends_block = false; //< no instruction may be moved across it
+    bool has_slot = false;   //< transfers control after its delay slot
+};
+
+auto effects_of(const MipsLine& line) -> LineEffects
+{
+    LineEffects effects;
+    const auto info = (line.kind == MipsLine::Kind::Instruction ? find_op(line.text) : nullptr);
+    if(!info)
+    {
+        effects.ends_block = true;
+        return effects;
+    }
+
+    // Registers read by the callee or by the caller past a return are not
+    // read by the transfer itself, which happens after its delay slot.
+    const auto& ops = line.operands;
+    switch(info->form)
+    {
+        case OpForm::Compute:
+            if(!ops.empty() && reg_number(ops[0]) > 0)
+                effects.def = reg_bit(reg_number(ops[0]));
+            for(size_t k = 1; k < ops.size(); ++k)
+                effects.use |= regs_read_by(ops[k]);
+            effects.loads = (line.text == "lw");
+            effects.movable = is_single_instruction(line);
+            break;
+        case OpForm::Read:
+            for(auto& op : ops)
+                effects.use |= regs_read_by(op);
+            effects.stores = (line.text == "sw");
+            effects.movable = is_single_instruction(line);
+            break;
+        case OpForm::Branch:
+        case OpForm::BranchLink:
+            for(size_t k = 0; k + 1 < ops.size(); ++k)
+                effects.use |= regs_read_by(ops[k]);
+            if(info->form == OpForm::BranchLink)
+                effects.def = reg_bit(31);
+            effects.ends_block = effects.has_slot = true;
+            break;
+        case OpForm::Jump:
+            effects.ends_block = effects.has_slot = true;
+            break;
+        case OpForm::Call:
+            effects.def = reg_bit(31);
+            effects.ends_block = effects.has_slot = true;
+            break;
+        case OpForm::Return:
+            for(auto& op : ops)
+                effects.use |= regs_read_by(op);
+            effects.ends_block = effects.has_slot = true;
+            break;
+    }
+    return effects;
+}
+
+/// \returns whether two lines may not be swapped.
+bool conflicts(const LineEffects& a, const LineEffects& b)
+{
+    return (a.def & (b.use | b.def)) || (a.use & b.def)
+           || (a.loads && b.stores) || (a.stores && (b.loads || b.stores));
+}
+}
+
+namespace cminus
+{
+auto parse_mips(std::string_view code) -> std::vector<MipsLine>
+{
+    std::vector<MipsLine> lines;
+    while(!code.empty())
+    {
+        const auto eol = code.find('\n');
+        auto text = code.substr(0, eol);
+        code.remove_prefix(eol == std::string_view::npos ? code.size() : eol + 1);
+
+        text = trim(text.substr(0, text.find('#')));
+        while(!text.empty())
+        {
+            const auto word_end = std::min(text.size(), text.find_first_of(" \t"));
+            const auto word = text.substr(0, word_end);
+            if(word.back() == ':')
+            {
+                const auto colon = text.find(':');
+                lines.push_back(MipsLine{MipsLine::Kind::Label, std::string(trim(text.substr(0, colon))), {}});
+                text = trim(text.substr(colon + 1));
+            }
+            else if(word.front() == '.')
+            {
+                lines.push_back(MipsLine{MipsLine::Kind::Directive, std::string(text), {}});
+                break;
+            }
+            else
+            {
+                MipsLine line{MipsLine::Kind::Instruction, std::string(word), {}};
+                for(auto rest = text.substr(word_end); !trim(rest).empty();)
+                {
+                    const auto comma = rest.find(',');
+                    line.operands.emplace_back(trim(rest.substr(0, comma)));
+                    rest.remove_prefix(comma == std::string_view::npos ? rest.size() : comma + 1);
+                }
+                lines.push_back(std::move(line));
+                break;
+            }
+        }
+    }
+    return lines;
+}
+
+void print_mips(const std::vector<MipsLine>& lines, std::string& dest)
+{
+    for(auto& line : lines)
+    {
+        dest += line.text;
+        if(line.kind == MipsLine::Kind::Label)
+            dest += ':';
+        for(size_t k = 0; k < line.operands.size(); ++k)
+        {
+            dest += (k == 0 ? " " : ", ");
+            dest += line.operands[k];
+        }
+        dest += '\n';
+    }
+}
+
+PeepholeOptimizer::PeepholeOptimizer() :
+    rule_hits(num_rules, 0)
+{
+}
+
+void PeepholeOptimizer::optimize(std::string& code)
+{
+    auto lines = parse_mips(code);
+    optimize(lines);
+    code.clear();
+    print_mips(lines, code);
+}
+
+void PeepholeOptimizer::optimize(std::vector<MipsLine>& lines)
+{
+    // Functions start at global labels and end before the next one or
+    // before a directive.
+    const auto is_function_end = [&](size_t i) {
+        return lines[i].kind == MipsLine::Kind::Directive
+               || (lines[i].kind == MipsLine::Kind::Label && !is_local_label(lines[i].text));
+    };
+
+    std::vector<MipsLine> result;
+    result.reserve(lines.size());
+    for(size_t i = 0; i < lines.size();)
+    {
+        if(lines[i].kind != MipsLine::Kind::Label || is_local_label(lines[i].text))
+        {
+            result.push_back(std::move(lines[i++]));
+            continue;
+        }
+
+        auto end = i + 1;
+        while(end < lines.size() && !is_function_end(end))
+            ++end;
+
+        std::vector<MipsLine> function(std::make_move_iterator(lines.begin() + i),
+                                       std::make_move_iterator(lines.begin() + end));
+        optimize_function(function);
+        result.insert(result.end(), std::make_move_iterator(function.begin()),
+                      std::make_move_iterator(function.end()));
+        i = end;
+    }
+
+    lines = std::move(result);
+}
+
+void PeepholeOptimizer::optimize_function(std::vector<MipsLine>& lines)
+{
+    // Each sweep rewrites the lines in place, with the ones done before
+    // `out` and the ones to go from `pos` on. Rules never grow the code, so
+    // the replacement of a pattern always fits before `pos`.
+    //
+    // Liveness is computed once per sweep. Rewrites never make a register
+    // live where it was not, thus what was dead stays dead until the next
+    // sweep, which finds what the stale liveness hid.
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        auto live_out = compute_liveness(lines);
+
+        const auto end = lines.size();
+        size_t out = 0;
+        for(size_t pos = 0; pos < end;)
+        {
+            std::optional<std::vector<MipsLine>> replacement;
+            size_t rule_index = 0;
+            for(; rule_index < num_rules && !replacement; ++rule_index)
+            {
+                const auto pattern_size = get_parsed_rules()[rule_index].pattern.size();
+                const auto last = std::min(pos + pattern_size, end) - 1;
+                replacement = apply_rule(rule_index, lines, pos, end, live_out[last]);
+            }
+
+            if(!replacement)
+            {
+                if(out != pos)
+                {
+                    lines[out] = std::move(lines[pos]);
+                    live_out[out] = live_out[pos];
+                }
+                ++out;
+                ++pos;
+                continue;
+            }
+
+            const auto pattern_size = get_parsed_rules()[rule_index - 1].pattern.size();
+            ++this->rule_hits[rule_index - 1];
+            changed = true;
+
+            // Only the registers live after the last line are known.
+            const auto live_after = live_out[pos + pattern_size - 1];
+            pos += pattern_size;
+            for(auto k = replacement->size(); k-- > 0;)
+            {
+                lines[--pos] = std::move((*replacement)[k]);
+                live_out[pos] = (k + 1 == replacement->size() ? live_after : all_regs);
+            }
+
+            // The rewritten lines may complete a pattern with the ones before.
+            for(size_t k = 0; k + 1 < max_pattern_size && out > 0; ++k)
+            {
+                if(--out != --pos)
+                {
+                    lines[pos] = std::move(lines[out]);
+                    live_out[pos] = live_out[out];
+                }
+            }
+        }
+
+        lines.erase(lines.begin() + out, lines.end());
+    }
+}
+
+auto PeepholeOptimizer::get_stats() const -> std::vector<PeepholeStats>
+{
+    std::vector<PeepholeStats> stats;
+    for(size_t i = 0; i < num_rules; ++i)
+    {
+        const auto& rule = peephole_rules[i];
+        auto it = std::find_if(stats.begin(), stats.end(), [&](const PeepholeStats& other) {
+            return std::string_view(other.rule) == rule.name;
+        });
+        if(it == stats.end())
+            it = stats.insert(stats.end(), PeepholeStats{rule.name});
+
+        it->num_hits += rule_hits[i];
+        it->num_lines_saved += rule_hits[i] * (rule.pattern.size() - rule.replacement.size());
+    }
+    return stats;
+}
+
+void MipsScheduler::schedule(std::string& code)
+{
+    auto lines = parse_mips(code);
+    schedule(lines);
+    code.clear();
+    print_mips(lines, code);
+}
+
+void MipsScheduler::schedule(std::vector<MipsLine>& lines)
+{
+    std::vector<MipsLine> result;
+    result.reserve(lines.size() + lines.size() / 4 + 1);
+    result.push_back(MipsLine{MipsLine::Kind::Directive, ".set noreorder", {}});
+
+    for(size_t i = 0; i < lines.size();)
+    {
+        const auto effects = effects_of(lines[i]);
+        if(effects.ends_block && !effects.has_slot)
+        {
+            result.push_back(std::move(lines[i++]));
+            continue;
+        }
+
+        auto end = i;
+        while(end < lines.size() && !effects_of(lines[end]).ends_block)
+            ++end;
+        const bool has_transfer = (end < lines.size() && effects_of(lines[end]).has_slot);
+        end += has_transfer;
+
+        std::vector<MipsLine> block(std::make_move_iterator(lines.begin() + i),
+                                    std::make_move_iterator(lines.begin() + end));
+        schedule_block(block, has_transfer);
+        result.insert(result.end(), std::make_move_iterator(block.begin()),
+                      std::make_move_iterator(block.end()));
+        i = end;
+    }
+
+    lines = std::move(result);
+}
+
+void MipsScheduler::schedule_block(std::vector<MipsLine>& block, bool has_transfer)
+{
+    std::vector<LineEffects> effects;
+    for(auto& line : block)
+        effects.push_back(effects_of(line));
+
+    const auto num_movable = block.size() - has_transfer;
+
+    // Moving a line out from between a load and its use would stall again.
+    const auto splits_load_use = [&](size_t pos) {
+        return pos > 0 && pos + 1 < block.size() && effects[pos - 1].loads
+               && (effects[pos + 1].use & effects[pos - 1].def);
+    };
+
+    const auto can_cross = [&](size_t pos, size_t first, size_t last) {
+        for(auto other = first; other < last; ++other)
+        {
+            if(conflicts(effects[pos], effects[other]))
+                return false;
+        }
+        return effects[pos].movable && !splits_load_use(pos);
+    };
+
+    const auto move_line = [&](size_t from, size_t to) {
+        if(from < to)
+        {
+            std::rotate(block.begin() + from, block.begin() + from + 1, block.begin() + to + 1);
+            std::rotate(effects.begin() + from, effects.begin() + from + 1, effects.begin() + to + 1);
+        }
+        else
+        {
+            std::rotate(block.begin() + to, block.begin() + from, block.begin() + from + 1);
+            std::rotate(effects.begin() + to, effects.begin() + from, effects.begin() + from + 1);
+        }
+    };
+
+    for(size_t pos = 0; pos + 1 < block.size(); ++pos)
+    {
+        const auto& load = effects[pos];
+        if(!load.loads || !(effects[pos + 1].use & load.def))
+            continue;
+        ++stats.num_load_uses;
+
+        // Prefer a later line not using the loaded register, then one from
+        // before the load.
+        auto filler = SIZE_MAX;
+        for(auto later = pos + 2; later < num_movable && filler == SIZE_MAX; ++later)
+        {
+            if(!(effects[later].use & load.def) && can_cross(later, pos + 1, later))
+                filler = later;
+        }
+        for(auto earlier = pos; earlier-- > 0 && filler == SIZE_MAX;)
+        {
+            const auto stalls = effects[earlier].loads && (effects[pos + 1].use & effects[earlier].def);
+            if(!stalls && can_cross(earlier, earlier + 1, pos + 1))
+                filler = earlier;
+        }
+
+        if(filler == SIZE_MAX)
+            continue;
+
+        ++stats.num_load_uses_split;
+        if(filler > pos)
+            move_line(filler, ++pos);
+        else
+            move_line(filler, pos);
+    }
+
+    if(!has_transfer)
+        return;
+
+    ++stats.num_slots;
+    const auto transfer = block.size() - 1;
+    for(auto pos = transfer; pos-- > 0;)
+    {
+        if(can_cross(pos, pos + 1, transfer + 1))
+        {
+            move_line(pos, transfer);
+            ++stats.num_slots_filled;
+            return;
+        }
+    }
+    block.push_back(MipsLine{MipsLine::Kind::Instruction, "nop", {}});
+}
+}
@@ -1,4 +1,5 @@
 #include <cminus/parser.hpp>
+#include <cminus/utility/thread_pool.hpp>
 
 // This is a recursive descent parser for the C- language. Three words of
 // lookahead are used in order to archieve linear time predictive parsing.
@@ -12,17 +13,158 @@ namespace cminus
 // <declaration-list> ::= <declaration-list> <declaration> | <declaration>
 auto Parser::parse_program() -> std::shared_ptr<ASTProgram>
 {
+    // Anything allocated while parsing is part of the tree, unless
+    // the semantic analyzer says otherwise (e.g. symbol tables).
+    MemScope mem_scope(MemTag::AST);
+
     auto program = sema.act_on_program_start();
     do
     {
         if(auto decl = parse_declaration())
+        {
             sema.act_on_top_level_decl(program, std::move(decl));
+        }
         else
+        {
+            sema.act_on_program_error(*program);
             return nullptr; // TODO how can we recover?
+        }
     } while(peek_word.category != Category::Eof);
     return sema.act_on_program_end(program);
 }
 
+auto Parser::parse_program_parallel(SourceFile& source, DiagnosticManager& diagman)
+        -> std::shared_ptr<ASTProgram>
+{
+    auto parse_sequentially = [&] {
+        Scanner scanner(source, diagman);
+        Semantics sema(source, diagman);
+        Parser parser(scanner, sema, diagman);
+        return parser.parse_program();
+    };
+
+    auto& pool = ThreadPool::shared();
+    if(pool.num_threads() == 1)
+        return parse_sequentially();
+
+    // Scan the whole program up front. Scanner diagnostics would be out
+    // of order with the parser ones, so leave those programs alone.
+    std::vector<Word> words;
+    {
+        MemScope mem_scope(MemTag::Source);
+        DiagnosticBuffer scan_diags;
+        Scanner scanner(source, scan_diags);
+        do
+            words.push_back(scanner.next_word());
+        while(words.back().category != Category::Eof);
+
+        if(scan_diags.size() != 0)
+            return parse_sequentially();
+    }
+
+    // Count the function bodies, making sure every curly brace is matched.
+    size_t num_bodies = 0;
+    size_t depth = 0;
+    for(const auto& word : words)
+    {
+        if(word.category == Category::OpenCurly)
+        {
+            if(depth++ == 0)
+                ++num_bodies;
+        }
+        else if(word.category == Category::CloseCurly)
+        {
+            if(depth == 0)
+                return parse_sequentially();
+            --depth;
+        }
+    }
+
+    if(depth != 0 || num_bodies < min_parallel_bodies)
+        return parse_sequentially();
+
+    MemScope mem_scope(MemTag::AST);
+
+    struct TopLevelDecl
+    {
+        std::shared_ptr<ASTDecl> decl; //< null if it failed to parse
+        ArrayView<const Word> body;    //< empty if not a function
+        size_t diags_end;              //< diagnostics up to the body
+        size_t num_visible_symbols;    //< top-level symbols seen by the body
+    };
+
+    // Parse the top-level declarations and function signatures in order,
+    // skipping the function bodies. The diagnostics are held back so they
+    // can be merged with the ones of the bodies.
+    DiagnosticBuffer top_level_diags;
+    Semantics sema(source, top_level_diags);
+    Parser parser(source, ArrayView<const Word>(words.data(), words.size()),
+                  sema, top_level_diags);
+
+    std::vector<TopLevelDecl> decls;
+    do
+    {
+        auto& top_level = decls.emplace_back();
+        if(parser.lookahead(2).category == Category::OpenParen)
+        {
+            auto fun_decl = parser.parse_fun_signature();
+            if(fun_decl && parser.peek_word.category == Category::OpenCurly)
+            {
+                top_level.body = parser.skip_compound_stmt();
+                top_level.decl = std::move(fun_decl);
+            }
+            else if(fun_decl)
+            {
+                // Diagnose the missing body as `parse_compound_stmt` would.
+                parser.expect_and_consume(Category::OpenCurly);
+            }
+        }
+        else
+        {
+            top_level.decl = parser.parse_var_declaration();
+        }
+
+        top_level.diags_end = top_level_diags.size();
+        top_level.num_visible_symbols = sema.get_symbols().size();
+    } while(decls.back().decl && parser.peek_word.category != Category::Eof);
+
+    // Parse the bodies, each one with its own parser.
+    std::unique_ptr<DiagnosticBuffer[]> body_diags(new DiagnosticBuffer[decls.size()]);
+    pool.parallel_for(decls.size(), [&](size_t i) {
+        auto& top_level = decls[i];
+        if(top_level.body.empty())
+            return;
+
+        MemScope mem_scope(MemTag::AST);
+        Semantics body_sema(sema, top_level.num_visible_symbols, body_diags[i]);
+        Parser body_parser(source, top_level.body, body_sema, body_diags[i]);
+
+        auto fun_decl = std::static_pointer_cast<ASTFunDecl>(top_level.decl);
+        if(!body_parser.parse_fun_body(std::move(fun_decl)))
+            top_level.decl = nullptr;
+        else
+            assert(body_parser.peek_word.category == Category::Eof);
+    });
+
+    // Merge everything in source order, stopping at the first parse error.
+    auto program = sema.act_on_program_start();
+    for(size_t i = 0; i < decls.size(); ++i)
+    {
+        top_level_diags.flush_into(diagman, decls[i].diags_end);
+        body_diags[i].flush_into(diagman);
+        if(!decls[i].decl)
+        {
+            sema.act_on_program_error(*program);
+            return nullptr; // TODO how can we recover?
+        }
+        sema.act_on_top_level_decl(program, std::move(decls[i].decl));
+    }
+
+    program = sema.act_on_program_end(std::move(program));
+    top_level_diags.flush_into(diagman);
+    return program;
+}
+
 // <declaration> ::= <var-declaration> | <fun-declaration>
 auto Parser::parse_declaration() -> std::shared_ptr<ASTDecl>
 {
@@ -75,16 +217,40 @@ auto Parser::expect_and_consume_type() -> std::optional<Word>
     }
     else
     {
-        diagman.report(scanner.get_source(), peek_word.location(),
+        diagman.report(source, peek_word.location(),
                        Diag::parser_expected_type);
         return std::nullopt;
     }
 }
 
 // <fun-declaration> ::= <type-specifier> ID ( <params> ) <compound-stmt>
-// <params> ::= <param-list> | void
-// <param-list> ::= <param-list> , <param> | <param>
 auto Parser::parse_fun_declaration() -> std::shared_ptr<ASTFunDecl>
+{
+    auto fun_decl = parse_fun_start();
+    if(!fun_decl)
+        return nullptr;
+
+    {
+        // Enter a new scope context for the parameters.
+        // Keep it active while parsing the function body as well.
+        ParseScope scope(sema, ScopeFlags::FunParamsScope);
+
+        if(!parse_params(*fun_decl))
+            return nullptr;
+
+        auto comp_stmt = parse_compound_stmt(ScopeFlags::CompoundStmt
+                                             | ScopeFlags::FunScope);
+        if(!comp_stmt)
+            return nullptr;
+
+        fun_decl->set_body(std::move(comp_stmt));
+    }
+
+    return sema.act_on_fun_decl_end(std::move(fun_decl));
+}
+
+// <type-specifier> ID (
+auto Parser::parse_fun_start() -> std::shared_ptr<ASTFunDecl>
 {
     auto retn = expect_and_consume_type();
     if(!retn)
@@ -99,40 +265,64 @@ auto Parser::parse_fun_declaration() -> std::shared_ptr<ASTFunDecl>
 
     auto fun_decl = sema.act_on_fun_decl_start(*retn, *id);
     assert(fun_decl != nullptr);
+    return fun_decl;
+}
 
+// <params> )
+// <params> ::= <param-list> | void
+// <param-list> ::= <param-list> , <param> | <param>
+auto Parser::parse_params(ASTFunDecl& fun_decl) -> bool
+{
+    // <params> ::= <param-list> | void
+    if(lookahead(0).category == Category::Void && lookahead(1).category == Category::CloseParen)
     {
-        // Enter a new scope context for the parameters.
-        // Keep it active while parsing the function body as well.
-        ParseScope scope(sema, ScopeFlags::FunParamsScope);
+        // The params of the function is a single void, i.e. no params.
+        // Consume the `void` and go on.
+        consume();
+    }
+    else // <param-list> ::= <param-list> , <param> | <param>
+    {
+        if(auto param = parse_param())
+            fun_decl.add_param(std::move(param));
+        else
+            return false;
 
-        // <params> ::= <param-list> | void
-        if(lookahead(0).category == Category::Void && lookahead(1).category == Category::CloseParen)
-        {
-            // The params of the function is a single void, i.e. no params.
-            // Consume the `void` and go on.
-            consume();
-        }
-        else // <param-list> ::= <param-list> , <param> | <param>
+        while(peek_word.category != Category::CloseParen)
         {
+            if(!expect_and_consume(Category::Comma))
+                return false;
+
             if(auto param = parse_param())
-                fun_decl->add_param(std::move(param));
+                fun_decl.add_param(std::move(param));
             else
-                return nullptr;
+                return false;
+        }
+    }
 
-            while(peek_word.category != Category::CloseParen)
-            {
-                if(!expect_and_consume(Category::Comma))
-                    return nullptr;
+    return expect_and_consume(Category::CloseParen).has_value();
+}
 
-                if(auto param = parse_param())
-                    fun_decl->add_param(std::move(param));
-                else
-                    return nullptr;
-            }
-        }
+// <type-specifier> ID ( <params> )
+auto Parser::parse_fun_signature() -> std::shared_ptr<ASTFunDecl>
+{
+    auto fun_decl = parse_fun_start();
+    if(!fun_decl)
+        return nullptr;
 
-        if(!expect_and_consume(Category::CloseParen))
-            return nullptr;
+    ParseScope scope(sema, ScopeFlags::FunParamsScope);
+    if(!parse_params(*fun_decl))
+        return nullptr;
+
+    return fun_decl;
+}
+
+// <compound-stmt>
+auto Parser::parse_fun_body(std::shared_ptr<ASTFunDecl> fun_decl)
+        -> std::shared_ptr<ASTFunDecl>
+{
+    {
+        ParseScope scope(sema, ScopeFlags::FunParamsScope);
+        sema.act_on_fun_body_start(*fun_decl);
 
         auto comp_stmt = parse_compound_stmt(ScopeFlags::CompoundStmt
                                              | ScopeFlags::FunScope);
@@ -145,6 +335,30 @@ auto Parser::parse_fun_declaration() -> std::shared_ptr<ASTFunDecl>
     return sema.act_on_fun_decl_end(std::move(fun_decl));
 }
 
+auto Parser::skip_compound_stmt() -> ArrayView<const Word>
+{
+    assert(scanner == nullptr);
+    assert(peek_word.category == Category::OpenCurly);
+
+    const auto first = words_begin + num_consumed;
+    auto last = first;
+    for(size_t depth = 0; last != words_end; ++last)
+    {
+        if(last->category == Category::OpenCurly)
+            ++depth;
+        else if(last->category == Category::CloseCurly && --depth == 0)
+            break;
+    }
+    assert(last != words_end); // braces must be matched beforehand
+
+    // Go on from the closing curly bracket.
+    this->words_next = last + 1;
+    this->num_consumed = std::distance(words_begin, words_next);
+    fill_stream();
+
+    return ArrayView<const Word>(first, std::distance(first, last + 1));
+}
+
 // <param> ::= <type-specifier> ID | <type-specifier> ID [ ]
 auto Parser::parse_param() -> std::shared_ptr<ASTParmVarDecl>
 {
@@ -188,7 +402,7 @@ auto Parser::parse_statement() -> std::shared_ptr<ASTStmt>
         case Category::Return:
             return parse_return_stmt();
         default:
-            diagman.report(scanner.get_source(), peek_word.location(),
+            diagman.report(source, peek_word.location(),
                            Diag::parser_expected_statement);
             return nullptr;
     }
@@ -220,8 +434,11 @@ auto Parser::parse_compound_stmt(ScopeFlags scope_flags)
 
     // Enter a new scope context for this compound statement.
     ParseScope scope(sema, scope_flags);
-    std::vector<std::shared_ptr<ASTVarDecl>> decls;
-    std::vector<std::shared_ptr<ASTStmt>> stms;
+
+    const auto decls_base = scratch_decls.size();
+    const auto stms_base = scratch_stms.size();
+    auto decls_guard = scratch_guard(scratch_decls, decls_base);
+    auto stms_guard = scratch_guard(scratch_stms, stms_base);
 
     // The first and follow set for local-declaration are disjoint. Therefore
     // we can parse local-declaration as long as we have a valid first symbol.
@@ -231,7 +448,7 @@ auto Parser::parse_compound_stmt(ScopeFlags scope_flags)
     {
         if(auto decl = parse_var_declaration())
         {
-            decls.push_back(std::move(decl));
+            scratch_decls.push_back(std::move(decl));
         }
         else
         {
@@ -248,7 +465,7 @@ auto Parser::parse_compound_stmt(ScopeFlags scope_flags)
     {
         if(auto stmt = parse_statement())
         {
-            stms.push_back(std::move(stmt));
+            scratch_stms.push_back(std::move(stmt));
         }
         else
         {
@@ -262,7 +479,8 @@ auto Parser::parse_compound_stmt(ScopeFlags scope_flags)
     assert(peek_word.category == Category::CloseCurly);
     consume();
 
-    return sema.act_on_compound_stmt(std::move(decls), std::move(stms));
+    return sema.act_on_compound_stmt(ArrayView(scratch_decls, decls_base),
+                                     ArrayView(scratch_stms, stms_base));
 }
 
 // <selection-stmt> ::= if ( <expression> ) <statement>
@@ -463,7 +681,7 @@ auto Parser::parse_factor() -> std::shared_ptr<ASTExpr>
 
         default:
         {
-            diagman.report(scanner.get_source(), peek_word.location(),
+            diagman.report(source, peek_word.location(),
                            Diag::parser_expected_expression);
             return nullptr;
         }
@@ -514,12 +732,13 @@ auto Parser::parse_call() -> std::shared_ptr<ASTFunCall>
     if(!expect_and_consume(Category::OpenParen))
         return nullptr;
 
-    std::vector<std::shared_ptr<ASTExpr>> args;
+    const auto args_base = scratch_args.size();
+    auto args_guard = scratch_guard(scratch_args, args_base);
 
     if(peek_word.category != Category::CloseParen)
     {
         if(auto expr = parse_expression())
-            args.push_back(std::move(expr));
+            scratch_args.push_back(std::move(expr));
         else
             return nullptr;
     }
@@ -530,7 +749,7 @@ auto Parser::parse_call() -> std::shared_ptr<ASTFunCall>
             return nullptr;
 
         if(auto expr = parse_expression())
-            args.push_back(std::move(expr));
+            scratch_args.push_back(std::move(expr));
         else
             return nullptr;
     }
@@ -539,7 +758,8 @@ auto Parser::parse_call() -> std::shared_ptr<ASTFunCall>
     if(!rparen)
         return nullptr;
 
-    return sema.act_on_call(*id, std::move(args), rparen->location());
+    return sema.act_on_call(*id, ArrayView(scratch_args, args_base),
+                            rparen->location());
 }
 }
 
@@ -0,0 +1,825 @@
+#include <algorithm>
+#include <cassert>
+#include <cminus/ast-visitor.hpp>
+#include <cminus/range-analysis.hpp>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+
+namespace
+{
+using namespace cminus;
+using Operation = ASTBinaryExpr::Operation;
+
+constexpr int64_t int32_min = std::numeric_limits<int32_t>::min();
+constexpr int64_t int32_max = std::numeric_limits<int32_t>::max();
+
+/// Loops nested deeper than this are not iterated until a fixpoint. The
+/// variables which change within them are assumed to hold any value instead.
+constexpr int max_fixpoint_depth = 3;
+
+/// Iterations of a loop before the ranges at its head are widened.
+constexpr int num_iterations_before_widening = 2;
+
+/// Iterations of a loop after the ranges at its head are stable.
+constexpr int num_narrowing_iterations = 1;
+
+/// A range of 32-bit integers.
+struct Interval
+{
+    int64_t lo = int32_min;
+    int64_t hi = int32_max;
+
+    /// \returns the range `[lo, hi]` or the range of every integer if the
+    /// bounds overflow, since values wrap around.
+    static auto of(int64_t lo, int64_t hi) -> Interval
+    {
+        if(lo < int32_min || hi > int32_max)
+            return Interval{};
+        return Interval{lo, hi};
+    }
+
+    bool is_full() const { return lo == int32_min && hi == int32_max; }
+    bool is_empty() const { return lo > hi; }
+    bool is_constant() const { return lo == hi; }
+
+    bool contains(const Interval& other) const
+    {
+        return lo <= other.lo && other.hi <= hi;
+    }
+};
+
+/// The ranges of the scalar variables at some point of a function.
+struct State
+{
+    /// Whether the point may be reached at all.
+    bool reachable = true;
+
+    /// Variables not in here may hold any value.
+    std::unordered_map<ASTVarDecl*, Interval> ranges;
+
+    auto get(ASTVarDecl* var) const -> Interval
+    {
+        auto it = ranges.find(var);
+        return it != ranges.end() ? it->second : Interval{};
+    }
+
+    void set(ASTVarDecl* var, const Interval& range)
+    {
+        if(range.is_full())
+            this->ranges.erase(var);
+        else
+            this->ranges[var] = range;
+    }
+
+    void forget(ASTVarDecl* var) { this->ranges.erase(var); }
+};
+
+/// \returns a state covering both `a` and `b`.
+auto join(const State& a, const State& b) -> State
+{
+    if(!a.reachable)
+        return b;
+    if(!b.reachable)
+        return a;
+
+    State result;
+    for(auto& [var, range] : a.ranges)
+    {
+        if(auto it = b.ranges.find(var); it != b.ranges.end())
+        {
+            result.set(var, Interval{std::min(range.lo, it->second.lo),
+                                     std::max(range.hi, it->second.hi)});
+        }
+    }
+    return result;
+}
+
+/// Checks whether the state `a` covers the state `b`.
+bool includes(const State& a, const State& b)
+{
+    if(!b.reachable)
+        return true;
+    if(!a.reachable)
+        return false;
+
+    for(auto& [var, range] : a.ranges)
+    {
+        auto it = b.ranges.find(var);
+        if(it == b.ranges.end() || !range.contains(it->second))
+            return false;
+    }
+    return true;
+}
+
+/// \returns a state covering both `old` and `cur`, where every bound
+/// that moved from `old` to `cur` is pushed to its limit.
+auto widen(const State& old, const State& cur) -> State
+{
+    if(!old.reachable)
+        return cur;
+    if(!cur.reachable)
+        return old;
+
+    State result;
+    for(auto& [var, range] : old.ranges)
+    {
+        if(auto it = cur.ranges.find(var); it != cur.ranges.end())
+        {
+            result.set(var, Interval{it->second.lo < range.lo ? int32_min : range.lo,
+                                     it->second.hi > range.hi ? int32_max : range.hi});
+        }
+    }
+    return result;
+}
+
+bool is_comparison(Operation op)
+{
+    switch(op)
+    {
+        case Operation::Less:
+        case Operation::LessEqual:
+        case Operation::Greater:
+        case Operation::GreaterEqual:
+        case Operation::Equal:
+        case Operation::NotEqual:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// \returns the comparison which is true whenever `op` is false.
+auto negate(Operation op) -> Operation
+{
+    switch(op)
+    {
+        case Operation::Less:
+            return Operation::GreaterEqual;
+        case Operation::LessEqual:
+            return Operation::Greater;
+        case Operation::Greater:
+            return Operation::LessEqual;
+        case Operation::GreaterEqual:
+            return Operation::Less;
+        case Operation::Equal:
+            return Operation::NotEqual;
+        case Operation::NotEqual:
+            return Operation::Equal;
+        default:
+            assert(false);
+            return op;
+    }
+}
+
+/// \returns the comparison `op` with its operands swapped.
+auto flip(Operation op) -> Operation
+{
+    switch(op)
+    {
+        case Operation::Less:
+            return Operation::Greater;
+        case Operation::LessEqual:
+            return Operation::GreaterEqual;
+        case Operation::Greater:
+            return Operation::Less;
+        case Operation::GreaterEqual:
+            return Operation::LessEqual;
+        default:
+            return op;
+    }
+}
+
+/// \returns the result of comparing any values in the ranges or
+/// `std::nullopt` if it depends on the values.
+auto compare(Operation op, const Interval& lhs, const Interval& rhs) -> std::optional<bool>
+{
+    switch(op)
+    {
+        case Operation::Less:
+            if(lhs.hi < rhs.lo)
+                return true;
+            if(lhs.lo >= rhs.hi)
+                return false;
+            break;
+        case Operation::LessEqual:
+            if(lhs.hi <= rhs.lo)
+                return true;
+            if(lhs.lo > rhs.hi)
+                return false;
+            break;
+        case Operation::Greater:
+        case Operation::GreaterEqual:
+            return compare(flip(op), rhs, lhs);
+        case Operation::Equal:
+            if(lhs.is_constant() && rhs.is_constant() && lhs.lo == rhs.lo)
+                return true;
+            if(lhs.hi < rhs.lo || rhs.hi < lhs.lo)
+                return false;
+            break;
+        case Operation::NotEqual:
+            if(auto equal = compare(Operation::Equal, lhs, rhs))
+                return !*equal;
+            break;
+        default:
+            break;
+    }
+    return std::nullopt;
+}
+
+/// \returns the range of `lhs op rhs` for any values in the ranges.
+auto evaluate(Operation op, const Interval& lhs, const Interval& rhs) -> Interval
+{
+    switch(op)
+    {
+        case Operation::Plus:
+            return Interval::of(lhs.lo + rhs.lo, lhs.hi + rhs.hi);
+        case Operation::Minus:
+            return Interval::of(lhs.lo - rhs.hi, lhs.hi - rhs.lo);
+        case Operation::Multiply:
+        case Operation::Divide:
+        {
+            // The quotient of a division by zero is unspecified.
+            if(op == Operation::Divide && rhs.lo <= 0 && rhs.hi >= 0)
+                return Interval{};
+
+            // Both operations are monotonic on each operand, as long as the
+            // divisor does not change sign, so the bounds are at the corners.
+            int64_t corners[4];
+            size_t i = 0;
+            for(auto x : {lhs.lo, lhs.hi})
+            {
+                for(auto y : {rhs.lo, rhs.hi})
+                    corners[i++] = (op == Operation::Multiply ? x * y : x / y);
+            }
+            return Interval::of(*std::min_element(corners, corners + 4),
+                                *std::max_element(corners, corners + 4));
+        }
+        case Operation::Assign:
+            return rhs;
+        default:
+            if(auto result = compare(op, lhs, rhs))
+                return Interval{*result, *result};
+            return Interval{0, 1};
+    }
+}
+
+/// Narrows the range of a variable known to satisfy `var op other`.
+void constrain(State& state, ASTVarDecl* var, Operation op, const Interval& other)
+{
+    auto range = state.get(var);
+    switch(op)
+    {
+        case Operation::Less:
+            range.hi = std::min(range.hi, other.hi - 1);
+            break;
+        case Operation::LessEqual:
+            range.hi = std::min(range.hi, other.hi);
+            break;
+        case Operation::Greater:
+            range.lo = std::max(range.lo, other.lo + 1);
+            break;
+        case Operation::GreaterEqual:
+            range.lo = std::max(range.lo, other.lo);
+            break;
+        case Operation::Equal:
+            range.lo = std::max(range.lo, other.lo);
+            range.hi = std::min(range.hi, other.hi);
+            break;
+        case Operation::NotEqual:
+            if(other.is_constant() && range.lo == other.lo)
+                ++range.lo;
+            else if(other.is_constant() && range.hi == other.lo)
+                --range.hi;
+            break;
+        default:
+            assert(false);
+            break;
+    }
+
+    if(range.is_empty())
+        state.reachable = false;
+    else
+        state.set(var, range);
+}
+
+/// Collects the variables which may change within a statement, that is,
+/// the ones assigned to and the ones declared in it.
+class VaryingVarsVisitor : public ASTVisitor
+{
+public:
+    bool contains(ASTVarDecl* var) const { return vars.count(var) != 0; }
+
+    void visit_compound_stmt(ASTCompoundStmt& stmt) override
+    {
+        for(auto it = stmt.decl_begin(); it != stmt.decl_end(); ++it)
+            this->vars.insert(it->get());
+        walk_compound_stmt(stmt);
+    }
+
+    void visit_binary_expr(ASTBinaryExpr& expr) override
+    {
+        if(expr.get_operation() == Operation::Assign)
+            this->vars.insert(expr.get_left()->as_var_expr()->get_decl().get());
+        walk_binary_expr(expr);
+    }
+
+private:
+    std::unordered_set<ASTVarDecl*> vars;
+};
+
+/// Interval analysis over the scalar variables of a function.
+///
+/// The function is interpreted over the ranges of its variables. Each loop
+/// is iterated until the ranges at its head are stable, widening them to
+/// ensure termination, after which its body is interpreted once more for
+/// recording the range of the subscripts within it.
+class RangeAnalyzer
+{
+public:
+    void analyze(ASTFunDecl& decl)
+    {
+        State state;
+        for(size_t i = 0; i < decl.get_num_params(); ++i)
+        {
+            if(auto param = decl.get_param(i); !param->is_array())
+                this->tracked.insert(param.get());
+        }
+        exec(*decl.get_body(), state);
+    }
+
+    /// Checks whether the scalar variable is a local or parameter.
+    bool is_tracked(ASTVarDecl* var) const { return tracked.count(var) != 0; }
+
+    /// Checks whether a subscript may ever be evaluated.
+    bool is_reachable(ASTVarRef& ref) const { return subscripts.count(&ref) != 0; }
+
+    /// Checks whether a subscript is non-negative whenever it is evaluated.
+    bool is_non_negative(ASTVarRef& ref) const
+    {
+        auto it = subscripts.find(&ref);
+        return it != subscripts.end() && it->second;
+    }
+
+private:
+    /// \returns the tracked variable referenced by `expr` or `nullptr`.
+    auto tracked_var(ASTExpr& expr) const -> ASTVarDecl*
+    {
+        if(expr.expr_kind() != ExprKind::VarRef)
+            return nullptr;
+        auto var = static_cast<ASTVarRef&>(expr).get_decl().get();
+        return is_tracked(var) ? var : nullptr;
+    }
+
+    /// Evaluates the index of a subscript and its bounds check.
+    void eval_subscript(ASTVarRef& ref, State& state)
+    {
+        auto& index_expr = *ref.get_index();
+        const auto index = eval(index_expr, state);
+
+        if(recording)
+        {
+            auto [it, inserted] = subscripts.emplace(&ref, true);
+            it->second = it->second && index.lo >= 0;
+        }
+
+        // The program exits on negative subscripts, and accessing past the
+        // end of an array is undefined, thus the index is within bounds
+        // from now on.
+        if(auto var = tracked_var(index_expr))
+        {
+            constrain(state, var, Operation::GreaterEqual, Interval{0, 0});
+            if(auto size = ref.get_decl()->get_array_size())
+                constrain(state, var, Operation::Less, Interval{0, size->get_value()});
+        }
+    }
+
+    void exec(ASTStmt& stmt, State& state)
+    {
+        if(!state.reachable)
+            return;
+
+        switch(stmt.stmt_kind())
+        {
+            case StmtKind::NullStmt:
+                break;
+            case StmtKind::ExprStmt:
+                eval(static_cast<ASTExpr&>(stmt), state);
+                break;
+            case StmtKind::CompoundStmt:
+            {
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(stmt);
+                for(auto it = comp_stmt.decl_begin(); it != comp_stmt.decl_end(); ++it)
+                {
+                    if(!(*it)->is_array())
+                    {
+                        this->tracked.insert(it->get());
+                        state.forget(it->get());
+                    }
+                }
+                for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+                    exec(**it, state);
+                break;
+            }
+            case StmtKind::SelectionStmt:
+            {
+                auto& if_stmt = static_cast<ASTSelectionStmt&>(stmt);
+                auto [on_true, on_false] = eval_cond(*if_stmt.get_cond(), std::move(state));
+                exec(*if_stmt.get_then(), on_true);
+                if(if_stmt.get_else())
+                    exec(*if_stmt.get_else(), on_false);
+                state = join(on_true, on_false);
+                break;
+            }
+            case StmtKind::IterationStmt:
+                exec_loop(static_cast<ASTIterationStmt&>(stmt), state);
+                break;
+            case StmtKind::ReturnStmt:
+            {
+                auto& retn_stmt = static_cast<ASTReturnStmt&>(stmt);
+                if(retn_stmt.get_expr())
+                    eval(*retn_stmt.get_expr(), state);
+                state.reachable = false;
+                break;
+            }
+        }
+    }
+
+    void exec_loop(ASTIterationStmt& loop, State& state)
+    {
+        auto& cond = *loop.get_cond();
+        auto& body = *loop.get_body();
+
+        State head = state;
+        if(++this->loop_depth > max_fixpoint_depth)
+        {
+            VaryingVarsVisitor varying;
+            varying.visit_iteration_stmt(loop);
+            for(auto it = head.ranges.begin(); it != head.ranges.end();)
+                it = varying.contains(it->first) ? head.ranges.erase(it) : std::next(it);
+        }
+        else
+        {
+            const auto was_recording = std::exchange(this->recording, false);
+
+            // \returns the state at the end of an iteration from `head`.
+            auto iterate = [&](const State& from) {
+                auto on_true = eval_cond(cond, from).first;
+                exec(body, on_true);
+                return on_true;
+            };
+
+            for(int i = 0;; ++i)
+            {
+                auto next = join(head, iterate(head));
+                if(includes(head, next))
+                    break;
+                head = (i < num_iterations_before_widening ? std::move(next)
+                                                           : widen(head, next));
+            }
+
+            // Widening may have lost bounds the loop keeps to, which iterating
+            // from the entry state once more may recover. Inner loops are
+            // widened as well, so the narrower state must be verified.
+            for(int i = 0; i < num_narrowing_iterations; ++i)
+            {
+                auto narrowed = join(state, iterate(head));
+                if(!includes(narrowed, iterate(narrowed)))
+                    break;
+                head = std::move(narrowed);
+            }
+            this->recording = was_recording;
+        }
+
+        auto [on_true, on_false] = eval_cond(cond, std::move(head));
+        if(recording)
+            exec(body, on_true);
+        state = std::move(on_false);
+        --this->loop_depth;
+    }
+
+    /// Evaluates a condition.
+    ///
+    /// \returns the states after the condition is true and after it is false.
+    auto eval_cond(ASTExpr& cond, State state) -> std::pair<State, State>
+    {
+        std::optional<bool> known;
+        std::pair<State, State> result;
+        auto& [on_true, on_false] = result;
+
+        if(cond.expr_kind() == ExprKind::BinaryExpr
+           && is_comparison(static_cast<ASTBinaryExpr&>(cond).get_operation()))
+        {
+            auto& expr = static_cast<ASTBinaryExpr&>(cond);
+            auto& left = *expr.get_left();
+            auto& right = *expr.get_right();
+            const auto op = expr.get_operation();
+
+            const auto lhs = eval(left, state);
+            const auto rhs = eval(right, state);
+            known = compare(op, lhs, rhs);
+            on_true = on_false = std::move(state);
+
+            // The left variable may have changed since it was read if the
+            // right operand assigns to it.
+            if(auto var = tracked_var(left))
+            {
+                VaryingVarsVisitor varying;
+                varying.visit_expr(right);
+                if(!varying.contains(var))
+                {
+                    constrain(on_true, var, op, rhs);
+                    constrain(on_false, var, negate(op), rhs);
+                }
+            }
+
+            if(auto var = tracked_var(right))
+            {
+                constrain(on_true, var, flip(op), lhs);
+                constrain(on_false, var, flip(negate(op)), lhs);
+            }
+        }
+        else
+        {
+            const auto value = eval(cond, state);
+            if(value.lo > 0 || value.hi < 0)
+                known = true;
+            else if(value.lo == 0 && value.hi == 0)
+                known = false;
+            on_true = on_false = std::move(state);
+
+            if(auto var = tracked_var(cond))
+            {
+                constrain(on_true, var, Operation::NotEqual, Interval{0, 0});
+                constrain(on_false, var, Operation::Equal, Interval{0, 0});
+            }
+        }
+
+        if(known)
+            (*known ? on_false : on_true).reachable = false;
+
+        return result;
+    }
+
+    auto eval(ASTExpr& expr, State& state) -> Interval
+    {
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+            {
+                const int64_t value = static_cast<ASTNumber&>(expr).get_value();
+                return Interval{value, value};
+            }
+            case ExprKind::VarRef:
+            {
+                auto& ref = static_cast<ASTVarRef&>(expr);
+                if(ref.get_index())
+                {
+                    eval_subscript(ref, state);
+                    return Interval{};
+                }
+                return state.get(ref.get_decl().get());
+            }
+            case ExprKind::FunCall:
+            {
+                // Calls may only change global variables.
+                auto& call = static_cast<ASTFunCall&>(expr);
+                for(auto it = call.arg_begin(); it != call.arg_end(); ++it)
+                    eval(**it, state);
+                return Interval{};
+            }
+            case ExprKind::BinaryExpr:
+            case ExprKind::AssignExpr:
+            {
+                auto& binary_expr = static_cast<ASTBinaryExpr&>(expr);
+                const auto op = binary_expr.get_operation();
+
+                // The address assigned to is computed before the value.
+                if(op == Operation::Assign)
+                {
+                    auto& ref = static_cast<ASTVarRef&>(*binary_expr.get_left());
+                    if(ref.get_index())
+                        eval_subscript(ref, state);
+
+                    const auto value = eval(*binary_expr.get_right(), state);
+                    if(is_tracked(ref.get_decl().get()))
+                        state.set(ref.get_decl().get(), value);
+                    return value;
+                }
+
+                const auto lhs = eval(*binary_expr.get_left(), state);
+                const auto rhs = eval(*binary_expr.get_right(), state);
+                return evaluate(op, lhs, rhs);
+            }
+        }
+        return Interval{};
+    }
+
+private:
+    std::unordered_set<ASTVarDecl*> tracked;
+    std::unordered_map<ASTVarRef*, bool> subscripts;
+    bool recording = true;
+    int loop_depth = 0;
+};
+
+/// Collects the bounds checks of a function which may be elided.
+///
+/// The check of a subscript is moved before a loop when its index does not
+/// change within the loop and it is performed in the first iteration before
+/// any call, return or inner loop. Those are the only means of producing
+/// output or never reaching the check, so exiting earlier than before
+/// is not observable. The loop condition is evaluated once more before
+/// the checks, thus it must have no side effects.
+class BoundsCheckVisitor : public ASTVisitor
+{
+public:
+    explicit BoundsCheckVisitor(const RangeAnalyzer& analyzer, BoundsCheckInfo& info) :
+        analyzer(analyzer),
+        info(info)
+    {
+    }
+
+    void visit_iteration_stmt(ASTIterationStmt& loop) override
+    {
+        if(has_no_side_effects(*loop.get_cond()))
+        {
+            this->current_loop = &loop;
+            this->varying = VaryingVarsVisitor();
+            this->varying.visit_iteration_stmt(loop);
+            this->stopped = false;
+            hoist_from(*loop.get_body());
+        }
+        walk_iteration_stmt(loop);
+    }
+
+    void visit_var_expr(ASTVarRef& ref) override
+    {
+        if(ref.get_index())
+        {
+            ++this->info.num_subscripts;
+            if(analyzer.is_non_negative(ref))
+                this->info.redundant.insert(&ref);
+        }
+        walk_var_expr(ref);
+    }
+
+private:
+    bool has_no_side_effects(ASTExpr& expr)
+    {
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+                return true;
+            case ExprKind::VarRef:
+            {
+                auto index = static_cast<ASTVarRef&>(expr).get_index();
+                return !index || has_no_side_effects(*index);
+            }
+            case ExprKind::BinaryExpr:
+            {
+                auto& binary_expr = static_cast<ASTBinaryExpr&>(expr);
+                return has_no_side_effects(*binary_expr.get_left())
+                       && has_no_side_effects(*binary_expr.get_right());
+            }
+            default:
+                return false;
+        }
+    }
+
+    /// Checks whether an expression is made only of numbers and scalar
+    /// locals which do not change within the current loop.
+    bool is_invariant(ASTExpr& expr)
+    {
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+                return true;
+            case ExprKind::VarRef:
+            {
+                auto& ref = static_cast<ASTVarRef&>(expr);
+                auto var = ref.get_decl().get();
+                return !ref.get_index() && analyzer.is_tracked(var) && !varying.contains(var);
+            }
+            case ExprKind::BinaryExpr:
+            {
+                auto& binary_expr = static_cast<ASTBinaryExpr&>(expr);
+                return is_invariant(*binary_expr.get_left())
+                       && is_invariant(*binary_expr.get_right());
+            }
+            default:
+                return false;
+        }
+    }
+
+    void hoist_subscript(ASTVarRef& ref)
+    {
+        if(analyzer.is_reachable(ref) && !analyzer.is_non_negative(ref)
+           && !info.hoisted.count(&ref) && is_invariant(*ref.get_index()))
+        {
+            this->info.hoisted.insert(&ref);
+            this->info.loop_checks[current_loop].push_back(&ref);
+        }
+    }
+
+    /// Hoists the checks performed by a statement of the loop body, in
+    /// evaluation order, until one of them may be skipped.
+    void hoist_from(ASTStmt& stmt)
+    {
+        if(stopped)
+            return;
+
+        switch(stmt.stmt_kind())
+        {
+            case StmtKind::NullStmt:
+                break;
+            case StmtKind::ExprStmt:
+                hoist_from_expr(static_cast<ASTExpr&>(stmt));
+                break;
+            case StmtKind::CompoundStmt:
+            {
+                auto& comp_stmt = static_cast<ASTCompoundStmt&>(stmt);
+                for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+                    hoist_from(**it);
+                break;
+            }
+            case StmtKind::SelectionStmt:
+                hoist_from_expr(*static_cast<ASTSelectionStmt&>(stmt).get_cond());
+                this->stopped = true;
+                break;
+            case StmtKind::IterationStmt:
+                hoist_from_expr(*static_cast<ASTIterationStmt&>(stmt).get_cond());
+                this->stopped = true;
+                break;
+            case StmtKind::ReturnStmt:
+                if(auto expr = static_cast<ASTReturnStmt&>(stmt).get_expr())
+                    hoist_from_expr(*expr);
+                this->stopped = true;
+                break;
+        }
+    }
+
+    void hoist_from_expr(ASTExpr& expr)
+    {
+        if(stopped)
+            return;
+
+        switch(expr.expr_kind())
+        {
+            case ExprKind::Number:
+                break;
+            case ExprKind::VarRef:
+            {
+                auto& ref = static_cast<ASTVarRef&>(expr);
+                if(auto index = ref.get_index())
+                {
+                    hoist_from_expr(*index);
+                    if(!stopped)
+                        hoist_subscript(ref);
+                }
+                break;
+            }
+            case ExprKind::FunCall:
+            {
+                auto& call = static_cast<ASTFunCall&>(expr);
+                for(auto it = call.arg_begin(); it != call.arg_end(); ++it)
+                    hoist_from_expr(**it);
+                this->stopped = true;
+                break;
+            }
+            case ExprKind::BinaryExpr:
+            case ExprKind::AssignExpr:
+            {
+                auto& binary_expr = static_cast<ASTBinaryExpr&>(expr);
+                hoist_from_expr(*binary_expr.get_left());
+                hoist_from_expr(*binary_expr.get_right());
+                break;
+            }
+        }
+    }
+
+private:
+    const RangeAnalyzer& analyzer;
+    BoundsCheckInfo& info;
+
+    ASTIterationStmt* current_loop = nullptr;
+    VaryingVarsVisitor varying;
+    bool stopped = false;
+};
+}
+
+namespace cminus
+{
+auto analyze_bounds_checks(ASTFunDecl& decl) -> BoundsCheckInfo
+{
+    BoundsCheckInfo info;
+
+    RangeAnalyzer analyzer;
+    analyzer.analyze(decl);
+
+    BoundsCheckVisitor visitor(analyzer, info);
+    visitor.visit_compound_stmt(*decl.get_body());
+
+    return info;
+}
+}
@@ -1,74 +1,363 @@
+#include <cminus/ast-visitor.hpp>
+#include <cminus/mem-report.hpp>
 #include <cminus/semantics.hpp>
+#include <cminus/utility/thread_pool.hpp>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+using namespace cminus;
+
+/// Type checks the body of functions.
+///
+/// The tree is only read, thus many checkers may run concurrently as long
+/// as each one reports into its own diagnostic manager.
+class FunBodyChecker : public ASTVisitor
+{
+public:
+    explicit FunBodyChecker(const SourceFile& source, DiagnosticManager& diagman) :
+        source(source), diagman(diagman)
+    {
+    }
+
+    void visit_fun_decl(ASTFunDecl& decl) override
+    {
+        this->is_fun_void = decl.is_void();
+        if(auto body = decl.get_body())
+            visit_compound_stmt(*body);
+    }
+
+    void visit_compound_stmt(ASTCompoundStmt& comp_stmt) override
+    {
+        for(auto it = comp_stmt.stmt_begin(); it != comp_stmt.stmt_end(); ++it)
+            check_stmt(**it);
+    }
+
+    void visit_selection_stmt(ASTSelectionStmt& if_stmt) override
+    {
+        check_cond(*if_stmt.get_cond());
+        check_stmt(*if_stmt.get_then());
+        if(auto else_stmt = if_stmt.get_else())
+            check_stmt(*else_stmt);
+    }
+
+    void visit_iteration_stmt(ASTIterationStmt& while_stmt) override
+    {
+        check_cond(*while_stmt.get_cond());
+        check_stmt(*while_stmt.get_body());
+    }
+
+    void visit_return_stmt(ASTReturnStmt& retn_stmt) override
+    {
+        if(auto expr = retn_stmt.get_expr())
+        {
+            if(this->is_fun_void)
+            {
+                diagman.report(source, retn_stmt.location(),
+                               Diag::sema_void_fun_returning_value)
+                        .range(expr->source_range());
+            }
+            else if(expr->type() != ExprType::Int)
+            {
+                diagman.report(source, expr->location(), Diag::sema_incompatible_return_type)
+                        .range(expr->source_range());
+            }
+            visit_expr(*expr);
+        }
+        else if(!this->is_fun_void)
+        {
+            diagman.report(source, retn_stmt.location(),
+                           Diag::sema_int_fun_not_returning_value);
+        }
+    }
+
+    void visit_var_expr(ASTVarRef& var_ref) override
+    {
+        if(auto index = var_ref.get_index())
+        {
+            if(index->type() != ExprType::Int)
+            {
+                diagman.report(source, index->location(), Diag::sema_index_is_not_int)
+                        .range(index->source_range());
+            }
+
+            visit_expr(*index);
+        }
+    }
+
+    void visit_call_expr(ASTFunCall& fun_call) override
+    {
+        auto fun_decl = fun_call.get_decl();
+        auto name = fun_call.source_range().substr(0, fun_decl->get_name().size());
+        auto num_args = static_cast<size_t>(std::distance(fun_call.arg_begin(),
+                                                          fun_call.arg_end()));
+
+        if(num_args < fun_decl->get_num_params())
+        {
+            diagman.report(source, name.begin(), Diag::sema_arg_too_few_params)
+                    .range(name);
+        }
+        else if(num_args > fun_decl->get_num_params())
+        {
+            diagman.report(source, name.begin(), Diag::sema_arg_too_many_params)
+                    .range(name);
+        }
+
+        // Match the arguments with the parameters for as long as possible.
+        size_t a = 0;
+        for(auto it = fun_call.arg_begin(); it != fun_call.arg_end(); ++it, ++a)
+        {
+            auto& arg = **it;
+            if(a < fun_decl->get_num_params())
+            {
+                bool is_arg_array = (arg.type() == ExprType::Array);
+                if(arg.type() == ExprType::Void
+                   || is_arg_array != fun_decl->get_param(a)->is_array())
+                {
+                    diagman.report(source, arg.location(),
+                                   Diag::sema_arg_type_mismatch)
+                            .range(arg.source_range());
+                }
+            }
+            visit_expr(arg);
+        }
+    }
+
+    void visit_binary_expr(ASTBinaryExpr& expr) override
+    {
+        auto lhs = expr.get_left();
+        auto rhs = expr.get_right();
+        if(lhs->type() != ExprType::Int || rhs->type() != ExprType::Int)
+        {
+            auto code = (expr.get_operation() == ASTBinaryExpr::Operation::Assign)
+                                ? Diag::sema_assignment_type_error
+                                : Diag::sema_binary_expr_type_error;
+            diagman.report(source, expr.op_location(), code)
+                    .range(lhs->source_range())
+                    .range(rhs->source_range());
+        }
+        visit_expr(*lhs);
+        visit_expr(*rhs);
+    }
+
+private:
+    void check_stmt(ASTStmt& stmt)
+    {
+        if(stmt.stmt_kind() == StmtKind::ExprStmt)
+        {
+            auto& expr = static_cast<ASTExpr&>(stmt);
+            if(expr.type() == ExprType::Array)
+            {
+                diagman.report(source, expr.location(), Diag::sema_array_statement)
+                        .range(expr.source_range());
+            }
+        }
+        visit_stmt(stmt);
+    }
+
+    void check_cond(ASTExpr& expr)
+    {
+        if(expr.type() != ExprType::Int)
+        {
+            diagman.report(source, expr.location(), Diag::sema_expr_not_boolean)
+                    .range(expr.source_range());
+        }
+        visit_expr(expr);
+    }
+
+private:
+    const SourceFile& source;
+    DiagnosticManager& diagman;
+    bool is_fun_void = true;
+};
+}
 
 namespace cminus
 {
-auto Scope::detach() -> std::unique_ptr<Scope>
+SymbolTable::SymbolTable(ScopeFlags flags) :
+    slots(64)
+{
+    enter_scope(flags);
+}
+
+SymbolTable::SymbolTable(const SymbolTable& outer, size_t num_outer_symbols,
+                         ScopeFlags flags) :
+    SymbolTable(flags)
+{
+    assert(num_outer_symbols <= outer.size());
+    this->outer = &outer;
+    this->num_outer_symbols = num_outer_symbols;
+}
+
+void SymbolTable::enter_scope(ScopeFlags flags)
+{
+    MemScope mem_scope(MemTag::Symbols);
+    this->scopes.push_back(ScopeInfo{flags, static_cast<uint32_t>(bindings.size())});
+}
+
+void SymbolTable::leave_scope()
+{
+    assert(!scopes.empty());
+    const auto first_binding = scopes.back().first_binding;
+
+    // Unwind the undo log, uncovering the shadowed declarations.
+    while(bindings.size() > first_binding)
+    {
+        const auto& binding = bindings.back();
+        this->slots[binding.slot].top = binding.shadowed;
+        this->bindings.pop_back();
+    }
+
+    this->scopes.pop_back();
+}
+
+auto SymbolTable::find_slot(SourceRange name) const -> size_t
 {
-    auto prev = std::move(this->parent_scope);
-    return prev;
+    // Linear probing on a power of two sized table.
+    const auto mask = slots.size() - 1;
+    auto index = std::hash<SourceRange>{}(name) & mask;
+    while(slots[index].used && slots[index].name != name)
+        index = (index + 1) & mask;
+    return index;
 }
 
-auto Scope::lookup_exclusive(SourceRange name) const -> std::shared_ptr<ASTDecl>
+auto SymbolTable::find_binding(SourceRange name) const -> const Binding*
 {
-    auto it = symbols.find(name);
-    if(it == symbols.end())
+    const auto& slot = slots[find_slot(name)];
+    if(!slot.used || slot.top == no_binding)
         return nullptr;
-    return it->second;
+    return &bindings[slot.top];
 }
 
-auto Scope::lookup(SourceRange name) const -> std::shared_ptr<ASTDecl>
+void SymbolTable::grow()
 {
-    auto decl = lookup_exclusive(name);
-    if(decl == nullptr && parent_scope)
-        decl = parent_scope->lookup(name);
-    return decl;
+    auto old_slots = std::exchange(slots, std::vector<Slot>(2 * slots.size()));
+    for(auto& old_slot : old_slots)
+    {
+        if(!old_slot.used)
+            continue;
+
+        const auto index = find_slot(old_slot.name);
+        this->slots[index] = old_slot;
+
+        // Every binding of this name is in the same slot.
+        for(auto b = old_slot.top; b != no_binding; b = bindings[b].shadowed)
+            this->bindings[b].slot = static_cast<uint32_t>(index);
+    }
 }
 
-auto Scope::insert(SourceRange name, std::shared_ptr<ASTDecl> decl)
+auto SymbolTable::lookup_exclusive(SourceRange name) const -> std::shared_ptr<ASTDecl>
+{
+    auto binding = find_binding(name);
+    if(binding == nullptr || binding->scope != scopes.size() - 1)
+        return nullptr;
+    return binding->decl;
+}
+
+auto SymbolTable::lookup(SourceRange name) const -> std::shared_ptr<ASTDecl>
+{
+    if(auto binding = find_binding(name))
+        return binding->decl;
+    if(outer != nullptr)
+        return outer->lookup_first(name, num_outer_symbols);
+    return nullptr;
+}
+
+auto SymbolTable::lookup_first(SourceRange name, size_t num_symbols) const
+        -> std::shared_ptr<ASTDecl>
+{
+    const auto& slot = slots[find_slot(name)];
+    if(!slot.used)
+        return nullptr;
+
+    // Symbols inserted later come first in the chain.
+    auto b = slot.top;
+    while(b != no_binding && b >= num_symbols)
+        b = bindings[b].shadowed;
+    return b != no_binding ? bindings[b].decl : nullptr;
+}
+
+auto SymbolTable::insert(SourceRange name, std::shared_ptr<ASTDecl> decl)
         -> std::pair<std::shared_ptr<ASTDecl>, bool>
 {
-    // If the parent scope is the function parameters scope, lookup
-    // this name there. This would be considered a redeclaration.
-    if(parent_scope && parent_scope->is_params_scope())
+    MemScope mem_scope(MemTag::Symbols);
+
+    const auto scope = static_cast<uint32_t>(scopes.size() - 1);
+
+    if(auto binding = find_binding(name))
+    {
+        // A redeclaration in the same scope.
+        if(binding->scope == scope)
+            return std::pair{binding->decl, false};
+
+        // If the parent scope is the function parameters scope, lookup
+        // this name there. This would be considered a redeclaration.
+        if(scope > 0 && binding->scope == scope - 1 && is_params_scope(scope - 1))
+            return std::pair{binding->decl, false};
+    }
+
+    // Keep the load factor of the table below one half.
+    if(2 * (num_used_slots + 1) > slots.size())
+        grow();
+
+    const auto slot_index = find_slot(name);
+    auto& slot = slots[slot_index];
+    if(!slot.used)
     {
-        if(auto decl = parent_scope->lookup_exclusive(name))
-            return std::pair{decl, false};
+        slot.used = true;
+        slot.name = name;
+        this->num_used_slots++;
     }
 
-    auto [it, inserted] = symbols.emplace(std::move(name), std::move(decl));
-    return std::pair{it->second, inserted};
+    const auto binding_index = static_cast<uint32_t>(bindings.size());
+    this->bindings.push_back(Binding{decl, static_cast<uint32_t>(slot_index),
+                                     slot.top, scope});
+    slot.top = binding_index;
+
+    return std::pair{std::move(decl), true};
 }
 
 void Semantics::enter_scope(ScopeFlags flags)
 {
-    auto old_scope = std::move(current_scope);
-    auto new_scope = std::make_unique<Scope>(flags, std::move(old_scope));
-    current_scope = std::move(new_scope);
+    symbols.enter_scope(flags);
 }
 
 void Semantics::leave_scope()
 {
-    current_scope = current_scope->detach();
-    assert(current_scope != nullptr);
+    symbols.leave_scope();
+    assert(symbols.depth() != 0);
 }
 
-auto Semantics::get_scope() -> Scope&
+auto Semantics::get_symbols() -> SymbolTable&
 {
-    assert(current_scope != nullptr);
-    return *current_scope;
+    return symbols;
 }
 
 Semantics::Semantics(SourceFile& source_a,
                      DiagnosticManager& diagman_a) :
     source(source_a),
-    diagman(diagman_a)
+    diagman(diagman_a),
+    symbols(ScopeFlags::TopLevel)
 {
-    current_scope = std::make_unique<Scope>(ScopeFlags::TopLevel, nullptr);
+    MemScope mem_scope(MemTag::AST);
 
     fun_println = make_builtin(Category::Void, "println", {"value"});
     fun_input = make_builtin(Category::Int, "input", {});
 }
 
+Semantics::Semantics(const Semantics& global_sema,
+                     size_t num_visible_symbols,
+                     DiagnosticManager& diagman_a) :
+    source(global_sema.source),
+    diagman(diagman_a),
+    symbols(global_sema.symbols, num_visible_symbols, ScopeFlags::TopLevel),
+    fun_println(global_sema.fun_println),
+    fun_input(global_sema.fun_input)
+{
+    assert(global_sema.symbols.depth() == 1);
+}
+
 auto Semantics::make_builtin(Category retn_type,
                              std::string name_a,
                              std::vector<std::string> params)
@@ -87,7 +376,7 @@ auto Semantics::make_builtin(Category retn_type,
         fun_decl->add_param(std::make_shared<ASTParmVarDecl>(parm_name, false));
     }
 
-    auto [decl, inserted] = current_scope->insert(name, fun_decl);
+    auto [decl, inserted] = symbols.insert(name, fun_decl);
     assert(inserted);
 
     return fun_decl;
@@ -101,6 +390,8 @@ auto Semantics::act_on_program_start() -> std::shared_ptr<ASTProgram>
 auto Semantics::act_on_program_end(std::shared_ptr<ASTProgram> program)
         -> std::shared_ptr<ASTProgram>
 {
+    check_fun_bodies(*program);
+
     if(program->decl_begin() == program->decl_end())
     {
         diagman.report(source, Diag::sema_empty_program);
@@ -121,6 +412,46 @@ auto Semantics::act_on_program_end(std::shared_ptr<ASTProgram> program)
     return program;
 }
 
+void Semantics::act_on_program_error(ASTProgram& program)
+{
+    check_fun_bodies(program);
+}
+
+void Semantics::check_fun_bodies(ASTProgram& program)
+{
+    std::vector<ASTFunDecl*> fun_decls;
+    for(auto it = program.decl_begin(); it != program.decl_end(); ++it)
+    {
+        if((*it)->decl_kind() == DeclKind::FunDecl)
+            fun_decls.push_back(static_cast<ASTFunDecl*>(it->get()));
+    }
+
+    auto& pool = ThreadPool::shared();
+    if(fun_decls.size() < min_parallel_bodies || pool.num_threads() == 1)
+    {
+        FunBodyChecker checker(source, diagman);
+        for(auto fun_decl : fun_decls)
+            checker.visit_fun_decl(*fun_decl);
+        return;
+    }
+
+    // Split the functions into contiguous chunks, each reporting into its
+    // own buffer. Propagating the buffers in order keeps the source order.
+    const auto num_chunks = std::min(fun_decls.size(), 4 * pool.num_threads());
+    std::unique_ptr<DiagnosticBuffer[]> buffers(new DiagnosticBuffer[num_chunks]);
+
+    pool.parallel_for(num_chunks, [&](size_t chunk) {
+        const auto first = chunk * fun_decls.size() / num_chunks;
+        const auto last = (chunk + 1) * fun_decls.size() / num_chunks;
+        FunBodyChecker checker(source, buffers[chunk]);
+        for(auto i = first; i < last; ++i)
+            checker.visit_fun_decl(*fun_decls[i]);
+    });
+
+    for(size_t chunk = 0; chunk < num_chunks; ++chunk)
+        buffers[chunk].flush_into(diagman);
+}
+
 void Semantics::act_on_top_level_decl(
         const std::shared_ptr<ASTProgram>& program,
         std::shared_ptr<ASTDecl> decl)
@@ -137,7 +468,7 @@ auto Semantics::act_on_var_decl(const Word& type, const Word& name,
 
     auto new_decl = std::make_shared<ASTVarDecl>(name.lexeme, std::move(array_size));
 
-    auto [decl, inserted] = current_scope->insert(name.lexeme, new_decl);
+    auto [decl, inserted] = symbols.insert(name.lexeme, new_decl);
     if(!inserted)
     {
         diagman.report(source, name.location(),
@@ -165,7 +496,7 @@ auto Semantics::act_on_fun_decl_start(const Word& retn_type, const Word& name)
 
     auto new_decl = std::make_shared<ASTFunDecl>(is_void, name.lexeme);
 
-    auto [decl, inserted] = current_scope->insert(name.lexeme, new_decl);
+    auto [decl, inserted] = symbols.insert(name.lexeme, new_decl);
     if(!inserted)
     {
         diagman.report(source, name.location(),
@@ -173,17 +504,25 @@ auto Semantics::act_on_fun_decl_start(const Word& retn_type, const Word& name)
                 .range(name.lexeme);
     }
 
-    this->is_current_fun_void = is_void;
     return new_decl;
 }
 
 auto Semantics::act_on_fun_decl_end(std::shared_ptr<ASTFunDecl> decl)
         -> std::shared_ptr<ASTFunDecl>
 {
-    this->is_current_fun_void = true;
     return decl;
 }
 
+void Semantics::act_on_fun_body_start(ASTFunDecl& decl)
+{
+    assert(symbols.is_params_scope());
+
+    // Redefinitions were diagnosed along with the signature. Those
+    // parameters stay hidden, as they did back then.
+    for(auto it = decl.parm_begin(); it != decl.parm_end(); ++it)
+        symbols.insert((*it)->get_name(), *it);
+}
+
 auto Semantics::act_on_param_decl(const Word& type, const Word& name,
                                   bool is_array)
         -> std::shared_ptr<ASTParmVarDecl>
@@ -193,7 +532,7 @@ auto Semantics::act_on_param_decl(const Word& type, const Word& name,
 
     auto new_decl = std::make_shared<ASTParmVarDecl>(name.lexeme, is_array);
 
-    auto [decl, inserted] = current_scope->insert(name.lexeme, new_decl);
+    auto [decl, inserted] = symbols.insert(name.lexeme, new_decl);
     if(!inserted)
     {
         diagman.report(source, name.location(),
@@ -215,13 +554,7 @@ auto Semantics::act_on_assign(std::shared_ptr<ASTVarRef> lhs,
                               const Word& op)
         -> std::shared_ptr<ASTAssignExpr>
 {
-    if(lhs->type() != ExprType::Int || rhs->type() != ExprType::Int)
-    {
-        diagman.report(source, op.location(), Diag::sema_assignment_type_error)
-                .range(lhs->source_range())
-                .range(rhs->source_range());
-    }
-    return std::make_shared<ASTAssignExpr>(std::move(lhs), std::move(rhs));
+    return std::make_shared<ASTAssignExpr>(std::move(lhs), std::move(rhs), op.location());
 }
 
 auto Semantics::act_on_binary_expr(std::shared_ptr<ASTExpr> lhs,
@@ -229,14 +562,9 @@ auto Semantics::act_on_binary_expr(std::shared_ptr<ASTExpr> lhs,
                                    const Word& op)
         -> std::shared_ptr<ASTBinaryExpr>
 {
-    if(lhs->type() != ExprType::Int || rhs->type() != ExprType::Int)
-    {
-        diagman.report(source, op.location(), Diag::sema_binary_expr_type_error)
-                .range(lhs->source_range())
-                .range(rhs->source_range());
-    }
     auto type = ASTBinaryExpr::type_from_category(op.category);
-    return std::make_shared<ASTBinaryExpr>(std::move(lhs), std::move(rhs), type);
+    return std::make_shared<ASTBinaryExpr>(std::move(lhs), std::move(rhs), type,
+                                           op.location());
 }
 
 auto Semantics::act_on_null_stmt()
@@ -248,19 +576,19 @@ auto Semantics::act_on_null_stmt()
 auto Semantics::act_on_expr_stmt(std::shared_ptr<ASTExpr> expr)
         -> std::shared_ptr<ASTExpr>
 {
-    if(expr->type() == ExprType::Array)
-    {
-        diagman.report(source, expr->location(), Diag::sema_array_statement)
-                .range(expr->source_range());
-    }
     return expr;
 }
 
-auto Semantics::act_on_compound_stmt(std::vector<std::shared_ptr<ASTVarDecl>> decls,
-                                     std::vector<std::shared_ptr<ASTStmt>> stms)
+auto Semantics::act_on_compound_stmt(ArrayView<std::shared_ptr<ASTVarDecl>> decls,
+                                     ArrayView<std::shared_ptr<ASTStmt>> stms)
         -> std::shared_ptr<ASTCompoundStmt>
 {
-    return std::make_shared<ASTCompoundStmt>(std::move(decls), std::move(stms));
+    // Copy the childrens into exactly sized storage.
+    return std::make_shared<ASTCompoundStmt>(
+            std::vector(std::make_move_iterator(decls.begin()),
+                        std::make_move_iterator(decls.end())),
+            std::vector(std::make_move_iterator(stms.begin()),
+                        std::make_move_iterator(stms.end())));
 }
 
 auto Semantics::act_on_selection_stmt(std::shared_ptr<ASTExpr> expr,
@@ -268,11 +596,6 @@ auto Semantics::act_on_selection_stmt(std::shared_ptr<ASTExpr> expr,
                                       std::shared_ptr<ASTStmt> stmt2)
         -> std::shared_ptr<ASTSelectionStmt>
 {
-    if(expr->type() != ExprType::Int)
-    {
-        diagman.report(source, expr->location(), Diag::sema_expr_not_boolean)
-                .range(expr->source_range());
-    }
     return std::make_shared<ASTSelectionStmt>(std::move(expr),
                                               std::move(stmt1),
                                               std::move(stmt2));
@@ -282,11 +605,6 @@ auto Semantics::act_on_iteration_stmt(std::shared_ptr<ASTExpr> expr,
                                       std::shared_ptr<ASTStmt> stmt)
         -> std::shared_ptr<ASTIterationStmt>
 {
-    if(expr->type() != ExprType::Int)
-    {
-        diagman.report(source, expr->location(), Diag::sema_expr_not_boolean)
-                .range(expr->source_range());
-    }
     return std::make_shared<ASTIterationStmt>(std::move(expr), std::move(stmt));
 }
 
@@ -294,26 +612,7 @@ auto Semantics::act_on_return_stmt(std::shared_ptr<ASTExpr> expr,
                                    const Word& return_word)
         -> std::shared_ptr<ASTReturnStmt>
 {
-    if(expr)
-    {
-        if(this->is_current_fun_void)
-        {
-            diagman.report(source, return_word.location(),
-                           Diag::sema_void_fun_returning_value)
-                    .range(expr->source_range());
-        }
-        else if(expr->type() != ExprType::Int)
-        {
-            diagman.report(source, expr->location(), Diag::sema_incompatible_return_type)
-                    .range(expr->source_range());
-        }
-    }
-    else if(!this->is_current_fun_void)
-    {
-        diagman.report(source, return_word.location(),
-                       Diag::sema_int_fun_not_returning_value);
-    }
-    return std::make_shared<ASTReturnStmt>(std::move(expr));
+    return std::make_shared<ASTReturnStmt>(std::move(expr), return_word.location());
 }
 
 auto Semantics::act_on_number(const Word& word)
@@ -329,7 +628,7 @@ auto Semantics::act_on_var(const Word& name, std::shared_ptr<ASTExpr> index)
 {
     assert(name.category == Category::Identifier);
 
-    auto decl = current_scope->lookup(name.lexeme);
+    auto decl = symbols.lookup(name.lexeme);
     if(!decl)
     {
         diagman.report(source, name.location(),
@@ -346,12 +645,6 @@ auto Semantics::act_on_var(const Word& name, std::shared_ptr<ASTExpr> index)
         return nullptr; // TODO error recovery
     }
 
-    if(index && index->type() != ExprType::Int)
-    {
-        diagman.report(source, index->location(), Diag::sema_index_is_not_int)
-                .range(index->source_range());
-    }
-
     if(index && !var_decl->is_array())
     {
         diagman.report(source, index->location(), Diag::sema_index_is_not_int)
@@ -364,13 +657,13 @@ auto Semantics::act_on_var(const Word& name, std::shared_ptr<ASTExpr> index)
 }
 
 auto Semantics::act_on_call(const Word& name,
-                            std::vector<std::shared_ptr<ASTExpr>> args,
+                            ArrayView<std::shared_ptr<ASTExpr>> args,
                             SourceLocation rparenloc)
         -> std::shared_ptr<ASTFunCall>
 {
     assert(name.category == Category::Identifier);
 
-    auto decl = current_scope->lookup(name.lexeme);
+    auto decl = symbols.lookup(name.lexeme);
     if(!decl)
     {
         diagman.report(source, name.location(),
@@ -387,56 +680,12 @@ auto Semantics::act_on_call(const Word& name,
         return nullptr; // TODO error recovery
     }
 
-    for(size_t a = 0;; ++a)
-    {
-        if(a == args.size())
-        {
-            // We are over with arguments. So we should be over with
-            // parameters as well. Otherwise that is an error.
-            if(a != fun_decl->get_num_params())
-            {
-                diagman.report(source, name.location(),
-                               Diag::sema_arg_too_few_params)
-                        .range(name.lexeme);
-            }
-            break;
-        }
-        else if(a == fun_decl->get_num_params())
-        {
-            // We are over with parameters, but we aren't with arguments.
-            diagman.report(source, name.location(),
-                           Diag::sema_arg_too_many_params)
-                    .range(name.lexeme);
-            break;
-        }
-        else
-        {
-            // Still possible to match arguments and parameters.
-            auto& arg = args[a];
-            auto param = fun_decl->get_param(a);
-
-            if(arg->type() == ExprType::Void)
-            {
-                diagman.report(source, arg->location(),
-                               Diag::sema_arg_type_mismatch)
-                        .range(arg->source_range());
-                continue;
-            }
-
-            bool is_arg_array = (arg->type() == ExprType::Array);
-            if(is_arg_array != param->is_array())
-            {
-                diagman.report(source, arg->location(),
-                               Diag::sema_arg_type_mismatch)
-                        .range(arg->source_range());
-                continue;
-            }
-        }
-    }
-
     auto range = SourceRange(name.lexeme.begin(),
                              std::distance(name.lexeme.begin(), rparenloc));
-    return std::make_shared<ASTFunCall>(std::move(fun_decl), std::move(args), range);
+    return std::make_shared<ASTFunCall>(std::move(fun_decl),
+                                        std::vector(std::make_move_iterator(args.begin()),
+                                                    std::make_move_iterator(args.end())),
+                                        range);
 }
 
 auto Semantics::number_from_word(const Word& word) -> int32_t
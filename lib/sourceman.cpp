@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cassert>
+#include <cminus/mem-report.hpp>
 #include <cminus/sourceman.hpp>
 #include <cstring>
 
@@ -8,6 +9,8 @@ namespace cminus
 SourceFile::SourceFile(std::unique_ptr<char[]> source_data_a, size_t source_size_a) :
     source_data(std::move(source_data_a)), source_size(source_size_a)
 {
+    MemScope mem_scope(MemTag::Source);
+
     // Discover line locations.
     this->lines.push_back(&source_data[0]);
     for(size_t i = 0; i < source_size; ++i)
@@ -20,6 +23,8 @@ SourceFile::SourceFile(std::unique_ptr<char[]> source_data_a, size_t source_size
 auto SourceFile::from_stream(std::FILE* stream, size_t hint_size)
         -> std::optional<SourceFile>
 {
+    MemScope mem_scope(MemTag::Source);
+
     std::unique_ptr<char[]> source_data, temp_source_data;
     size_t source_size = 0; //< not including null terminator
 
@@ -81,6 +86,7 @@ auto SourceFile::view_with_terminator() const -> SourceRange
 
 auto SourceFile::make_source_range(std::string str) -> SourceRange
 {
+    MemScope mem_scope(MemTag::Source);
     auto [it, inserted] = this->vranges.emplace(std::move(str));
     return std::string_view(*it);
 }
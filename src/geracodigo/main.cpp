@@ -1,9 +1,21 @@
 #include <cminus/ast-codegen-visitor.hpp>
+#include <cminus/ast-dead-code-visitor.hpp>
+#include <cminus/ast-fold-visitor.hpp>
+#include <cminus/ast-hash-visitor.hpp>
+#include <cminus/ast-inline-visitor.hpp>
+#include <cminus/ast-lower-visitor.hpp>
+#include <cminus/ast-serialization.hpp>
+#include <cminus/ir-codegen.hpp>
+#include <cminus/ir-passes.hpp>
+#include <cminus/mem-report.hpp>
+#include <cminus/mips-peephole.hpp>
 #include <cminus/parser.hpp>
 #include <cminus/scanner.hpp>
 #include <cminus/semantics.hpp>
 #include <cminus/utility/contracts.hpp>
 #include <cminus/utility/scope_guard.hpp>
+#include <cinttypes>
+#include <cstdlib>
 #include <cstring>
 using namespace cminus;
 
@@ -31,11 +43,177 @@ syscall
 jr $ra
 )__mips__";
 
-int codegen(std::FILE* istream, std::FILE* ostream)
+struct Options
+{
+    /// Writes the binary AST instead of MIPS code.
+    bool emit_ast = false;
+    /// Reads a binary AST instead of a source file.
+    bool from_ast = false;
+    /// Writes the structural hash of the AST instead of MIPS code.
+    bool ast_hash = false;
+    /// Writes the intermediate representation instead of MIPS code.
+    bool emit_ir = false;
+    /// The optimization level of the generated code.
+    int opt_level = 0;
+    /// Prints the bounds checks elided from each function.
+    bool bounds_check_report = false;
+    /// Prints how much each peephole rule saved.
+    bool peephole_report = false;
+    /// Emits code for targets executing the delay slots of branches.
+    bool target_delay_slots = false;
+    /// Prints how many delay slots were filled and loads were scheduled.
+    bool schedule_report = false;
+};
+
+void print_bounds_check_report(const std::vector<ASTCodegenVisitor::BoundsCheckStats>& all_stats)
+{
+    std::fprintf(stderr, "%-20s %10s %10s %10s\n", "function", "checks", "removed", "hoisted");
+    for(auto& stats : all_stats)
+    {
+        std::fprintf(stderr, "%-20s %10zu %10zu %10zu\n", stats.function.c_str(),
+                     stats.num_checks, stats.num_removed, stats.num_hoisted);
+    }
+}
+
+void emit_program(ASTProgram& program, std::FILE* ostream, const Options& options)
+{
+    if(options.emit_ast)
+    {
+        std::string ast_data;
+        ASTSerializerVisitor visitor(ast_data);
+        visitor.visit_program(program);
+        std::fwrite(ast_data.data(), 1, ast_data.size(), ostream);
+        return;
+    }
+
+    if(options.ast_hash)
+    {
+        ASTHashVisitor visitor;
+        visitor.visit_program(program);
+        std::fprintf(ostream, "%016" PRIx64 "\n", visitor.get_hash());
+        return;
+    }
+
+    if(options.opt_level >= 1)
+    {
+        ASTInlineVisitor inliner;
+        inliner.visit_program(program);
+
+        ASTFoldVisitor folder;
+        folder.visit_program(program);
+
+        ASTDeadCodeVisitor dead_code;
+        dead_code.visit_program(program);
+    }
+
+    std::string codegen;
+    if(options.emit_ir || options.opt_level != 1)
+    {
+        IRModule module;
+        LowerOptions lower_options;
+        lower_options.bounds_check_elim = (options.opt_level >= 1);
+        ASTLowerVisitor lowerer(module, lower_options);
+        lowerer.visit_program(program);
+
+        if(options.bounds_check_report)
+            print_bounds_check_report(lowerer.get_bounds_check_stats());
+
+        if(options.opt_level >= 2)
+            optimize_ir(module);
+
+        if(options.emit_ir)
+        {
+            std::string ir_text;
+            print_ir(module, ir_text);
+            std::fwrite(ir_text.data(), 1, ir_text.size(), ostream);
+            return;
+        }
+
+        IRCodegenOptions ir_codegen_options;
+        ir_codegen_options.regalloc = (options.opt_level >= 2);
+        ir_codegen_options.strength_reduce = (options.opt_level >= 2);
+        IRCodegen ir_codegen(codegen, ir_codegen_options);
+        ir_codegen.emit_module(module);
+    }
+    else
+    {
+        ASTCodegenVisitor visitor(codegen, CodegenOptions::from_level(options.opt_level));
+        visitor.visit_program(program);
+
+        if(options.bounds_check_report)
+            print_bounds_check_report(visitor.get_bounds_check_stats());
+    }
+
+    if(options.opt_level >= 1)
+    {
+        PeepholeOptimizer peephole;
+        peephole.optimize(codegen);
+
+        if(options.peephole_report)
+        {
+            std::fprintf(stderr, "%-20s %10s %10s\n", "rule", "hits", "saved");
+            for(auto& stats : peephole.get_stats())
+            {
+                std::fprintf(stderr, "%-20s %10zu %10zu\n", stats.rule,
+                             stats.num_hits, stats.num_lines_saved);
+            }
+        }
+    }
+
+    if(options.target_delay_slots)
+    {
+        // The runtime needs its delay slots filled as well.
+        codegen += '\n';
+        codegen += crt_code;
+
+        MipsScheduler scheduler;
+        scheduler.schedule(codegen);
+        std::fprintf(ostream, "%s", codegen.c_str());
+
+        if(options.schedule_report)
+        {
+            const auto stats = scheduler.get_stats();
+            std::fprintf(stderr, "%-20s %10s %10s\n", "", "total", "scheduled");
+            std::fprintf(stderr, "%-20s %10zu %10zu\n", "delay slots",
+                         stats.num_slots, stats.num_slots_filled);
+            std::fprintf(stderr, "%-20s %10zu %10zu\n", "load uses",
+                         stats.num_load_uses, stats.num_load_uses_split);
+        }
+        return;
+    }
+
+    std::fprintf(ostream, "%s\n", codegen.c_str());
+    std::fprintf(ostream, "%*s\n", (int) crt_code.size(), crt_code.data());
+}
+
+int codegen_from_ast(std::FILE* istream, std::FILE* ostream, const Options& options)
+{
+    auto ast_file = ASTFile::from_stream(istream);
+    if(!ast_file)
+    {
+        std::perror("geracodigo: error");
+        return 1;
+    }
+
+    auto ast = ast_file->load_program();
+    if(!ast)
+    {
+        std::fprintf(stderr, "geracodigo: error: invalid or incompatible AST file\n");
+        return 1;
+    }
+
+    emit_program(*ast, ostream, options);
+    return 0;
+}
+
+int codegen(std::FILE* istream, std::FILE* ostream, const Options& options)
 {
     bool error = false;
     DiagnosticManager diagman;
 
+    if(options.from_ast)
+        return codegen_from_ast(istream, ostream, options);
+
     auto source = SourceFile::from_stream(istream);
     if(!source)
     {
@@ -48,20 +226,10 @@ int codegen(std::FILE* istream, std::FILE* ostream)
         return true;
     });
 
-    Scanner scanner(*source, diagman);
-    Semantics sema(*source, diagman);
-    Parser parser(scanner, sema, diagman);
-
-    if(auto ast = parser.parse_program())
+    if(auto ast = Parser::parse_program_parallel(*source, diagman))
     {
         if(!error)
-        {
-            std::string codegen;
-            ASTCodegenVisitor visitor(codegen);
-            visitor.visit_program(*ast);
-            std::fprintf(ostream, "%s\n", codegen.c_str());
-            std::fprintf(ostream, "%*s\n", (int) crt_code.size(), crt_code.data());
-        }
+            emit_program(*ast, ostream, options);
     }
 
     return 0;
@@ -69,9 +237,67 @@ int codegen(std::FILE* istream, std::FILE* ostream)
 
 int main(int argc, char* argv[])
 {
-    if(argc < 3)
+    Options options;
+
+    // Options come before the positional arguments. Notice a single dash
+    // is not an option, but the standard stream.
+    while(argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0')
+    {
+        if(!strcmp(argv[1], "--emit-ast"))
+            options.emit_ast = true;
+        else if(!strcmp(argv[1], "--from-ast"))
+            options.from_ast = true;
+        else if(!strcmp(argv[1], "--ast-hash"))
+            options.ast_hash = true;
+        else if(!strcmp(argv[1], "--emit-ir"))
+            options.emit_ir = true;
+        else if(!strcmp(argv[1], "-O0") || !strcmp(argv[1], "-O1")
+                || !strcmp(argv[1], "-O2"))
+            options.opt_level = argv[1][2] - '0';
+        else if(!strcmp(argv[1], "-fmem-report"))
+        {
+            enable_mem_tracking();
+            std::atexit([] { mem_report(stderr); });
+        }
+        else if(!strcmp(argv[1], "-fbounds-check-report"))
+            options.bounds_check_report = true;
+        else if(!strcmp(argv[1], "-fpeephole-report"))
+            options.peephole_report = true;
+        else if(!strcmp(argv[1], "--target-delay-slots"))
+            options.target_delay_slots = true;
+        else if(!strcmp(argv[1], "-fschedule-report"))
+            options.schedule_report = true;
+        else
+        {
+            std::fprintf(stderr, "geracodigo: error: unknown option %s\n", argv[1]);
+            return 1;
+        }
+        --argc;
+        ++argv;
+    }
+
+    if(argc < 3 || (options.emit_ast && (options.from_ast || options.ast_hash))
+       || (options.emit_ir && (options.emit_ast || options.ast_hash)))
+    {
+        std::fprintf(stderr, "usage: ./geracodigo [--emit-ast | --from-ast] [--ast-hash | --emit-ir] [-O0 | -O1 | -O2] [-fmem-report] [-fbounds-check-report] [-fpeephole-report] [--target-delay-slots] [-fschedule-report] <source-file> <out-file>\n");
+        return 1;
+    }
+
+    if(options.bounds_check_report && options.opt_level == 0)
+    {
+        std::fprintf(stderr, "geracodigo: error: -fbounds-check-report requires -O1 or -O2\n");
+        return 1;
+    }
+
+    if(options.peephole_report && options.opt_level == 0)
+    {
+        std::fprintf(stderr, "geracodigo: error: -fpeephole-report requires -O1 or -O2\n");
+        return 1;
+    }
+
+    if(options.schedule_report && !options.target_delay_slots)
     {
-        std::fprintf(stderr, "usage: ./geracodigo <source-file> <out-file>\n");
+        std::fprintf(stderr, "geracodigo: error: -fschedule-report requires --target-delay-slots\n");
         return 1;
     }
 
@@ -111,5 +337,5 @@ int main(int argc, char* argv[])
         }
     }
 
-    return codegen(istream, ostream);
+    return codegen(istream, ostream, options);
 }
@@ -1,6 +1,8 @@
+#include <cminus/mem-report.hpp>
 #include <cminus/scanner.hpp>
 #include <cminus/utility/contracts.hpp>
 #include <cminus/utility/scope_guard.hpp>
+#include <cstdlib>
 #include <cstring>
 using namespace cminus;
 
@@ -93,9 +95,27 @@ int lexico(std::FILE* istream, std::FILE* ostream)
 
 int main(int argc, char* argv[])
 {
+    // Options come before the positional arguments. Notice a single dash
+    // is not an option, but the standard stream.
+    while(argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0')
+    {
+        if(!strcmp(argv[1], "-fmem-report"))
+        {
+            enable_mem_tracking();
+            std::atexit([] { mem_report(stderr); });
+        }
+        else
+        {
+            std::fprintf(stderr, "lexico: error: unknown option %s\n", argv[1]);
+            return 1;
+        }
+        --argc;
+        ++argv;
+    }
+
     if(argc < 3)
     {
-        std::fprintf(stderr, "usage: ./lexico <source-file> <out-file>\n");
+        std::fprintf(stderr, "usage: ./lexico [-fmem-report] <source-file> <out-file>\n");
         return 1;
     }
 
@@ -2,12 +2,75 @@
 #include <cminus/parser.hpp>
 #include <cminus/scanner.hpp>
 #include <cminus/semantics.hpp>
+#include <cminus/mem-report.hpp>
 #include <cminus/utility/contracts.hpp>
 #include <cminus/utility/scope_guard.hpp>
+#include <cstdlib>
 #include <cstring>
 using namespace cminus;
 
-int sintatico(std::FILE* istream, std::FILE* ostream)
+auto diag_to_string(Diag code) -> std::string_view
+{
+    switch(code)
+    {
+        case Diag::lexer_bad_number:
+            return "lexer_bad_number";
+        case Diag::lexer_bad_char:
+            return "lexer_bad_char";
+        case Diag::lexer_unclosed_comment:
+            return "lexer_unclosed_comment";
+        case Diag::parser_expected_token:
+            return "parser_expected_token";
+        case Diag::parser_expected_type:
+            return "parser_expected_type";
+        case Diag::parser_expected_expression:
+            return "parser_expected_expression";
+        case Diag::parser_expected_statement:
+            return "parser_expected_statement";
+        case Diag::parser_number_too_big:
+            return "parser_number_too_big";
+        case Diag::sema_redefinition:
+            return "sema_redefinition";
+        case Diag::sema_undeclared_identifier:
+            return "sema_undeclared_identifier";
+        case Diag::sema_empty_program:
+            return "sema_empty_program";
+        case Diag::sema_last_decl_not_main:
+            return "sema_last_decl_not_main";
+        case Diag::sema_var_cannot_be_void:
+            return "sema_var_cannot_be_void";
+        case Diag::sema_assignment_type_error:
+            return "sema_assignment_type_error";
+        case Diag::sema_binary_expr_type_error:
+            return "sema_binary_expr_type_error";
+        case Diag::sema_array_statement:
+            return "sema_array_statement";
+        case Diag::sema_expr_not_boolean:
+            return "sema_expr_not_boolean";
+        case Diag::sema_void_fun_returning_value:
+            return "sema_void_fun_returning_value";
+        case Diag::sema_incompatible_return_type:
+            return "sema_incompatible_return_type";
+        case Diag::sema_int_fun_not_returning_value:
+            return "sema_int_fun_not_returning_value";
+        case Diag::sema_var_is_not_var:
+            return "sema_var_is_not_var";
+        case Diag::sema_index_is_not_int:
+            return "sema_index_is_not_int";
+        case Diag::sema_fun_is_not_fun:
+            return "sema_fun_is_not_fun";
+        case Diag::sema_arg_too_few_params:
+            return "sema_arg_too_few_params";
+        case Diag::sema_arg_too_many_params:
+            return "sema_arg_too_many_params";
+        case Diag::sema_arg_type_mismatch:
+            return "sema_arg_type_mismatch";
+        default:
+            cminus_unreachable();
+    }
+}
+
+int sintatico(std::FILE* istream, std::FILE* ostream, bool diagnostics_report)
 {
     bool error = false;
     DiagnosticManager diagman;
@@ -19,23 +82,31 @@ int sintatico(std::FILE* istream, std::FILE* ostream)
         return 1;
     }
 
-    diagman.handler([&](const Diagnostic&) {
+    diagman.handler([&](const Diagnostic& diag) {
         error = true;
+        if(diagnostics_report)
+        {
+            auto [line, column] = source->find_line_and_column(diag.loc);
+            auto name = diag_to_string(diag.code);
+            std::fprintf(stderr, "%u:%u: %.*s\n", line, column,
+                         static_cast<int>(name.size()), name.data());
+        }
         return true;
     });
 
-    Scanner scanner(*source, diagman);
-    Semantics sema(*source, diagman);
-    Parser parser(scanner, sema, diagman);
-
-    if(auto ast = parser.parse_program())
+    if(auto ast = Parser::parse_program_parallel(*source, diagman))
     {
         if(!error)
         {
-            std::string ast_dump;
-            ASTDumpVisitor visitor(ast_dump);
+            OutputSink sink(ostream);
+            ASTDumpVisitor visitor(sink);
             visitor.visit_program(*ast);
-            std::fprintf(ostream, "%s\n", ast_dump.c_str());
+            sink.push_back('\n');
+            if(!sink.flush())
+            {
+                std::perror("sintatico: error");
+                return 1;
+            }
         }
     }
 
@@ -44,9 +115,31 @@ int sintatico(std::FILE* istream, std::FILE* ostream)
 
 int main(int argc, char* argv[])
 {
+    bool diagnostics_report = false;
+
+    // Options come before the positional arguments. Notice a single dash
+    // is not an option, but the standard stream.
+    while(argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0')
+    {
+        if(!strcmp(argv[1], "-fmem-report"))
+        {
+            enable_mem_tracking();
+            std::atexit([] { mem_report(stderr); });
+        }
+        else if(!strcmp(argv[1], "-fdiagnostics-report"))
+            diagnostics_report = true;
+        else
+        {
+            std::fprintf(stderr, "sintatico: error: unknown option %s\n", argv[1]);
+            return 1;
+        }
+        --argc;
+        ++argv;
+    }
+
     if(argc < 3)
     {
-        std::fprintf(stderr, "usage: ./sintatico <source-file> <out-file>\n");
+        std::fprintf(stderr, "usage: ./sintatico [-fmem-report] [-fdiagnostics-report] <source-file> <out-file>\n");
         return 1;
     }
 
@@ -86,5 +179,5 @@ int main(int argc, char* argv[])
         }
     }
 
-    return sintatico(istream, ostream);
+    return sintatico(istream, ostream, diagnostics_report);
 }
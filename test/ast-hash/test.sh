@@ -0,0 +1,40 @@
+#!/bin/sh
+GERACODIGO=../../geracodigo
+tempfile=$(mktemp)
+tempout=$(mktemp)
+exit_code=0
+
+# Programs differing only by naming and formatting must hash equally.
+for infile in *.renamed.in; do
+    [ -f "$infile" ] || break
+    origfile="${infile%.renamed.in}.in"
+
+    printf "Testing $infile... "
+    $GERACODIGO --ast-hash "$origfile" "$tempout"
+    if $GERACODIGO --ast-hash "$infile" - | diff - "$tempout" >$tempfile; then
+        printf "\033[0;32mOK\033[0m\n"
+    else
+        printf "\033[0;31mFAILED\033[0m\n"
+        cat "$tempfile"
+        exit_code=1
+    fi
+done
+
+# Programs differing in meaning must not.
+for infile in *.changed.in; do
+    [ -f "$infile" ] || break
+    origfile="${infile%.changed.in}.in"
+
+    printf "Testing $infile... "
+    $GERACODIGO --ast-hash "$origfile" "$tempout"
+    if $GERACODIGO --ast-hash "$infile" - | diff - "$tempout" >$tempfile; then
+        printf "\033[0;31mFAILED\033[0m\n"
+        printf "hashes are equal\n"
+        exit_code=1
+    else
+        printf "\033[0;32mOK\033[0m\n"
+    fi
+done
+rm "$tempout"
+rm "$tempfile"
+exit $exit_code
@@ -2,21 +2,75 @@
 GERACODIGO=../../geracodigo
 tempfile=$(mktemp)
 tempout=$(mktemp)
+tempast=$(mktemp)
+tempref=$(mktemp)
 exit_code=0
 for infile in *.in; do
     [ -f "$infile" ] || break
     stdin_file="${infile%.*}.stdin"
     stdout_file="${infile%.*}.stdout"
 
-    printf "Testing $infile... "
-    if $GERACODIGO "$infile" "$tempout" && spim -f "$tempout" < "$stdin_file" | sed -e '0,/^Loaded:/d' | diff - "$stdout_file" >$tempfile; then
+    for flags in -O0 -O1 -O2 "-O0 --target-delay-slots" "-O1 --target-delay-slots" "-O2 --target-delay-slots"; do
+        case "$flags" in
+            *--target-delay-slots*) spim_flags=-delayed_branches ;;
+            *) spim_flags= ;;
+        esac
+        printf "Testing $infile ($flags)... "
+        if $GERACODIGO $flags "$infile" "$tempout" && spim $spim_flags -f "$tempout" < "$stdin_file" | sed -e '0,/^Loaded:/d' | diff - "$stdout_file" >$tempfile; then
+            printf "\033[0;32mOK\033[0m\n"
+        else
+            printf "\033[0;31mFAILED\033[0m\n"
+            cat "$tempfile"
+            exit_code=1
+        fi
+    done
+
+    # Code generated from the cached AST must match the one from source.
+    for flags in -O0 -O1 -O2; do
+        printf "Testing $infile ($flags --emit-ast, --from-ast)... "
+        if $GERACODIGO $flags "$infile" "$tempref" && $GERACODIGO --emit-ast "$infile" "$tempast" \
+           && $GERACODIGO --from-ast $flags "$tempast" "$tempout" && cmp "$tempref" "$tempout" >$tempfile; then
+            printf "\033[0;32mOK\033[0m\n"
+        else
+            printf "\033[0;31mFAILED\033[0m\n"
+            cat "$tempfile"
+            exit_code=1
+        fi
+    done
+
+    # A truncated AST file must be rejected rather than half translated.
+    printf "Testing $infile (truncated --from-ast)... "
+    size=$(wc -c <"$tempast")
+    head -c $((size / 2)) "$tempast" >"$tempref"
+    if $GERACODIGO --from-ast "$tempref" "$tempout" 2>/dev/null; then
+        printf "\033[0;31mFAILED\033[0m\n"
+        exit_code=1
+    else
+        printf "\033[0;32mOK\033[0m\n"
+    fi
+done
+# Translation time must grow linearly with the size of the program, which
+# is generated with many functions and a long main.
+awk 'BEGIN {
+    for(i = 0; i < 500; ++i)
+        printf "int f%d(int a)\n{\n    return a + %d;\n}\n", i, i;
+    printf "void main(void)\n{\n    int x;\n    x = input();\n";
+    for(i = 0; i < 2000; ++i)
+        printf "    x = f%d(x) * %d;\n    println(x);\n", i % 500, i % 5 + 1;
+    printf "}\n";
+}' >"$tempref"
+for flags in -O0 -O1 -O2 "-O2 --target-delay-slots"; do
+    printf "Testing large program ($flags)... "
+    if timeout 10 $GERACODIGO $flags "$tempref" "$tempout"; then
         printf "\033[0;32mOK\033[0m\n"
     else
         printf "\033[0;31mFAILED\033[0m\n"
-        cat "$tempfile"
         exit_code=1
     fi
 done
+
 rm "$tempout"
+rm "$tempast"
+rm "$tempref"
 rm "$tempfile"
 exit $exit_code
@@ -17,6 +17,32 @@ for infile in *.in; do
         exit_code=1
     fi
 done
+
+# Every diagnostic must be reported, not only the first one.
+for diagfile in *.diag; do
+    [ -f "$diagfile" ] || break
+    infile="${diagfile%.*}.in"
+
+    printf "Testing diagnostics of $infile... "
+    if $SINTATICO -fdiagnostics-report "$infile" - 2>&1 >/dev/null | diff - "$diagfile" >$tempfile; then
+        printf "\033[0;32mOK\033[0m\n"
+    else
+        printf "\033[0;31mFAILED\033[0m\n"
+        cat "$tempfile"
+        exit_code=1
+    fi
+done
+
+# The dump must fail rather than be silently truncated.
+if [ -w /dev/full ]; then
+    printf "Testing short writes... "
+    if $SINTATICO test-call-simple.in /dev/full 2>/dev/null; then
+        printf "\033[0;31mFAILED\033[0m\n"
+        exit_code=1
+    else
+        printf "\033[0;32mOK\033[0m\n"
+    fi
+fi
 rm "$tempout"
 rm "$tempfile"
 exit $exit_code
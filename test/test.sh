@@ -8,6 +8,10 @@ echo "Testing parser..."
 cd sintatico
 sh ./test.sh
 cd ..
+echo "Testing structural hash..."
+cd ast-hash
+sh ./test.sh
+cd ..
 echo "Testing code generation..."
 cd geracodigo
 sh ./test.sh